@@ -37,8 +37,14 @@ func GetPackage() *denv.Package {
 	maintest.AddDependencies(cunittestpkg.GetMainLib())
 	maintest.AddDependency(testlib)
 
+	// benchmark application, source/bench/cpp
+	benchapp := denv.SetupCppAppProject(mainpkg, name+"_bench", "bench")
+	benchapp.AddDependencies(cbasepkg.GetMainLib())
+	benchapp.AddDependency(mainlib)
+
 	mainpkg.AddMainLib(mainlib)
 	mainpkg.AddTestLib(testlib)
 	mainpkg.AddUnittest(maintest)
+	mainpkg.AddMainApp(benchapp)
 	return mainpkg
 }
@@ -0,0 +1,94 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+#include "ctext/c_parser2.h"
+#include "ctext/c_text_csv.h"
+#include "ctext/c_text_stream.h"
+
+#include "c_bench.h"
+
+namespace ncore
+{
+    namespace nbench
+    {
+        // Counts the fields of the rows with the CSV reader
+        static s64 csv_fields(corpus_t const& csv, bool view, counting_alloc_t* allocator, buffer_t memory, ncsv::config_t const& config)
+        {
+            corpus_stream_t stream(csv, view);
+            text_stream_t   text(&stream, text_stream_t::encoding_ascii, allocator, 65536);
+            ncsv::reader_t  reader(text, memory, config);
+            ncsv::batch_t   batch;
+            s64             fields = 0;
+            while (reader.read(batch))
+            {
+                for (s32 r = 0; r < batch.m_rows; ++r)
+                    fields += batch.m_widths[r];
+            }
+            text.close();
+            return fields;
+        }
+
+        // Counts the fields of the lines with a parser2 program that skips until the next delimiter or line end
+        static s64 parser2_fields(corpus_t const& csv, counting_alloc_t* allocator, parser2::parser_t::program_t field)
+        {
+            corpus_stream_t stream(csv, true);
+            text_stream_t   text(&stream, text_stream_t::encoding_ascii, allocator, 65536);
+            crunes_t        line;
+            s64             fields = 0;
+            while (text.readLine(line))
+            {
+                nrunes::reader_t reader(line);
+                while (parser2::parser_t::parse(field, reader))
+                    fields += 1;
+            }
+            text.close();
+            return fields;
+        }
+
+        void bench_csv(corpus_t const& corpus, counting_alloc_t* allocator)
+        {
+            // The corpus as CSV, the tokens of a line are its fields
+            corpus_t csv = corpus;
+            csv.m_text   = (char*)allocator->m_allocator->allocate(corpus.m_size);
+            for (u32 i = 0; i < corpus.m_size; ++i)
+                csv.m_text[i] = (corpus.m_text[i] == ' ') ? ',' : corpus.m_text[i];
+
+            ncsv::config_t config;
+            config.m_max_rows    = 256;
+            config.m_max_columns = 64;
+            u32 const memory_size = ncsv::reader_t::required(config);
+            u8*       memory      = (u8*)allocator->m_allocator->allocate(memory_size);
+
+            u8                           data[4096];
+            parser2::parser_t            parser(buffer_t(data, data + sizeof(data)));
+            parser2::parser_t::program_t field = parser.Until(parser.In(ascii::make_crunes(",\n")));
+
+            const char* names[] = {"fields/reader/view", "fields/reader/read", "fields/parser2"};
+            for (s32 c = 0; c < 3; ++c)
+            {
+                result_t  result = {"csv", names[c], csv.m_size, 0, 0, 0, 0, 0, 0};
+                s64 const allocs = allocator->m_allocs;
+                u64 const begin  = now_ns();
+                u64       end    = begin;
+                while ((end - begin) < cMinTimeNs)
+                {
+                    if (c < 2)
+                        result.m_items = csv_fields(csv, c == 0, allocator, buffer_t(memory, memory + memory_size), config);
+                    else
+                        result.m_items = parser2_fields(csv, allocator, field);
+                    result.m_iterations += 1;
+                    result.m_bytes += csv.m_size;
+                    end = now_ns();
+                }
+                result.m_ns     = end - begin;
+                result.m_allocs = allocator->m_allocs - allocs;
+                report(result);
+            }
+
+            allocator->m_allocator->deallocate(memory);
+            allocator->m_allocator->deallocate(csv.m_text);
+        }
+
+    } // namespace nbench
+} // namespace ncore
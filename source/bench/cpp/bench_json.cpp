@@ -0,0 +1,139 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+#include "ctext/c_parser2.h"
+#include "ctext/c_text_json.h"
+#include "ctext/c_text_stream.h"
+
+#include "c_bench.h"
+
+namespace ncore
+{
+    namespace nbench
+    {
+        static u32 write_text(char* text, u32 size, const char* s)
+        {
+            while (*s != 0)
+                text[size++] = *s++;
+            return size;
+        }
+
+        static u32 write_number(char* text, u32 size, u32 value)
+        {
+            char digits[10];
+            s32  n = 0;
+            do
+            {
+                digits[n++] = (char)('0' + (value % 10));
+                value /= 10;
+            } while (value != 0);
+            while (n > 0)
+                text[size++] = digits[--n];
+            return size;
+        }
+
+        // The corpus as JSON Lines, every line becomes {"ts":<line>,"level":"info","tokens":[...],"user":{"id":<line>}}
+        // with the tokens of the line as strings
+        static u32 json_corpus(corpus_t const& corpus, char* text)
+        {
+            char const* corpus_text = corpus.m_text;
+            u32         size        = 0;
+            u32         line        = 0;
+            u32         i           = 0;
+            while (i < corpus.m_size)
+            {
+                u32 eol = i;
+                while (eol < corpus.m_size && corpus_text[eol] != '\n')
+                    eol += 1;
+
+                size = write_text(text, size, "{\"ts\":");
+                size = write_number(text, size, line);
+                size = write_text(text, size, ",\"level\":\"info\",\"tokens\":[");
+                for (u32 t = i; t < eol;)
+                {
+                    u32 e = t;
+                    while (e < eol && corpus_text[e] != ' ')
+                        e += 1;
+                    if (t > i)
+                        text[size++] = ',';
+                    text[size++] = '"';
+                    for (u32 j = t; j < e; ++j)
+                        text[size++] = corpus_text[j];
+                    text[size++] = '"';
+                    t = e + 1;
+                }
+                size = write_text(text, size, "],\"user\":{\"id\":");
+                size = write_number(text, size, line++);
+                size = write_text(text, size, "}}\n");
+                i = eol + 1;
+            }
+            return size;
+        }
+
+        void bench_json(corpus_t const& corpus, counting_alloc_t* allocator)
+        {
+            corpus_t json = corpus;
+            json.m_text   = (char*)allocator->m_allocator->allocate(corpus.m_size * 2 + corpus.m_lines * 96);
+            json.m_size   = json_corpus(corpus, json.m_text);
+
+            u32 const memory_size = njson::document_t::required(4096);
+            u8*       memory      = (u8*)allocator->m_allocator->allocate(memory_size);
+
+            // The parser2 version searches the line for the key and reads the number after it
+            u8                           data[4096];
+            parser2::parser_t            parser(buffer_t(data, data + sizeof(data)));
+            parser2::parser_t::program_t id = parser.Sequence(parser.Exact(ascii::make_crunes("\"id\":")), parser.Integer64());
+
+            const char* names[] = {"index", "find/user.id", "find/user.id/parser2"};
+            for (s32 c = 0; c < 3; ++c)
+            {
+                result_t  result = {"json", names[c], json.m_size, 0, 0, 0, 0, 0, 0};
+                s64 const allocs = allocator->m_allocs;
+                u64 const begin  = now_ns();
+                u64       end    = begin;
+                while ((end - begin) < cMinTimeNs)
+                {
+                    corpus_stream_t   stream(json, true);
+                    text_stream_t     text(&stream, text_stream_t::encoding_ascii, allocator, 65536);
+                    njson::document_t document(buffer_t(memory, memory + memory_size));
+                    s64               items = 0;
+                    if (c < 2)
+                    {
+                        while (document.read(text))
+                        {
+                            s64 value = 0;
+                            if (c == 0)
+                                items += document.structurals();
+                            else if (document.as_s64(document.find("user.id"), value))
+                                items += 1;
+                        }
+                    }
+                    else
+                    {
+                        crunes_t line;
+                        while (text.readLine(line))
+                        {
+                            nrunes::reader_t reader(line);
+                            nrunes::reader_t match;
+                            items += parser2::parser_t::find(id, reader, match) ? 1 : 0;
+                        }
+                    }
+                    text.close();
+
+                    result.m_items = items;
+                    result.m_iterations += 1;
+                    result.m_bytes += json.m_size;
+                    end = now_ns();
+                }
+                result.m_ns     = end - begin;
+                result.m_allocs = allocator->m_allocs - allocs;
+                report(result);
+            }
+
+            allocator->m_allocator->deallocate(memory);
+            allocator->m_allocator->deallocate(json.m_text);
+        }
+
+    } // namespace nbench
+} // namespace ncore
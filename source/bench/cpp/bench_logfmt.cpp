@@ -0,0 +1,139 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+#include "ctext/c_parser2.h"
+#include "ctext/c_text_logfmt.h"
+#include "ctext/c_text_stream.h"
+
+#include "c_bench.h"
+
+namespace ncore
+{
+    namespace nbench
+    {
+        // The corpus as logfmt, every line becomes "ts=<line>" followed by its tokens as the values of the keys
+        // f0 to f7, every fourth value is quoted and holds two tokens
+        static u32 logfmt_corpus(corpus_t const& corpus, char* text)
+        {
+            char const* corpus_text = corpus.m_text;
+            u32         size        = 0;
+            u32         line        = 0;
+            u32         i           = 0;
+            while (i < corpus.m_size)
+            {
+                u32 eol = i;
+                while (eol < corpus.m_size && corpus_text[eol] != '\n')
+                    eol += 1;
+
+                char digits[10];
+                s32  n     = 0;
+                u32  value = line++;
+                do
+                {
+                    digits[n++] = (char)('0' + (value % 10));
+                    value /= 10;
+                } while (value != 0);
+                text[size++] = 't';
+                text[size++] = 's';
+                text[size++] = '=';
+                while (n > 0)
+                    text[size++] = digits[--n];
+
+                s32 column = 0;
+                for (u32 t = i; t < eol; column += 1)
+                {
+                    u32 e = t;
+                    while (e < eol && corpus_text[e] != ' ')
+                        e += 1;
+                    bool const quoted = (column & 3) == 3 && e < eol;
+                    if (quoted)
+                    {
+                        for (e += 1; e < eol && corpus_text[e] != ' ';)
+                            e += 1;
+                    }
+
+                    text[size++] = ' ';
+                    text[size++] = 'f';
+                    text[size++] = (char)('0' + (column & 7));
+                    text[size++] = '=';
+                    if (quoted)
+                        text[size++] = '"';
+                    for (u32 j = t; j < e; ++j)
+                        text[size++] = corpus_text[j];
+                    if (quoted)
+                        text[size++] = '"';
+                    t = e + 1;
+                }
+                text[size++] = '\n';
+                i = eol + 1;
+            }
+            return size;
+        }
+
+        void bench_logfmt(corpus_t const& corpus, counting_alloc_t* allocator)
+        {
+            corpus_t logfmt = corpus;
+            logfmt.m_text   = (char*)allocator->m_allocator->allocate(corpus.m_size * 3 + corpus.m_lines * 16);
+            logfmt.m_size   = logfmt_corpus(corpus, logfmt.m_text);
+
+            const char*     wanted[] = {"f2", "f5"};
+            const char*     finds[]  = {"f2=", "f5="};
+            u8              keys_memory[256];
+            nlogfmt::keys_t keys(buffer_t(keys_memory, keys_memory + sizeof(keys_memory)));
+            keys.build(wanted, 2);
+
+            // The parser2 version finds every wanted key with a program of its own
+            u8                           data[4096];
+            parser2::parser_t            parser(buffer_t(data, data + sizeof(data)));
+            parser2::parser_t::program_t programs[2];
+            for (s32 k = 0; k < 2; ++k)
+                programs[k] = parser.Sequence(parser.Exact(ascii::make_crunes(finds[k])), parser.Until(parser.In(ascii::make_crunes(" \n"))));
+
+            const char* names[] = {"extract/2 keys", "tokenize/all pairs", "extract/2 keys/parser2"};
+            for (s32 c = 0; c < 3; ++c)
+            {
+                result_t  result = {"logfmt", names[c], logfmt.m_size, 0, 0, 0, 0, 0, 0};
+                s64 const allocs = allocator->m_allocs;
+                u64 const begin  = now_ns();
+                u64       end    = begin;
+                while ((end - begin) < cMinTimeNs)
+                {
+                    corpus_stream_t stream(logfmt, true);
+                    text_stream_t   text(&stream, text_stream_t::encoding_ascii, allocator, 65536);
+                    crunes_t        line;
+                    nlogfmt::pair_t pairs[64];
+                    s64             items = 0;
+                    while (text.readLine(line))
+                    {
+                        if (c == 0)
+                            items += nlogfmt::extract(line, keys, pairs);
+                        else if (c == 1)
+                            items += nlogfmt::tokenize(line, pairs, 64);
+                        else
+                        {
+                            for (s32 k = 0; k < 2; ++k)
+                            {
+                                nrunes::reader_t reader(line);
+                                nrunes::reader_t match;
+                                items += parser2::parser_t::find(programs[k], reader, match) ? 1 : 0;
+                            }
+                        }
+                    }
+                    text.close();
+
+                    result.m_items = items;
+                    result.m_iterations += 1;
+                    result.m_bytes += logfmt.m_size;
+                    end = now_ns();
+                }
+                result.m_ns     = end - begin;
+                result.m_allocs = allocator->m_allocs - allocs;
+                report(result);
+            }
+
+            allocator->m_allocator->deallocate(logfmt.m_text);
+        }
+
+    } // namespace nbench
+} // namespace ncore
@@ -0,0 +1,105 @@
+#include "ccore/c_target.h"
+#include "cbase/c_base.h"
+#include "cbase/c_allocator.h"
+#include "cbase/c_context.h"
+#include "ctext/c_text_corpus.h"
+
+#include "c_bench.h"
+
+#include <chrono>
+#include <cstdio>
+
+namespace ncore
+{
+    namespace nbench
+    {
+        bool corpus_create(corpus_t& corpus, alloc_t* allocator, u32 size, u32 seed)
+        {
+            corpus.m_text  = (char*)allocator->allocate(size);
+            corpus.m_size  = 0;
+            corpus.m_lines = 0;
+            if (corpus.m_text == nullptr)
+                return false;
+
+            ncorpus::config_t config;
+            config.m_seed     = seed;
+            config.m_max_line = 200;
+            config.m_emails   = 10;
+            config.m_ipv4     = 10;
+            config.m_hosts    = 10;
+            corpus.m_size     = ncorpus::generate(config, (u8*)corpus.m_text, size, corpus.m_lines);
+            return true;
+        }
+
+        void corpus_destroy(corpus_t& corpus, alloc_t* allocator)
+        {
+            allocator->deallocate(corpus.m_text);
+            corpus.m_text = nullptr;
+            corpus.m_size = 0;
+        }
+
+        void report(result_t const& result)
+        {
+            f64 const seconds = (f64)result.m_ns / 1.0e9;
+            f64 const mbps    = (seconds > 0.0) ? ((f64)result.m_bytes / (1024.0 * 1024.0)) / seconds : 0.0;
+            printf("{\"suite\":\"%s\",\"case\":\"%s\",\"corpus\":%u,\"iterations\":%lld,\"bytes\":%llu,\"items\":%lld,\"ns\":%llu,\"mb_per_s\":%.1f,\"allocs\":%lld", result.m_suite, result.m_case, result.m_corpus, (long long)result.m_iterations,
+                   (unsigned long long)result.m_bytes, (long long)result.m_items, (unsigned long long)result.m_ns, mbps, (long long)result.m_allocs);
+            if (result.m_code != 0)
+                printf(",\"code\":%u", result.m_code);
+            printf("}\n");
+            fflush(stdout);
+        }
+
+        u64 now_ns() { return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+    } // namespace nbench
+} // namespace ncore
+
+// Usage: ctext_bench [size ...], the sizes of the corpora in KB (default 64, 1024 and 16384).
+// Results go to stdout as JSON lines, see result_t.
+int main(int argc, char** argv)
+{
+    using namespace ncore;
+
+    cbase::init();
+
+    alloc_t*                 system = context_t::system_alloc();
+    nbench::counting_alloc_t counting(system);
+    context_t::set_system_alloc(&counting);
+
+    u32 sizes[16] = {64, 1024, 16384};
+    s32 num_sizes = 3;
+    if (argc > 1)
+    {
+        num_sizes = 0;
+        for (s32 i = 1; i < argc && num_sizes < 16; ++i)
+        {
+            u32 kb = 0;
+            for (const char* c = argv[i]; *c >= '0' && *c <= '9'; ++c)
+                kb = (kb * 10) + (u32)(*c - '0');
+            if (kb > 0)
+                sizes[num_sizes++] = kb;
+        }
+    }
+
+    for (s32 i = 0; i < num_sizes; ++i)
+    {
+        nbench::corpus_t corpus;
+        if (!nbench::corpus_create(corpus, system, sizes[i] * 1024, 0x5eed))
+            continue;
+        nbench::bench_text_stream(corpus, &counting);
+        nbench::bench_parser2(corpus, &counting);
+        nbench::bench_parser3(corpus, &counting);
+        nbench::bench_combparser(corpus, &counting);
+        nbench::bench_pipeline(corpus, &counting);
+        nbench::bench_scheduler(corpus, &counting);
+        nbench::bench_csv(corpus, &counting);
+        nbench::bench_logfmt(corpus, &counting);
+        nbench::bench_json(corpus, &counting);
+        nbench::corpus_destroy(corpus, system);
+    }
+
+    context_t::set_system_alloc(system);
+    cbase::exit();
+    return 0;
+}
@@ -0,0 +1,355 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+#include "cbase/c_va_list.h"
+#include "ctext/c_parser.h"
+#include "ctext/c_parser2.h"
+#include "ctext/c_parser3.h"
+
+#include "c_bench.h"
+
+namespace ncore
+{
+    namespace nbench
+    {
+        // Runs 'check' on every token (text between spaces and line ends) of the corpus, returns the number of
+        // tokens that match
+        template <typename C> static s64 check_tokens(corpus_t const& corpus, C& check)
+        {
+            s64         matches = 0;
+            char const* text    = corpus.m_text;
+            u32         begin   = 0;
+            for (u32 i = 0; i < corpus.m_size; ++i)
+            {
+                if (text[i] != ' ' && text[i] != '\n')
+                    continue;
+                if (i > begin)
+                {
+                    nrunes::reader_t reader(make_crunes((ascii::pcrune)text, begin, i, i));
+                    matches += check(reader) ? 1 : 0;
+                }
+                begin = i + 1;
+            }
+            return matches;
+        }
+
+        // Runs 'check' on every line of the corpus, returns the number of lines that match
+        template <typename C> static s64 check_lines(corpus_t const& corpus, C& check)
+        {
+            s64         matches = 0;
+            char const* text    = corpus.m_text;
+            u32         begin   = 0;
+            for (u32 i = 0; i < corpus.m_size; ++i)
+            {
+                if (text[i] != '\n')
+                    continue;
+                nrunes::reader_t reader(make_crunes((ascii::pcrune)text, begin, i + 1, i + 1));
+                matches += check(reader) ? 1 : 0;
+                begin = i + 1;
+            }
+            return matches;
+        }
+
+        template <typename C> static void run(corpus_t const& corpus, counting_alloc_t* allocator, const char* suite, const char* name, C& check, u32 code = 0)
+        {
+            result_t  result = {suite, name, corpus.m_size, 0, 0, 0, 0, 0, code};
+            s64 const allocs = allocator->m_allocs;
+            u64 const begin  = now_ns();
+            u64       end    = begin;
+            while ((end - begin) < cMinTimeNs)
+            {
+                result.m_items = check(corpus);
+                result.m_iterations += 1;
+                result.m_bytes += corpus.m_size;
+                end = now_ns();
+            }
+            result.m_ns     = end - begin;
+            result.m_allocs = allocator->m_allocs - allocs;
+            report(result);
+        }
+
+        struct parse_t
+        {
+            parser2::parser_t::program_t m_program;
+            bool                         operator()(nrunes::reader_t& reader) { return parser2::parser_t::parse(m_program, reader); }
+            s64                          operator()(corpus_t const& corpus) { return check_tokens(corpus, *this); }
+        };
+
+        struct parse_lines_t
+        {
+            parser2::parser_t::program_t m_program;
+            bool                         operator()(nrunes::reader_t& reader) { return parser2::parser_t::parse(m_program, reader); }
+            s64                          operator()(corpus_t const& corpus) { return check_lines(corpus, *this); }
+        };
+
+        struct find_t
+        {
+            parser2::parser_t::program_t m_program;
+            s64                          operator()(corpus_t const& corpus)
+            {
+                nrunes::reader_t reader(make_crunes((ascii::pcrune)corpus.m_text, 0, corpus.m_size, corpus.m_size));
+                nrunes::reader_t matches[64];
+                s64              total = 0;
+                while (true)
+                {
+                    s32 const n = parser2::parser_t::findAll(m_program, reader, matches, 64);
+                    total += n;
+                    if (n < 64)
+                        break;
+                }
+                return total;
+            }
+        };
+
+        struct jit_parse_t
+        {
+            parser2::jit_t* m_jit;
+            bool            operator()(nrunes::reader_t& reader) { return m_jit->parse(reader); }
+            s64             operator()(corpus_t const& corpus) { return check_tokens(corpus, *this); }
+        };
+
+        template <bool lines> struct parse3_t
+        {
+            parser3::parser_t*          m_parser;
+            parser3::parser_t::code_t* m_code;
+            bool                        operator()(nrunes::reader_t& reader) { return m_parser->Parse(m_code, reader); }
+            s64                         operator()(corpus_t const& corpus) { return lines ? check_lines(corpus, *this) : check_tokens(corpus, *this); }
+        };
+
+        struct check_t
+        {
+            combparser::tokenizer_t* m_rule;
+            bool                     operator()(nrunes::reader_t& reader) { return m_rule->Check(reader); }
+            s64                      operator()(corpus_t const& corpus) { return check_tokens(corpus, *this); }
+        };
+
+        static u32 write_number(char* text, u32 size, u32 value)
+        {
+            char digits[10];
+            s32  n = 0;
+            do
+            {
+                digits[n++] = (char)('0' + (value % 10));
+                value /= 10;
+            } while (value != 0);
+            while (n > 0)
+                text[size++] = digits[--n];
+            return size;
+        }
+
+        // The corpus as the records of the use case of parser3 (use_case_1), every line becomes "<line>: " followed
+        // by the first two tokens as a quoted string, or by the lengths of the tokens as numbers with a '|' halfway.
+        // Every seventh record is followed by its first token and does not match.
+        static u32 record_corpus(corpus_t const& corpus, char* text)
+        {
+            char const* corpus_text = corpus.m_text;
+            u32         size        = 0;
+            u32         line        = 0;
+            u32         i           = 0;
+            while (i < corpus.m_size)
+            {
+                u32 eol = i;
+                while (eol < corpus.m_size && corpus_text[eol] != '\n')
+                    eol += 1;
+
+                size         = write_number(text, size, line);
+                text[size++] = ':';
+                text[size++] = ' ';
+                if ((line % 7) == 6)
+                {
+                    for (u32 j = i; j < eol && corpus_text[j] != ' '; ++j)
+                        text[size++] = corpus_text[j];
+                }
+                else if ((line % 3) == 0)
+                {
+                    text[size++] = '"';
+                    u32 j = i;
+                    for (s32 spaces = 0; j < eol && corpus_text[j] != '"'; ++j)
+                    {
+                        if (corpus_text[j] == ' ' && ++spaces == 2)
+                            break;
+                    }
+                    for (u32 k = i; k < j; ++k)
+                        text[size++] = corpus_text[k];
+                    text[size++] = '"';
+                }
+                else
+                {
+                    s32 tokens = 0;
+                    for (u32 j = i; j < eol; ++j)
+                        tokens += (corpus_text[j] == ' ') ? 1 : 0;
+                    s32 column = 0;
+                    for (u32 t = i; t < eol; column += 1)
+                    {
+                        u32 e = t;
+                        while (e < eol && corpus_text[e] != ' ')
+                            e += 1;
+                        if (column > 0)
+                            text[size++] = ' ';
+                        if (column == (tokens + 1) / 2)
+                        {
+                            text[size++] = '|';
+                            text[size++] = ' ';
+                        }
+                        size = write_number(text, size, e - t);
+                        t    = e + 1;
+                    }
+                }
+                text[size++] = '\n';
+                line += 1;
+                i = eol + 1;
+            }
+            return size;
+        }
+
+        static corpus_t record_corpus_create(corpus_t const& corpus, counting_alloc_t* allocator)
+        {
+            corpus_t records = corpus;
+            records.m_text   = (char*)allocator->m_allocator->allocate(corpus.m_size * 2 + corpus.m_lines * 16);
+            records.m_size   = record_corpus(corpus, records.m_text);
+            return records;
+        }
+
+        // The captures of the use case rule
+        struct record_vars_t
+        {
+            s32      m_index;
+            s32      m_left;
+            s32      m_right;
+            crunes_t m_string;
+            va_r_t   m_index_var;
+            va_r_t   m_left_var;
+            va_r_t   m_right_var;
+            va_r_t   m_string_var;
+
+            record_vars_t() : m_index(0), m_left(0), m_right(0), m_index_var(&m_index), m_left_var(&m_left), m_right_var(&m_right), m_string_var(&m_string) {}
+        };
+
+        // parser3 has Until(until, code) and EOL(), parser2 spells them with Not and ZeroOrMore
+        static parser2::parser_t::program_t until2(parser2::parser_t& p, parser2::parser_t::program_t until, parser2::parser_t::program_t code)
+        {
+            return p.Sequence(p.ZeroOrMore(p.Sequence(p.Not(until), code)), p.Not(p.Not(until)));
+        }
+
+        static parser2::parser_t::program_t use_case_1(parser2::parser_t& p, record_vars_t& v)
+        {
+            parser2::parser_t::program_t ws     = p.ZeroOrMore(p.WhiteSpace());
+            parser2::parser_t::program_t eol    = p.Or(p.EndOfText(), p.EndOfLine());
+            parser2::parser_t::program_t quoted = p.Sequence(p.Is('"'), p.Extract(&v.m_string_var, until2(p, p.Is('"'), p.Any())), p.Is('"'), p.Sequence(ws, eol));
+            parser2::parser_t::program_t left   = until2(p, p.Or(p.Is('|'), eol), p.Sequence(ws, p.Extract(&v.m_left_var, p.Integer32()), ws));
+            parser2::parser_t::program_t right  = p.Sequence(p.Is('|'), until2(p, eol, p.Sequence(ws, p.Extract(&v.m_right_var, p.Integer32()), ws)));
+            return p.Sequence(p.Extract(&v.m_index_var, p.Integer32()), p.Is(':'), ws, p.Or(quoted, p.Sequence(left, p.Or(eol, right))));
+        }
+
+        static parser3::parser_t::code_t* use_case_1(parser3::parser_t& p, record_vars_t& v)
+        {
+            // clang-format off
+            return p.Sequence(p.Extract(&v.m_index_var, p.Integer32())
+                ->Is(':')
+                ->WhiteSpace()
+                ->Or(p.Sequence(p.Is('"')->Extract(&v.m_string_var, p.Until(p.Is('"'), p.Any()))->Is('"')->WhiteSpace()->EOL()),
+                     p.Sequence(p.Until(p.Or(p.Is('|'), p.EOL()), p.Sequence(p.WhiteSpace()->Extract(&v.m_left_var, p.Integer32())->WhiteSpace()))
+                        ->Or(p.EOL(), p.Sequence(p.Is('|')->Until(p.EOL(), p.Sequence(p.WhiteSpace()->Extract(&v.m_right_var, p.Integer32())->WhiteSpace())))))));
+            // clang-format on
+        }
+
+        void bench_parser2(corpus_t const& corpus, counting_alloc_t* allocator)
+        {
+            u8                data[16384];
+            parser2::parser_t parser(buffer_t(data, data + sizeof(data)));
+
+            parser2::parser_t::program_t programs[4];
+            programs[0] = parser.Email();
+            programs[1] = parser.IPv4();
+            programs[2] = parser.Host();
+            programs[3] = parser.Unsigned64();
+
+            const char* tokens[] = {"token/email", "token/ipv4", "token/host", "token/numeric"};
+            const char* finds[]  = {"find/email", "find/ipv4", "find/host", "find/numeric"};
+            for (s32 i = 0; i < 4; ++i)
+            {
+                parser2::parser_t::statistics_t stats;
+                parser2::parser_t::statistics(programs[i], stats);
+                parse_t parse = {programs[i]};
+                run(corpus, allocator, "parser2", tokens[i], parse, stats.m_size);
+                find_t find = {programs[i]};
+                run(corpus, allocator, "parser2", finds[i], find, stats.m_size);
+            }
+
+            const char* optimized[] = {"token/email/optimized", "token/ipv4/optimized", "token/host/optimized", "token/numeric/optimized"};
+            for (s32 i = 0; i < 4; ++i)
+            {
+                parser2::parser_t::statistics_t stats;
+                parse_t                         parse = {parser2::parser_t::optimize(programs[i])};
+                parser2::parser_t::statistics(parse.m_program, stats);
+                run(corpus, allocator, "parser2", optimized[i], parse, stats.m_size);
+            }
+
+            // Native code of the optimized programs versus the interpreter cases above, the code size is the size of
+            // the native code
+            const char* jits[] = {"token/email/jit", "token/ipv4/jit", "token/host/jit"};
+            for (s32 i = 0; i < 3; ++i)
+            {
+                parser2::jit_t jit;
+                jit.compile(parser2::parser_t::optimize(programs[i]));
+                jit_parse_t parse = {&jit};
+                run(corpus, allocator, "parser2", jits[i], parse, jit.size());
+            }
+
+            corpus_t                        records = record_corpus_create(corpus, allocator);
+            record_vars_t                   vars;
+            parse_lines_t                   record = {use_case_1(parser, vars)};
+            parser2::parser_t::statistics_t stats;
+            parser2::parser_t::statistics(record.m_program, stats);
+            run(records, allocator, "parser2", "record/use_case_1", record, stats.m_size);
+            allocator->m_allocator->deallocate(records.m_text);
+        }
+
+        // The same grammars as bench_parser2, every grammar is built into its own buffer so that the code size is the
+        // size of its code blocks
+        void bench_parser3(corpus_t const& corpus, counting_alloc_t* allocator)
+        {
+            const char* tokens[] = {"token/email", "token/ipv4", "token/host"};
+            for (s32 i = 0; i < 3; ++i)
+            {
+                u8                         data[8192];
+                parser3::parser_t          parser(buffer_t(data, data + sizeof(data)));
+                parser3::parser_t::code_t* code = (i == 0) ? parser.Email() : ((i == 1) ? parser.IPv4() : parser.Host());
+                parse3_t<false>            parse = {&parser, code};
+                run(corpus, allocator, "parser3", tokens[i], parse, parser.Size());
+            }
+
+            corpus_t          records = record_corpus_create(corpus, allocator);
+            record_vars_t     vars;
+            u8                data[4096];
+            parser3::parser_t parser(buffer_t(data, data + sizeof(data)));
+            parse3_t<true>    record = {&parser, use_case_1(parser, vars)};
+            run(records, allocator, "parser3", "record/use_case_1", record, parser.Size());
+            allocator->m_allocator->deallocate(records.m_text);
+        }
+
+        void bench_combparser(corpus_t const& corpus, counting_alloc_t* allocator)
+        {
+            combparser::utils::Email     email;
+            combparser::utils::IPv4      ipv4;
+            combparser::utils::Host      host;
+            combparser::filters::Integer numeric;
+
+            combparser::tokenizer_t* rules[]  = {&email, &ipv4, &host, &numeric};
+            const char*              checks[] = {"token/email", "token/ipv4", "token/host", "token/numeric"};
+            const char*              lowers[] = {"token/email/compiled", "token/ipv4/compiled", "token/host/compiled", "token/numeric/compiled"};
+            for (s32 i = 0; i < 4; ++i)
+            {
+                check_t check = {rules[i]};
+                run(corpus, allocator, "combparser", checks[i], check);
+
+                u8                   data[8192];
+                combparser::Compiled compiled(*rules[i], buffer_t(data, data + sizeof(data)));
+                check_t              lowered = {&compiled};
+                run(corpus, allocator, "combparser", lowers[i], lowered);
+            }
+        }
+
+    } // namespace nbench
+} // namespace ncore
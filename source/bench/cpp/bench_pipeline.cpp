@@ -0,0 +1,177 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+#include "ctext/c_parser2.h"
+#include "ctext/c_text_corpus.h"
+#include "ctext/c_text_pipeline.h"
+#include "ctext/c_text_stream.h"
+
+#include "c_bench.h"
+
+namespace ncore
+{
+    namespace nbench
+    {
+        static const s32 cMaxWorkers = 8;
+
+        // A parser per worker thread. As pipeline worker it counts the email addresses of every line, 'm_chunks'
+        // counts the email addresses of the chunks of the scheduler.
+        class email_worker_t : public npipeline::worker_t
+        {
+        public:
+            email_worker_t() : m_parser(buffer_t(m_data, m_data + sizeof(m_data))), m_program(m_parser.Email()), m_chunks(m_program) {}
+
+            virtual void parse(npipeline::batch_t& batch)
+            {
+                nrunes::reader_t matches[16];
+                for (s32 i = 0; i < batch.m_count; ++i)
+                {
+                    nrunes::reader_t reader(batch.m_lines[i]);
+                    batch.m_results[i] = parser2::parser_t::findAll(m_program, reader, matches, 16);
+                }
+            }
+
+        private:
+            u8                           m_data[16384];
+            parser2::parser_t            m_parser;
+            parser2::parser_t::program_t m_program;
+
+        public:
+            npipeline::find_worker_t m_chunks;
+        };
+
+        class count_sink_t : public npipeline::sink_t
+        {
+        public:
+            count_sink_t() : m_matches(0) {}
+            virtual void consume(npipeline::batch_t const& batch)
+            {
+                for (s32 i = 0; i < batch.m_count; ++i)
+                    m_matches += batch.m_results[i];
+            }
+            s64 m_matches;
+        };
+
+        void bench_pipeline(corpus_t const& corpus, counting_alloc_t* allocator)
+        {
+            static email_worker_t workers[cMaxWorkers];
+            npipeline::worker_t*  stages[cMaxWorkers];
+            for (s32 i = 0; i < cMaxWorkers; ++i)
+                stages[i] = &workers[i];
+
+            u32 const memory_size = npipeline::pipeline_t::required(cMaxWorkers);
+            u8*       memory      = (u8*)allocator->m_allocator->allocate(memory_size);
+
+            const char* names[] = {"find/email/workers=1", "find/email/workers=2", "find/email/workers=4", "find/email/workers=8"};
+            for (s32 w = 0; w < 4; ++w)
+            {
+                s32 const num_workers = 1 << w;
+                result_t  result      = {"pipeline", names[w], corpus.m_size, 0, 0, 0, 0, 0, 0};
+                s64 const allocs      = allocator->m_allocs;
+                u64 const begin       = now_ns();
+                u64       end         = begin;
+                while ((end - begin) < cMinTimeNs)
+                {
+                    corpus_stream_t       stream(corpus, true);
+                    text_stream_t         text(&stream, text_stream_t::encoding_ascii, allocator);
+                    npipeline::pipeline_t pipeline(buffer_t(memory, memory + memory_size));
+                    count_sink_t          sink;
+                    pipeline.run(text, stages, num_workers, sink);
+                    text.close();
+
+                    result.m_items = sink.m_matches;
+                    result.m_iterations += 1;
+                    result.m_bytes += corpus.m_size;
+                    end = now_ns();
+                }
+                result.m_ns     = end - begin;
+                result.m_allocs = allocator->m_allocs - allocs;
+                report(result);
+            }
+
+            allocator->m_allocator->deallocate(memory);
+        }
+
+        // A corpus where the middle eighth is dense with email addresses and host names and the rest is mostly
+        // numbers, parsing costs are skewed so an equal division of the text over the workers is unbalanced
+        static u32 skewed_corpus(u8* text, u32 size)
+        {
+            ncorpus::config_t sparse;
+            sparse.m_max_line = 200;
+            sparse.m_numbers  = 80;
+            sparse.m_emails   = 0;
+            sparse.m_ipv4     = 0;
+            sparse.m_hosts    = 0;
+
+            ncorpus::config_t dense = sparse;
+            dense.m_seed            = 0xd15e;
+            dense.m_numbers         = 5;
+            dense.m_emails          = 45;
+            dense.m_hosts           = 45;
+
+            ncorpus::generator_t before(sparse);
+            ncorpus::generator_t middle(dense);
+            sparse.m_seed = 0xaf7e;
+            ncorpus::generator_t after(sparse);
+
+            u32 written = before.write(text, (size / 16) * 7);
+            written += middle.write(text + written, (size / 16) * 9 - written);
+            written += after.write(text + written, size - written);
+            return written;
+        }
+
+        void bench_scheduler(corpus_t const& corpus, counting_alloc_t* allocator)
+        {
+            u8*       text = (u8*)allocator->m_allocator->allocate(corpus.m_size);
+            u32 const size = skewed_corpus(text, corpus.m_size);
+
+            static email_worker_t      workers[cMaxWorkers];
+            npipeline::chunk_worker_t* finds[cMaxWorkers];
+            for (s32 i = 0; i < cMaxWorkers; ++i)
+                finds[i] = &workers[i].m_chunks;
+
+            u32 const memory_size = npipeline::scheduler_t::required(cMaxWorkers);
+            u8*       memory      = (u8*)allocator->m_allocator->allocate(memory_size);
+
+            // 'static' parses an equal part of the text per worker, 'stealing' splits the parts into tasks of 16 KB
+            const char* names[2][4] = {{"find/email/static/workers=1", "find/email/static/workers=2", "find/email/static/workers=4", "find/email/static/workers=8"},
+                                       {"find/email/stealing/workers=1", "find/email/stealing/workers=2", "find/email/stealing/workers=4", "find/email/stealing/workers=8"}};
+            for (s32 mode = 0; mode < 2; ++mode)
+            {
+                for (s32 w = 0; w < 4; ++w)
+                {
+                    s32 const num_workers = 1 << w;
+                    u32 const task_size   = (mode == 0) ? size : 16384;
+                    result_t  result      = {"scheduler", names[mode][w], size, 0, 0, 0, 0, 0, 0};
+                    s64 const allocs      = allocator->m_allocs;
+                    u64 const begin       = now_ns();
+                    u64       end         = begin;
+                    while ((end - begin) < cMinTimeNs)
+                    {
+                        s64 matches = 0;
+                        for (s32 i = 0; i < num_workers; ++i)
+                            matches -= workers[i].m_chunks.matches();
+
+                        npipeline::scheduler_t scheduler(buffer_t(memory, memory + memory_size));
+                        scheduler.run(make_crunes((ascii::pcrune)text, 0, size, size), finds, num_workers, task_size);
+
+                        for (s32 i = 0; i < num_workers; ++i)
+                            matches += workers[i].m_chunks.matches();
+                        result.m_items = matches;
+                        result.m_iterations += 1;
+                        result.m_bytes += size;
+                        end = now_ns();
+                    }
+                    result.m_ns     = end - begin;
+                    result.m_allocs = allocator->m_allocs - allocs;
+                    report(result);
+                }
+            }
+
+            allocator->m_allocator->deallocate(memory);
+            allocator->m_allocator->deallocate(text);
+        }
+
+    } // namespace nbench
+} // namespace ncore
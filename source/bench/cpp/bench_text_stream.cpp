@@ -0,0 +1,92 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+#include "ctext/c_parser2.h"
+#include "ctext/c_text_stream.h"
+
+#include "c_bench.h"
+
+namespace ncore
+{
+    namespace nbench
+    {
+        static void bench_read_lines(corpus_t const& corpus, counting_alloc_t* allocator, bool view, text_stream_t::encoding encoding, const char* name)
+        {
+            result_t result = {"text_stream", name, corpus.m_size, 0, 0, 0, 0, 0, 0};
+            s64 const allocs = allocator->m_allocs;
+            u64 const begin  = now_ns();
+            u64       end    = begin;
+            while ((end - begin) < cMinTimeNs)
+            {
+                corpus_stream_t stream(corpus, view);
+                text_stream_t   text(&stream, encoding, allocator);
+                crunes_t        line;
+                s64             lines = 0;
+                while (text.readLine(line))
+                    lines += 1;
+                text.close();
+
+                result.m_items = lines;
+                result.m_iterations += 1;
+                result.m_bytes += corpus.m_size;
+                end = now_ns();
+            }
+            result.m_ns     = end - begin;
+            result.m_allocs = allocator->m_allocs - allocs;
+            report(result);
+        }
+
+        // Count the tokens of the lines of a UTF-8 stream with a parser2 program that reads every character, the
+        // stream hands out its pure ASCII windows as ASCII text unless 'decode' forces the lines back to UTF-8 so
+        // every character is decoded
+        static void bench_tokens_utf8(corpus_t const& corpus, counting_alloc_t* allocator, bool decode, const char* name)
+        {
+            u8                           data[4096];
+            parser2::parser_t            parser(buffer_t(data, data + sizeof(data)));
+            parser2::parser_t::program_t token = parser.Until(parser.In(ascii::make_crunes(" \n")));
+
+            result_t  result = {"text_stream", name, corpus.m_size, 0, 0, 0, 0, 0, 0};
+            s64 const allocs = allocator->m_allocs;
+            u64 const begin  = now_ns();
+            u64       end    = begin;
+            while ((end - begin) < cMinTimeNs)
+            {
+                corpus_stream_t stream(corpus, true);
+                text_stream_t   text(&stream, text_stream_t::encoding_utf8, allocator);
+                crunes_t        line;
+                s64             tokens = 0;
+                while (text.readLine(line))
+                {
+                    if (decode)
+                        line.m_type = utf8::TYPE;
+                    nrunes::reader_t reader(line);
+                    while (parser2::parser_t::parse(token, reader))
+                    {
+                        tokens += 1;
+                        reader.skip();
+                    }
+                }
+                text.close();
+
+                result.m_items = tokens;
+                result.m_iterations += 1;
+                result.m_bytes += corpus.m_size;
+                end = now_ns();
+            }
+            result.m_ns     = end - begin;
+            result.m_allocs = allocator->m_allocs - allocs;
+            report(result);
+        }
+
+        void bench_text_stream(corpus_t const& corpus, counting_alloc_t* allocator)
+        {
+            bench_read_lines(corpus, allocator, true, text_stream_t::encoding_ascii, "readLine/view");
+            bench_read_lines(corpus, allocator, false, text_stream_t::encoding_ascii, "readLine/read");
+            bench_read_lines(corpus, allocator, true, text_stream_t::encoding_utf8, "readLine/view/utf8");
+            bench_tokens_utf8(corpus, allocator, false, "tokens/utf8/ascii windows");
+            bench_tokens_utf8(corpus, allocator, true, "tokens/utf8/decoded");
+        }
+
+    } // namespace nbench
+} // namespace ncore
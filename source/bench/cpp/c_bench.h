@@ -0,0 +1,134 @@
+#ifndef __CTEXT_BENCH_H__
+#define __CTEXT_BENCH_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cbase/c_allocator.h"
+#include "ccore/c_stream.h"
+
+// Internal to the ctext benchmark, shared by the benchmark suites.
+
+namespace ncore
+{
+    namespace nbench
+    {
+        // Counts the allocations, forwards to the allocator it replaces
+        class counting_alloc_t : public alloc_t
+        {
+        public:
+            counting_alloc_t(alloc_t* allocator) : m_allocator(allocator), m_allocs(0), m_bytes(0) {}
+
+            alloc_t* m_allocator;
+            s64      m_allocs;
+            s64      m_bytes;
+
+        protected:
+            virtual void* v_allocate(u32 size, u32 alignment)
+            {
+                m_allocs += 1;
+                m_bytes += size;
+                return m_allocator->allocate(size, alignment);
+            }
+            virtual void v_deallocate(void* mem) { m_allocator->deallocate(mem); }
+        };
+
+        // The text of a benchmark, lines of words, numbers, emails, IPv4 addresses and host names generated by
+        // ncorpus. The same 'seed' and 'size' always produce the same text.
+        struct corpus_t
+        {
+            char* m_text;
+            u32   m_size;  // bytes of text, the text ends with a line end
+            u32   m_lines; // number of lines
+        };
+
+        bool corpus_create(corpus_t& corpus, alloc_t* allocator, u32 size, u32 seed);
+        void corpus_destroy(corpus_t& corpus, alloc_t* allocator);
+
+        // A stream over the corpus in memory, it can be viewed unless 'm_view' is false and then text_stream_t has
+        // to copy the text into its own buffer
+        class corpus_stream_t : public istream_t
+        {
+            u8 const* m_buffer;
+            u64       m_size;
+            u64       m_cursor;
+            bool      m_view;
+
+        public:
+            corpus_stream_t(corpus_t const& corpus, bool view) : m_buffer((u8 const*)corpus.m_text), m_size(corpus.m_size), m_cursor(0), m_view(view) {}
+
+        protected:
+            virtual bool v_canSeek() const { return true; }
+            virtual bool v_canRead() const { return true; }
+            virtual bool v_canWrite() const { return false; }
+            virtual bool v_canView() const { return m_view; }
+            virtual void v_flush() {}
+            virtual void v_close() {}
+            virtual u64  v_getLength() const { return m_size; }
+            virtual void v_setLength(u64) {}
+            virtual s64  v_setPos(s64 pos)
+            {
+                m_cursor = ((u64)pos < m_size) ? (u64)pos : m_size;
+                return (s64)m_cursor;
+            }
+            virtual s64 v_getPos() const { return (s64)m_cursor; }
+            virtual s64 v_view(u8 const*& buffer, s64 count)
+            {
+                if ((u64)count > (m_size - m_cursor))
+                    count = (s64)(m_size - m_cursor);
+                buffer = (count > 0) ? m_buffer + m_cursor : nullptr;
+                m_cursor += (u64)count;
+                return count;
+            }
+            virtual s64 v_read(u8* buffer, s64 count)
+            {
+                if ((u64)count > (m_size - m_cursor))
+                    count = (s64)(m_size - m_cursor);
+                for (s64 i = 0; i < count; ++i)
+                    buffer[i] = m_buffer[m_cursor + i];
+                m_cursor += (u64)count;
+                return count;
+            }
+            virtual s64 v_write(const u8*, s64) { return -1; }
+        };
+
+        // A run of a benchmark case, written as one JSON object per line:
+        //   {"suite":"parser2","case":"find/ipv4","corpus":1048576,"iterations":12,"bytes":12582912,"items":3120,
+        //    "ns":10485760,"mb_per_s":1144.4,"allocs":0}
+        // a parser case adds "code", the bytes of code of its program
+        struct result_t
+        {
+            const char* m_suite;
+            const char* m_case;
+            u32         m_corpus;     // bytes of the corpus
+            s64         m_iterations; // number of passes over the corpus
+            u64         m_bytes;      // bytes processed by all passes
+            s64         m_items;      // lines, matches, ... of a single pass
+            u64         m_ns;         // time of all passes
+            s64         m_allocs;     // allocations of all passes
+            u32         m_code;       // bytes of code of the program, 0 when the case has no program
+        };
+
+        void report(result_t const& result);
+
+        // Time in nanoseconds, from an arbitrary start
+        u64 now_ns();
+
+        // Passes over the corpus are repeated until this much time has been spent
+        static const u64 cMinTimeNs = 200 * 1000 * 1000;
+
+        void bench_text_stream(corpus_t const& corpus, counting_alloc_t* allocator);
+        void bench_parser2(corpus_t const& corpus, counting_alloc_t* allocator);
+        void bench_parser3(corpus_t const& corpus, counting_alloc_t* allocator);
+        void bench_combparser(corpus_t const& corpus, counting_alloc_t* allocator);
+        void bench_pipeline(corpus_t const& corpus, counting_alloc_t* allocator);
+        void bench_scheduler(corpus_t const& corpus, counting_alloc_t* allocator);
+        void bench_csv(corpus_t const& corpus, counting_alloc_t* allocator);
+        void bench_logfmt(corpus_t const& corpus, counting_alloc_t* allocator);
+        void bench_json(corpus_t const& corpus, counting_alloc_t* allocator);
+
+    } // namespace nbench
+} // namespace ncore
+
+#endif // __CTEXT_BENCH_H__
@@ -1,6 +1,6 @@
 #include "cbase/c_runes.h"
-#include "cbase/c_runes.h"
 #include "ctext/c_parser.h"
+#include "ctext/c_parser2.h"
 
 namespace ncore
 {
@@ -22,6 +22,9 @@ namespace ncore
         utils::ServerAddress  utils::sServerAddress;
         utils::Uri            utils::sURI;
 
+        typedef parser2::parser_t            parser_t;
+        typedef parser2::parser_t::program_t program_t;
+
         namespace manipulators
         {
             bool Not::Check(nrunes::reader_t& _reader)
@@ -112,8 +115,15 @@ namespace ncore
                 u64 i = 0;
                 for (; i < m_max; i++)
                 {
+                    u32 const iteration = _reader.get_cursor();
                     if (!m_tokenizer_a.Check(_reader))
                         break;
+                    if (iteration == _reader.get_cursor())
+                    {
+                        // Matched without consuming anything, repeating will not change that
+                        i = m_max;
+                        break;
+                    }
                 }
 
                 if (i >= m_min && i <= m_max)
@@ -125,14 +135,19 @@ namespace ncore
                 return false;
             }
 
-            bool Times::Check(nrunes::reader_t& _reader) { return Within(m_max, m_max, m_tokenizer_a).Check(_reader); }
-            bool OneOrMore::Check(nrunes::reader_t& _reader) { return Within(1, -1, m_tokenizer_a).Check(_reader); }
-            bool ZeroOrOne::Check(nrunes::reader_t& _reader) { return Within(0, 1, m_tokenizer_a).Check(_reader); }
-            bool While::Check(nrunes::reader_t& _reader) { return Within(0, -1, m_tokenizer_a).Check(_reader); }
+            // Advance until the position where 'a' matches (not included)
             bool Until::Check(nrunes::reader_t& _reader)
             {
-                Not n(m_tokenizer_a);
-                return (While(n)).Check(_reader);
+                while (_reader.valid())
+                {
+                    u32 const  cursor = _reader.get_cursor();
+                    bool const found  = m_tokenizer_a.Check(_reader);
+                    _reader.set_cursor(cursor);
+                    if (found)
+                        break;
+                    _reader.skip();
+                }
+                return true;
             }
 
             bool Extract::Check(nrunes::reader_t& _reader)
@@ -163,11 +178,91 @@ namespace ncore
 
             bool Enclosed::Check(nrunes::reader_t& _reader)
             {
-                filters::Exact open(m_open);
-                filters::Exact close(m_close);
-                Sequence       a(open, m_tokenizer_a);
-                Sequence       b(a, close);
-                return b.Check(_reader);
+                u32 start = _reader.get_cursor();
+                if (filters::Exact::Match(m_open, _reader) && m_tokenizer_a.Check(_reader) && filters::Exact::Match(m_close, _reader))
+                    return true;
+                _reader.set_cursor(start);
+                return false;
+            }
+
+            // Lowering to parser2
+
+            bool Not::Lower(parser_t& parser, program_t& program)
+            {
+                program_t a;
+                if (!m_tokenizer_a.Lower(parser, a))
+                    return false;
+                program = parser.Not(a);
+                return true;
+            }
+
+            bool Or::Lower(parser_t& parser, program_t& program)
+            {
+                program_t a, b;
+                if (!m_tokenizer_a.Lower(parser, a) || !m_tokenizer_b.Lower(parser, b))
+                    return false;
+                program = parser.Or(a, b);
+                return true;
+            }
+
+            bool And::Lower(parser_t& parser, program_t& program)
+            {
+                program_t a, b;
+                if (!m_tokenizer_a.Lower(parser, a) || !m_tokenizer_b.Lower(parser, b))
+                    return false;
+                program = parser.And(a, b);
+                return true;
+            }
+
+            bool Sequence::Lower(parser_t& parser, program_t& program)
+            {
+                program_t a, b;
+                if (!m_tokenizer_a.Lower(parser, a) || !m_tokenizer_b.Lower(parser, b))
+                    return false;
+                program = parser.Sequence(a, b);
+                return true;
+            }
+
+            bool Sequence3::Lower(parser_t& parser, program_t& program)
+            {
+                program_t a, b, c;
+                if (!m_tokenizer_a.Lower(parser, a) || !m_tokenizer_b.Lower(parser, b) || !m_tokenizer_c.Lower(parser, c))
+                    return false;
+                program = parser.Sequence(a, b, c);
+                return true;
+            }
+
+            bool Within::Lower(parser_t& parser, program_t& program)
+            {
+                program_t a;
+                if (!m_tokenizer_a.Lower(parser, a))
+                    return false;
+                s32 const _min = m_min > 0x7fffffff ? 0x7fffffff : (s32)m_min;
+                s32 const _max = m_max > 0x7fffffff ? 0x7fffffff : (s32)m_max;
+                program        = parser.Within(a, _min, _max);
+                return true;
+            }
+
+            bool Until::Lower(parser_t& parser, program_t& program)
+            {
+                program_t a;
+                if (!m_tokenizer_a.Lower(parser, a))
+                    return false;
+                program = parser.ZeroOrMore(parser.Sequence(parser.Not(a), parser.Any()));
+                return true;
+            }
+
+            // The selection and the callback are side effects that parser2 cannot express
+            bool Extract::Lower(parser_t&, program_t&) { return false; }
+            bool ReturnToCallback::Lower(parser_t&, program_t&) { return false; }
+
+            bool Enclosed::Lower(parser_t& parser, program_t& program)
+            {
+                program_t a;
+                if (!m_tokenizer_a.Lower(parser, a))
+                    return false;
+                program = parser.Sequence(parser.Exact(m_open.get_source()), a, parser.Exact(m_close.get_source()));
+                return true;
             }
         } // namespace manipulators
 
@@ -229,32 +324,42 @@ namespace ncore
                 return true;
             }
 
+            static inline bool is_alpha(uchar32 c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+            static inline bool is_digit(uchar32 c) { return c >= '0' && c <= '9'; }
+
             bool AlphaNumeric::Check(nrunes::reader_t& _reader)
             {
-                manipulators::Or r(sAlphabet, sDigit);
-                return r.Check(_reader);
+                uchar32 const c = _reader.peek();
+                if (is_alpha(c) || is_digit(c))
+                {
+                    _reader.skip();
+                    return true;
+                }
+                return false;
             }
 
-            bool Exact::Check(nrunes::reader_t& _reader)
+            bool Exact::Match(nrunes::reader_t input, nrunes::reader_t& _reader)
             {
-                m_input.reset();
+                input.reset();
 
                 u32 start = _reader.get_cursor();
-                while (m_input.valid())
+                while (input.valid())
                 {
                     uchar32 a = _reader.peek();
-                    uchar32 b = m_input.peek();
+                    uchar32 b = input.peek();
                     if (a != b)
                     {
                         _reader.set_cursor(start);
                         return false;
                     }
-                    m_input.skip();
+                    input.skip();
                     _reader.skip();
                 }
                 return true;
             }
 
+            bool Exact::Check(nrunes::reader_t& _reader) { return Match(m_input, _reader); }
+
             bool Like::Check(nrunes::reader_t& _reader)
             {
                 m_input.reset();
@@ -287,8 +392,21 @@ namespace ncore
                 return false;
             }
 
-            bool Decimal::Check(nrunes::reader_t& _reader) { return manipulators::OneOrMore(sDigit).Check(_reader); }
-            bool Word::Check(nrunes::reader_t& _reader) { return manipulators::OneOrMore(sAlphabet).Check(_reader); }
+            bool Decimal::Check(nrunes::reader_t& _reader)
+            {
+                u32 start = _reader.get_cursor();
+                while (is_digit(_reader.peek()))
+                    _reader.skip();
+                return start != _reader.get_cursor();
+            }
+
+            bool Word::Check(nrunes::reader_t& _reader)
+            {
+                u32 start = _reader.get_cursor();
+                while (is_alpha(_reader.peek()))
+                    _reader.skip();
+                return start != _reader.get_cursor();
+            }
             bool EndOfText::Check(nrunes::reader_t& _reader) { return (_reader.peek() == ('\0')); }
 
 #if defined(PLATFORM_PC)
@@ -339,6 +457,7 @@ namespace ncore
                     if (!nrunes::is_digit(c))
                         break;
                     value = (value * 10) + nrunes::to_digit(c);
+                    _reader.skip();
                 }
                 if (c == '.')
                 {
@@ -351,6 +470,7 @@ namespace ncore
                             break;
                         value = value + f32(nrunes::to_digit(c)) / mantissa;
                         mantissa *= 10.0f;
+                        _reader.skip();
                     }
                 }
                 if (start == _reader.get_cursor())
@@ -364,6 +484,106 @@ namespace ncore
                 _reader.set_cursor(start);
                 return false;
             }
+
+            // Lowering to parser2
+
+            bool Any::Lower(parser_t& parser, program_t& program)
+            {
+                program = parser.Any();
+                return true;
+            }
+
+            bool In::Lower(parser_t& parser, program_t& program)
+            {
+                program = parser.In(m_input.get_source());
+                return true;
+            }
+
+            bool Between::Lower(parser_t& parser, program_t& program)
+            {
+                program = parser.Between(m_lower, m_upper);
+                return true;
+            }
+
+            bool Alphabet::Lower(parser_t& parser, program_t& program)
+            {
+                program = parser.Alphabet();
+                return true;
+            }
+
+            bool Digit::Lower(parser_t& parser, program_t& program)
+            {
+                program = parser.Digit();
+                return true;
+            }
+
+            bool Hex::Lower(parser_t& parser, program_t& program)
+            {
+                program = parser.Hex();
+                return true;
+            }
+
+            bool AlphaNumeric::Lower(parser_t& parser, program_t& program)
+            {
+                program = parser.AlphaNumeric();
+                return true;
+            }
+
+            bool Exact::Lower(parser_t& parser, program_t& program)
+            {
+                program = parser.Exact(m_input.get_source());
+                return true;
+            }
+
+            bool Like::Lower(parser_t& parser, program_t& program)
+            {
+                program = parser.Like(m_input.get_source());
+                return true;
+            }
+
+            bool WhiteSpace::Lower(parser_t& parser, program_t& program) { return m_whitespace.Lower(parser, program); }
+
+            bool Is::Lower(parser_t& parser, program_t& program)
+            {
+                program = parser.Is(m_char);
+                return true;
+            }
+
+            bool Decimal::Lower(parser_t& parser, program_t& program)
+            {
+                program = parser.OneOrMore(parser.Digit());
+                return true;
+            }
+
+            bool Word::Lower(parser_t& parser, program_t& program)
+            {
+                program = parser.Word();
+                return true;
+            }
+
+            bool EndOfText::Lower(parser_t& parser, program_t& program)
+            {
+                program = parser.EndOfText();
+                return true;
+            }
+
+#if defined(PLATFORM_PC)
+            bool EndOfLine::Lower(parser_t& parser, program_t& program) { return Exact("\r\n", 2).Lower(parser, program); }
+#else
+            bool EndOfLine::Lower(parser_t& parser, program_t& program) { return Exact("\n", 1).Lower(parser, program); }
+#endif
+
+            bool Integer::Lower(parser_t& parser, program_t& program)
+            {
+                program = parser.Integer64(m_min, m_max);
+                return true;
+            }
+
+            bool Float::Lower(parser_t& parser, program_t& program)
+            {
+                program = parser.Float32(m_min, m_max);
+                return true;
+            }
         } // namespace filters
 
         namespace utils
@@ -373,47 +593,87 @@ namespace ncore
 
             bool IPv4::Check(nrunes::reader_t& _reader) { return m_ipv4.Check(_reader); }
 
-            bool Host::Check(nrunes::reader_t& _reader)
+            // The rule graph is built once, checking does not construct anything
+            Host::Host()
+                : m_oom_an(sAlphaNumeric)
+                , m_dash('-')
+                , m_dot('.')
+                , m_dash_oom_an(m_dash, m_oom_an)
+                , m_dot_oom_an(m_dot, m_oom_an)
+                , m_zom_dash_oom_an(m_dash_oom_an)
+                , m_dot_oom_an_zom_dash_oom_an(m_dot_oom_an, m_zom_dash_oom_an)
+                , m_host_tail(m_dot_oom_an_zom_dash_oom_an)
+                , m_host_head(m_oom_an, m_host_tail)
+                , m_name(m_host_head, m_host_tail)
+                , m_host(m_ipv4, m_name)
             {
-                if (sIPv4.Check(_reader))
-                {
-                    return true;
-                }
-                OneOrMore  oom_an(sAlphaNumeric);
-                Is         dash('-');
-                Is         dot('.');
-                Sequence   dash_oom_an(dash, oom_an);
-                Sequence   dot_oom_an(dot, oom_an);
-                ZeroOrMore zom_dash_oom_an(dash_oom_an);
-                Sequence   dot_oom_an_zom_dash_oom_an(dot_oom_an, zom_dash_oom_an);
-                ZeroOrMore host_tail(dot_oom_an_zom_dash_oom_an);
-                Sequence   host_head(oom_an, host_tail);
-                Sequence   host(host_head, host_tail);
-                return host.Check(_reader);
             }
 
+            bool Host::Check(nrunes::reader_t& _reader) { return m_host.Check(_reader); }
+
             static const char* sValidEmailUriChars = "!#$%&'*+/=?^_`{|}~-";
 
-            bool Email::Check(nrunes::reader_t& _reader)
+            Email::Email()
+                : m_validchars(sValidEmailUriChars, 19)
+                , m_valid(sAlphaNumeric, m_validchars)
+                , m_oom_valid(m_valid)
+                , m_dot('.')
+                , m_dot_valid(m_dot, m_oom_valid)
+                , m_zom_dot_valid(m_dot_valid)
+                , m_at('@')
+                , m_domain()
+                , m_local(m_oom_valid, m_zom_dot_valid)
+                , m_at_domain(m_at, m_domain)
+                , m_email(m_local, m_at_domain)
             {
-                In         validchars(sValidEmailUriChars, 19);
-                Or         valid(sAlphaNumeric, validchars);
-                OneOrMore  oom_valid(valid);
-                Is         dot('.');
-                Sequence   dot_valid(dot, oom_valid);
-                ZeroOrMore zom_dot_valid(dot_valid);
-                Is         mt('@');
-                Sequence   a(oom_valid, zom_dot_valid);
-                Sequence   b(mt, sHost);
-                Sequence   email(a, b);
-                return email.Check(_reader);
             }
 
+            bool Email::Check(nrunes::reader_t& _reader) { return m_email.Check(_reader); }
+
             bool ServerAddress::Check(nrunes::reader_t& _reader) { return false; }
 
             bool Uri::Check(nrunes::reader_t& _reader) { return false; }
 
+
+            // Lowering to parser2
+
+            bool IPv4::Lower(parser_t& parser, program_t& program) { return m_ipv4.Lower(parser, program); }
+            bool Host::Lower(parser_t& parser, program_t& program) { return m_host.Lower(parser, program); }
+            bool Email::Lower(parser_t& parser, program_t& program) { return m_email.Lower(parser, program); }
+            bool ServerAddress::Lower(parser_t&, program_t&) { return false; }
+            bool Uri::Lower(parser_t&, program_t&) { return false; }
+
         } // namespace utils
+
+        Compiled::Compiled(tokenizer_t& rule, buffer_t buffer)
+            : m_rule(rule)
+            , m_parser(buffer)
+            , m_program()
+            , m_compiled(false)
+        {
+            program_t program;
+            if (m_rule.Lower(m_parser, program))
+            {
+                // A root program, so that the rule starts with a single instruction. When the buffer ran out of
+                // space the program is incomplete and the rule keeps running through its own Check.
+                program_t const root = m_parser.Program(program);
+                if (m_parser.valid())
+                {
+                    m_program  = root;
+                    m_compiled = true;
+                }
+            }
+        }
+
+        bool Compiled::Check(nrunes::reader_t& _reader)
+        {
+            if (m_compiled)
+                return parser_t::parse(m_program, _reader);
+            return m_rule.Check(_reader);
+        }
+
+        bool Compiled::Lower(parser_t& parser, program_t& program) { return m_rule.Lower(parser, program); }
+
     } // namespace combparser
 
 } // namespace ncore
@@ -5,307 +5,13 @@
 #include "cbase/c_runes.h"
 
 #include "ctext/c_parser2.h"
+#include "ctext/c_text_scan.h"
+#include "ctext/private/c_parser2_machine.h"
 
 namespace ncore
 {
     namespace parser2
     {
-        enum eOpcode
-        {
-            eNOP = 0,
-            // Manipulators (scope)
-            eNot,
-            eOr,
-            eAnd,
-            eSequence,
-            eWithin,
-            eTimes,
-            eOneOrMore,
-            eZeroOrMore,
-            eZeroOrOne,
-            eWhile,
-            eUntil,
-            eExtract,
-            eEnclosed,
-            // Filters
-            eAny = 0x80,
-            eDigest,
-            eIn,
-            eBetween,
-            eAlphabet,
-            eDigit,
-            eHex,
-            eAlphaNumeric,
-            eExact,
-            eLike,
-            eWhiteSpace,
-            eIs,
-            eDecimal,
-            eWord,
-            eEndOfText,
-            eEndOfLine,
-            eUnsigned32,
-            eUnsigned64,
-            eInteger32,
-            eInteger64,
-            eFloat32,
-            eFloat64,
-            // Utils
-            eIPv4 = 0x40,
-            eHost,
-            eEmail,
-            ePhone,
-            eServerAddress,
-            eUri
-        };
-
-        class machine_t
-        {
-        public:
-            machine_t() : m_code(), m_program() {}
-
-            struct operands_t
-            {
-                static void write(binary_writer_t& writer, u16 opa) { writer.write(opa); }
-                static void write(binary_writer_t& writer, u32 opa) { writer.write(opa); }
-                static u16  write(binary_writer_t& writer, u32 opa, u32 opb)
-                {
-                    u16 const offset = (u16)writer.pos();
-                    writer.write(opa);
-                    writer.write(opb);
-                    return offset;
-                }
-                static void write(binary_writer_t& writer, s32 opa) { writer.write(opa); }
-                static u16  write(binary_writer_t& writer, s32 opa, s32 opb)
-                {
-                    u16 const offset = (u16)writer.pos();
-                    writer.write(opa);
-                    writer.write(opb);
-                    return offset;
-                }
-                static u16 write(binary_writer_t& writer, s64 opa, s64 opb)
-                {
-                    u16 const offset = (u16)writer.pos();
-                    writer.write(opa);
-                    writer.write(opb);
-                    return offset;
-                }
-                static u16 write(binary_writer_t& writer, u64 opa)
-                {
-                    u16 const offset = (u16)writer.pos();
-                    writer.write(opa);
-                    return offset;
-                }
-                static u16 write(binary_writer_t& writer, u64 opa, u64 opb)
-                {
-                    u16 const offset = (u16)writer.pos();
-                    writer.write(opa);
-                    writer.write(opb);
-                    return offset;
-                }
-                static u16 write(binary_writer_t& writer, f32 opa, f32 opb)
-                {
-                    u16 const offset = (u16)writer.pos();
-                    writer.write(opa);
-                    writer.write(opb);
-                    return offset;
-                }
-                static u16 write(binary_writer_t& writer, f64 opa, f64 opb)
-                {
-                    u16 const offset = (u16)writer.pos();
-                    writer.write(opa);
-                    writer.write(opb);
-                    return offset;
-                }
-                static u16 write(binary_writer_t& writer, va_r_t* var)
-                {
-                    u16 const offset = (u16)writer.pos();
-                    writer.write((u64)var);
-                    return offset;
-                }
-                static u16 write(binary_writer_t& writer, nrunes::reader_t const& reader)
-                {
-                    crunes_t  r      = reader.get_current();
-                    u16 const offset = (u16)writer.pos();
-                    writer.write(r.m_type);
-                    writer.write(r.m_ascii);
-                    writer.write(r.m_ascii + r.m_end);
-                    return offset;
-                }
-                static s32     read_s32(binary_reader_t& reader) { return reader.read_s32(); }
-                static s64     read_s64(binary_reader_t& reader) { return reader.read_s64(); }
-                static u8      read_u8(binary_reader_t& reader) { return reader.read_u8(); }
-                static u32     read_u32(binary_reader_t& reader) { return reader.read_u32(); }
-                static uchar32 read_uchar32(binary_reader_t& reader) { return (uchar32)reader.read_u32(); }
-                static u64     read_u64(binary_reader_t& reader) { return reader.read_u64(); }
-                static f32     read_f32(binary_reader_t& reader) { return reader.read_f32(); }
-                static f64     read_f64(binary_reader_t& reader) { return reader.read_f64(); }
-                static va_r_t* read_var(binary_reader_t& reader)
-                {
-                    va_r_t* var = (va_r_t*)reader.read_u64();
-                    return var;
-                }
-                static crunes_t read_crunes(binary_reader_t& reader)
-                {
-                    const char* str_begin = nullptr;
-                    const char* str_end   = nullptr;
-                    s8          str_type  = 0;
-                    reader.view_string(str_begin, str_end, str_type);
-
-                    crunes_t str;
-                    str.m_type = str_type;
-                    str.m_ascii = str_begin;
-                    str.m_str   = 0;
-                    str.m_eos   = (u32)(str_end - str_begin);
-                    str.m_end   = str.m_eos;
-                    return str;
-                }
-            };
-
-            nrunes::writer_t* get_writer(u32 channel) { return nullptr; }
-
-            binary_writer_t m_code;
-            binary_reader_t m_program;
-
-            struct context_t
-            {
-                context_t(nrunes::reader_t const& _reader) : reader(_reader) {}
-                u32              get_cursor() const { return reader.get_cursor(); }
-                void             set_cursor(u32 const& c) { reader.set_cursor(c); }
-                nrunes::reader_t reader;
-            };
-            typedef parser_t::pc_t pc_t;
-
-            inline void                emit_instr(eOpcode o) { m_code.write((u16)o); }
-            template <typename T> void emit_instr(eOpcode o, T _a)
-            {
-                emit_instr(o);
-                operands_t::write(m_code, _a);
-            }
-            template <typename T1, typename T2> void emit_instr(eOpcode o, T1 _a, T2 _b)
-            {
-                emit_instr(o);
-                operands_t::write(m_code, _a, _b);
-            }
-            void emit_instr(eOpcode o, crunes_t const& runes)
-            {
-                emit_instr(o);
-                operands_t::write(m_code, (u8)runes.m_type);
-                operands_t::write(m_code, (u64)runes.m_ascii, (u64)runes.m_ascii + runes.m_end);
-            }
-            void emit_instr(eOpcode o, va_r_t var)
-            {
-                emit_instr(o);
-                operands_t::write(m_code, (u16)var.mType);
-                operands_t::write(m_code, (u64)var.mRef);
-            }
-            void emit_call(pc_t pc1) { m_code.write(pc1); }
-            void emit_calls(pc_t pc1)
-            {
-                m_code.write((u16)1);
-                m_code.write(pc1);
-            }
-            void emit_calls(pc_t pc1, pc_t pc2)
-            {
-                m_code.write((u16)2);
-                m_code.write(pc1);
-                m_code.write(pc2);
-            }
-            void emit_calls(pc_t pc1, pc_t pc2, pc_t pc3)
-            {
-                m_code.write((u16)3);
-                m_code.write(pc1);
-                m_code.write(pc2);
-                m_code.write(pc3);
-            }
-            void emit_calls(pc_t pc1, pc_t pc2, pc_t pc3, pc_t pc4)
-            {
-                m_code.write((u16)4);
-                m_code.write(pc1);
-                m_code.write(pc2);
-                m_code.write(pc3);
-                m_code.write(pc4);
-            }
-
-            inline pc_t pc() const { return (pc_t)m_program.pos(); }
-
-            inline pc_t exec_jmp()
-            {
-                pc_t const pos = (pc_t)m_program.pos();
-                pc_t const pc  = (pc_t)m_program.read_u16();
-                m_program.seek(pc);
-                return pos;
-            }
-
-            inline void skip_jmp()
-            {
-                // skip a call entry
-                m_program.read_u16();
-            }
-
-            bool fnOpcodeIs(eOpcode) const;
-            bool fnExec(context_t& ctxt);
-            bool fnNot(context_t& ctxt);
-            bool fnOr(context_t& ctxt);
-            bool fnAnd(context_t& ctxt);
-            bool fnSequence(context_t& ctxt);
-            bool fnWithin(context_t& ctxt, s32 _min, s32 _max);
-            bool fnTimes(context_t& ctxt, s32 _count);
-            bool fnOneOrMore(context_t& ctxt);
-            bool fnZeroOrMore(context_t& ctxt);
-            bool fnZeroOrOne(context_t& ctxt);
-            bool fnWhile(context_t& ctxt);
-            bool fnUntil(context_t& ctxt);
-            bool fnExtract(context_t& ctxt, va_r_t* var);
-            bool fnEnclosed(context_t& ctxt, uchar32 _open, uchar32 _close);
-
-            bool fnAny(context_t& ctxt);
-            bool fnDigest(context_t& ctxt, u8 flags);
-            bool fnIn(context_t& ctxt, nrunes::reader_t _chars);
-            bool fnBetween(context_t& ctxt, uchar32 _from, uchar32 _until);
-            bool fnAlphabet(context_t& ctxt);
-            bool fnDigit(context_t& ctxt);
-            bool fnHex(context_t& ctxt);
-            bool fnAlphaNumeric(context_t& ctxt);
-            bool fnExact(context_t& ctxt, nrunes::reader_t _text); // Case-Sensitive
-            bool fnLike(context_t& ctxt, nrunes::reader_t _text);  // Case-Insensitive
-            bool fnWhiteSpace(context_t& ctxt);
-            bool fnIs(context_t& ctxt, uchar32 _c);
-            bool fnWord(context_t& ctxt);
-            bool fnEndOfText(context_t& ctxt);
-            bool fnEndOfLine(context_t& ctxt);
-            bool fnUnsigned32(context_t& ctxt, u32 _min, u32 _max);
-            bool fnUnsigned64(context_t& ctxt, u64 _min, u64 _max);
-            bool fnInteger32(context_t& ctxt, s32 _min, s32 _max);
-            bool fnInteger64(context_t& ctxt, s64 _min, s64 _max);
-            bool fnFloat32(context_t& ctxt, f32 _min, f32 _max);
-            bool fnFloat64(context_t& ctxt, f64 _min, f64 _max);
-            bool fnDecimal(context_t& ctxt);
-
-            parser_t::program_t initialize(buffer_t buffer)
-            {
-                m_code = binary_writer_t(buffer.m_begin, buffer.m_end);
-                return parser_t::program_t(this, 0);
-            }
-
-            bool execute(parser_t::program_t const& prog, nrunes::reader_t const& reader, u32& cursor)
-            {
-                context_t ctxt(reader);
-                ctxt.reader.set_cursor(cursor);
-                buffer_t code = m_code.get_current_buffer();
-                m_program     = binary_reader_t(code.m_begin, code.m_end);
-                m_program.seek(prog.pc());
-                if (fnExec(ctxt))
-                {
-                    cursor = ctxt.get_cursor();
-                    return true;
-                }
-                return false;
-            }
-
-            DCORE_CLASS_PLACEMENT_NEW_DELETE
-        };
-
         parser_t::program_t::program_t() : m_machine(nullptr), m_pc(0) {}
         parser_t::program_t::program_t(machine_t* m) : m_machine(m) { m_pc = m->pc(); }
         parser_t::program_t::program_t(machine_t* m, pc_t pc) : m_machine(m), m_pc(pc) {}
@@ -539,7 +245,8 @@ namespace ncore
         parser_t::program_t parser_t::Program(program_t p)
         {
             program_t prog(m_machine);
-            m_machine->emit_call(p.pc());
+            m_machine->emit_instr(eSequence);
+            m_machine->emit_calls(p.pc());
             return prog;
         }
         parser_t::program_t parser_t::Not(program_t p)
@@ -779,7 +486,7 @@ namespace ncore
         {
             crunes_t validchars = make_crunes((ascii::pcrune) "!#$%&'*+/=?^_`{|}~-", 0, 19, 19);
 
-            program_t email_program = Sequence(OneOrMore(Or(AlphaNumeric(), In(validchars))), ZeroOrMore(Sequence(Or(Is('.'), Is('_')), Or(AlphaNumeric(), In(validchars)))), Is('@'), Host());
+            program_t email_program = Sequence(OneOrMore(Or(AlphaNumeric(), In(validchars))), ZeroOrMore(Sequence(Or(Is('.'), Is('_')), OneOrMore(Or(AlphaNumeric(), In(validchars))))), Is('@'), Host());
             return email_program;
         }
 
@@ -824,13 +531,63 @@ namespace ncore
             return program;
         }
 
+        // Execute the program referenced by the call entry at the current position, when done
+        // the position is restored to that call entry.
         bool machine_t::fnExec(context_t& ctxt)
         {
-            bool result = true;
+            pc_t const pc     = exec_jmp();
+            bool const result = fnRun(ctxt);
+            m_program.seek(pc);
+            return result;
+        }
 
-            u16 const pc = exec_jmp();
+        // Execute the instruction at the current position.
+        // Note: operands are read into locals first, the evaluation order of function arguments is unspecified.
+        bool machine_t::fnRun(context_t& ctxt)
+        {
+#if defined(CTEXT_PARSER2_PROFILE)
+            if (m_counters != nullptr)
+                return fnProfile(ctxt);
+#endif
+            eOpcode const o = (eOpcode)m_program.read_u8();
+            ctxt.examine();
+            if (o >= eRegular)
+                return fnRegular(ctxt, m_regular[o - eRegular]);
+            return fnDispatch(ctxt, o);
+        }
+
+#if defined(CTEXT_PARSER2_PROFILE)
+        // Execute the instruction at the current position and update its counters. The reach is measured per
+        // instruction, what it examined beyond the end of its match (or its start when it fails) is backtracked.
+        bool machine_t::fnProfile(context_t& ctxt)
+        {
+            pc_t const pc    = (pc_t)m_program.pos();
+            u32 const  start = ctxt.get_cursor();
+            u32 const  reach = ctxt.reach;
+            ctxt.reach       = start;
 
             eOpcode const o = (eOpcode)m_program.read_u8();
+            ctxt.examine();
+            bool const result = (o >= eRegular) ? fnRegular(ctxt, m_regular[o - eRegular]) : fnDispatch(ctxt, o);
+
+            if (pc < m_num_counters)
+            {
+                parser_t::counter_t& counter = m_counters[pc];
+                u32 const            end     = result ? ctxt.get_cursor() : start;
+                counter.m_executions += 1;
+                counter.m_successes += result ? 1 : 0;
+                counter.m_failures += result ? 0 : 1;
+                if (ctxt.reach > end)
+                    counter.m_backtracked += ctxt.reach - end;
+            }
+            ctxt.reach = (reach > ctxt.reach) ? reach : ctxt.reach;
+            return result;
+        }
+#endif
+
+        bool machine_t::fnDispatch(context_t& ctxt, eOpcode o)
+        {
+            bool result = true;
             switch (o)
             {
                 case eNOP: break;
@@ -842,11 +599,19 @@ namespace ncore
                 case eServerAddress:
                 case eUri: break;
 
+                case eRegular: break; // handled by fnRun
+
                 case eNot: result = fnNot(ctxt); break;
                 case eOr: result = fnOr(ctxt); break;
                 case eAnd: result = fnAnd(ctxt); break;
                 case eSequence: result = fnSequence(ctxt); break;
-                case eWithin: result = fnWithin(ctxt, operands_t::read_s32(m_program), operands_t::read_s32(m_program)); break;
+                case eWithin:
+                {
+                    s32 const a = operands_t::read_s32(m_program);
+                    s32 const b = operands_t::read_s32(m_program);
+                    result      = fnWithin(ctxt, a, b);
+                }
+                break;
                 case eTimes: result = fnTimes(ctxt, operands_t::read_s32(m_program)); break;
                 case eOneOrMore: result = fnOneOrMore(ctxt); break;
                 case eZeroOrMore: result = fnZeroOrMore(ctxt); break;
@@ -854,12 +619,24 @@ namespace ncore
                 case eWhile: result = fnWhile(ctxt); break;
                 case eUntil: result = fnUntil(ctxt); break;
                 case eExtract: result = fnExtract(ctxt, operands_t::read_var(m_program)); break;
-                case eEnclosed: result = fnEnclosed(ctxt, operands_t::read_uchar32(m_program), operands_t::read_uchar32(m_program)); break;
+                case eEnclosed:
+                {
+                    uchar32 const a = operands_t::read_uchar32(m_program);
+                    uchar32 const b = operands_t::read_uchar32(m_program);
+                    result          = fnEnclosed(ctxt, a, b);
+                }
+                break;
 
                 case eAny: result = fnAny(ctxt); break;
                 case eDigest: result = fnDigest(ctxt, operands_t::read_u8(m_program)); break;
                 case eIn: result = fnIn(ctxt, operands_t::read_crunes(m_program)); break;
-                case eBetween: result = fnBetween(ctxt, operands_t::read_uchar32(m_program), operands_t::read_uchar32(m_program)); break;
+                case eBetween:
+                {
+                    uchar32 const a = operands_t::read_uchar32(m_program);
+                    uchar32 const b = operands_t::read_uchar32(m_program);
+                    result          = fnBetween(ctxt, a, b);
+                }
+                break;
                 case eAlphabet: result = fnAlphabet(ctxt); break;
                 case eDigit: result = fnDigit(ctxt); break;
                 case eHex: result = fnHex(ctxt); break;
@@ -872,25 +649,76 @@ namespace ncore
                 case eWord: result = fnWord(ctxt); break;
                 case eEndOfText: result = fnEndOfText(ctxt); break;
                 case eEndOfLine: result = fnEndOfLine(ctxt); break;
-                case eUnsigned32: result = fnUnsigned32(ctxt, operands_t::read_u32(m_program), operands_t::read_u32(m_program)); break;
-                case eUnsigned64: result = fnUnsigned64(ctxt, operands_t::read_u64(m_program), operands_t::read_u64(m_program)); break;
-                case eInteger32: result = fnInteger32(ctxt, operands_t::read_s32(m_program), operands_t::read_s32(m_program)); break;
-                case eInteger64: result = fnInteger64(ctxt, operands_t::read_s64(m_program), operands_t::read_s64(m_program)); break;
-                case eFloat32: result = fnFloat32(ctxt, operands_t::read_f32(m_program), operands_t::read_f32(m_program)); break;
-                case eFloat64: result = fnFloat64(ctxt, operands_t::read_f64(m_program), operands_t::read_f64(m_program)); break;
+                case eUnsigned32:
+                {
+                    u32 const a = operands_t::read_u32(m_program);
+                    u32 const b = operands_t::read_u32(m_program);
+                    result      = fnUnsigned32(ctxt, a, b);
+                }
+                break;
+                case eUnsigned64:
+                {
+                    u64 const a = operands_t::read_u64(m_program);
+                    u64 const b = operands_t::read_u64(m_program);
+                    result      = fnUnsigned64(ctxt, a, b);
+                }
+                break;
+                case eInteger32:
+                {
+                    s32 const a = operands_t::read_s32(m_program);
+                    s32 const b = operands_t::read_s32(m_program);
+                    result      = fnInteger32(ctxt, a, b);
+                }
+                break;
+                case eInteger64:
+                {
+                    s64 const a = operands_t::read_s64(m_program);
+                    s64 const b = operands_t::read_s64(m_program);
+                    result      = fnInteger64(ctxt, a, b);
+                }
+                break;
+                case eFloat32:
+                {
+                    f32 const a = operands_t::read_f32(m_program);
+                    f32 const b = operands_t::read_f32(m_program);
+                    result      = fnFloat32(ctxt, a, b);
+                }
+                break;
+                case eFloat64:
+                {
+                    f64 const a = operands_t::read_f64(m_program);
+                    f64 const b = operands_t::read_f64(m_program);
+                    result      = fnFloat64(ctxt, a, b);
+                }
+                break;
+                case eUnsignedDigits:
+                {
+                    u64 const a  = operands_t::read_u64(m_program);
+                    u64 const b  = operands_t::read_u64(m_program);
+                    s32 const lo = operands_t::read_u8(m_program);
+                    s32 const hi = operands_t::read_u8(m_program);
+                    result       = fnUnsignedDigits(ctxt, a, b, lo, hi);
+                }
+                break;
             }
 
-            m_program.seek(pc);
             return result;
         }
 
         bool machine_t::fnOpcodeIs(eOpcode o) const
         {
-            u16 const opcode = m_program.peek_u16();
+            u8 const opcode = m_program.peek_u8();
             return opcode == o;
         }
 
-        bool machine_t::fnNot(context_t& ctxt) { return fnExec(ctxt); }
+        bool machine_t::fnNot(context_t& ctxt)
+        {
+            u32 const cursor = ctxt.get_cursor();
+            skip_count();
+            bool const result = fnExec(ctxt);
+            ctxt.set_cursor(cursor);
+            return !result;
+        }
 
         bool machine_t::fnOr(context_t& ctxt)
         {
@@ -911,10 +739,11 @@ namespace ncore
             return false;
         }
 
+        // All operands have to match at the same position, the cursor ends up at the shortest match
         bool machine_t::fnAnd(context_t& ctxt)
         {
             u32 const cursor = ctxt.get_cursor();
-            u32       best   = ctxt.get_cursor();
+            u32       best   = 0xffffffff;
 
             u16 n = m_program.read_u16(); // number of operands
             while (n != 0)
@@ -928,10 +757,12 @@ namespace ncore
                 }
                 skip_jmp();
 
-                best = ctxt.get_cursor();
+                if (ctxt.get_cursor() < best)
+                    best = ctxt.get_cursor();
 
                 n--;
             }
+            ctxt.set_cursor(best);
             return true;
         }
 
@@ -956,15 +787,24 @@ namespace ncore
 
         bool machine_t::fnWithin(context_t& ctxt, s32 _min, s32 _max)
         {
+            skip_count();
+
             u32 const cursor = ctxt.get_cursor();
             s32       i      = 0;
             while (i < _max)
             {
+                u32 const iteration = ctxt.get_cursor();
                 if (!fnExec(ctxt))
                 {
+                    ctxt.set_cursor(iteration);
                     break;
                 }
                 i += 1;
+                if (iteration == ctxt.get_cursor())
+                {
+                    // Matched without consuming anything, repeating will not change that
+                    i = _max;
+                }
             }
 
             if (i >= _min && i <= _max)
@@ -980,8 +820,9 @@ namespace ncore
         bool machine_t::fnWhile(context_t& ctxt) { return fnWithin(ctxt, 0, 0x7fffffff); }
         bool machine_t::fnUntil(context_t& ctxt)
         {
+            skip_count();
+
             u32 const cursor = ctxt.get_cursor();
-            s32       i      = 0;
             while (!fnEndOfText(ctxt))
             {
                 if (fnExec(ctxt))
@@ -997,6 +838,8 @@ namespace ncore
         }
         bool machine_t::fnExtract(context_t& ctxt, va_r_t* var)
         {
+            skip_count();
+
             u32 start = ctxt.get_cursor();
             if (!fnExec(ctxt))
             {
@@ -1013,6 +856,8 @@ namespace ncore
         }
         bool machine_t::fnEnclosed(context_t& ctxt, uchar32 _open, uchar32 _close)
         {
+            skip_count();
+
             u32 start = ctxt.get_cursor();
             if (ctxt.reader.peek() != _open)
                 return false;
@@ -1023,6 +868,7 @@ namespace ncore
                 ctxt.set_cursor(start);
                 return false;
             }
+            ctxt.examine();
             if (ctxt.reader.peek() != _close)
             {
                 ctxt.set_cursor(start);
@@ -1033,6 +879,8 @@ namespace ncore
         }
         bool machine_t::fnAny(context_t& ctxt)
         {
+            if (!ctxt.reader.valid())
+                return false;
             ctxt.reader.skip();
             return true;
         }
@@ -1072,11 +920,13 @@ namespace ncore
                             break;
                     }
 
-                    return false;
+                    // Digesting always succeeds, it just stops at the first character that is not part of 'flags'
+                    return true;
                 }
                 ctxt.reader.skip();
             }
-            return false;
+            ctxt.examine();
+            return true;
         }
         bool machine_t::fnIn(context_t& ctxt, nrunes::reader_t _chars)
         {
@@ -1104,43 +954,11 @@ namespace ncore
             }
             return false;
         }
-        bool machine_t::fnAlphabet(context_t& ctxt)
-        {
-            if (!fnBetween(ctxt, 'a', 'z'))
-            {
-                if (!fnBetween(ctxt, 'A', 'Z'))
-                    return false;
-            }
-            ctxt.reader.skip();
-            return true;
-        }
-        bool machine_t::fnDigit(context_t& ctxt)
-        {
-            if (!fnBetween(ctxt, '0', '9'))
-            {
-                return false;
-            }
-            ctxt.reader.skip();
-            return true;
-        }
-        bool machine_t::fnHex(context_t& ctxt)
-        {
-            if (fnBetween(ctxt, 'a', 'f') || fnBetween(ctxt, 'A', 'F') || fnBetween(ctxt, '0', '9'))
-            {
-                ctxt.reader.skip();
-                return true;
-            }
-            return false;
-        }
-        bool machine_t::fnAlphaNumeric(context_t& ctxt)
-        {
-            if (fnDigit(ctxt) || fnAlphabet(ctxt))
-            {
-                ctxt.reader.skip();
-                return true;
-            }
-            return false;
-        }
+        // Note: fnBetween already advances the reader when it matches
+        bool machine_t::fnAlphabet(context_t& ctxt) { return fnBetween(ctxt, 'a', 'z') || fnBetween(ctxt, 'A', 'Z'); }
+        bool machine_t::fnDigit(context_t& ctxt) { return fnBetween(ctxt, '0', '9'); }
+        bool machine_t::fnHex(context_t& ctxt) { return fnBetween(ctxt, 'a', 'f') || fnBetween(ctxt, 'A', 'F') || fnBetween(ctxt, '0', '9'); }
+        bool machine_t::fnAlphaNumeric(context_t& ctxt) { return fnDigit(ctxt) || fnAlphabet(ctxt); }
         bool machine_t::fnExact(context_t& ctxt, nrunes::reader_t _text)
         {
             _text.reset();
@@ -1148,7 +966,8 @@ namespace ncore
             u32 cursor  = ctxt.get_cursor();
             while (_text.valid())
             {
-                uchar32 const s = ctxt.reader.peek();
+                ctxt.examine();
+                uchar32 const s = ctxt.reader.read();
                 uchar32 const c = _text.read();
                 if (c != s)
                 {
@@ -1165,9 +984,10 @@ namespace ncore
             u32 cursor  = ctxt.get_cursor();
             while (_text.valid())
             {
-                uchar32 const s = ctxt.reader.peek();
+                ctxt.examine();
+                uchar32 const s = ctxt.reader.read();
                 uchar32 const c = _text.read();
-                if (c != s && nrunes::to_lower(c) != nrunes::to_lower(c))
+                if (c != s && nrunes::to_lower(c) != nrunes::to_lower(s))
                 {
                     ctxt.set_cursor(cursor);
                     return false;
@@ -1204,16 +1024,22 @@ namespace ncore
                 return false;
             }
             while (fnAlphabet(ctxt)) {}
+            ctxt.examine();
             return true;
         }
 
-        bool machine_t::fnEndOfText(context_t& ctxt) { return !ctxt.reader.valid(); }
+        bool machine_t::fnEndOfText(context_t& ctxt)
+        {
+            ctxt.examine();
+            return !ctxt.reader.valid();
+        }
 
         bool machine_t::fnEndOfLine(context_t& ctxt)
         {
             u32           cursor = ctxt.get_cursor();
             uchar32 const s1     = ctxt.reader.peek();
             ctxt.reader.skip();
+            ctxt.examine();
             uchar32 const s2 = ctxt.reader.peek();
             if (s1 == '\r' && s2 == '\n')
             {
@@ -1244,6 +1070,7 @@ namespace ncore
                 ctxt.reader.skip();
             }
 
+            ctxt.examine();
             if (cursor == ctxt.get_cursor())
                 return false;
 
@@ -1255,33 +1082,42 @@ namespace ncore
             return false;
         }
         bool machine_t::fnInteger32(context_t& ctxt, s32 _min, s32 _max) { return fnInteger64(ctxt, _min, _max); }
-        bool machine_t::fnInteger64(context_t& ctxt, s64 _min, s64 _max)
-        {
-            u32 cursor = ctxt.get_cursor();
 
-            s64 value = 0;
+        bool read_integer64(nrunes::reader_t& reader, s64& value)
+        {
+            value = 0;
 
-            uchar32 c = ctxt.reader.peek();
+            uchar32 c = reader.peek();
 
             bool const is_negative = (c == '-');
             if (is_negative)
-                ctxt.reader.skip();
+                reader.skip();
 
-            while (ctxt.reader.valid())
+            u32 const digits = reader.get_cursor();
+            while (reader.valid())
             {
-                c = ctxt.reader.peek();
+                c = reader.peek();
                 if (!(c >= '0' && c <= '9'))
                     break;
                 value = (value * 10) + nrunes::to_digit(c);
-                ctxt.reader.skip();
+                reader.skip();
             }
-            if (cursor == ctxt.get_cursor())
+            if (digits == reader.get_cursor())
                 return false;
 
             if (is_negative)
                 value = -value;
+            return true;
+        }
 
-            if (value >= _min && value <= _max)
+        bool machine_t::fnInteger64(context_t& ctxt, s64 _min, s64 _max)
+        {
+            u32 cursor = ctxt.get_cursor();
+
+            s64        value  = 0;
+            bool const number = read_integer64(ctxt.reader, value);
+            ctxt.examine();
+            if (number && value >= _min && value <= _max)
             {
                 return true;
             }
@@ -1289,39 +1125,54 @@ namespace ncore
             return false;
         }
         bool machine_t::fnFloat32(context_t& ctxt, f32 _min, f32 _max) { return fnFloat64(ctxt, _min, _max); }
-        bool machine_t::fnFloat64(context_t& ctxt, f64 _min, f64 _max)
+
+        bool read_float64(nrunes::reader_t& reader, f64& value)
         {
-            u32 cursor = ctxt.get_cursor();
+            u32 const cursor = reader.get_cursor();
 
-            f64     value       = 0.0;
-            uchar32 c           = ctxt.reader.peek();
+            value               = 0.0;
+            uchar32 c           = reader.peek();
             bool    is_negative = c == '-';
             if (is_negative)
-                ctxt.reader.skip();
-            while (ctxt.reader.valid())
+                reader.skip();
+            while (reader.valid())
             {
-                c = ctxt.reader.peek();
+                c = reader.peek();
                 if (!nrunes::is_digit(c))
                     break;
                 value = (value * 10.0) + nrunes::to_digit(c);
+                reader.skip();
             }
             if (c == '.')
             {
-                ctxt.reader.skip();
+                reader.skip();
                 f64 mantissa = 10.0;
-                while (ctxt.reader.valid())
+                while (reader.valid())
                 {
-                    c = ctxt.reader.peek();
+                    c = reader.peek();
                     if (!nrunes::is_digit(c))
                         break;
                     value = value + f64(nrunes::to_digit(c)) / mantissa;
                     mantissa *= 10.0;
+                    reader.skip();
                 }
             }
-            if (cursor == ctxt.get_cursor())
+            if (cursor == reader.get_cursor())
                 return false;
             if (is_negative)
                 value = -value;
+            return true;
+        }
+
+        bool machine_t::fnFloat64(context_t& ctxt, f64 _min, f64 _max)
+        {
+            u32 cursor = ctxt.get_cursor();
+
+            f64        value  = 0.0;
+            bool const number = read_float64(ctxt.reader, value);
+            ctxt.examine();
+            if (!number)
+                return false;
             if (value >= _min && value <= _max)
             {
                 return true;
@@ -1331,6 +1182,399 @@ namespace ncore
         }
         bool machine_t::fnDecimal(context_t& ctxt) { return fnUnsigned64(ctxt, 0, 0xffffffffffffffffUL); }
 
+        // The value is of all the digits, the match ends after at most '_hi' digits
+        bool machine_t::fnUnsignedDigits(context_t& ctxt, u64 _min, u64 _max, s32 _lo, s32 _hi)
+        {
+            u32 const cursor = ctxt.get_cursor();
+            u32       end    = cursor;
+            s32       digits = 0;
+            u64       value  = 0;
+            while (ctxt.reader.valid())
+            {
+                uchar32 c = ctxt.reader.peek();
+                if (!(c >= '0' && c <= '9'))
+                    break;
+                value = (value * 10) + nrunes::to_digit(c);
+                ctxt.reader.skip();
+                if (digits < _hi)
+                {
+                    digits += 1;
+                    end = ctxt.get_cursor();
+                }
+            }
+
+            ctxt.examine();
+            if (cursor == ctxt.get_cursor() || digits < _lo || value < _min || value > _max)
+            {
+                ctxt.set_cursor(cursor);
+                return false;
+            }
+            ctxt.set_cursor(end);
+            return true;
+        }
+
+        void machine_t::decode(pc_t pc, instr_t& instr) const
+        {
+            buffer_t const  code = m_code.get_current_buffer();
+            binary_reader_t reader(code.m_begin, code.m_end);
+            reader.seek(pc);
+
+            instr.m_opcode = (eOpcode)reader.read_u8();
+            if (instr.m_opcode >= eRegular)
+                instr.m_opcode = (eOpcode)m_regular[instr.m_opcode - eRegular]->m_opcode;
+            instr.m_ncalls    = 0;
+            instr.m_calls     = 0;
+            instr.m_a         = 0;
+            instr.m_b         = 0;
+            instr.m_fa        = 0.0;
+            instr.m_fb        = 0.0;
+            instr.m_text      = crunes_t();
+            instr.m_digits[0] = 0;
+            instr.m_digits[1] = 0;
+
+            switch (instr.m_opcode)
+            {
+                case eWithin:
+                case eInteger32:
+                    instr.m_a = operands_t::read_s32(reader);
+                    instr.m_b = operands_t::read_s32(reader);
+                    break;
+                case eTimes: instr.m_a = operands_t::read_s32(reader); break;
+                case eExtract: instr.m_a = (s64)operands_t::read_u64(reader); break;
+                case eEnclosed:
+                case eBetween:
+                case eUnsigned32:
+                    instr.m_a = operands_t::read_u32(reader);
+                    instr.m_b = operands_t::read_u32(reader);
+                    break;
+                case eDigest: instr.m_a = operands_t::read_u8(reader); break;
+                case eIn:
+                case eExact:
+                case eLike: instr.m_text = operands_t::read_crunes(reader); break;
+                case eIs: instr.m_a = operands_t::read_uchar32(reader); break;
+                case eUnsigned64:
+                    instr.m_a = (s64)operands_t::read_u64(reader);
+                    instr.m_b = (s64)operands_t::read_u64(reader);
+                    break;
+                case eInteger64:
+                    instr.m_a = operands_t::read_s64(reader);
+                    instr.m_b = operands_t::read_s64(reader);
+                    break;
+                case eFloat32:
+                    instr.m_fa = operands_t::read_f32(reader);
+                    instr.m_fb = operands_t::read_f32(reader);
+                    break;
+                case eFloat64:
+                    instr.m_fa = operands_t::read_f64(reader);
+                    instr.m_fb = operands_t::read_f64(reader);
+                    break;
+                case eUnsignedDigits:
+                    instr.m_a         = (s64)operands_t::read_u64(reader);
+                    instr.m_b         = (s64)operands_t::read_u64(reader);
+                    instr.m_digits[0] = operands_t::read_u8(reader);
+                    instr.m_digits[1] = operands_t::read_u8(reader);
+                    break;
+                default: break;
+            }
+
+            if (is_scope(instr.m_opcode))
+            {
+                instr.m_ncalls = reader.read_u16();
+                instr.m_calls  = (pc_t)reader.pos();
+                reader.seek(instr.m_calls + instr.m_ncalls * sizeof(pc_t));
+            }
+            instr.m_size = (u32)reader.pos() - pc;
+        }
+
+        machine_t::pc_t machine_t::call(instr_t const& instr, s32 index) const
+        {
+            buffer_t const  code = m_code.get_current_buffer();
+            binary_reader_t reader(code.m_begin, code.m_end);
+            reader.seek(instr.m_calls + index * sizeof(pc_t));
+            return (pc_t)reader.read_u32();
+        }
+
+        bool machine_t::ascii_class(instr_t const& instr, nscan::byteset_t& set)
+        {
+            set.clear();
+            switch (instr.m_opcode)
+            {
+                case eIs:
+                    if (instr.m_a <= 0 || instr.m_a >= 0x80)
+                        return false;
+                    set.set((u8)instr.m_a);
+                    return true;
+                case eIn:
+                {
+                    nrunes::reader_t chars(instr.m_text);
+                    while (chars.valid())
+                    {
+                        uchar32 const c = chars.read();
+                        if (c == 0 || c >= 0x80)
+                            return false;
+                        set.set((u8)c);
+                    }
+                    return true;
+                }
+                case eBetween:
+                    if (instr.m_a <= 0 || instr.m_b >= 0x80)
+                        return false;
+                    if (instr.m_a <= instr.m_b)
+                        set.set((u8)instr.m_a, (u8)instr.m_b);
+                    return true;
+                case eAlphabet:
+                    set.set('a', 'z');
+                    set.set('A', 'Z');
+                    return true;
+                case eDigit: set.set('0', '9'); return true;
+                case eHex:
+                    set.set('0', '9');
+                    set.set('a', 'f');
+                    set.set('A', 'F');
+                    return true;
+                case eAlphaNumeric:
+                    set.set('0', '9');
+                    set.set('a', 'z');
+                    set.set('A', 'Z');
+                    return true;
+                case eWhiteSpace:
+                    set.set(' ');
+                    set.set('\t');
+                    set.set('\r');
+                    return true;
+                default: break;
+            }
+            return false;
+        }
+
+        // Non-ASCII runes are not tracked individually, they mark every byte that can start a multi-byte sequence
+        static void first_add(nscan::byteset_t& set, uchar32 c)
+        {
+            if (c < 0x80)
+                set.set((u8)c);
+            else
+                set.set(0x80, 0xff);
+        }
+
+        static void first_add(nscan::byteset_t& set, uchar32 from, uchar32 to)
+        {
+            if (from > to)
+                return;
+            if (from < 0x80)
+                set.set((u8)from, (u8)(to < 0x80 ? to : 0x7f));
+            if (to >= 0x80)
+                set.set(0x80, 0xff);
+        }
+
+        void machine_t::first(pc_t pc, first_t& f) const
+        {
+            instr_t instr;
+            decode(pc, instr);
+
+            f.m_set.clear();
+            f.m_nullable = false;
+
+            first_t child;
+            switch (instr.m_opcode)
+            {
+                case eSequence:
+                    f.m_nullable = true;
+                    for (s32 i = 0; i < instr.m_ncalls && f.m_nullable; ++i)
+                    {
+                        first(call(instr, i), child);
+                        f.m_set.merge(child.m_set);
+                        f.m_nullable = child.m_nullable;
+                    }
+                    break;
+                case eOr:
+                    for (s32 i = 0; i < instr.m_ncalls; ++i)
+                    {
+                        first(call(instr, i), child);
+                        f.m_set.merge(child.m_set);
+                        f.m_nullable = f.m_nullable || child.m_nullable;
+                    }
+                    break;
+                case eAnd:
+                    // Every operand has to match at the same position, only the non-nullable ones restrict the set
+                    f.m_set.fill();
+                    f.m_nullable = true;
+                    for (s32 i = 0; i < instr.m_ncalls; ++i)
+                    {
+                        first(call(instr, i), child);
+                        if (!child.m_nullable)
+                            f.m_set.intersect(child.m_set);
+                        f.m_nullable = f.m_nullable && child.m_nullable;
+                    }
+                    break;
+                case eWithin:
+                case eTimes:
+                    first(call(instr, 0), f);
+                    f.m_nullable = f.m_nullable || instr.m_a == 0;
+                    break;
+                case eOneOrMore:
+                case eExtract: first(call(instr, 0), f); break;
+                case eZeroOrMore:
+                case eZeroOrOne:
+                case eWhile:
+                    first(call(instr, 0), f);
+                    f.m_nullable = true;
+                    break;
+                case eEnclosed: first_add(f.m_set, (uchar32)instr.m_a); break;
+
+                case eAny: f.m_set.fill(); break;
+                case eIn:
+                {
+                    nrunes::reader_t chars(instr.m_text);
+                    while (chars.valid())
+                        first_add(f.m_set, chars.read());
+                }
+                break;
+                case eBetween: first_add(f.m_set, (uchar32)instr.m_a, (uchar32)instr.m_b); break;
+                case eWord:
+                case eAlphabet:
+                    first_add(f.m_set, 'a', 'z');
+                    first_add(f.m_set, 'A', 'Z');
+                    break;
+                case eDecimal:
+                case eUnsigned32:
+                case eUnsigned64:
+                case eUnsignedDigits:
+                case eDigit: first_add(f.m_set, '0', '9'); break;
+                case eHex:
+                    first_add(f.m_set, '0', '9');
+                    first_add(f.m_set, 'a', 'f');
+                    first_add(f.m_set, 'A', 'F');
+                    break;
+                case eAlphaNumeric:
+                    first_add(f.m_set, '0', '9');
+                    first_add(f.m_set, 'a', 'z');
+                    first_add(f.m_set, 'A', 'Z');
+                    break;
+                case eExact:
+                case eLike:
+                {
+                    nrunes::reader_t text(instr.m_text);
+                    if (!text.valid())
+                    {
+                        f.m_nullable = true;
+                        break;
+                    }
+                    uchar32 const c = text.peek();
+                    first_add(f.m_set, c);
+                    if (instr.m_opcode == eLike)
+                    {
+                        first_add(f.m_set, nrunes::to_lower(c));
+                        first_add(f.m_set, nrunes::to_upper(c));
+                    }
+                }
+                break;
+                case eWhiteSpace:
+                    first_add(f.m_set, ' ');
+                    first_add(f.m_set, '\t');
+                    first_add(f.m_set, '\r');
+                    break;
+                case eIs: first_add(f.m_set, (uchar32)instr.m_a); break;
+                case eEndOfLine:
+                    first_add(f.m_set, '\r');
+                    first_add(f.m_set, '\n');
+                    break;
+                case eInteger32:
+                case eInteger64:
+                    first_add(f.m_set, '0', '9');
+                    first_add(f.m_set, '-');
+                    break;
+                case eFloat32:
+                case eFloat64:
+                    first_add(f.m_set, '0', '9');
+                    first_add(f.m_set, '-');
+                    first_add(f.m_set, '.');
+                    break;
+
+                // Anything that can match without consuming, or that scans ahead, can start anywhere
+                case eEndOfText: f.m_nullable = true; break;
+                default:
+                    f.m_set.fill();
+                    f.m_nullable = true;
+                    break;
+            }
+        }
+
+        bool machine_t::search(parser_t::program_t const& prog, first_t const& first, nrunes::reader_t const& reader, u32& begin, u32& end)
+        {
+            crunes_t const text   = reader.get_current();
+            u32 const      cursor = reader.get_cursor();
+
+            if (first.m_nullable || (text.m_type != ascii::TYPE && text.m_type != utf8::TYPE))
+            {
+                // Every position is a candidate (nullable program), or the text is not byte addressable
+                nrunes::reader_t r = reader;
+                while (true)
+                {
+                    u32 const start = r.get_cursor();
+                    if (first.m_nullable || (r.valid() && first.m_set.has((u8)(r.peek() < 0x80 ? r.peek() : 0x80))))
+                    {
+                        end = start;
+                        if (execute(prog, reader, end))
+                        {
+                            begin = start;
+                            return true;
+                        }
+                    }
+                    if (!r.valid())
+                        return false;
+                    r.skip();
+                }
+            }
+
+            // Skip ahead to the next byte that can start a match, then attempt the match at that position
+            u8 const* const base  = (u8 const*)text.m_ascii + text.m_str;
+            u8 const* const eos   = (u8 const*)text.m_ascii + text.m_end;
+            bool const      utf8  = text.m_type == utf8::TYPE;
+            s32 const       count = first.m_set.count();
+            u8 const        c1    = (u8)first.m_set.first();
+
+            // Find the 2nd member of the set when there are exactly two
+            u8 c2 = c1;
+            if (count == 2)
+            {
+                for (s32 b = c1 + 1; b < 256; ++b)
+                {
+                    if (first.m_set.has((u8)b))
+                    {
+                        c2 = (u8)b;
+                        break;
+                    }
+                }
+            }
+
+            u8 const* str = base;
+            while (str < eos)
+            {
+                if (count == 1)
+                    str = nscan::find_byte(str, eos, c1);
+                else if (count == 2)
+                    str = nscan::find_byte2(str, eos, c1, c2);
+                else
+                    str = nscan::find_in_set(str, eos, first.m_set);
+                if (str >= eos)
+                    break;
+
+                // Never start a match in the middle of a multi-byte sequence
+                if (!utf8 || (*str & 0xc0) != 0x80)
+                {
+                    u32 const start = cursor + (u32)(str - base);
+                    end             = start;
+                    if (execute(prog, reader, end))
+                    {
+                        begin = start;
+                        return true;
+                    }
+                }
+                ++str;
+            }
+            return false;
+        }
+
         void use_case_parser2()
         {
             u8       buffer[1024 + 1];
@@ -1346,12 +1590,29 @@ namespace ncore
             // result == true !
         }
 
+        // The machine is placed at the (aligned) start of the buffer, the code follows it
+        static u32 machine_offset(buffer_t const& buffer) { return (u32)((sizeof(void*) - ((ptr_t)buffer.m_begin & (sizeof(void*) - 1))) & (sizeof(void*) - 1)); }
+
         parser_t::parser_t(buffer_t buffer)
         {
             m_buffer = buffer;
+            reset();
+        }
+
+        u32 parser_t::required(u32 code_size) { return (u32)(sizeof(void*) - 1) + (u32)sizeof(machine_t) + code_size; }
+
+        u32 parser_t::size() const { return machine_offset(m_buffer) + (u32)sizeof(machine_t) + (u32)m_machine->m_code.pos(); }
 
-            buffer_t machine_buffer = buffer(0, sizeof(machine_t));
-            buffer_t work_buffer    = buffer(sizeof(machine_t), buffer.size());
+        u32 parser_t::code_size() const { return m_machine->m_size; }
+
+        bool parser_t::valid() const { return !m_machine->m_error; }
+
+        void parser_t::reset()
+        {
+            u32 const offset = machine_offset(m_buffer);
+            ASSERT(offset + sizeof(machine_t) <= m_buffer.size());
+            buffer_t machine_buffer = m_buffer(offset, offset + sizeof(machine_t));
+            buffer_t work_buffer    = m_buffer(offset + sizeof(machine_t), m_buffer.size());
             void*    machine_mem    = machine_buffer.data();
             m_machine               = new (machine_mem) machine_t();
             m_machine->initialize(work_buffer);
@@ -1369,6 +1630,66 @@ namespace ncore
             return false;
         }
 
+        s32 parser_t::parse_partial(program_t program, nrunes::reader_t& reader)
+        {
+            u32        cursor  = reader.get_cursor();
+            bool       hit_end = false;
+            machine_t* m       = program.m_machine;
+            bool const result  = m->execute(program, reader, cursor, &hit_end);
+            if (hit_end)
+                return cNEEDMORE;
+            if (!result)
+                return cNOMATCH;
+            reader.set_cursor(cursor);
+            return cMATCH;
+        }
+
+        bool parser_t::find(program_t program, nrunes::reader_t& reader, nrunes::reader_t& match)
+        {
+            machine_t*          m = program.m_machine;
+            machine_t::first_t first;
+            if (m->m_error)
+                return false;
+            m->first(program.pc(), first);
+
+            u32 begin, end;
+            if (m->search(program, first, reader, begin, end))
+            {
+                match = reader.select(begin, end);
+                reader.set_cursor(end);
+                return true;
+            }
+            return false;
+        }
+
+        s32 parser_t::findAll(program_t program, nrunes::reader_t& reader, nrunes::reader_t* matches, s32 max_matches)
+        {
+            machine_t*          m = program.m_machine;
+            machine_t::first_t first;
+            if (m->m_error)
+                return 0;
+            m->first(program.pc(), first);
+
+            s32 n = 0;
+            while (n < max_matches)
+            {
+                u32 begin, end;
+                if (!m->search(program, first, reader, begin, end))
+                    break;
+
+                matches[n++] = reader.select(begin, end);
+                reader.set_cursor(end);
+                if (begin == end)
+                {
+                    // An empty match, step over one character to guarantee progress
+                    if (!reader.valid())
+                        break;
+                    reader.skip();
+                }
+            }
+            return n;
+        }
+
     } // namespace parser2
 
 } // namespace ncore
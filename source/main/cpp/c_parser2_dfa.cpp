@@ -0,0 +1,471 @@
+#include "ccore/c_debug.h"
+#include "ccore/c_target.h"
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+
+#include "ctext/c_parser2.h"
+#include "ctext/c_text_scan.h"
+#include "ctext/private/c_parser2_machine.h"
+
+namespace ncore
+{
+    namespace parser2
+    {
+        static inline s32 lowest_bit(u64 w)
+        {
+            s32 i = 0;
+            while ((w & 1) == 0)
+            {
+                w >>= 1;
+                i += 1;
+            }
+            return i;
+        }
+
+        static u8* take(buffer_t& memory, u32 size, u32 alignment)
+        {
+            u8* ptr = (u8*)(((ptr_t)memory.m_begin + (alignment - 1)) & ~((ptr_t)alignment - 1));
+            if (ptr + size > memory.m_end)
+                return nullptr;
+            memory.m_begin = ptr + size;
+            return ptr;
+        }
+
+        // Glushkov construction, every character class of the sub-program becomes a position, a state of the
+        // automaton is 'the last position that matched'. The construction only accepts sub-programs where the
+        // leftmost-longest DFA match is identical to what the (greedy, possessive, ordered choice) interpreter
+        // matches:
+        // - only ASCII character classes, every position consumes exactly one byte
+        // - no captures, lookahead (Not, And), Until, Any or numeric ranges
+        // - loops with a body that can match the empty string are rejected
+        // - an alternative of Or that can match the empty string must be the last one
+        // - the automaton must be deterministic (see 'deterministic()'), so that the first byte always decides
+        //   which alternative or iteration is taken, exactly like the interpreter commits to it
+        struct glushkov_t
+        {
+            struct node_t
+            {
+                u64  m_first;
+                u64  m_last;
+                bool m_nullable;
+            };
+
+            glushkov_t(machine_t const* m) : m_machine(m), m_npos(0), m_ok(true) {}
+
+            node_t epsilon() const
+            {
+                node_t n;
+                n.m_first    = 0;
+                n.m_last     = 0;
+                n.m_nullable = true;
+                return n;
+            }
+
+            node_t position(nscan::byteset_t const& set)
+            {
+                if (m_npos >= regular_t::cMaxPositions)
+                {
+                    m_ok = false;
+                    return epsilon();
+                }
+                s32 const p = m_npos++;
+                m_sets[p]   = set;
+                m_follow[p] = 0;
+                node_t n;
+                n.m_first    = (u64)1 << p;
+                n.m_last     = (u64)1 << p;
+                n.m_nullable = false;
+                return n;
+            }
+
+            node_t sequence(node_t const& a, node_t const& b)
+            {
+                for (u64 bits = a.m_last; bits != 0; bits &= bits - 1)
+                    m_follow[lowest_bit(bits)] |= b.m_first;
+                node_t n;
+                n.m_first    = a.m_first | (a.m_nullable ? b.m_first : 0);
+                n.m_last     = b.m_last | (b.m_nullable ? a.m_last : 0);
+                n.m_nullable = a.m_nullable && b.m_nullable;
+                return n;
+            }
+
+            node_t alternative(node_t const& a, node_t const& b)
+            {
+                // Ordered choice, an earlier alternative that matches empty would always win
+                if (a.m_nullable)
+                    m_ok = false;
+                node_t n;
+                n.m_first    = a.m_first | b.m_first;
+                n.m_last     = a.m_last | b.m_last;
+                n.m_nullable = b.m_nullable;
+                return n;
+            }
+
+            node_t repeat(node_t const& a, bool nullable)
+            {
+                if (a.m_nullable)
+                    m_ok = false;
+                for (u64 bits = a.m_last; bits != 0; bits &= bits - 1)
+                    m_follow[lowest_bit(bits)] |= a.m_first;
+                node_t n     = a;
+                n.m_nullable = nullable;
+                return n;
+            }
+
+            node_t optional(node_t const& a)
+            {
+                node_t n     = a;
+                n.m_nullable = true;
+                return n;
+            }
+
+            // (a (a (a)?)?)? for 'count' iterations, the nesting keeps the automaton deterministic
+            node_t optionals(machine_t::pc_t body, s32 count)
+            {
+                if (count == 0)
+                    return epsilon();
+                node_t const a = build(body);
+                if (a.m_nullable)
+                    m_ok = false;
+                if (!m_ok)
+                    return a;
+                return optional(sequence(a, optionals(body, count - 1)));
+            }
+
+            node_t within(machine_t::pc_t body, s64 _min, s64 _max)
+            {
+                node_t n = epsilon();
+                for (s64 i = 0; i < _min && m_ok; ++i)
+                {
+                    node_t const a = build(body);
+                    if (a.m_nullable)
+                        m_ok = false;
+                    n = sequence(n, a);
+                }
+                if (!m_ok)
+                    return n;
+                if (_max == 0x7fffffff)
+                    return sequence(n, repeat(build(body), true));
+                if (_max - _min > regular_t::cMaxPositions)
+                {
+                    m_ok = false;
+                    return n;
+                }
+                return sequence(n, optionals(body, (s32)(_max - _min)));
+            }
+
+            void characters(nscan::byteset_t& set, uchar32 from, uchar32 to)
+            {
+                if (from == 0 || to >= 0x80 || from > to)
+                    m_ok = false;
+                else
+                    set.set((u8)from, (u8)to);
+            }
+
+            node_t text(crunes_t const& runes, bool ignore_case)
+            {
+                node_t           n = epsilon();
+                nrunes::reader_t reader(runes);
+                while (reader.valid() && m_ok)
+                {
+                    uchar32 const    c = reader.read();
+                    nscan::byteset_t set;
+                    characters(set, c, c);
+                    if (ignore_case && m_ok)
+                    {
+                        characters(set, nrunes::to_lower(c), nrunes::to_lower(c));
+                        characters(set, nrunes::to_upper(c), nrunes::to_upper(c));
+                    }
+                    n = sequence(n, position(set));
+                }
+                return n;
+            }
+
+            node_t build(machine_t::pc_t pc)
+            {
+                if (!m_ok)
+                    return epsilon();
+
+                machine_t::instr_t instr;
+                m_machine->decode(pc, instr);
+
+                nscan::byteset_t set;
+                switch (instr.m_opcode)
+                {
+                    case eSequence:
+                    case eEnclosed:
+                    {
+                        node_t n = epsilon();
+                        if (instr.m_opcode == eEnclosed)
+                        {
+                            characters(set, (uchar32)instr.m_a, (uchar32)instr.m_a);
+                            n = position(set);
+                        }
+                        for (s32 i = 0; i < instr.m_ncalls && m_ok; ++i)
+                            n = sequence(n, build(m_machine->call(instr, i)));
+                        if (instr.m_opcode == eEnclosed)
+                        {
+                            set.clear();
+                            characters(set, (uchar32)instr.m_b, (uchar32)instr.m_b);
+                            n = sequence(n, position(set));
+                        }
+                        return n;
+                    }
+                    case eOr:
+                    {
+                        if (instr.m_ncalls == 0)
+                            break;
+                        node_t n = build(m_machine->call(instr, 0));
+                        for (s32 i = 1; i < instr.m_ncalls && m_ok; ++i)
+                            n = alternative(n, build(m_machine->call(instr, i)));
+                        return n;
+                    }
+                    case eWithin: return within(m_machine->call(instr, 0), instr.m_a, instr.m_b);
+                    case eTimes: return within(m_machine->call(instr, 0), instr.m_a, instr.m_a);
+                    case eOneOrMore: return repeat(build(m_machine->call(instr, 0)), false);
+                    case eZeroOrMore:
+                    case eWhile: return repeat(build(m_machine->call(instr, 0)), true);
+                    case eZeroOrOne: return optional(build(m_machine->call(instr, 0)));
+
+                    case eIn:
+                    {
+                        nrunes::reader_t chars(instr.m_text);
+                        while (chars.valid() && m_ok)
+                        {
+                            uchar32 const c = chars.read();
+                            characters(set, c, c);
+                        }
+                        return position(set);
+                    }
+                    case eBetween: characters(set, (uchar32)instr.m_a, (uchar32)instr.m_b); return position(set);
+                    case eAlphabet:
+                        characters(set, 'a', 'z');
+                        characters(set, 'A', 'Z');
+                        return position(set);
+                    case eDigit: characters(set, '0', '9'); return position(set);
+                    case eHex:
+                        characters(set, '0', '9');
+                        characters(set, 'a', 'f');
+                        characters(set, 'A', 'F');
+                        return position(set);
+                    case eAlphaNumeric:
+                        characters(set, '0', '9');
+                        characters(set, 'a', 'z');
+                        characters(set, 'A', 'Z');
+                        return position(set);
+                    case eWord:
+                        characters(set, 'a', 'z');
+                        characters(set, 'A', 'Z');
+                        return repeat(position(set), false);
+                    case eWhiteSpace:
+                        characters(set, ' ', ' ');
+                        characters(set, '\t', '\t');
+                        characters(set, '\r', '\r');
+                        return position(set);
+                    case eIs: characters(set, (uchar32)instr.m_a, (uchar32)instr.m_a); return position(set);
+                    case eExact: return text(instr.m_text, false);
+                    case eLike: return text(instr.m_text, true);
+                    default: break;
+                }
+
+                m_ok = false;
+                return epsilon();
+            }
+
+            // Every byte has to select at most one position out of the start set and out of each follow set
+            bool deterministic(node_t const& root) const
+            {
+                if (!disjoint(root.m_first))
+                    return false;
+                for (s32 p = 0; p < m_npos; ++p)
+                {
+                    if (!disjoint(m_follow[p]))
+                        return false;
+                }
+                return true;
+            }
+
+            bool disjoint(u64 positions) const
+            {
+                nscan::byteset_t seen;
+                for (u64 bits = positions; bits != 0; bits &= bits - 1)
+                {
+                    nscan::byteset_t both = seen;
+                    both.intersect(m_sets[lowest_bit(bits)]);
+                    if (both.count() != 0)
+                        return false;
+                    seen.merge(m_sets[lowest_bit(bits)]);
+                }
+                return true;
+            }
+
+            regular_t* emit(buffer_t& memory, u8 opcode, node_t const& root) const
+            {
+                regular_t* r = (regular_t*)take(memory, sizeof(regular_t), sizeof(void*));
+                if (r == nullptr)
+                    return nullptr;
+
+                r->m_opcode     = opcode;
+                r->m_num_states = (u8)(m_npos + 1);
+
+                // Bytes that match the same positions behave the same, they share a column in the table
+                u64 signature[256];
+                r->m_num_classes = 0;
+                for (s32 b = 0; b < 256; ++b)
+                {
+                    u64 sig = 0;
+                    for (s32 p = 0; p < m_npos; ++p)
+                    {
+                        if (m_sets[p].has((u8)b))
+                            sig |= (u64)1 << p;
+                    }
+                    s32 c = 0;
+                    while (c < r->m_num_classes && signature[c] != sig)
+                        c += 1;
+                    if (c == r->m_num_classes)
+                    {
+                        signature[c]       = sig;
+                        r->m_class_byte[c] = (u8)b;
+                        r->m_num_classes += 1;
+                    }
+                    r->m_classes[b] = (u8)c;
+                }
+
+                u32 const table_size = (u32)r->m_num_states * r->m_num_classes;
+                r->m_follow          = (u64*)take(memory, sizeof(u64) * r->m_num_states, sizeof(u64));
+                r->m_sets            = (nscan::byteset_t*)take(memory, sizeof(nscan::byteset_t) * m_npos, sizeof(u64));
+                r->m_table           = take(memory, table_size, 1);
+                if (r->m_table == nullptr)
+                    return nullptr;
+
+                r->m_follow[0] = root.m_first;
+                r->m_accept[0] = root.m_nullable ? 1 : 0;
+                for (s32 p = 0; p < m_npos; ++p)
+                {
+                    r->m_follow[p + 1] = m_follow[p];
+                    r->m_sets[p]       = m_sets[p];
+                    r->m_accept[p + 1] = ((root.m_last >> p) & 1) ? 1 : 0;
+                }
+                for (u32 i = 0; i < table_size; ++i)
+                    r->m_table[i] = regular_t::cUnknown;
+                return r;
+            }
+
+            machine_t const* m_machine;
+            s32              m_npos;
+            bool             m_ok;
+            nscan::byteset_t m_sets[regular_t::cMaxPositions];
+            u64              m_follow[regular_t::cMaxPositions];
+        };
+
+        static s32 compile_regular(machine_t* m, machine_t::pc_t pc, buffer_t& memory)
+        {
+            u8* const code = m->m_code.get_current_buffer().m_begin;
+            if (code[pc] >= eRegular)
+                return 0;
+
+            machine_t::instr_t instr;
+            m->decode(pc, instr);
+            if (!machine_t::is_scope(instr.m_opcode))
+                return 0;
+
+            {
+                glushkov_t               g(m);
+                glushkov_t::node_t const root = g.build(pc);
+                if (g.m_ok && g.m_npos >= 2 && g.deterministic(root))
+                {
+                    if (m->m_num_regular >= machine_t::cMaxRegular)
+                        return 0;
+                    regular_t* r = g.emit(memory, (u8)instr.m_opcode, root);
+                    if (r == nullptr)
+                        return 0;
+                    m->m_regular[m->m_num_regular] = r;
+                    code[pc]                       = (u8)(eRegular + m->m_num_regular);
+                    m->m_num_regular += 1;
+                    return 1;
+                }
+            }
+
+            // Not regular as a whole, try the operands
+            s32 n = 0;
+            for (s32 i = 0; i < instr.m_ncalls; ++i)
+                n += compile_regular(m, m->call(instr, i), memory);
+            return n;
+        }
+
+        s32 machine_t::compile(pc_t pc, buffer_t& memory)
+        {
+            if (m_regular == nullptr)
+            {
+                m_regular = (regular_t**)take(memory, sizeof(regular_t*) * cMaxRegular, sizeof(void*));
+                if (m_regular == nullptr)
+                    return 0;
+            }
+            return compile_regular(this, pc, memory);
+        }
+
+        static u8 resolve(regular_t* r, s32 state, s32 cls)
+        {
+            u8 const b    = r->m_class_byte[cls];
+            u8       next = regular_t::cDead;
+            for (u64 bits = r->m_follow[state]; bits != 0; bits &= bits - 1)
+            {
+                s32 const p = lowest_bit(bits);
+                if (r->m_sets[p].has(b))
+                {
+                    next = (u8)(p + 1);
+                    break;
+                }
+            }
+            r->m_table[state * r->m_num_classes + cls] = next;
+            return next;
+        }
+
+        // Run the DFA over the bytes from the cursor, the match ends at the last accepting state that was reached
+        bool machine_t::fnRegular(context_t& ctxt, regular_t* r)
+        {
+            crunes_t const text = ctxt.reader.get_current();
+            if (text.m_type != ascii::TYPE && text.m_type != utf8::TYPE)
+                return fnDispatch(ctxt, (eOpcode)r->m_opcode);
+
+            u8 const* const str   = (u8 const*)text.m_ascii + text.m_str;
+            s32 const       len   = (s32)(text.m_end - text.m_str);
+            u8 const* const table = r->m_table;
+            s32 const       ncls  = r->m_num_classes;
+
+            s32 state = 0;
+            s32 last  = r->m_accept[0] ? 0 : -1;
+            s32 i     = 0;
+            for (; i < len; ++i)
+            {
+                s32 const cls  = r->m_classes[str[i]];
+                u8        next = table[state * ncls + cls];
+                if (next == regular_t::cUnknown)
+                    next = resolve(r, state, cls);
+                if (next == regular_t::cDead)
+                    break;
+                state = next;
+                if (r->m_accept[state])
+                    last = i + 1;
+            }
+            // The byte that ended the loop (or the end of the text) has been examined
+            u32 const examined = text.m_str + (u32)i;
+            ctxt.hit_end |= (i == len);
+            ctxt.reach = (examined > ctxt.reach) ? examined : ctxt.reach;
+
+            if (last < 0)
+                return false;
+            ctxt.set_cursor(ctxt.get_cursor() + (u32)last);
+            return true;
+        }
+
+        s32 parser_t::compile(program_t program, buffer_t memory)
+        {
+            machine_t* m = program.m_machine;
+            if (m->m_error)
+                return 0;
+            return m->compile(program.pc(), memory);
+        }
+
+    } // namespace parser2
+} // namespace ncore
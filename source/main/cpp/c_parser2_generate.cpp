@@ -0,0 +1,330 @@
+#include "ccore/c_debug.h"
+#include "ccore/c_target.h"
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+
+#include "ctext/c_parser2.h"
+#include "ctext/c_text_scan.h"
+#include "ctext/private/c_parser2_machine.h"
+
+namespace ncore
+{
+    namespace parser2
+    {
+        // Every instruction becomes a function '<name>_<pc>(p, e)' that returns the end of its match or 0, the
+        // functions are written after the functions they call. The generated code only uses the language, it
+        // does not depend on ctext.
+        class generator_t
+        {
+        public:
+            static const s32 cMaxNodes = 1024;
+
+            generator_t(machine_t const* m, const char* name, char* source, s32 size) : m_machine(m), m_name(name), m_text(source, size), m_num_nodes(0), m_ok(true) {}
+
+            s32 generate(machine_t::pc_t pc)
+            {
+                put("// Generated by ctext (parser2::parser_t::generate), do not edit.\n");
+                put("// ");
+                put(m_name);
+                put("(cursor, end) returns the end of the match at 'cursor' or 0 when there is no match.\n\n");
+                node(pc);
+                put("const char* ");
+                put(m_name);
+                put("(const char* cursor, const char* end) { return ");
+                function(pc);
+                put("(cursor, end); }\n");
+                s32 const length = m_text.end();
+                return m_ok ? length : -1;
+            }
+
+        private:
+            void put(char c) { m_text.put(c); }
+            void put(const char* str) { m_text.put(str); }
+            void put(u64 v) { m_text.put(v); }
+            void put(s64 v) { m_text.put(v); }
+            void function(machine_t::pc_t pc)
+            {
+                put(m_name);
+                put('_');
+                put((u64)pc);
+            }
+            void call(machine_t::pc_t pc, const char* cursor)
+            {
+                function(pc);
+                put('(');
+                put(cursor);
+                put(", e)");
+            }
+
+            void condition(nscan::byteset_t const& set)
+            {
+                s32 ranges = 0;
+                for (s32 b = 0; b < 0x100; ++b)
+                {
+                    if (!set.has((u8)b))
+                        continue;
+                    s32 to = b;
+                    while (to + 1 < 0x100 && set.has((u8)(to + 1)))
+                        to += 1;
+                    if (ranges++ > 0)
+                        put(" || ");
+                    if (to == b)
+                    {
+                        put("c == ");
+                        put((u64)b);
+                    }
+                    else
+                    {
+                        put("(c >= ");
+                        put((u64)b);
+                        put(" && c <= ");
+                        put((u64)to);
+                        put(')');
+                    }
+                    b = to;
+                }
+                if (ranges == 0)
+                    put("false");
+            }
+
+            bool visited(machine_t::pc_t pc)
+            {
+                for (s32 i = 0; i < m_num_nodes; ++i)
+                {
+                    if (m_nodes[i] == pc)
+                        return true;
+                }
+                if (m_num_nodes == cMaxNodes)
+                {
+                    m_ok = false;
+                    return true;
+                }
+                m_nodes[m_num_nodes++] = pc;
+                return false;
+            }
+
+            void number(u64 _min, u64 _max, s32 _lo, s32 _hi)
+            {
+                put("    const char*        start = p;\n");
+                if (_hi >= 0)
+                {
+                    put("    const char*        end   = p;\n");
+                    put("    long long          n     = 0;\n");
+                }
+                put("    unsigned long long value = 0;\n");
+                put("    while (p != e && *p >= '0' && *p <= '9')\n    {\n");
+                put("        value = (value * 10) + (unsigned long long)(*p - '0');\n");
+                put("        ++p;\n");
+                if (_hi >= 0)
+                {
+                    put("        if (n < ");
+                    put((s64)_hi);
+                    put(")\n        {\n            n += 1;\n            end = p;\n        }\n");
+                }
+                put("    }\n    if (p == start");
+                if (_hi >= 0)
+                {
+                    put(" || n < ");
+                    put((s64)_lo);
+                }
+                if (_min != 0)
+                {
+                    put(" || value < ");
+                    put(_min);
+                    put("ULL");
+                }
+                if (_max != 0xffffffffffffffffUL)
+                {
+                    put(" || value > ");
+                    put(_max);
+                    put("ULL");
+                }
+                put(")\n        return 0;\n");
+                put(_hi >= 0 ? "    return end;\n" : "    return p;\n");
+            }
+
+            void repeat(machine_t::instr_t const& instr, s64 _min, s64 _max)
+            {
+                put("    long long i = 0;\n    while (i < ");
+                put(_max);
+                put(")\n    {\n        const char* r = ");
+                call(m_machine->call(instr, 0), "p");
+                put(";\n        if (r == 0)\n            break;\n        i += 1;\n");
+                put("        if (r == p)\n            i = ");
+                put(_max);
+                put(";\n        p = r;\n    }\n    if (i < ");
+                put(_min);
+                put(" || i > ");
+                put(_max);
+                put(")\n        return 0;\n    return p;\n");
+            }
+
+            void node(machine_t::pc_t pc)
+            {
+                if (!m_ok || visited(pc))
+                    return;
+
+                machine_t::instr_t instr;
+                m_machine->decode(pc, instr);
+                for (s32 i = 0; i < instr.m_ncalls; ++i)
+                    node(m_machine->call(instr, i));
+                if (!m_ok)
+                    return;
+
+                put("static inline const char* ");
+                function(pc);
+                put("(const char* p, const char* e)\n{\n");
+
+                nscan::byteset_t set;
+                if (machine_t::ascii_class(instr, set))
+                {
+                    put("    if (p == e)\n        return 0;\n");
+                    put("    unsigned char const c = (unsigned char)*p;\n    if (!(");
+                    condition(set);
+                    put("))\n        return 0;\n    return p + 1;\n}\n\n");
+                    return;
+                }
+
+                switch (instr.m_opcode)
+                {
+                    case eNOP: put("    (void)e;\n    return p;\n"); break;
+                    case eSequence:
+                        for (s32 i = 0; i < instr.m_ncalls; ++i)
+                        {
+                            put("    p = ");
+                            call(m_machine->call(instr, i), "p");
+                            put(";\n    if (p == 0)\n        return 0;\n");
+                        }
+                        if (instr.m_ncalls == 0)
+                            put("    (void)e;\n");
+                        put("    return p;\n");
+                        break;
+                    case eOr:
+                        if (instr.m_ncalls == 0)
+                        {
+                            put("    (void)p;\n    (void)e;\n    return 0;\n");
+                            break;
+                        }
+                        if (instr.m_ncalls > 1)
+                            put("    const char* r = 0;\n");
+                        for (s32 i = 0; i < instr.m_ncalls - 1; ++i)
+                        {
+                            put("    r = ");
+                            call(m_machine->call(instr, i), "p");
+                            put(";\n    if (r != 0)\n        return r;\n");
+                        }
+                        put("    return ");
+                        call(m_machine->call(instr, instr.m_ncalls - 1), "p");
+                        put(";\n");
+                        break;
+                    case eAnd:
+                        if (instr.m_ncalls == 0)
+                        {
+                            put("    (void)e;\n    return p;\n");
+                            break;
+                        }
+                        put("    const char* best = ");
+                        call(m_machine->call(instr, 0), "p");
+                        put(";\n    if (best == 0)\n        return 0;\n");
+                        for (s32 i = 1; i < instr.m_ncalls; ++i)
+                        {
+                            put(i == 1 ? "    const char* r = " : "    r = ");
+                            call(m_machine->call(instr, i), "p");
+                            put(";\n    if (r == 0)\n        return 0;\n    if (r < best)\n        best = r;\n");
+                        }
+                        put("    return best;\n");
+                        break;
+                    case eNot:
+                        put("    return (");
+                        call(m_machine->call(instr, 0), "p");
+                        put(" != 0) ? 0 : p;\n");
+                        break;
+                    case eWithin: repeat(instr, instr.m_a, instr.m_b); break;
+                    case eTimes: repeat(instr, instr.m_a, instr.m_a); break;
+                    case eOneOrMore: repeat(instr, 1, 0x7fffffff); break;
+                    case eZeroOrMore:
+                    case eWhile: repeat(instr, 0, 0x7fffffff); break;
+                    case eZeroOrOne: repeat(instr, 0, 1); break;
+                    case eEnclosed:
+                        if (instr.m_a <= 0 || instr.m_a >= 0x80 || instr.m_b <= 0 || instr.m_b >= 0x80)
+                        {
+                            m_ok = false;
+                            break;
+                        }
+                        put("    if (p == e || (unsigned char)*p != ");
+                        put(instr.m_a);
+                        put(")\n        return 0;\n    p = ");
+                        call(m_machine->call(instr, 0), "p + 1");
+                        put(";\n    if (p == 0 || p == e || (unsigned char)*p != ");
+                        put(instr.m_b);
+                        put(")\n        return 0;\n    return p + 1;\n");
+                        break;
+                    case eWord:
+                        set.set('a', 'z');
+                        set.set('A', 'Z');
+                        put("    if (p == e)\n        return 0;\n    unsigned char c = (unsigned char)*p;\n    if (!(");
+                        condition(set);
+                        put("))\n        return 0;\n    ++p;\n    while (p != e)\n    {\n        c = (unsigned char)*p;\n        if (!(");
+                        condition(set);
+                        put("))\n            break;\n        ++p;\n    }\n    return p;\n");
+                        break;
+                    case eExact:
+                    {
+                        s32              len = 0;
+                        nrunes::reader_t chars(instr.m_text);
+                        put("    static const unsigned char text[] = {");
+                        while (chars.valid())
+                        {
+                            uchar32 const c = chars.read();
+                            if (c == 0 || c >= 0x80)
+                                m_ok = false;
+                            if (len++ > 0)
+                                put(", ");
+                            put((u64)c);
+                        }
+                        if (len == 0)
+                            put('0');
+                        put("};\n    if ((e - p) < ");
+                        put((s64)len);
+                        put(")\n        return 0;\n    for (int i = 0; i < ");
+                        put((s64)len);
+                        put("; ++i)\n    {\n        if ((unsigned char)p[i] != text[i])\n            return 0;\n    }\n    return p + ");
+                        put((s64)len);
+                        put(";\n");
+                    }
+                    break;
+                    case eEndOfText: put("    return (p == e) ? p : 0;\n"); break;
+                    case eEndOfLine:
+                        put("    if (p == e)\n        return 0;\n");
+                        put("    if (*p == '\\n')\n        return p + 1;\n");
+                        put("    if (*p == '\\r' && (p + 1) != e && p[1] == '\\n')\n        return p + 2;\n");
+                        put("    return 0;\n");
+                        break;
+                    case eUnsigned32:
+                    case eUnsigned64: number((u64)instr.m_a, (u64)instr.m_b, 0, -1); break;
+                    case eDecimal: number(0, 0xffffffffffffffffUL, 0, -1); break;
+                    case eUnsignedDigits: number((u64)instr.m_a, (u64)instr.m_b, instr.m_digits[0], instr.m_digits[1]); break;
+                    default: m_ok = false; break;
+                }
+                put("}\n\n");
+            }
+
+            machine_t const* m_machine;
+            const char*      m_name;
+            text_t           m_text;
+            machine_t::pc_t  m_nodes[cMaxNodes];
+            s32              m_num_nodes;
+            bool             m_ok;
+        };
+
+        s32 parser_t::generate(program_t program, const char* name, char* source, s32 size)
+        {
+            machine_t const* m = program.m_machine;
+            if (m->m_error)
+                return -1;
+            generator_t generator(m, name, source, size);
+            return generator.generate(program.pc());
+        }
+
+    } // namespace parser2
+} // namespace ncore
@@ -0,0 +1,189 @@
+#include "ccore/c_debug.h"
+#include "ccore/c_target.h"
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+
+#include "ctext/c_parser2.h"
+#include "ctext/private/c_parser2_machine.h"
+
+namespace ncore
+{
+    namespace parser2
+    {
+        incremental_t::incremental_t(buffer_t buffer, parser_t::program_t program)
+            : m_program(program)
+            , m_count(0)
+            , m_gap(0)
+            , m_bad(0)
+            , m_full(false)
+            , m_begin(0)
+            , m_end(0)
+            , m_reparsed(0)
+        {
+            u8* const begin = (u8*)(((ptr_t)buffer.m_begin + (sizeof(u32) - 1)) & ~((ptr_t)sizeof(u32) - 1));
+            m_records       = (record_t*)begin;
+            m_capacity      = (begin < buffer.m_end) ? (s32)((buffer.m_end - begin) / sizeof(record_t)) : 0;
+        }
+
+        u32 incremental_t::required(s32 max_records) { return (u32)(sizeof(u32) - 1) + (u32)(max_records * sizeof(record_t)); }
+
+        // Records before the gap hold absolute positions, records after the gap hold positions relative to the end
+        incremental_t::record_t incremental_t::at(s32 index) const
+        {
+            if (index < m_gap)
+                return m_records[index];
+            record_t r = m_records[index + (m_capacity - m_count)];
+            r.m_begin  = m_end - r.m_begin;
+            r.m_end    = m_end - r.m_end;
+            r.m_reach  = m_end - r.m_reach;
+            return r;
+        }
+
+        void incremental_t::move_gap(s32 index)
+        {
+            s32 const shift = m_capacity - m_count;
+            while (m_gap > index)
+            {
+                m_gap -= 1;
+                record_t& r = m_records[m_gap + shift];
+                r           = m_records[m_gap];
+                r.m_begin   = m_end - r.m_begin;
+                r.m_end     = m_end - r.m_end;
+                r.m_reach   = m_end - r.m_reach;
+            }
+            while (m_gap < index)
+            {
+                m_records[m_gap] = at(m_gap);
+                m_gap += 1;
+            }
+        }
+
+        // Remove the first record after the gap
+        void incremental_t::drop()
+        {
+            if (m_records[m_gap + (m_capacity - m_count)].m_bad)
+                m_bad -= 1;
+            m_count -= 1;
+        }
+
+        // Add a record before the gap
+        bool incremental_t::push(record_t const& record)
+        {
+            if (m_count == m_capacity)
+                return false;
+            m_records[m_gap] = record;
+            m_gap += 1;
+            m_count += 1;
+            if (record.m_bad)
+                m_bad += 1;
+            return true;
+        }
+
+        bool incremental_t::get(s32 index, u32& begin, u32& end) const
+        {
+            record_t const r = at(index);
+            begin            = r.m_begin;
+            end              = r.m_end;
+            return !r.m_bad;
+        }
+
+        // Parse records from 'cursor' until the first record after the gap is reached
+        void incremental_t::run(nrunes::reader_t const& text, u32 cursor)
+        {
+            machine_t* const m = m_program.m_machine;
+            while (true)
+            {
+                // Records that start before the cursor have been replaced
+                while (m_gap < m_count && at(m_gap).m_begin < cursor)
+                    drop();
+                if (m_gap < m_count && at(m_gap).m_begin == cursor)
+                    break;
+                if (cursor >= m_end)
+                    break;
+
+                record_t r;
+                r.m_begin = cursor;
+                r.m_end   = cursor;
+                r.m_reach = cursor;
+                r.m_bad   = 0;
+                m_reparsed += 1;
+                if (!m->execute(m_program, text, r.m_end, nullptr, &r.m_reach) || r.m_end == cursor)
+                {
+                    // Not a record, the text up to where a record can be parsed again (or up to the next record
+                    // that is still valid) is marked as bad
+                    u32 const        limit = (m_gap < m_count) ? at(m_gap).m_begin : m_end;
+                    nrunes::reader_t probe = text;
+                    probe.set_cursor(cursor);
+                    probe.skip();
+                    while (probe.get_cursor() < limit)
+                    {
+                        u32 end = probe.get_cursor();
+                        m_reparsed += 1;
+                        if (m->execute(m_program, text, end) && end > probe.get_cursor())
+                            break;
+                        probe.skip();
+                    }
+                    r.m_end   = (probe.get_cursor() < limit) ? probe.get_cursor() : limit;
+                    r.m_reach = r.m_end;
+                    r.m_bad   = 1;
+                }
+                if (!push(r))
+                {
+                    m_full = true;
+                    break;
+                }
+                cursor = r.m_end;
+            }
+        }
+
+        bool incremental_t::parse(nrunes::reader_t const& text)
+        {
+            m_count    = 0;
+            m_gap      = 0;
+            m_bad      = 0;
+            m_full     = false;
+            m_begin    = text.get_cursor();
+            m_end      = text.get_source().m_end;
+            m_reparsed = 0;
+            run(text, m_begin);
+            return valid();
+        }
+
+        bool incremental_t::edit(nrunes::reader_t const& text, u32 from, u32 to, u32 size)
+        {
+            ASSERT(from <= to && to <= m_end && text.get_cursor() == m_begin);
+            if (m_full)
+                return parse(text);
+
+            // The first record that examined the edited text, the records are contiguous so 'end' is
+            // ordered, records before the one that holds 'from' can still have looked ahead into the edit
+            s32 lo = 0;
+            s32 hi = m_count;
+            while (lo < hi)
+            {
+                s32 const mid = (lo + hi) >> 1;
+                if (at(mid).m_end <= from)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            while (lo > 0 && at(lo - 1).m_reach >= from)
+                lo -= 1;
+
+            u32 cursor = (lo > 0) ? at(lo - 1).m_end : m_begin;
+            cursor     = (cursor < from) ? cursor : from;
+
+            // Records that start in front of the end of the edit are gone, the others stay valid
+            move_gap(lo);
+            while (m_gap < m_count && at(m_gap).m_begin < to)
+                drop();
+            m_end = m_end - (to - from) + size;
+            ASSERT(m_end == text.get_source().m_end);
+
+            m_reparsed = 0;
+            run(text, cursor);
+            return valid();
+        }
+
+    } // namespace parser2
+} // namespace ncore
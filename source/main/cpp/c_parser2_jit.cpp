@@ -0,0 +1,675 @@
+#include "ccore/c_debug.h"
+#include "ccore/c_target.h"
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+
+#include "ctext/c_parser2.h"
+#include "ctext/c_text_scan.h"
+#include "ctext/private/c_parser2_machine.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#    define CTEXT_PARSER2_JIT
+#    if defined(_WIN32)
+#        define WIN32_LEAN_AND_MEAN
+#        include <windows.h>
+#    else
+#        include <sys/mman.h>
+#    endif
+#endif
+
+namespace ncore
+{
+    namespace parser2
+    {
+        // The native code is a function 'u8 const* match(u8 const* cursor, u8 const* end)' that returns the
+        // cursor after the match or nullptr. Registers:
+        // - r8  the cursor
+        // - r9  the end of the text
+        // - rax, rcx, rdx, r10, r11 scratch
+        // These are volatile in both the System V and the Windows x64 calling convention, nothing has to be saved.
+        // The state of scopes (the cursor to return to, repeat counters) is kept in fixed slots of the stack frame,
+        // a scope at nesting depth 'd' uses slot 'd' and 'd + 1'. A failure is a jump to the failure label of the
+        // scope that handles it, the slots of the scopes in between do not need to be cleaned up.
+        //
+        // Only the instructions that work on single ASCII bytes are translated, a program with other instructions
+        // (Extract, Any, Until, Like, signed and float numbers, ...) is not compiled and runs on the interpreter.
+        typedef u8 const* (*jit_fn)(u8 const* cursor, u8 const* end);
+
+#if defined(CTEXT_PARSER2_JIT)
+
+        static u8* jit_alloc(u32 size)
+        {
+#    if defined(_WIN32)
+            return (u8*)VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#    else
+            void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            return (mem == MAP_FAILED) ? nullptr : (u8*)mem;
+#    endif
+        }
+
+        static bool jit_protect(u8* code, u32 size)
+        {
+#    if defined(_WIN32)
+            DWORD old;
+            return VirtualProtect(code, size, PAGE_EXECUTE_READ, &old) != 0;
+#    else
+            return mprotect(code, size, PROT_READ | PROT_EXEC) == 0;
+#    endif
+        }
+
+        static void jit_free(u8* code, u32 size)
+        {
+#    if defined(_WIN32)
+            VirtualFree(code, 0, MEM_RELEASE);
+#    else
+            munmap(code, size);
+#    endif
+        }
+
+        enum eCondition
+        {
+            cB  = 0x2,
+            cAE = 0x3,
+            cE  = 0x4,
+            cNE = 0x5,
+            cBE = 0x6,
+            cA  = 0x7,
+            cL  = 0xC,
+            cGE = 0xD,
+            cG  = 0xF,
+        };
+
+        // A jump target, the rel32 fields of the jumps to a label that is not bound yet form a chain
+        struct label_t
+        {
+            label_t() : m_pos(-1), m_chain(-1) {}
+            s32 m_pos;
+            s32 m_chain;
+        };
+
+        class jit_compiler_t
+        {
+        public:
+            static const s32 cMaxSlots = 256;
+
+            jit_compiler_t(machine_t const* m, u8* code, u32 capacity) : m_machine(m), m_code(code), m_size(0), m_capacity(capacity), m_slots(0), m_ok(true) {}
+
+            u32 compile(machine_t::pc_t pc)
+            {
+                // prologue, the size of the frame is patched when it is known
+#    if defined(_WIN32)
+                bytes(0x49, 0x89, 0xC8); // mov r8, rcx
+                bytes(0x49, 0x89, 0xD1); // mov r9, rdx
+#    else
+                bytes(0x49, 0x89, 0xF8); // mov r8, rdi
+                bytes(0x49, 0x89, 0xF1); // mov r9, rsi
+#    endif
+                bytes(0x48, 0x81, 0xEC); // sub rsp, imm32
+                s32 const frame = (s32)m_size;
+                dword(0);
+
+                label_t fail;
+                node(pc, fail, 0);
+
+                u32 const size = (u32)(m_slots * 8 + 8);
+                bytes(0x4C, 0x89, 0xC0); // mov rax, r8
+                bytes(0x48, 0x81, 0xC4); // add rsp, imm32
+                dword(size);
+                byte(0xC3);
+                bind(fail);
+                bytes(0x31, 0xC0); // xor eax, eax
+                bytes(0x48, 0x81, 0xC4);
+                dword(size);
+                byte(0xC3);
+
+                if (!m_ok)
+                    return 0;
+                patch(frame, size);
+                return m_size;
+            }
+
+        private:
+            void byte(u8 b)
+            {
+                if (m_size < m_capacity)
+                    m_code[m_size++] = b;
+                else
+                    m_ok = false;
+            }
+            void bytes(u8 b0, u8 b1)
+            {
+                byte(b0);
+                byte(b1);
+            }
+            void bytes(u8 b0, u8 b1, u8 b2)
+            {
+                byte(b0);
+                byte(b1);
+                byte(b2);
+            }
+            void bytes(u8 b0, u8 b1, u8 b2, u8 b3)
+            {
+                bytes(b0, b1);
+                bytes(b2, b3);
+            }
+            void dword(u32 v)
+            {
+                for (s32 i = 0; i < 4; ++i)
+                    byte((u8)(v >> (i * 8)));
+            }
+            void qword(u64 v)
+            {
+                dword((u32)v);
+                dword((u32)(v >> 32));
+            }
+            void patch(s32 pos, u32 v)
+            {
+                if (pos + 4 > (s32)m_size)
+                    return;
+                for (s32 i = 0; i < 4; ++i)
+                    m_code[pos + i] = (u8)(v >> (i * 8));
+            }
+            s32 read(s32 pos) const { return (s32)((u32)m_code[pos] | ((u32)m_code[pos + 1] << 8) | ((u32)m_code[pos + 2] << 16) | ((u32)m_code[pos + 3] << 24)); }
+
+            void target(label_t& l)
+            {
+                if (l.m_pos >= 0)
+                {
+                    dword((u32)(l.m_pos - (s32)(m_size + 4)));
+                }
+                else
+                {
+                    s32 const field = (s32)m_size;
+                    dword((u32)l.m_chain);
+                    l.m_chain = field;
+                }
+            }
+            void bind(label_t& l)
+            {
+                l.m_pos = (s32)m_size;
+                while (l.m_chain >= 0 && l.m_chain + 4 <= (s32)m_size)
+                {
+                    s32 const next = read(l.m_chain);
+                    patch(l.m_chain, (u32)(l.m_pos - (l.m_chain + 4)));
+                    l.m_chain = next;
+                }
+            }
+            void jmp(label_t& l)
+            {
+                byte(0xE9);
+                target(l);
+            }
+            void jcc(eCondition c, label_t& l)
+            {
+                bytes(0x0F, (u8)(0x80 + c));
+                target(l);
+            }
+
+            // [rsp + 8 * slot]
+            void slot_operand(u8 modrm, s32 slot)
+            {
+                bytes(modrm, 0x24);
+                dword((u32)(slot * 8));
+                if (slot >= m_slots)
+                    m_slots = slot + 1;
+            }
+            void store(s32 slot) // mov [slot], r8
+            {
+                bytes(0x4C, 0x89);
+                slot_operand(0x84, slot);
+            }
+            void load(s32 slot) // mov r8, [slot]
+            {
+                bytes(0x4C, 0x8B);
+                slot_operand(0x84, slot);
+            }
+            void compare(s32 slot) // cmp r8, [slot]
+            {
+                bytes(0x4C, 0x3B);
+                slot_operand(0x84, slot);
+            }
+            void store_imm(s32 slot, s32 v) // mov qword [slot], imm32
+            {
+                bytes(0x48, 0xC7);
+                slot_operand(0x84, slot);
+                dword((u32)v);
+            }
+            void compare_imm(s32 slot, s32 v) // cmp qword [slot], imm32
+            {
+                bytes(0x48, 0x81);
+                slot_operand(0xBC, slot);
+                dword((u32)v);
+            }
+            void increment(s32 slot) // inc qword [slot]
+            {
+                bytes(0x48, 0xFF);
+                slot_operand(0x84, slot);
+            }
+
+            // The byte at the cursor has to be in 'set', on success the cursor is not advanced yet
+            void test(nscan::byteset_t const& set, label_t& fail)
+            {
+                bytes(0x4D, 0x39, 0xC8); // cmp r8, r9
+                jcc(cAE, fail);
+                bytes(0x41, 0x0F, 0xB6, 0x00); // movzx eax, byte [r8]
+
+                u8  from[4], to[4];
+                s32 ranges = 0;
+                for (s32 b = 0; b < 0x80 && ranges <= 3; ++b)
+                {
+                    if (!set.has((u8)b))
+                        continue;
+                    if (ranges > 0 && to[ranges - 1] == b - 1)
+                    {
+                        to[ranges - 1] = (u8)b;
+                        continue;
+                    }
+                    if (ranges < 4)
+                    {
+                        from[ranges] = (u8)b;
+                        to[ranges]   = (u8)b;
+                    }
+                    ranges += 1;
+                }
+
+                if (ranges == 0)
+                {
+                    jmp(fail);
+                    return;
+                }
+                if (ranges <= 3)
+                {
+                    label_t ok;
+                    for (s32 r = 0; r < ranges; ++r)
+                    {
+                        if (from[r] == to[r])
+                        {
+                            bytes(0x3C, from[r]); // cmp al, imm8
+                            jcc(r + 1 < ranges ? cE : cNE, r + 1 < ranges ? ok : fail);
+                        }
+                        else
+                        {
+                            bytes(0x8D, 0x48, (u8)(0x100 - from[r])); // lea ecx, [rax - from]
+                            bytes(0x83, 0xF9, (u8)(to[r] - from[r])); // cmp ecx, imm8
+                            jcc(r + 1 < ranges ? cBE : cA, r + 1 < ranges ? ok : fail);
+                        }
+                    }
+                    bind(ok);
+                    return;
+                }
+
+                // A table of 256 bytes in the code, jumped over
+                byte(0xE9);
+                dword(256);
+                s32 const table = (s32)m_size;
+                for (s32 b = 0; b < 256; ++b)
+                    byte(set.has((u8)b) ? 1 : 0);
+                bytes(0x48, 0x8D, 0x0D); // lea rcx, [rip + disp32]
+                dword((u32)(table - (s32)(m_size + 4)));
+                bytes(0x80, 0x3C, 0x01, 0x00); // cmp byte [rcx + rax], 0
+                jcc(cE, fail);
+            }
+
+            void advance() { bytes(0x49, 0xFF, 0xC0); } // inc r8
+
+            // Same as machine_t::fnWithin
+            void repeat(machine_t::instr_t const& instr, s64 _min, s64 _max, label_t& fail, s32 depth)
+            {
+                machine_t::instr_t child;
+                m_machine->decode(m_machine->call(instr, 0), child);
+
+                nscan::byteset_t set;
+                if (machine_t::ascii_class(child, set))
+                {
+                    // The body always consumes one byte, the counter is kept in rdx
+                    label_t loop, done;
+                    bytes(0x31, 0xD2); // xor edx, edx
+                    bind(loop);
+                    bytes(0x48, 0x81, 0xFA); // cmp rdx, imm32
+                    dword((u32)_max);
+                    jcc(cGE, done);
+                    test(set, done);
+                    advance();
+                    bytes(0x48, 0xFF, 0xC2); // inc rdx
+                    jmp(loop);
+                    bind(done);
+                    bytes(0x48, 0x81, 0xFA);
+                    dword((u32)_min);
+                    jcc(cL, fail);
+                    bytes(0x48, 0x81, 0xFA);
+                    dword((u32)_max);
+                    jcc(cG, fail);
+                    return;
+                }
+
+                s32 const count     = depth;
+                s32 const iteration = depth + 1;
+                label_t   loop, again, done, stop;
+                store_imm(count, 0);
+                bind(loop);
+                compare_imm(count, (s32)_max);
+                jcc(cGE, done);
+                store(iteration);
+                node(m_machine->call(instr, 0), stop, depth + 2);
+                increment(count);
+                compare(iteration);
+                jcc(cNE, loop);
+                // Matched without consuming anything, repeating will not change that
+                store_imm(count, (s32)_max);
+                jmp(done);
+                bind(stop);
+                load(iteration);
+                bind(done);
+                compare_imm(count, (s32)_min);
+                jcc(cL, fail);
+                compare_imm(count, (s32)_max);
+                jcc(cG, fail);
+            }
+
+            // Same as machine_t::fnUnsigned64 (_hi < 0) and machine_t::fnUnsignedDigits
+            void number(u64 _min, u64 _max, s32 _lo, s32 _hi, label_t& fail)
+            {
+                label_t loop, end;
+                bytes(0x4D, 0x89, 0xC2); // mov r10, r8
+                bytes(0x4D, 0x89, 0xC3); // mov r11, r8
+                bytes(0x31, 0xC0);       // xor eax, eax
+                bytes(0x31, 0xD2);       // xor edx, edx
+                bind(loop);
+                bytes(0x4D, 0x39, 0xC8); // cmp r8, r9
+                jcc(cAE, end);
+                bytes(0x41, 0x0F, 0xB6, 0x08); // movzx ecx, byte [r8]
+                bytes(0x83, 0xE9, '0');        // sub ecx, '0'
+                bytes(0x83, 0xF9, 9);          // cmp ecx, 9
+                jcc(cA, end);
+                bytes(0x48, 0x6B, 0xC0, 10); // imul rax, rax, 10
+                bytes(0x48, 0x01, 0xC8);     // add rax, rcx
+                advance();
+                if (_hi >= 0)
+                {
+                    bytes(0x48, 0x81, 0xFA); // cmp rdx, imm32
+                    dword((u32)_hi);
+                    jcc(cGE, loop);
+                    bytes(0x48, 0xFF, 0xC2); // inc rdx
+                    bytes(0x4D, 0x89, 0xC3); // mov r11, r8
+                }
+                jmp(loop);
+                bind(end);
+                bytes(0x4D, 0x39, 0xD0); // cmp r8, r10
+                jcc(cE, fail);
+                if (_hi >= 0)
+                {
+                    bytes(0x48, 0x81, 0xFA); // cmp rdx, imm32
+                    dword((u32)_lo);
+                    jcc(cL, fail);
+                }
+                bytes(0x48, 0xB9); // mov rcx, imm64
+                qword(_min);
+                bytes(0x48, 0x39, 0xC8); // cmp rax, rcx
+                jcc(cB, fail);
+                bytes(0x48, 0xB9);
+                qword(_max);
+                bytes(0x48, 0x39, 0xC8);
+                jcc(cA, fail);
+                if (_hi >= 0)
+                    bytes(0x4D, 0x89, 0xD8); // mov r8, r11
+            }
+
+            void node(machine_t::pc_t pc, label_t& fail, s32 depth)
+            {
+                if (!m_ok)
+                    return;
+                if (depth + 2 > cMaxSlots)
+                {
+                    m_ok = false;
+                    return;
+                }
+
+                machine_t::instr_t instr;
+                m_machine->decode(pc, instr);
+
+                nscan::byteset_t set;
+                if (machine_t::ascii_class(instr, set))
+                {
+                    test(set, fail);
+                    advance();
+                    return;
+                }
+
+                switch (instr.m_opcode)
+                {
+                    case eNOP: return;
+                    case eSequence:
+                        for (s32 i = 0; i < instr.m_ncalls; ++i)
+                            node(m_machine->call(instr, i), fail, depth);
+                        return;
+                    case eOr:
+                    {
+                        if (instr.m_ncalls == 0)
+                        {
+                            jmp(fail);
+                            return;
+                        }
+                        label_t ok;
+                        store(depth);
+                        for (s32 i = 0; i < instr.m_ncalls - 1; ++i)
+                        {
+                            label_t next;
+                            node(m_machine->call(instr, i), next, depth + 1);
+                            jmp(ok);
+                            bind(next);
+                            load(depth);
+                        }
+                        node(m_machine->call(instr, instr.m_ncalls - 1), fail, depth + 1);
+                        bind(ok);
+                        return;
+                    }
+                    case eAnd:
+                    {
+                        // slot 'depth' is the start, 'depth + 1' the shortest match
+                        store(depth);
+                        for (s32 i = 0; i < instr.m_ncalls; ++i)
+                        {
+                            if (i > 0)
+                                load(depth);
+                            node(m_machine->call(instr, i), fail, depth + 2);
+                            if (i == 0)
+                            {
+                                store(depth + 1);
+                            }
+                            else
+                            {
+                                label_t longer;
+                                compare(depth + 1);
+                                jcc(cAE, longer);
+                                store(depth + 1);
+                                bind(longer);
+                            }
+                        }
+                        if (instr.m_ncalls > 0)
+                            load(depth + 1);
+                        return;
+                    }
+                    case eNot:
+                    {
+                        label_t no;
+                        store(depth);
+                        node(m_machine->call(instr, 0), no, depth + 1);
+                        jmp(fail);
+                        bind(no);
+                        load(depth);
+                        return;
+                    }
+                    case eWithin: repeat(instr, instr.m_a, instr.m_b, fail, depth); return;
+                    case eTimes: repeat(instr, instr.m_a, instr.m_a, fail, depth); return;
+                    case eOneOrMore: repeat(instr, 1, 0x7fffffff, fail, depth); return;
+                    case eZeroOrMore:
+                    case eWhile: repeat(instr, 0, 0x7fffffff, fail, depth); return;
+                    case eZeroOrOne: repeat(instr, 0, 1, fail, depth); return;
+                    case eEnclosed:
+                    {
+                        if (instr.m_a <= 0 || instr.m_a >= 0x80 || instr.m_b <= 0 || instr.m_b >= 0x80)
+                            break;
+                        set.set((u8)instr.m_a);
+                        test(set, fail);
+                        advance();
+                        node(m_machine->call(instr, 0), fail, depth);
+                        set.clear();
+                        set.set((u8)instr.m_b);
+                        test(set, fail);
+                        advance();
+                        return;
+                    }
+                    case eWord:
+                    {
+                        label_t loop, done;
+                        set.set('a', 'z');
+                        set.set('A', 'Z');
+                        test(set, fail);
+                        advance();
+                        bind(loop);
+                        test(set, done);
+                        advance();
+                        jmp(loop);
+                        bind(done);
+                        return;
+                    }
+                    case eExact:
+                    {
+                        u8               text[256];
+                        s32              len = 0;
+                        nrunes::reader_t chars(instr.m_text);
+                        while (chars.valid())
+                        {
+                            uchar32 const c = chars.read();
+                            if (c == 0 || c >= 0x80 || len == 256)
+                            {
+                                m_ok = false;
+                                return;
+                            }
+                            text[len++] = (u8)c;
+                        }
+                        if (len == 0)
+                            return;
+                        bytes(0x49, 0x8D, 0x80); // lea rax, [r8 + disp32]
+                        dword((u32)len);
+                        bytes(0x4C, 0x39, 0xC8); // cmp rax, r9
+                        jcc(cA, fail);
+                        for (s32 i = 0; i < len; ++i)
+                        {
+                            bytes(0x41, 0x80, 0xB8); // cmp byte [r8 + disp32], imm8
+                            dword((u32)i);
+                            byte(text[i]);
+                            jcc(cNE, fail);
+                        }
+                        bytes(0x49, 0x81, 0xC0); // add r8, imm32
+                        dword((u32)len);
+                        return;
+                    }
+                    case eEndOfText:
+                    {
+                        bytes(0x4D, 0x39, 0xC8); // cmp r8, r9
+                        jcc(cB, fail);
+                        return;
+                    }
+                    case eEndOfLine:
+                    {
+                        label_t lf, done;
+                        bytes(0x4D, 0x39, 0xC8); // cmp r8, r9
+                        jcc(cAE, fail);
+                        bytes(0x41, 0x0F, 0xB6, 0x00); // movzx eax, byte [r8]
+                        bytes(0x3C, '\n');             // cmp al, '\n'
+                        jcc(cE, lf);
+                        bytes(0x3C, '\r');
+                        jcc(cNE, fail);
+                        bytes(0x49, 0x8D, 0x80); // lea rax, [r8 + 1]
+                        dword(1);
+                        bytes(0x4C, 0x39, 0xC8); // cmp rax, r9
+                        jcc(cAE, fail);
+                        bytes(0x41, 0x80, 0xB8); // cmp byte [r8 + 1], '\n'
+                        dword(1);
+                        byte('\n');
+                        jcc(cNE, fail);
+                        advance();
+                        bind(lf);
+                        advance();
+                        return;
+                    }
+                    case eUnsigned32:
+                    case eUnsigned64: number((u64)instr.m_a, (u64)instr.m_b, 0, -1, fail); return;
+                    case eDecimal: number(0, 0xffffffffffffffffUL, 0, -1, fail); return;
+                    case eUnsignedDigits: number((u64)instr.m_a, (u64)instr.m_b, instr.m_digits[0], instr.m_digits[1], fail); return;
+                    default: break;
+                }
+                m_ok = false;
+            }
+
+            machine_t const* m_machine;
+            u8*              m_code;
+            u32              m_size;
+            u32              m_capacity;
+            s32              m_slots;
+            bool             m_ok;
+        };
+
+#endif
+
+        jit_t::jit_t() : m_program(), m_code(nullptr), m_capacity(0), m_size(0) {}
+
+        jit_t::~jit_t() { reset(); }
+
+        void jit_t::reset()
+        {
+#if defined(CTEXT_PARSER2_JIT)
+            if (m_code != nullptr)
+                jit_free((u8*)m_code, m_capacity);
+#endif
+            m_code     = nullptr;
+            m_capacity = 0;
+            m_size     = 0;
+        }
+
+        bool jit_t::compile(parser_t::program_t program, u32 max_code_size)
+        {
+            reset();
+            m_program = program;
+#if defined(CTEXT_PARSER2_JIT)
+            machine_t const* m = program.m_machine;
+            if (m->m_error)
+                return false;
+
+            u8* code = jit_alloc(max_code_size);
+            if (code == nullptr)
+                return false;
+
+            jit_compiler_t compiler(m, code, max_code_size);
+            u32 const      size = compiler.compile(program.pc());
+            if (size == 0 || !jit_protect(code, max_code_size))
+            {
+                jit_free(code, max_code_size);
+                return false;
+            }
+            m_code     = code;
+            m_capacity = max_code_size;
+            m_size     = size;
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        bool jit_t::parse(nrunes::reader_t& reader) const
+        {
+            crunes_t const text = reader.get_current();
+            if (m_code == nullptr || (text.m_type != ascii::TYPE && text.m_type != utf8::TYPE))
+                return parser_t::parse(m_program, reader);
+
+            u8 const* const str   = (u8 const*)text.m_ascii;
+            u8 const* const match = ((jit_fn)m_code)(str + text.m_str, str + text.m_end);
+            if (match == nullptr)
+                return false;
+            reader.set_cursor((u32)(match - str));
+            return true;
+        }
+
+    } // namespace parser2
+} // namespace ncore
@@ -0,0 +1,458 @@
+#include "ccore/c_debug.h"
+#include "ccore/c_target.h"
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+
+#include "ctext/c_parser2.h"
+#include "ctext/c_text_scan.h"
+#include "ctext/private/c_parser2_machine.h"
+
+namespace ncore
+{
+    namespace parser2
+    {
+        static const char* opcode_name(eOpcode o)
+        {
+            switch (o)
+            {
+                case eNOP: return "NOP";
+                case eNot: return "NOT";
+                case eOr: return "OR";
+                case eAnd: return "AND";
+                case eSequence: return "SEQUENCE";
+                case eWithin: return "WITHIN";
+                case eTimes: return "TIMES";
+                case eOneOrMore: return "ONEORMORE";
+                case eZeroOrMore: return "ZEROORMORE";
+                case eZeroOrOne: return "ZEROORONE";
+                case eWhile: return "WHILE";
+                case eUntil: return "UNTIL";
+                case eExtract: return "EXTRACT";
+                case eEnclosed: return "ENCLOSED";
+                case eAny: return "ANY";
+                case eDigest: return "DIGEST";
+                case eIn: return "IN";
+                case eBetween: return "BETWEEN";
+                case eAlphabet: return "ALPHABET";
+                case eDigit: return "DIGIT";
+                case eHex: return "HEX";
+                case eAlphaNumeric: return "ALPHANUMERIC";
+                case eExact: return "EXACT";
+                case eLike: return "LIKE";
+                case eWhiteSpace: return "WHITESPACE";
+                case eIs: return "IS";
+                case eDecimal: return "DECIMAL";
+                case eWord: return "WORD";
+                case eEndOfText: return "EOT";
+                case eEndOfLine: return "EOL";
+                case eUnsigned32: return "U32";
+                case eUnsigned64: return "U64";
+                case eInteger32: return "S32";
+                case eInteger64: return "S64";
+                case eFloat32: return "F32";
+                case eFloat64: return "F64";
+                case eUnsignedDigits: return "UDIGITS";
+                default: break;
+            }
+            return nullptr;
+        }
+
+        // The different instructions that a program runs, with the height of their call tree
+        class nodes_t
+        {
+        public:
+            static const s32 cMaxNodes = 1024;
+
+            nodes_t(machine_t const* m) : m_machine(m), m_count(0), m_full(false) {}
+
+            // Returns the height of the call tree of 'pc', instructions called from more than one place are
+            // visited once
+            s32 collect(machine_t::pc_t pc)
+            {
+                for (s32 i = 0; i < m_count; ++i)
+                {
+                    if (m_pcs[i] == pc)
+                        return m_heights[i];
+                }
+                if (m_count == cMaxNodes)
+                {
+                    m_full = true;
+                    return 0;
+                }
+                s32 const index  = m_count++;
+                m_pcs[index]     = pc;
+                m_heights[index] = 1;
+
+                machine_t::instr_t instr;
+                m_machine->decode(pc, instr);
+                s32 height = 0;
+                for (s32 i = 0; i < instr.m_ncalls; ++i)
+                {
+                    s32 const h = collect(m_machine->call(instr, i));
+                    height      = (h > height) ? h : height;
+                }
+                m_heights[index] = 1 + height;
+                return m_heights[index];
+            }
+
+            void sort()
+            {
+                for (s32 i = 1; i < m_count; ++i)
+                {
+                    machine_t::pc_t const pc = m_pcs[i];
+                    s32 const             h  = m_heights[i];
+                    s32                   j  = i;
+                    for (; j > 0 && m_pcs[j - 1] > pc; --j)
+                    {
+                        m_pcs[j]     = m_pcs[j - 1];
+                        m_heights[j] = m_heights[j - 1];
+                    }
+                    m_pcs[j]     = pc;
+                    m_heights[j] = h;
+                }
+            }
+
+            machine_t const* m_machine;
+            machine_t::pc_t  m_pcs[cMaxNodes];
+            s32              m_heights[cMaxNodes];
+            s32              m_count;
+            bool             m_full; // more than cMaxNodes instructions, the rest is not visited
+        };
+
+        // Lists the instructions of a program, either as a tree in pre-order where operands are indented below the
+        // instruction that calls them (an instruction that is called from more than one place is listed once, later
+        // calls refer to its pc) or in the order of the code.
+        //
+        //     pc          exec       ok     fail  backtrack
+        //     000063         4        2        2         13  SEQUENCE
+        //     000058         4        2        2         13    TIMES 3
+        //     00004d        12       10        2          4      SEQUENCE
+        //
+        class listing_t
+        {
+        public:
+            static const s32 cMaxNodes = 1024;
+
+            listing_t(machine_t const* m, char* text, s32 size) : m_machine(m), m_text(text, size), m_num_nodes(0) {}
+
+            s32 list(machine_t::pc_t pc)
+            {
+                if (m_machine->m_counters != nullptr)
+                {
+                    m_text.put("time ");
+                    m_text.put(pc < m_machine->m_num_counters ? m_machine->m_counters[pc].m_time : (u64)0);
+                    m_text.put(" ns\n");
+                    m_text.put("pc          exec       ok     fail  backtrack\n");
+                }
+                node(pc, 0);
+                return m_text.end();
+            }
+
+            s32 disassemble(nodes_t const& nodes)
+            {
+                for (s32 i = 0; i < nodes.m_count; ++i)
+                {
+                    machine_t::instr_t instr;
+                    m_machine->decode(nodes.m_pcs[i], instr);
+                    hex(nodes.m_pcs[i]);
+                    m_text.put("  ");
+                    instruction(nodes.m_pcs[i], instr);
+                    for (s32 c = 0; c < instr.m_ncalls; ++c)
+                    {
+                        m_text.put(c == 0 ? " -> " : " ");
+                        hex(m_machine->call(instr, c));
+                    }
+                    m_text.put('\n');
+                }
+                if (nodes.m_full)
+                    m_text.put("...\n");
+                return m_text.end();
+            }
+
+        private:
+            void hex(u32 v)
+            {
+                static const char* digits = "0123456789abcdef";
+                for (s32 i = 5; i >= 0; --i)
+                    m_text.put(digits[(v >> (i * 4)) & 0xf]);
+            }
+
+            void character(uchar32 c)
+            {
+                if (c >= 0x20 && c < 0x7f && c != '\'' && c != '"' && c != '\\')
+                {
+                    m_text.put((char)c);
+                    return;
+                }
+                static const char* digits = "0123456789abcdef";
+                m_text.put("\\x");
+                s32 n = 2;
+                while (n < 8 && (c >> (n * 4)) != 0)
+                    n += 2;
+                for (s32 i = n - 1; i >= 0; --i)
+                    m_text.put(digits[(c >> (i * 4)) & 0xf]);
+            }
+
+            void quoted(uchar32 c)
+            {
+                m_text.put('\'');
+                character(c);
+                m_text.put('\'');
+            }
+
+            void real(f64 v)
+            {
+                if (v < 0.0)
+                {
+                    m_text.put('-');
+                    v = -v;
+                }
+                s32 exponent = 0;
+                if (v >= 1.0e15)
+                {
+                    while (v >= 10.0)
+                    {
+                        v /= 10.0;
+                        exponent += 1;
+                    }
+                }
+                u64 const whole    = (u64)v;
+                u64       fraction = (u64)((v - (f64)whole) * 1000.0 + 0.5);
+                m_text.put(whole + (fraction / 1000));
+                m_text.put('.');
+                m_text.put(fraction % 1000, 3);
+                if (exponent > 0)
+                {
+                    m_text.put('e');
+                    m_text.put((u64)exponent);
+                }
+            }
+
+            void instruction(machine_t::pc_t pc, machine_t::instr_t const& instr)
+            {
+                const char* name = opcode_name(instr.m_opcode);
+                m_text.put(name != nullptr ? name : "???");
+                switch (instr.m_opcode)
+                {
+                    case eWithin:
+                    case eInteger32:
+                    case eInteger64:
+                        m_text.put(' ');
+                        m_text.put(instr.m_a);
+                        m_text.put(", ");
+                        m_text.put(instr.m_b);
+                        break;
+                    case eTimes:
+                        m_text.put(' ');
+                        m_text.put(instr.m_a);
+                        break;
+                    case eUnsigned32:
+                    case eUnsigned64:
+                    case eUnsignedDigits:
+                        m_text.put(' ');
+                        m_text.put((u64)instr.m_a);
+                        m_text.put(", ");
+                        m_text.put((u64)instr.m_b);
+                        if (instr.m_opcode == eUnsignedDigits)
+                        {
+                            m_text.put(", ");
+                            m_text.put((u64)instr.m_digits[0]);
+                            m_text.put(", ");
+                            m_text.put((u64)instr.m_digits[1]);
+                        }
+                        break;
+                    case eFloat32:
+                    case eFloat64:
+                        m_text.put(' ');
+                        real(instr.m_fa);
+                        m_text.put(", ");
+                        real(instr.m_fb);
+                        break;
+                    case eEnclosed:
+                    case eBetween:
+                        m_text.put(' ');
+                        quoted((uchar32)instr.m_a);
+                        m_text.put(", ");
+                        quoted((uchar32)instr.m_b);
+                        break;
+                    case eIs:
+                        m_text.put(' ');
+                        quoted((uchar32)instr.m_a);
+                        break;
+                    case eDigest:
+                        m_text.put(' ');
+                        m_text.put((u64)instr.m_a);
+                        break;
+                    case eIn:
+                    case eExact:
+                    case eLike:
+                    {
+                        m_text.put(" \"");
+                        nrunes::reader_t chars(instr.m_text);
+                        while (chars.valid())
+                            character(chars.read());
+                        m_text.put('"');
+                    }
+                    break;
+                    default: break;
+                }
+                if (m_machine->m_code.get_current_buffer().m_begin[pc] >= (u8)eRegular)
+                    m_text.put(" (dfa)");
+            }
+
+            bool visited(machine_t::pc_t pc)
+            {
+                for (s32 i = 0; i < m_num_nodes; ++i)
+                {
+                    if (m_nodes[i] == pc)
+                        return true;
+                }
+                if (m_num_nodes < cMaxNodes)
+                    m_nodes[m_num_nodes++] = pc;
+                return false;
+            }
+
+            void node(machine_t::pc_t pc, s32 depth)
+            {
+                hex(pc);
+                if (m_machine->m_counters != nullptr && pc < m_machine->m_num_counters)
+                {
+                    parser_t::counter_t const& counter = m_machine->m_counters[pc];
+                    m_text.put((u64)counter.m_executions, 10);
+                    m_text.put((u64)counter.m_successes, 9);
+                    m_text.put((u64)counter.m_failures, 9);
+                    m_text.put(counter.m_backtracked, 11);
+                }
+                m_text.put("  ");
+                for (s32 i = 0; i < depth; ++i)
+                    m_text.put("  ");
+
+                bool const seen = visited(pc);
+                if (seen)
+                {
+                    m_text.put("-> ");
+                    hex(pc);
+                    m_text.put('\n');
+                    return;
+                }
+
+                machine_t::instr_t instr;
+                m_machine->decode(pc, instr);
+                instruction(pc, instr);
+                m_text.put('\n');
+
+                for (s32 i = 0; i < instr.m_ncalls; ++i)
+                    node(m_machine->call(instr, i), depth + 1);
+            }
+
+            machine_t const* m_machine;
+            text_t           m_text;
+            machine_t::pc_t  m_nodes[cMaxNodes];
+            s32              m_num_nodes;
+        };
+
+        s32 parser_t::listing(program_t program, char* text, s32 size)
+        {
+            machine_t const* m = program.m_machine;
+            if (m->m_error)
+            {
+                text_t out(text, size);
+                out.put("invalid\n");
+                return out.end();
+            }
+            listing_t listing(m, text, size);
+            return listing.list(program.pc());
+        }
+
+        s32 parser_t::disassemble(program_t program, char* text, s32 size)
+        {
+            machine_t const* m = program.m_machine;
+            if (m->m_error)
+            {
+                text_t out(text, size);
+                out.put("invalid\n");
+                return out.end();
+            }
+            nodes_t nodes(m);
+            nodes.collect(program.pc());
+            nodes.sort();
+            listing_t listing(m, text, size);
+            return listing.disassemble(nodes);
+        }
+
+        bool parser_t::statistics(program_t program, statistics_t& stats)
+        {
+            stats.m_size         = 0;
+            stats.m_instructions = 0;
+            stats.m_max_depth    = 0;
+            stats.m_backtracking = 0;
+            for (s32 i = 0; i < 256; ++i)
+                stats.m_mix[i] = 0;
+
+            machine_t const* m = program.m_machine;
+            if (m->m_error)
+                return false;
+
+            nodes_t nodes(m);
+            stats.m_max_depth    = nodes.collect(program.pc());
+            stats.m_instructions = nodes.m_count;
+            for (s32 i = 0; i < nodes.m_count; ++i)
+            {
+                machine_t::instr_t instr;
+                m->decode(nodes.m_pcs[i], instr);
+                stats.m_size += instr.m_size;
+                stats.m_mix[instr.m_opcode] += 1;
+
+                // An alternative that fails restarts at the position of the Or, every operand of an And restarts
+                // at the same position and a repetition ends with an iteration that fails or is cut off.
+                switch (instr.m_opcode)
+                {
+                    case eOr:
+                    case eAnd: stats.m_backtracking += (instr.m_ncalls > 1) ? instr.m_ncalls - 1 : 0; break;
+                    case eNot:
+                    case eWithin:
+                    case eTimes:
+                    case eOneOrMore:
+                    case eZeroOrMore:
+                    case eZeroOrOne:
+                    case eWhile:
+                    case eUntil: stats.m_backtracking += 1; break;
+                    default: break;
+                }
+            }
+            return !nodes.m_full;
+        }
+
+        const char* parser_t::opcode(s32 index) { return (index >= 0 && index < 256) ? opcode_name((eOpcode)index) : nullptr; }
+
+        u32 parser_t::profile_required() const { return (u32)(sizeof(u64) - 1) + m_machine->m_size * (u32)sizeof(counter_t); }
+
+        bool parser_t::profile(buffer_t memory)
+        {
+#if defined(CTEXT_PARSER2_PROFILE)
+            machine_t* m = m_machine;
+            if (m->m_error || memory.size() < profile_required())
+                return false;
+            u32 const  offset   = (u32)((sizeof(u64) - ((ptr_t)memory.m_begin & (sizeof(u64) - 1))) & (sizeof(u64) - 1));
+            counter_t* counters = (counter_t*)(memory.m_begin + offset);
+            for (u32 i = 0; i < m->m_size; ++i)
+                counters[i] = counter_t();
+            m->m_counters     = counters;
+            m->m_num_counters = m->m_size;
+            return true;
+#else
+            (void)memory;
+            return false;
+#endif
+        }
+
+        parser_t::counter_t const* parser_t::counters(program_t program)
+        {
+            machine_t const* m = program.m_machine;
+            if (m->m_counters == nullptr || program.pc() >= m->m_num_counters)
+                return nullptr;
+            return &m->m_counters[program.pc()];
+        }
+
+    } // namespace parser2
+} // namespace ncore
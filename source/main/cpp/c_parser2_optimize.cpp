@@ -0,0 +1,361 @@
+#include "ccore/c_debug.h"
+#include "ccore/c_target.h"
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+
+#include "ctext/c_parser2.h"
+#include "ctext/private/c_parser2_machine.h"
+
+namespace ncore
+{
+    namespace parser2
+    {
+        // The rewrites are exact because the machine does not backtrack into an operand that has matched, running
+        // the same code at the same position always gives the same result:
+        // - Sequence(a, Sequence(b, c)) -> Sequence(a, b, c), the same for Or
+        // - Sequence(a) and Or(a) -> a
+        // - Or(Is(a), Is(b), In("cd")) -> In("abcd"), only adjacent ASCII operands
+        // - Or(Sequence(p, a), Sequence(p, b)) -> Sequence(p, Or(a, b)), only adjacent operands
+        // - And(Within(Digit(), lo, hi), Unsigned32(min, max)) -> UnsignedDigits(min, max, lo, hi)
+        //
+        // New code is appended to the code of the machine, instructions that do not change are not copied.
+        static const s32 cMaxOperands = 64;
+        static const s32 cMaxClass    = 128;
+
+        static bool equal(machine_t const* m, machine_t::pc_t a, machine_t::pc_t b)
+        {
+            if (a == b)
+                return true;
+
+            machine_t::instr_t ia, ib;
+            m->decode(a, ia);
+            m->decode(b, ib);
+            if (ia.m_opcode != ib.m_opcode || ia.m_ncalls != ib.m_ncalls || ia.m_a != ib.m_a || ia.m_b != ib.m_b || ia.m_fa != ib.m_fa || ia.m_fb != ib.m_fb)
+                return false;
+            if (ia.m_digits[0] != ib.m_digits[0] || ia.m_digits[1] != ib.m_digits[1])
+                return false;
+            if (ia.m_text.m_type != ib.m_text.m_type || ia.m_text.m_ascii != ib.m_text.m_ascii || ia.m_text.m_end != ib.m_text.m_end)
+                return false;
+            for (s32 i = 0; i < ia.m_ncalls; ++i)
+            {
+                if (!equal(m, m->call(ia, i), m->call(ib, i)))
+                    return false;
+            }
+            return true;
+        }
+
+        static machine_t::pc_t emit_scope(machine_t* m, eOpcode o, machine_t::pc_t const* calls, s32 n)
+        {
+            machine_t::pc_t const pc = m->pc();
+            m->emit_instr(o);
+            m->write((u16)n);
+            for (s32 i = 0; i < n; ++i)
+                m->emit_call(calls[i]);
+            return pc;
+        }
+
+        // A copy of the scope instruction at 'pc' (same operands) with other calls
+        static machine_t::pc_t emit_copy(machine_t* m, machine_t::instr_t const& instr, machine_t::pc_t pc, machine_t::pc_t const* calls, s32 n)
+        {
+            u8 const* const       code   = m->m_code.get_current_buffer().m_begin;
+            machine_t::pc_t const result = m->pc();
+            m->emit_instr(instr.m_opcode);
+            for (machine_t::pc_t i = pc + 1; i < instr.m_calls - sizeof(u16); ++i)
+                m->write(code[i]);
+            m->write((u16)n);
+            for (s32 i = 0; i < n; ++i)
+                m->emit_call(calls[i]);
+            return result;
+        }
+
+        // Adds the characters of an operand of Or that matches a single ASCII character to 'chars'
+        static bool single_chars(machine_t const* m, machine_t::pc_t pc, u8* chars, s32& len, u64* seen)
+        {
+            machine_t::instr_t instr;
+            m->decode(pc, instr);
+            if (instr.m_opcode == eIs)
+            {
+                if (instr.m_a < 0 || instr.m_a >= 0x80)
+                    return false;
+                if ((seen[instr.m_a >> 6] & ((u64)1 << (instr.m_a & 63))) == 0)
+                {
+                    seen[instr.m_a >> 6] |= (u64)1 << (instr.m_a & 63);
+                    chars[len++] = (u8)instr.m_a;
+                }
+                return true;
+            }
+            if (instr.m_opcode == eIn)
+            {
+                u8               add[cMaxClass];
+                s32              n = 0;
+                nrunes::reader_t text(instr.m_text);
+                while (text.valid())
+                {
+                    uchar32 const c = text.read();
+                    if (c >= 0x80 || n == cMaxClass)
+                        return false;
+                    add[n++] = (u8)c;
+                }
+                for (s32 i = 0; i < n; ++i)
+                {
+                    if ((seen[add[i] >> 6] & ((u64)1 << (add[i] & 63))) == 0)
+                    {
+                        seen[add[i] >> 6] |= (u64)1 << (add[i] & 63);
+                        chars[len++] = add[i];
+                    }
+                }
+                return true;
+            }
+            return false;
+        }
+
+        static s32 simplify_or(machine_t* m, machine_t::pc_t* calls, s32 n);
+
+        // Or(Sequence(p, a), Sequence(p, b, c)) -> Sequence(p, Or(a, Sequence(b, c)))
+        static machine_t::pc_t hoist(machine_t* m, machine_t::pc_t const* calls, s32 n)
+        {
+            machine_t::instr_t instr;
+            machine_t::pc_t    rests[cMaxOperands];
+            for (s32 i = 0; i < n; ++i)
+            {
+                m->decode(calls[i], instr);
+                if (instr.m_ncalls == 2)
+                {
+                    rests[i] = m->call(instr, 1);
+                }
+                else
+                {
+                    machine_t::pc_t rest[cMaxOperands];
+                    for (s32 c = 1; c < instr.m_ncalls; ++c)
+                        rest[c - 1] = m->call(instr, c);
+                    rests[i] = emit_scope(m, eSequence, rest, instr.m_ncalls - 1);
+                }
+            }
+            s32 const       nrests = simplify_or(m, rests, n);
+            machine_t::pc_t inner  = (nrests == 1) ? rests[0] : emit_scope(m, eOr, rests, nrests);
+
+            m->decode(calls[0], instr);
+            machine_t::pc_t seq[cMaxOperands];
+            s32             nseq = 0;
+            seq[nseq++]          = m->call(instr, 0);
+            m->decode(inner, instr);
+            if (instr.m_opcode == eSequence && instr.m_ncalls < cMaxOperands)
+            {
+                for (s32 c = 0; c < instr.m_ncalls; ++c)
+                    seq[nseq++] = m->call(instr, c);
+            }
+            else
+            {
+                seq[nseq++] = inner;
+            }
+            return emit_scope(m, eSequence, seq, nseq);
+        }
+
+        // Merge adjacent character operands and hoist common prefixes of adjacent sequences, returns the number
+        // of operands that are left in 'calls'.
+        static s32 simplify_or(machine_t* m, machine_t::pc_t* calls, s32 n)
+        {
+            s32 out = 0;
+            for (s32 i = 0; i < n && !m->m_error;)
+            {
+                u8  chars[cMaxClass];
+                s32 len     = 0;
+                u64 seen[2] = {0, 0};
+                s32 j       = i;
+                while (j < n && single_chars(m, calls[j], chars, len, seen))
+                    j += 1;
+                if (j - i >= 2)
+                {
+                    machine_t::pc_t const text = m->pc();
+                    for (s32 c = 0; c < len; ++c)
+                        m->write(chars[c]);
+                    if (m->m_error)
+                        return n;
+                    ascii::pcrune const str = (ascii::pcrune)m->m_code.get_current_buffer().m_begin + text;
+                    calls[out++]            = m->pc();
+                    m->emit_instr(eIn, make_crunes(str, 0, (u32)len, (u32)len));
+                    i = j;
+                    continue;
+                }
+
+                j = i + 1;
+                machine_t::instr_t first;
+                m->decode(calls[i], first);
+                if (first.m_opcode == eSequence && first.m_ncalls >= 2)
+                {
+                    machine_t::pc_t const prefix = m->call(first, 0);
+                    while (j < n)
+                    {
+                        machine_t::instr_t next;
+                        m->decode(calls[j], next);
+                        if (next.m_opcode != eSequence || next.m_ncalls < 2 || !equal(m, prefix, m->call(next, 0)))
+                            break;
+                        j += 1;
+                    }
+                }
+                if (j - i >= 2)
+                    calls[out++] = hoist(m, calls + i, j - i);
+                else
+                    calls[out++] = calls[i];
+                i = j;
+            }
+            return out;
+        }
+
+        static bool repeated_digit(machine_t const* m, machine_t::pc_t pc, s64& lo, s64& hi)
+        {
+            machine_t::instr_t instr;
+            m->decode(pc, instr);
+            if (instr.m_opcode == eWithin)
+            {
+                lo = instr.m_a;
+                hi = instr.m_b;
+            }
+            else if (instr.m_opcode == eTimes)
+            {
+                lo = instr.m_a;
+                hi = instr.m_a;
+            }
+            else
+            {
+                return false;
+            }
+            m->decode(m->call(instr, 0), instr);
+            return instr.m_opcode == eDigit || (instr.m_opcode == eBetween && instr.m_a == '0' && instr.m_b == '9');
+        }
+
+        static bool unsigned_range(machine_t const* m, machine_t::pc_t pc, u64& _min, u64& _max)
+        {
+            machine_t::instr_t instr;
+            m->decode(pc, instr);
+            if (instr.m_opcode == eUnsigned32 || instr.m_opcode == eUnsigned64)
+            {
+                _min = (u64)instr.m_a;
+                _max = (u64)instr.m_b;
+                return true;
+            }
+            if (instr.m_opcode == eDecimal)
+            {
+                _min = 0;
+                _max = 0xffffffffffffffffUL;
+                return true;
+            }
+            return false;
+        }
+
+        // And(Within(Digit(), lo, hi), Unsigned32(min, max)), in any order
+        static bool fold_digits(machine_t* m, machine_t::pc_t const* calls, s32 n, machine_t::pc_t& pc)
+        {
+            if (n != 2)
+                return false;
+            s64 lo, hi;
+            u64 _min, _max;
+            if (!(repeated_digit(m, calls[0], lo, hi) && unsigned_range(m, calls[1], _min, _max)) && !(repeated_digit(m, calls[1], lo, hi) && unsigned_range(m, calls[0], _min, _max)))
+                return false;
+            if (lo < 0 || lo > hi || hi > 0xff)
+                return false;
+            pc = m->pc();
+            m->emit_instr(eUnsignedDigits, _min, _max);
+            m->write((u8)lo);
+            m->write((u8)hi);
+            return true;
+        }
+
+        static machine_t::pc_t optimize(machine_t* m, machine_t::pc_t pc)
+        {
+            machine_t::instr_t instr;
+            m->decode(pc, instr);
+            if (!machine_t::is_scope(instr.m_opcode) || instr.m_ncalls > cMaxOperands)
+                return pc;
+
+            machine_t::pc_t calls[cMaxOperands];
+            s32             n       = 0;
+            bool            changed = false;
+            for (s32 i = 0; i < instr.m_ncalls; ++i)
+            {
+                machine_t::pc_t const original = m->call(instr, i);
+                machine_t::pc_t const c        = optimize(m, original);
+                if (m->m_error)
+                    return pc;
+                changed = changed || (c != original);
+
+                if (instr.m_opcode == eSequence || instr.m_opcode == eOr)
+                {
+                    machine_t::instr_t inner;
+                    m->decode(c, inner);
+                    if (inner.m_opcode == instr.m_opcode && (n + inner.m_ncalls) <= cMaxOperands)
+                    {
+                        for (s32 j = 0; j < inner.m_ncalls; ++j)
+                            calls[n++] = m->call(inner, j);
+                        changed = true;
+                        continue;
+                    }
+                }
+                if (n == cMaxOperands)
+                    return pc;
+                calls[n++] = c;
+            }
+
+            switch (instr.m_opcode)
+            {
+                case eSequence:
+                    if (n == 1)
+                        return calls[0];
+                    break;
+                case eOr:
+                {
+                    s32 const left = simplify_or(m, calls, n);
+                    if (m->m_error)
+                        return pc;
+                    changed = changed || (left != n);
+                    n       = left;
+                    if (n == 1)
+                        return calls[0];
+                }
+                break;
+                case eAnd:
+                {
+                    machine_t::pc_t folded;
+                    if (fold_digits(m, calls, n, folded))
+                        return folded;
+                }
+                break;
+                default: break;
+            }
+
+            if (!changed)
+                return pc;
+            return emit_copy(m, instr, pc, calls, n);
+        }
+
+        parser_t::program_t parser_t::optimize(program_t program)
+        {
+            machine_t* m = program.m_machine;
+            if (m->m_error)
+                return program;
+            machine_t::pc_t const pc = parser2::optimize(m, program.pc());
+            if (m->m_error)
+                return program;
+            return program_t(m, pc);
+        }
+
+        static s32 count_instructions(machine_t const* m, machine_t::pc_t pc)
+        {
+            machine_t::instr_t instr;
+            m->decode(pc, instr);
+            s32 n = 1;
+            for (s32 i = 0; i < instr.m_ncalls; ++i)
+                n += count_instructions(m, m->call(instr, i));
+            return n;
+        }
+
+        s32 parser_t::instructions(program_t program)
+        {
+            machine_t* m = program.m_machine;
+            if (m->m_error)
+                return 0;
+            return count_instructions(m, program.pc());
+        }
+
+    } // namespace parser2
+} // namespace ncore
@@ -0,0 +1,364 @@
+#include "ccore/c_debug.h"
+#include "ccore/c_target.h"
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+
+#include "ctext/c_parser2.h"
+#include "ctext/private/c_parser2_machine.h"
+
+namespace ncore
+{
+    namespace parser2
+    {
+        static const s32 cMaxPrefix = 32;     // longest literal prefix that is entered into the automaton
+        static const u16 cNoNode    = 0xffff; // transition that has not been resolved (only during build)
+
+        // Collect the literal (ASCII) bytes that every match of the program at 'pc' has to start with.
+        // Returns true when the whole program is a literal, meaning the caller can continue with the
+        // next element of a sequence.
+        static bool literal_prefix(machine_t const* m, machine_t::pc_t pc, u8* prefix, s32& len)
+        {
+            machine_t::instr_t instr;
+            m->decode(pc, instr);
+
+            switch (instr.m_opcode)
+            {
+                case eSequence:
+                    for (s32 i = 0; i < instr.m_ncalls; ++i)
+                    {
+                        if (!literal_prefix(m, m->call(instr, i), prefix, len))
+                            return false;
+                    }
+                    return true;
+                case eExtract: return literal_prefix(m, m->call(instr, 0), prefix, len);
+                case eOneOrMore:
+                case eAnd:
+                    // The first operand is required, whatever it starts with is a prefix of the match
+                    literal_prefix(m, m->call(instr, 0), prefix, len);
+                    return false;
+                case eIs:
+                    if (instr.m_a >= 0x80 || len >= cMaxPrefix)
+                        return false;
+                    prefix[len++] = (u8)instr.m_a;
+                    return true;
+                case eExact:
+                {
+                    if (instr.m_text.m_type != ascii::TYPE && instr.m_text.m_type != utf8::TYPE)
+                        return false;
+                    nrunes::reader_t text(instr.m_text);
+                    while (text.valid())
+                    {
+                        uchar32 const c = text.read();
+                        if (c >= 0x80 || len >= cMaxPrefix)
+                            return false;
+                        prefix[len++] = (u8)c;
+                    }
+                    return true;
+                }
+                default: break;
+            }
+            return false;
+        }
+
+        static inline s32 lowest_bit(u64 w)
+        {
+            s32 i = 0;
+            while ((w & 1) == 0)
+            {
+                w >>= 1;
+                i += 1;
+            }
+            return i;
+        }
+
+        ruleset_t::ruleset_t(buffer_t buffer, s32 max_rules)
+            : m_buffer(buffer)
+            , m_alloc(buffer.m_begin)
+            , m_peak(0)
+            , m_max_rules(max_rules)
+            , m_num_rules(0)
+            , m_words((max_rules + 63) >> 6)
+            , m_built(false)
+            , m_first(nullptr)
+            , m_always(nullptr)
+            , m_num_classes(0)
+            , m_num_nodes(0)
+            , m_delta(nullptr)
+            , m_node_rule(nullptr)
+            , m_node_dict(nullptr)
+        {
+            ASSERT(max_rules > 0 && max_rules <= 0x7fff);
+            m_rules      = (parser_t::program_t*)allocate(sizeof(parser_t::program_t) * max_rules, sizeof(void*));
+            m_prefix_len = (u8*)allocate(sizeof(u8) * max_rules, sizeof(u8));
+            m_prefix_nxt = (s16*)allocate(sizeof(s16) * max_rules, sizeof(s16));
+            m_next       = (u32*)allocate(sizeof(u32) * max_rules, sizeof(u32));
+            if (m_next == nullptr)
+                m_max_rules = 0;
+            for (s32 i = 0; i < 256; ++i)
+                m_classes[i] = 0;
+        }
+
+        u8* ruleset_t::allocate(u32 size, u32 alignment)
+        {
+            u8* ptr = (u8*)(((ptr_t)m_alloc + (alignment - 1)) & ~((ptr_t)alignment - 1));
+            u32 const used = (u32)((ptr + size) - m_buffer.m_begin);
+            m_peak         = (used > m_peak) ? used : m_peak;
+            if (ptr + size > m_buffer.m_end)
+                return nullptr;
+            m_alloc = ptr + size;
+            return ptr;
+        }
+
+        s32 ruleset_t::add(parser_t::program_t program)
+        {
+            if (m_built || m_num_rules >= m_max_rules || program.m_machine->m_error)
+                return -1;
+            s32 const rule = m_num_rules++;
+            m_rules[rule]  = program;
+            return rule;
+        }
+
+        bool ruleset_t::build()
+        {
+            if (m_built)
+                return true;
+            if (m_max_rules == 0)
+                return false;
+
+            m_first  = (u64*)allocate(sizeof(u64) * 256 * m_words, sizeof(u64));
+            m_always = (u64*)allocate(sizeof(u64) * m_words, sizeof(u64));
+            if (m_always == nullptr)
+                return false;
+            for (s32 i = 0; i < 256 * m_words; ++i)
+                m_first[i] = 0;
+            for (s32 i = 0; i < m_words; ++i)
+                m_always[i] = 0;
+
+            // Pass 1: literal prefixes define the byte classes and the (upper bound of the) number of nodes,
+            // rules without a usable prefix are indexed by their FIRST set.
+            u8  prefix[cMaxPrefix];
+            s32 max_nodes = 1;
+            for (s32 r = 0; r < m_num_rules; ++r)
+            {
+                parser_t::program_t const& prog = m_rules[r];
+                machine_t const*           m    = prog.m_machine;
+
+                s32 len = 0;
+                literal_prefix(m, prog.pc(), prefix, len);
+
+                // A single byte prefix is as selective as the FIRST set, keep the automaton small
+                if (len >= 2 && (max_nodes + len) < (s32)cNoNode)
+                {
+                    m_prefix_len[r] = (u8)len;
+                    max_nodes += len;
+                    for (s32 i = 0; i < len; ++i)
+                    {
+                        if (m_classes[prefix[i]] == 0)
+                            m_classes[prefix[i]] = (u8)++m_num_classes;
+                    }
+                }
+                else
+                {
+                    m_prefix_len[r] = 0;
+                    machine_t::first_t first;
+                    m->first(prog.pc(), first);
+                    u64 const bit = (u64)1 << (r & 63);
+                    if (first.m_nullable)
+                    {
+                        m_always[r >> 6] |= bit;
+                    }
+                    else
+                    {
+                        for (s32 b = 0; b < 256; ++b)
+                        {
+                            if (first.m_set.has((u8)b))
+                                m_first[b * m_words + (r >> 6)] |= bit;
+                        }
+                    }
+                }
+            }
+            m_num_classes += 1; // class 0, bytes that do not appear in any prefix
+
+            m_delta     = (u16*)allocate(sizeof(u16) * max_nodes * m_num_classes, sizeof(u16));
+            m_node_rule = (s16*)allocate(sizeof(s16) * max_nodes, sizeof(s16));
+            m_node_dict = (u16*)allocate(sizeof(u16) * max_nodes, sizeof(u16));
+            if (m_node_dict == nullptr)
+                return false;
+
+            // Temporary, released at the end of the build
+            u8* const  mark  = m_alloc;
+            u16* const fail  = (u16*)allocate(sizeof(u16) * max_nodes, sizeof(u16));
+            u16* const queue = (u16*)allocate(sizeof(u16) * max_nodes, sizeof(u16));
+            if (queue == nullptr)
+                return false;
+
+            for (s32 i = 0; i < max_nodes * m_num_classes; ++i)
+                m_delta[i] = cNoNode;
+            for (s32 i = 0; i < max_nodes; ++i)
+            {
+                m_node_rule[i] = -1;
+                m_node_dict[i] = 0;
+            }
+
+            // Pass 2: the trie, rules are inserted last to first so that the rule chains are in rule order
+            m_num_nodes = 1;
+            for (s32 r = m_num_rules - 1; r >= 0; --r)
+            {
+                if (m_prefix_len[r] == 0)
+                    continue;
+                s32 len = 0;
+                literal_prefix(m_rules[r].m_machine, m_rules[r].pc(), prefix, len);
+
+                u16 node = 0;
+                for (s32 i = 0; i < m_prefix_len[r]; ++i)
+                {
+                    u16& next = m_delta[node * m_num_classes + m_classes[prefix[i]]];
+                    if (next == cNoNode)
+                        next = (u16)m_num_nodes++;
+                    node = next;
+                }
+                m_prefix_nxt[r]   = m_node_rule[node];
+                m_node_rule[node] = (s16)r;
+            }
+
+            // Pass 3: failure links (breadth first) turn the trie into a complete automaton
+            s32 head = 0, tail = 0;
+            fail[0]  = 0;
+            for (s32 c = 0; c < m_num_classes; ++c)
+            {
+                u16& next = m_delta[c];
+                if (next == cNoNode)
+                {
+                    next = 0;
+                }
+                else
+                {
+                    fail[next]    = 0;
+                    queue[tail++] = next;
+                }
+            }
+            while (head < tail)
+            {
+                u16 const node = queue[head++];
+                for (s32 c = 0; c < m_num_classes; ++c)
+                {
+                    u16&      next     = m_delta[node * m_num_classes + c];
+                    u16 const fallback = m_delta[fail[node] * m_num_classes + c];
+                    if (next == cNoNode)
+                    {
+                        next = fallback;
+                    }
+                    else
+                    {
+                        fail[next]        = fallback;
+                        m_node_dict[next] = (m_node_rule[fallback] >= 0) ? fallback : m_node_dict[fallback];
+                        queue[tail++]     = next;
+                    }
+                }
+            }
+
+            m_alloc = mark;
+            m_built = true;
+            return true;
+        }
+
+        bool ruleset_t::attempt(s32 rule, nrunes::reader_t const& reader, u32 start, report_t* report)
+        {
+            if (start < m_next[rule])
+                return false;
+
+            parser_t::program_t const& prog = m_rules[rule];
+            u32                        end  = start;
+            if (!prog.m_machine->execute(prog, reader, end))
+                return false;
+
+            report->match(rule, reader.select(start, end));
+            m_next[rule] = (end > start) ? end : start + 1;
+            return true;
+        }
+
+        s32 ruleset_t::scan(nrunes::reader_t const& reader, report_t* report)
+        {
+            if (!m_built && !build())
+                return 0;
+
+            u32 const      cursor = reader.get_cursor();
+            crunes_t const text   = reader.get_current();
+            for (s32 r = 0; r < m_num_rules; ++r)
+                m_next[r] = cursor;
+
+            s32 count = 0;
+            if (text.m_type != ascii::TYPE && text.m_type != utf8::TYPE)
+            {
+                // Not byte addressable, evaluate the rules one after the other
+                for (s32 r = 0; r < m_num_rules; ++r)
+                {
+                    parser_t::program_t const& prog = m_rules[r];
+                    machine_t::first_t         first;
+                    prog.m_machine->first(prog.pc(), first);
+
+                    nrunes::reader_t rest = reader;
+                    u32              begin, end;
+                    while (prog.m_machine->search(prog, first, rest, begin, end))
+                    {
+                        report->match(r, reader.select(begin, end));
+                        count += 1;
+                        rest.set_cursor(end);
+                        if (begin == end)
+                        {
+                            if (!rest.valid())
+                                break;
+                            rest.skip();
+                        }
+                    }
+                }
+                return count;
+            }
+
+            u8 const* const str  = (u8 const*)text.m_ascii + text.m_str;
+            s32 const       len  = (s32)(text.m_end - text.m_str);
+            bool const      utf8 = text.m_type == utf8::TYPE;
+
+            u16 state = 0;
+            for (s32 i = 0; i <= len; ++i)
+            {
+                u32 const pos = cursor + (u32)i;
+                if (i == len)
+                {
+                    // Only rules that can match the empty string can match at the end of the text
+                    for (s32 w = 0; w < m_words; ++w)
+                    {
+                        for (u64 bits = m_always[w]; bits != 0; bits &= bits - 1)
+                            count += attempt((w << 6) + lowest_bit(bits), reader, pos, report) ? 1 : 0;
+                    }
+                    break;
+                }
+
+                u8 const b = str[i];
+
+                // Rules that are indexed by the byte they start with, never in the middle of a multi-byte sequence
+                if (!utf8 || (b & 0xc0) != 0x80)
+                {
+                    u64 const* first = m_first + b * m_words;
+                    for (s32 w = 0; w < m_words; ++w)
+                    {
+                        for (u64 bits = first[w] | m_always[w]; bits != 0; bits &= bits - 1)
+                            count += attempt((w << 6) + lowest_bit(bits), reader, pos, report) ? 1 : 0;
+                    }
+                }
+
+                // Rules whose literal prefix ends at this byte
+                state    = m_delta[state * m_num_classes + m_classes[b]];
+                u16 node = (m_node_rule[state] >= 0) ? state : m_node_dict[state];
+                while (node != 0)
+                {
+                    for (s32 r = m_node_rule[node]; r >= 0; r = m_prefix_nxt[r])
+                        count += attempt(r, reader, pos + 1 - m_prefix_len[r], report) ? 1 : 0;
+                    node = m_node_dict[node];
+                }
+            }
+            return count;
+        }
+
+    } // namespace parser2
+} // namespace ncore
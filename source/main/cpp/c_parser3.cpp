@@ -11,100 +11,994 @@ namespace ncore
 {
     namespace parser3
     {
-        // Call parser_t when starting a new code block.
-        // You will not be able to write any additional commands to this block when it has been
-        // handed to another code block as input. From that moment on this code-block will be locked.
-        parser_t::code_t* parser_t::code_t::Extract(va_r_t* var, code_t* lhs) { return this; }
-        parser_t::code_t* parser_t::code_t::Not(code_t* lhs) { return this; }
-        parser_t::code_t* parser_t::code_t::Or(code_t* lhs, code_t* rhs) { return this; }
-        parser_t::code_t* parser_t::code_t::And(code_t* lhs, code_t* rhs) { return this; }
-        parser_t::code_t* parser_t::code_t::Sequence(code_t* lhs) { return this; }
-        parser_t::code_t* parser_t::code_t::Within(s32 _min, s32 _max) { return this; }
-        parser_t::code_t* parser_t::code_t::Times(s32 _count) { return this; }
-        parser_t::code_t* parser_t::code_t::OneOrMore(code_t* code) { return this; }
-        parser_t::code_t* parser_t::code_t::ZeroOrMore(code_t* code) { return this; }
-        parser_t::code_t* parser_t::code_t::ZeroOrOne(code_t* code) { return this; }
-        parser_t::code_t* parser_t::code_t::While(code_t* code) { return this; }
-        parser_t::code_t* parser_t::code_t::Until(code_t* until, code_t* code) { return this; }
-        parser_t::code_t* parser_t::code_t::Enclosed(uchar32 _open, uchar32 _close) { return this; }
-        parser_t::code_t* parser_t::code_t::Any() { return this; }
-        parser_t::code_t* parser_t::code_t::In(crunes_t const& _chars) { return this; }
-        parser_t::code_t* parser_t::code_t::Between(uchar32 _from, uchar32 _until) { return this; }
-        parser_t::code_t* parser_t::code_t::Alphabet() { return this; }
-        parser_t::code_t* parser_t::code_t::Digit() { return this; }
-        parser_t::code_t* parser_t::code_t::Hex() { return this; }
-        parser_t::code_t* parser_t::code_t::AlphaNumeric() { return this; }
-        parser_t::code_t* parser_t::code_t::Exact(crunes_t const& _text) { return this; }
-        parser_t::code_t* parser_t::code_t::Like(crunes_t const& _text) { return this; }
-        parser_t::code_t* parser_t::code_t::WhiteSpace(u8 flags) { return this; }
-        parser_t::code_t* parser_t::code_t::Is(uchar32 _c) { return this; }
-        parser_t::code_t* parser_t::code_t::Word() { return this; }
-        parser_t::code_t* parser_t::code_t::EndOfText() { return this; }
-        parser_t::code_t* parser_t::code_t::EndOfLine() { return this; }
-        parser_t::code_t* parser_t::code_t::EOL() { return this; }
-        parser_t::code_t* parser_t::code_t::Unsigned32(u32 _min, u32 _max) { return this; }
-        parser_t::code_t* parser_t::code_t::Unsigned64(u64 _min, u64 _max) { return this; }
-        parser_t::code_t* parser_t::code_t::Integer32(s32 _min, s32 _max) { return this; }
-        parser_t::code_t* parser_t::code_t::Integer64(s64 _min, s64 _max) { return this; }
-        parser_t::code_t* parser_t::code_t::Float32(f32 _min, f32 _max) { return this; }
-        parser_t::code_t* parser_t::code_t::Float64(f64 _min, f64 _max) { return this; }
-        parser_t::code_t* parser_t::code_t::Email() { return this; }
-        parser_t::code_t* parser_t::code_t::IPv4() { return this; }
-        parser_t::code_t* parser_t::code_t::Host() { return this; }
-        parser_t::code_t* parser_t::code_t::Date() { return this; }
-        parser_t::code_t* parser_t::code_t::Time() { return this; }
-        parser_t::code_t* parser_t::code_t::Phone() { return this; }
-        parser_t::code_t* parser_t::code_t::ServerAddress() { return this; }
-        parser_t::code_t* parser_t::code_t::URI() { return this; }
-
-        parser_t::parser_t(buffer_t buffer) {}
-
-        bool parser_t::Parse(nrunes::reader_t&) { return false; }
-
-        static parser_t::code_t sNullCode;
-
-        parser_t::code_t* parser_t::Extract(va_r_t* var, code_t* lhs) { return &sNullCode; }
-        parser_t::code_t* parser_t::Not(code_t* lhs) { return &sNullCode; }
-        parser_t::code_t* parser_t::Or(code_t* lhs, code_t* rhs) { return &sNullCode; }
-        parser_t::code_t* parser_t::And(code_t* lhs, code_t* rhs) { return &sNullCode; }
-        parser_t::code_t* parser_t::Sequence(code_t* lhs) { return &sNullCode; }
-        parser_t::code_t* parser_t::Within(s32 _min, s32 _max) { return &sNullCode; }
-        parser_t::code_t* parser_t::Times(s32 _count) { return &sNullCode; }
-        parser_t::code_t* parser_t::OneOrMore(code_t* code) { return &sNullCode; }
-        parser_t::code_t* parser_t::ZeroOrMore(code_t* code) { return &sNullCode; }
-        parser_t::code_t* parser_t::ZeroOrOne(code_t* code) { return &sNullCode; }
-        parser_t::code_t* parser_t::While(code_t* code) { return &sNullCode; }
-        parser_t::code_t* parser_t::Until(code_t* until, code_t* code) { return &sNullCode; }
-        parser_t::code_t* parser_t::Enclosed(uchar32 _open, uchar32 _close) { return &sNullCode; }
-        parser_t::code_t* parser_t::Any() { return &sNullCode; }
-        parser_t::code_t* parser_t::In(crunes_t const& _chars) { return &sNullCode; }
-        parser_t::code_t* parser_t::Between(uchar32 _from, uchar32 _until) { return &sNullCode; }
-        parser_t::code_t* parser_t::Alphabet() { return &sNullCode; }
-        parser_t::code_t* parser_t::Digit() { return &sNullCode; }
-        parser_t::code_t* parser_t::Hex() { return &sNullCode; }
-        parser_t::code_t* parser_t::AlphaNumeric() { return &sNullCode; }
-        parser_t::code_t* parser_t::Exact(crunes_t const& _text) { return &sNullCode; }
-        parser_t::code_t* parser_t::Like(crunes_t const& _text) { return &sNullCode; }
-        parser_t::code_t* parser_t::WhiteSpace(u8 flags) { return &sNullCode; }
-        parser_t::code_t* parser_t::Is(uchar32 _c) { return &sNullCode; }
-        parser_t::code_t* parser_t::Word() { return &sNullCode; }
-        parser_t::code_t* parser_t::EndOfText() { return &sNullCode; }
-        parser_t::code_t* parser_t::EndOfLine() { return &sNullCode; }
-        parser_t::code_t* parser_t::EOL() { return &sNullCode; }
-        parser_t::code_t* parser_t::Unsigned32(u32 _min, u32 _max) { return &sNullCode; }
-        parser_t::code_t* parser_t::Unsigned64(u64 _min, u64 _max) { return &sNullCode; }
-        parser_t::code_t* parser_t::Integer32(s32 _min, s32 _max) { return &sNullCode; }
-        parser_t::code_t* parser_t::Integer64(s64 _min, s64 _max) { return &sNullCode; }
-        parser_t::code_t* parser_t::Float32(f32 _min, f32 _max) { return &sNullCode; }
-        parser_t::code_t* parser_t::Float64(f64 _min, f64 _max) { return &sNullCode; }
-        parser_t::code_t* parser_t::Email() { return &sNullCode; }
-        parser_t::code_t* parser_t::IPv4() { return &sNullCode; }
-        parser_t::code_t* parser_t::Host() { return &sNullCode; }
-        parser_t::code_t* parser_t::Date() { return &sNullCode; }
-        parser_t::code_t* parser_t::Time() { return &sNullCode; }
-        parser_t::code_t* parser_t::Phone() { return &sNullCode; }
-        parser_t::code_t* parser_t::ServerAddress() { return &sNullCode; }
-        parser_t::code_t* parser_t::URI() { return &sNullCode; }
+        // Instruction encoding, operands follow the opcode byte, multi-byte operands are little-endian.
+        // JSR operands are the (u16) entry offset of a locked code block.
+        enum eOpcode
+        {
+            eRET = 0,      //
+            eJMP,          // u16 target
+            eEXTRACT,      // u64 va_r_t*, JSR code
+            eNOT,          // JSR code
+            eOR,           // JSR lhs, JSR rhs
+            eAND,          // JSR lhs, JSR rhs
+            eCALL,         // JSR code
+            eWITHIN,       // s32 min, s32 max, JSR code
+            eONE_OR_MORE,  // JSR code
+            eZERO_OR_MORE, // JSR code
+            eZERO_OR_ONE,  // JSR code
+            eUNTIL,        // JSR until, JSR code
+            eENCLOSED,     // u32 open, u32 close, JSR code
+            eANY,          //
+            eIN,           // u8 size, utf-8 text
+            eBETWEEN,      // u32 from, u32 until
+            eALPHABET,     //
+            eDIGIT,        //
+            eHEX,          //
+            eALNUM,        //
+            eEXACT,        // u8 size, utf-8 text
+            eLIKE,         // u8 size, utf-8 text
+            eWHITESPACE,   // u8 flags
+            eIS8,          // u8 character
+            eIS32,         // u32 character
+            eWORD,         //
+            eEOT,          //
+            eENDOFLINE,    //
+            eEOL,          //
+            eU32,          // u32 min, u32 max
+            eU64,          // u64 min, u64 max
+            eI32,          // s32 min, s32 max
+            eI64,          // s64 min, s64 max
+            eF32,          // f32 min, f32 max
+            eF64,          // f64 min, f64 max
+        };
+
+        static const u32 cLinkSize = 3;      // JMP u16 or RET
+        static const u32 cMaxCode  = 0xffff; // code offsets are 16-bit
+
+        static inline void put_u16(u8* p, u16 v)
+        {
+            p[0] = (u8)v;
+            p[1] = (u8)(v >> 8);
+        }
+        static inline void put_u32(u8* p, u32 v)
+        {
+            p[0] = (u8)v;
+            p[1] = (u8)(v >> 8);
+            p[2] = (u8)(v >> 16);
+            p[3] = (u8)(v >> 24);
+        }
+        static inline void put_u64(u8* p, u64 v)
+        {
+            put_u32(p, (u32)v);
+            put_u32(p + 4, (u32)(v >> 32));
+        }
+        static inline u16 get_u16(u8 const* p) { return (u16)(p[0] | (p[1] << 8)); }
+        static inline u32 get_u32(u8 const* p) { return (u32)p[0] | ((u32)p[1] << 8) | ((u32)p[2] << 16) | ((u32)p[3] << 24); }
+        static inline u64 get_u64(u8 const* p) { return (u64)get_u32(p) | ((u64)get_u32(p + 4) << 32); }
+
+        static inline void put_f32(u8* p, f32 v)
+        {
+            union
+            {
+                f32 f;
+                u32 u;
+            } bits;
+            bits.f = v;
+            put_u32(p, bits.u);
+        }
+        static inline void put_f64(u8* p, f64 v)
+        {
+            union
+            {
+                f64 f;
+                u64 u;
+            } bits;
+            bits.f = v;
+            put_u64(p, bits.u);
+        }
+        static inline f32 get_f32(u8 const* p)
+        {
+            union
+            {
+                f32 f;
+                u32 u;
+            } bits;
+            bits.u = get_u32(p);
+            return bits.f;
+        }
+        static inline f64 get_f64(u8 const* p)
+        {
+            union
+            {
+                f64 f;
+                u64 u;
+            } bits;
+            bits.u = get_u64(p);
+            return bits.f;
+        }
+
+        // Text operands (In, Exact, Like) are stored inline as UTF-8, independent of the type of the runes
+        static s32 utf8_size(uchar32 c) { return (c < 0x80) ? 1 : (c < 0x800) ? 2 : (c < 0x10000) ? 3 : 4; }
+        static u8* utf8_write(u8* p, uchar32 c)
+        {
+            switch (utf8_size(c))
+            {
+                case 1: *p++ = (u8)c; break;
+                case 2:
+                    *p++ = (u8)(0xc0 | (c >> 6));
+                    *p++ = (u8)(0x80 | (c & 0x3f));
+                    break;
+                case 3:
+                    *p++ = (u8)(0xe0 | (c >> 12));
+                    *p++ = (u8)(0x80 | ((c >> 6) & 0x3f));
+                    *p++ = (u8)(0x80 | (c & 0x3f));
+                    break;
+                default:
+                    *p++ = (u8)(0xf0 | (c >> 18));
+                    *p++ = (u8)(0x80 | ((c >> 12) & 0x3f));
+                    *p++ = (u8)(0x80 | ((c >> 6) & 0x3f));
+                    *p++ = (u8)(0x80 | (c & 0x3f));
+                    break;
+            }
+            return p;
+        }
+        static uchar32 utf8_read(u8 const*& p)
+        {
+            u8 const b = *p++;
+            if (b < 0x80)
+                return b;
+            s32     n = (b >= 0xf0) ? 3 : (b >= 0xe0) ? 2 : 1;
+            uchar32 c = b & (0x3f >> n);
+            while (n-- > 0)
+                c = (c << 6) | (*p++ & 0x3f);
+            return c;
+        }
+        static u32 text_size(crunes_t const& text)
+        {
+            nrunes::reader_t reader(text);
+            u32              size = 0;
+            while (reader.valid())
+                size += utf8_size(reader.read());
+            return size;
+        }
+
+        static inline bool is_alphabet(uchar32 c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+        static inline bool is_digit(uchar32 c) { return c >= '0' && c <= '9'; }
+        static inline bool is_hex(uchar32 c) { return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+        static inline bool is_space(uchar32 c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+        static inline bool match_if(nrunes::reader_t& reader, bool match)
+        {
+            if (match)
+                reader.skip();
+            return match;
+        }
+
+        static bool end_of_line(nrunes::reader_t& reader)
+        {
+            uchar32 const c = reader.peek();
+            if (c == '\n')
+            {
+                reader.skip();
+                return true;
+            }
+            if (c == '\r')
+            {
+                u32 const cursor = reader.get_cursor();
+                reader.skip();
+                if (reader.peek() == '\n')
+                {
+                    reader.skip();
+                    return true;
+                }
+                reader.set_cursor(cursor);
+            }
+            return false;
+        }
+
+        // Number parsers, same semantics as the ones of parser2
+        static bool parse_unsigned(nrunes::reader_t& reader, u64 _min, u64 _max)
+        {
+            u32 const cursor = reader.get_cursor();
+            u64       value  = 0;
+            while (reader.valid())
+            {
+                uchar32 const c = reader.peek();
+                if (!is_digit(c))
+                    break;
+                value = (value * 10) + (c - '0');
+                reader.skip();
+            }
+            if (cursor != reader.get_cursor() && value >= _min && value <= _max)
+                return true;
+            reader.set_cursor(cursor);
+            return false;
+        }
+        static bool parse_integer(nrunes::reader_t& reader, s64 _min, s64 _max)
+        {
+            u32 const  cursor      = reader.get_cursor();
+            bool const is_negative = reader.peek() == '-';
+            if (is_negative)
+                reader.skip();
+            u32 const digits = reader.get_cursor();
+            s64       value  = 0;
+            while (reader.valid())
+            {
+                uchar32 const c = reader.peek();
+                if (!is_digit(c))
+                    break;
+                value = (value * 10) + (c - '0');
+                reader.skip();
+            }
+            if (is_negative)
+                value = -value;
+            if (digits != reader.get_cursor() && value >= _min && value <= _max)
+                return true;
+            reader.set_cursor(cursor);
+            return false;
+        }
+        static bool parse_float(nrunes::reader_t& reader, f64 _min, f64 _max)
+        {
+            u32 const  cursor      = reader.get_cursor();
+            bool const is_negative = reader.peek() == '-';
+            if (is_negative)
+                reader.skip();
+            f64 value = 0.0;
+            while (reader.valid() && is_digit(reader.peek()))
+                value = (value * 10.0) + (reader.read() - '0');
+            if (reader.peek() == '.')
+            {
+                reader.skip();
+                f64 mantissa = 10.0;
+                while (reader.valid() && is_digit(reader.peek()))
+                {
+                    value = value + f64(reader.read() - '0') / mantissa;
+                    mantissa *= 10.0;
+                }
+            }
+            if (is_negative)
+                value = -value;
+            if (cursor != reader.get_cursor() && value >= _min && value <= _max)
+                return true;
+            reader.set_cursor(cursor);
+            return false;
+        }
+
+        // ----------------------------------------------------------------------------------------------------------------
+        // Building
+
+        parser_t::parser_t(buffer_t buffer)
+            : m_buffer(buffer)
+            , m_top(0)
+            , m_bottom((u32)(buffer.m_end - buffer.m_begin))
+            , m_root(nullptr)
+            , m_error(buffer.m_begin == buffer.m_end)
+        {
+        }
+
+        // Returned when a block could not be allocated, every instruction added to it is ignored and any
+        // block that uses it as input ends up invalid.
+        static parser_t         sNullParser((buffer_t()));
+        static parser_t::code_t sNullCode = {&sNullParser, 0, 0, true};
+
+        u32 parser_t::Used() const { return m_top + ((u32)(m_buffer.m_end - m_buffer.m_begin) - m_bottom); }
+
+        void parser_t::Reset()
+        {
+            m_top    = 0;
+            m_bottom = (u32)(m_buffer.m_end - m_buffer.m_begin);
+            m_root   = nullptr;
+            m_error  = m_buffer.m_begin == m_buffer.m_end;
+        }
+
+        parser_t::code_t* parser_t::begin()
+        {
+            u8* const header = (u8*)(((ptr_t)(m_buffer.m_begin + m_bottom) - sizeof(code_t)) & ~((ptr_t)sizeof(void*) - 1));
+            if (m_error || m_bottom < sizeof(code_t) + sizeof(void*) || header < m_buffer.m_begin + m_top + cLinkSize || m_top + cLinkSize > cMaxCode)
+            {
+                m_error = true;
+                return &sNullCode;
+            }
+            m_bottom = (u32)(header - m_buffer.m_begin);
+
+            code_t* code   = (code_t*)header;
+            code->m_parser = this;
+            code->m_entry  = m_top;
+            code->m_tail   = m_top;
+            code->m_locked = false;
+
+            m_buffer.m_begin[m_top] = eRET;
+            m_top += cLinkSize;
+            m_root = code;
+            return code;
+        }
+
+        u8* parser_t::append(code_t* code, u32 size)
+        {
+            if (m_error || code->m_locked)
+            {
+                ASSERT(m_error || code == &sNullCode); // adding to a block that has been used as input
+                return nullptr;
+            }
+
+            // Extend in place when the block is at the end of the code, otherwise continue in a new segment
+            u32 pos = code->m_tail;
+            if (pos + cLinkSize != m_top)
+                pos = m_top;
+            if (pos + size + cLinkSize > m_bottom || pos + size + cLinkSize > cMaxCode)
+            {
+                m_error = true;
+                return nullptr;
+            }
+
+            u8* const data = m_buffer.m_begin;
+            if (pos != code->m_tail)
+            {
+                data[code->m_tail] = eJMP;
+                put_u16(data + code->m_tail + 1, (u16)pos);
+            }
+            code->m_tail       = pos + size;
+            data[code->m_tail] = eRET;
+            m_top              = code->m_tail + cLinkSize;
+            m_root             = code;
+            return data + pos;
+        }
+
+        u16 parser_t::lock(code_t* code)
+        {
+            if (code->m_parser != this)
+            {
+                m_error = true;
+                return 0;
+            }
+            if (!code->m_locked)
+            {
+                code->m_locked = true;
+                // The link slot of a locked block is only ever a RET, give back the unused bytes
+                if (code->m_tail + cLinkSize == m_top)
+                    m_top = code->m_tail + 1;
+                if (m_root == code)
+                    m_root = nullptr;
+            }
+            return (u16)code->m_entry;
+        }
+
+        u8* parser_t::emit(code_t* code, u8 opcode, u32 operands)
+        {
+            u8* const p = code->m_parser->append(code, 1 + operands);
+            if (p == nullptr)
+                return nullptr;
+            p[0] = opcode;
+            return p + 1;
+        }
+
+        parser_t::code_t* parser_t::op(code_t* code, u8 opcode)
+        {
+            emit(code, opcode, 0);
+            return code;
+        }
+
+        parser_t::code_t* parser_t::op(code_t* code, u8 opcode, code_t* a)
+        {
+            u16 const jsr = lock(a);
+            u8* const p   = emit(code, opcode, 2);
+            if (p != nullptr)
+                put_u16(p, jsr);
+            return code;
+        }
+
+        parser_t::code_t* parser_t::op(code_t* code, u8 opcode, code_t* a, code_t* b)
+        {
+            u16 const jsr_a = lock(a);
+            u16 const jsr_b = lock(b);
+            u8* const p     = emit(code, opcode, 4);
+            if (p != nullptr)
+            {
+                put_u16(p, jsr_a);
+                put_u16(p + 2, jsr_b);
+            }
+            return code;
+        }
+
+        parser_t::code_t* parser_t::op(code_t* code, u8 opcode, crunes_t const& text)
+        {
+            u32 const size = text_size(text);
+            if (size > 0xff)
+            {
+                m_error = true;
+                return code;
+            }
+            u8* p = emit(code, opcode, 1 + size);
+            if (p != nullptr)
+            {
+                *p++ = (u8)size;
+                nrunes::reader_t reader(text);
+                while (reader.valid())
+                    p = utf8_write(p, reader.read());
+            }
+            return code;
+        }
+
+        // Instructions are added to the end of this block, blocks that are passed as input are locked.
+        parser_t::code_t* parser_t::code_t::Extract(va_r_t* var, code_t* lhs)
+        {
+            u16 const jsr = m_parser->lock(lhs);
+            u8* const p   = m_parser->emit(this, eEXTRACT, 10);
+            if (p != nullptr)
+            {
+                put_u64(p, (u64)(ptr_t)var);
+                put_u16(p + 8, jsr);
+            }
+            return this;
+        }
+        parser_t::code_t* parser_t::code_t::Not(code_t* lhs) { return m_parser->op(this, eNOT, lhs); }
+        parser_t::code_t* parser_t::code_t::Or(code_t* lhs, code_t* rhs) { return m_parser->op(this, eOR, lhs, rhs); }
+        parser_t::code_t* parser_t::code_t::And(code_t* lhs, code_t* rhs) { return m_parser->op(this, eAND, lhs, rhs); }
+        parser_t::code_t* parser_t::code_t::Sequence(code_t* lhs) { return m_parser->op(this, eCALL, lhs); }
+        parser_t::code_t* parser_t::code_t::Within(code_t* code, s32 _min, s32 _max)
+        {
+            u16 const jsr = m_parser->lock(code);
+            u8* const p   = m_parser->emit(this, eWITHIN, 10);
+            if (p != nullptr)
+            {
+                put_u32(p, (u32)_min);
+                put_u32(p + 4, (u32)_max);
+                put_u16(p + 8, jsr);
+            }
+            return this;
+        }
+        parser_t::code_t* parser_t::code_t::Times(s32 _count, code_t* code) { return Within(code, _count, _count); }
+        parser_t::code_t* parser_t::code_t::OneOrMore(code_t* code) { return m_parser->op(this, eONE_OR_MORE, code); }
+        parser_t::code_t* parser_t::code_t::ZeroOrMore(code_t* code) { return m_parser->op(this, eZERO_OR_MORE, code); }
+        parser_t::code_t* parser_t::code_t::ZeroOrOne(code_t* code) { return m_parser->op(this, eZERO_OR_ONE, code); }
+        parser_t::code_t* parser_t::code_t::While(code_t* code) { return m_parser->op(this, eZERO_OR_MORE, code); }
+        parser_t::code_t* parser_t::code_t::Until(code_t* until, code_t* code) { return m_parser->op(this, eUNTIL, until, code); }
+        parser_t::code_t* parser_t::code_t::Enclosed(uchar32 _open, uchar32 _close, code_t* code)
+        {
+            u16 const jsr = m_parser->lock(code);
+            u8* const p   = m_parser->emit(this, eENCLOSED, 10);
+            if (p != nullptr)
+            {
+                put_u32(p, _open);
+                put_u32(p + 4, _close);
+                put_u16(p + 8, jsr);
+            }
+            return this;
+        }
+        parser_t::code_t* parser_t::code_t::Any() { return m_parser->op(this, eANY); }
+        parser_t::code_t* parser_t::code_t::In(crunes_t const& _chars) { return m_parser->op(this, eIN, _chars); }
+        parser_t::code_t* parser_t::code_t::Between(uchar32 _from, uchar32 _until)
+        {
+            u8* const p = m_parser->emit(this, eBETWEEN, 8);
+            if (p != nullptr)
+            {
+                put_u32(p, _from);
+                put_u32(p + 4, _until);
+            }
+            return this;
+        }
+        parser_t::code_t* parser_t::code_t::Alphabet() { return m_parser->op(this, eALPHABET); }
+        parser_t::code_t* parser_t::code_t::Digit() { return m_parser->op(this, eDIGIT); }
+        parser_t::code_t* parser_t::code_t::Hex() { return m_parser->op(this, eHEX); }
+        parser_t::code_t* parser_t::code_t::AlphaNumeric() { return m_parser->op(this, eALNUM); }
+        parser_t::code_t* parser_t::code_t::Exact(crunes_t const& _text) { return m_parser->op(this, eEXACT, _text); }
+        parser_t::code_t* parser_t::code_t::Like(crunes_t const& _text) { return m_parser->op(this, eLIKE, _text); }
+        parser_t::code_t* parser_t::code_t::WhiteSpace(u8 flags)
+        {
+            u8* const p = m_parser->emit(this, eWHITESPACE, 1);
+            if (p != nullptr)
+                p[0] = flags;
+            return this;
+        }
+        parser_t::code_t* parser_t::code_t::Is(uchar32 _c)
+        {
+            if (_c < 0x100)
+            {
+                u8* const p = m_parser->emit(this, eIS8, 1);
+                if (p != nullptr)
+                    p[0] = (u8)_c;
+            }
+            else
+            {
+                u8* const p = m_parser->emit(this, eIS32, 4);
+                if (p != nullptr)
+                    put_u32(p, _c);
+            }
+            return this;
+        }
+        parser_t::code_t* parser_t::code_t::Word() { return m_parser->op(this, eWORD); }
+        parser_t::code_t* parser_t::code_t::EndOfText() { return m_parser->op(this, eEOT); }
+        parser_t::code_t* parser_t::code_t::EndOfLine() { return m_parser->op(this, eENDOFLINE); }
+        parser_t::code_t* parser_t::code_t::EOL() { return m_parser->op(this, eEOL); }
+        parser_t::code_t* parser_t::code_t::Unsigned32(u32 _min, u32 _max)
+        {
+            u8* const p = m_parser->emit(this, eU32, 8);
+            if (p != nullptr)
+            {
+                put_u32(p, _min);
+                put_u32(p + 4, _max);
+            }
+            return this;
+        }
+        parser_t::code_t* parser_t::code_t::Unsigned64(u64 _min, u64 _max)
+        {
+            u8* const p = m_parser->emit(this, eU64, 16);
+            if (p != nullptr)
+            {
+                put_u64(p, _min);
+                put_u64(p + 8, _max);
+            }
+            return this;
+        }
+        parser_t::code_t* parser_t::code_t::Integer32(s32 _min, s32 _max)
+        {
+            u8* const p = m_parser->emit(this, eI32, 8);
+            if (p != nullptr)
+            {
+                put_u32(p, (u32)_min);
+                put_u32(p + 4, (u32)_max);
+            }
+            return this;
+        }
+        parser_t::code_t* parser_t::code_t::Integer64(s64 _min, s64 _max)
+        {
+            u8* const p = m_parser->emit(this, eI64, 16);
+            if (p != nullptr)
+            {
+                put_u64(p, (u64)_min);
+                put_u64(p + 8, (u64)_max);
+            }
+            return this;
+        }
+        parser_t::code_t* parser_t::code_t::Float32(f32 _min, f32 _max)
+        {
+            u8* const p = m_parser->emit(this, eF32, 8);
+            if (p != nullptr)
+            {
+                put_f32(p, _min);
+                put_f32(p + 4, _max);
+            }
+            return this;
+        }
+        parser_t::code_t* parser_t::code_t::Float64(f64 _min, f64 _max)
+        {
+            u8* const p = m_parser->emit(this, eF64, 16);
+            if (p != nullptr)
+            {
+                put_f64(p, _min);
+                put_f64(p + 8, _max);
+            }
+            return this;
+        }
+        parser_t::code_t* parser_t::code_t::Email() { return Sequence(m_parser->Email()); }
+        parser_t::code_t* parser_t::code_t::IPv4() { return Sequence(m_parser->IPv4()); }
+        parser_t::code_t* parser_t::code_t::Host() { return Sequence(m_parser->Host()); }
+        parser_t::code_t* parser_t::code_t::Date() { return Sequence(m_parser->Date()); }
+        parser_t::code_t* parser_t::code_t::Time() { return Sequence(m_parser->Time()); }
+        parser_t::code_t* parser_t::code_t::Phone() { return Sequence(m_parser->Phone()); }
+        parser_t::code_t* parser_t::code_t::ServerAddress() { return Sequence(m_parser->ServerAddress()); }
+        parser_t::code_t* parser_t::code_t::URI() { return Sequence(m_parser->URI()); }
+
+        // Starting a new block, inputs are locked first so that their unused link slot can be given back
+        parser_t::code_t* parser_t::Extract(va_r_t* var, code_t* lhs)
+        {
+            lock(lhs);
+            return begin()->Extract(var, lhs);
+        }
+        parser_t::code_t* parser_t::Not(code_t* lhs)
+        {
+            lock(lhs);
+            return op(begin(), eNOT, lhs);
+        }
+        parser_t::code_t* parser_t::Or(code_t* lhs, code_t* rhs)
+        {
+            lock(lhs);
+            lock(rhs);
+            return op(begin(), eOR, lhs, rhs);
+        }
+        parser_t::code_t* parser_t::And(code_t* lhs, code_t* rhs)
+        {
+            lock(lhs);
+            lock(rhs);
+            return op(begin(), eAND, lhs, rhs);
+        }
+        parser_t::code_t* parser_t::Sequence(code_t* lhs)
+        {
+            lock(lhs);
+            return op(begin(), eCALL, lhs);
+        }
+        parser_t::code_t* parser_t::Within(code_t* code, s32 _min, s32 _max)
+        {
+            lock(code);
+            return begin()->Within(code, _min, _max);
+        }
+        parser_t::code_t* parser_t::Times(s32 _count, code_t* code) { return Within(code, _count, _count); }
+        parser_t::code_t* parser_t::OneOrMore(code_t* code)
+        {
+            lock(code);
+            return op(begin(), eONE_OR_MORE, code);
+        }
+        parser_t::code_t* parser_t::ZeroOrMore(code_t* code)
+        {
+            lock(code);
+            return op(begin(), eZERO_OR_MORE, code);
+        }
+        parser_t::code_t* parser_t::ZeroOrOne(code_t* code)
+        {
+            lock(code);
+            return op(begin(), eZERO_OR_ONE, code);
+        }
+        parser_t::code_t* parser_t::While(code_t* code) { return ZeroOrMore(code); }
+        parser_t::code_t* parser_t::Until(code_t* until, code_t* code)
+        {
+            lock(until);
+            lock(code);
+            return op(begin(), eUNTIL, until, code);
+        }
+        parser_t::code_t* parser_t::Enclosed(uchar32 _open, uchar32 _close, code_t* code)
+        {
+            lock(code);
+            return begin()->Enclosed(_open, _close, code);
+        }
+        parser_t::code_t* parser_t::Any() { return begin()->Any(); }
+        parser_t::code_t* parser_t::In(crunes_t const& _chars) { return begin()->In(_chars); }
+        parser_t::code_t* parser_t::Between(uchar32 _from, uchar32 _until) { return begin()->Between(_from, _until); }
+        parser_t::code_t* parser_t::Alphabet() { return begin()->Alphabet(); }
+        parser_t::code_t* parser_t::Digit() { return begin()->Digit(); }
+        parser_t::code_t* parser_t::Hex() { return begin()->Hex(); }
+        parser_t::code_t* parser_t::AlphaNumeric() { return begin()->AlphaNumeric(); }
+        parser_t::code_t* parser_t::Exact(crunes_t const& _text) { return begin()->Exact(_text); }
+        parser_t::code_t* parser_t::Like(crunes_t const& _text) { return begin()->Like(_text); }
+        parser_t::code_t* parser_t::WhiteSpace(u8 flags) { return begin()->WhiteSpace(flags); }
+        parser_t::code_t* parser_t::Is(uchar32 _c) { return begin()->Is(_c); }
+        parser_t::code_t* parser_t::Word() { return begin()->Word(); }
+        parser_t::code_t* parser_t::EndOfText() { return begin()->EndOfText(); }
+        parser_t::code_t* parser_t::EndOfLine() { return begin()->EndOfLine(); }
+        parser_t::code_t* parser_t::EOL() { return begin()->EOL(); }
+        parser_t::code_t* parser_t::Unsigned32(u32 _min, u32 _max) { return begin()->Unsigned32(_min, _max); }
+        parser_t::code_t* parser_t::Unsigned64(u64 _min, u64 _max) { return begin()->Unsigned64(_min, _max); }
+        parser_t::code_t* parser_t::Integer32(s32 _min, s32 _max) { return begin()->Integer32(_min, _max); }
+        parser_t::code_t* parser_t::Integer64(s64 _min, s64 _max) { return begin()->Integer64(_min, _max); }
+        parser_t::code_t* parser_t::Float32(f32 _min, f32 _max) { return begin()->Float32(_min, _max); }
+        parser_t::code_t* parser_t::Float64(f64 _min, f64 _max) { return begin()->Float64(_min, _max); }
+
+        parser_t::code_t* parser_t::Email()
+        {
+            crunes_t validchars = make_crunes((ascii::pcrune) "!#$%&'*+/=?^_`{|}~-", 0, 19, 19);
+
+            // clang-format off
+            code_t* atom = OneOrMore(Or(AlphaNumeric(), In(validchars)));
+            return Sequence(atom)
+                ->ZeroOrMore(Or(Is('.'), Is('_'))->Sequence(atom))
+                ->Is('@')
+                ->Host();
+            // clang-format on
+        }
+
+        parser_t::code_t* parser_t::IPv4()
+        {
+            // clang-format off
+            code_t* octet = And(Within(Digit(), 1, 3), Unsigned32(0, 255));
+            return Times(3, Sequence(octet)->Is('.'))
+                ->Sequence(octet);
+            // clang-format on
+        }
+
+        parser_t::code_t* parser_t::Host()
+        {
+            // clang-format off
+            code_t* label = OneOrMore(AlphaNumeric())
+                ->ZeroOrMore(Is('-')->OneOrMore(AlphaNumeric()));
+            code_t* name  = Sequence(label)
+                ->ZeroOrMore(Is('.')->Sequence(label));
+            return Or(IPv4(), name);
+            // clang-format on
+        }
+
+        parser_t::code_t* parser_t::Date()
+        {
+            // clang-format off
+            return Times(4, Digit())
+                ->Is('-')
+                ->And(Times(2, Digit()), Unsigned32(1, 12))
+                ->Is('-')
+                ->And(Times(2, Digit()), Unsigned32(1, 31));
+            // clang-format on
+        }
+
+        parser_t::code_t* parser_t::Time()
+        {
+            // clang-format off
+            return And(Times(2, Digit()), Unsigned32(0, 23))
+                ->Is(':')
+                ->And(Times(2, Digit()), Unsigned32(0, 59))
+                ->ZeroOrOne(Is(':')->And(Times(2, Digit()), Unsigned32(0, 60)));
+            // clang-format on
+        }
+
+        parser_t::code_t* parser_t::Phone()
+        {
+            crunes_t separators = make_crunes((ascii::pcrune) " -", 0, 2, 2);
+
+            // clang-format off
+            return ZeroOrOne(Is('+'))
+                ->OneOrMore(Digit())
+                ->ZeroOrMore(ZeroOrOne(In(separators))->OneOrMore(Digit()));
+            // clang-format on
+        }
+
+        parser_t::code_t* parser_t::ServerAddress()
+        {
+            // clang-format off
+            return Host()
+                ->Is(':')
+                ->Unsigned32(1, 65535);
+            // clang-format on
+        }
+
+        parser_t::code_t* parser_t::URI()
+        {
+            crunes_t schemechars = make_crunes((ascii::pcrune) "+-.", 0, 3, 3);
+            crunes_t separator   = make_crunes((ascii::pcrune) "://", 0, 3, 3);
+            crunes_t pathchars   = make_crunes((ascii::pcrune) "/-._~%!$&'()*+,;=:@?#", 0, 21, 21);
+
+            // clang-format off
+            return Alphabet()
+                ->ZeroOrMore(Or(AlphaNumeric(), In(schemechars)))
+                ->Exact(separator)
+                ->Host()
+                ->ZeroOrOne(Is(':')->Unsigned32(0, 65535))
+                ->ZeroOrOne(Is('/')->ZeroOrMore(Or(AlphaNumeric(), In(pathchars))));
+            // clang-format on
+        }
+
+        // ----------------------------------------------------------------------------------------------------------------
+        // Executing
+
+        bool parser_t::Parse(nrunes::reader_t& reader)
+        {
+            if (m_root == nullptr)
+                return false;
+            return Parse(m_root, reader);
+        }
+
+        bool parser_t::Parse(code_t* code, nrunes::reader_t& reader)
+        {
+            if (m_error || code->m_parser != this)
+                return false;
+            return exec(code->m_entry, reader);
+        }
+
+        bool parser_t::repeat(u32 pc, s32 _min, s32 _max, nrunes::reader_t& reader)
+        {
+            u32 const cursor = reader.get_cursor();
+            s32       i      = 0;
+            while (i < _max)
+            {
+                u32 const iteration = reader.get_cursor();
+                if (!exec(pc, reader))
+                    break;
+                i += 1;
+                if (iteration == reader.get_cursor())
+                {
+                    // Matched without consuming anything, repeating will not change that
+                    i = _max;
+                }
+            }
+            if (i >= _min)
+                return true;
+            reader.set_cursor(cursor);
+            return false;
+        }
+
+        // Execute the block at 'pc', all instructions have to match in sequence.
+        // On failure the cursor of 'reader' is restored to where it was when entering the block.
+        bool parser_t::exec(u32 pc, nrunes::reader_t& reader)
+        {
+            u8 const* const code   = m_buffer.m_begin;
+            u8 const*       ip     = code + pc;
+            u32 const       cursor = reader.get_cursor();
+
+            bool result = true;
+            while (result)
+            {
+                switch (*ip++)
+                {
+                    case eRET: return true;
+                    case eJMP: ip = code + get_u16(ip); break;
+                    case eEXTRACT:
+                    {
+                        va_r_t* const var   = (va_r_t*)(ptr_t)get_u64(ip);
+                        u32 const     start = reader.get_cursor();
+                        result              = exec(get_u16(ip + 8), reader);
+                        if (result)
+                        {
+                            crunes_t const runes = reader.select(start, reader.get_cursor()).get_current();
+                            if (!is_empty(runes))
+                                *var = runes;
+                        }
+                        ip += 10;
+                        break;
+                    }
+                    case eNOT:
+                    {
+                        u32 const start = reader.get_cursor();
+                        result          = !exec(get_u16(ip), reader);
+                        reader.set_cursor(start);
+                        ip += 2;
+                        break;
+                    }
+                    case eOR:
+                        result = exec(get_u16(ip), reader) || exec(get_u16(ip + 2), reader);
+                        ip += 4;
+                        break;
+                    case eAND:
+                    {
+                        // Both have to match at the same position, the cursor ends up at the shortest match
+                        u32 const start = reader.get_cursor();
+                        result          = exec(get_u16(ip), reader);
+                        if (result)
+                        {
+                            u32 const lhs = reader.get_cursor();
+                            reader.set_cursor(start);
+                            result = exec(get_u16(ip + 2), reader);
+                            if (result && lhs < reader.get_cursor())
+                                reader.set_cursor(lhs);
+                        }
+                        ip += 4;
+                        break;
+                    }
+                    case eCALL:
+                        result = exec(get_u16(ip), reader);
+                        ip += 2;
+                        break;
+                    case eWITHIN:
+                        result = repeat(get_u16(ip + 8), (s32)get_u32(ip), (s32)get_u32(ip + 4), reader);
+                        ip += 10;
+                        break;
+                    case eONE_OR_MORE:
+                        result = repeat(get_u16(ip), 1, 0x7fffffff, reader);
+                        ip += 2;
+                        break;
+                    case eZERO_OR_MORE:
+                        result = repeat(get_u16(ip), 0, 0x7fffffff, reader);
+                        ip += 2;
+                        break;
+                    case eZERO_OR_ONE:
+                        result = repeat(get_u16(ip), 0, 1, reader);
+                        ip += 2;
+                        break;
+                    case eUNTIL:
+                    {
+                        // Repeat 'code' until 'until' matches, 'until' itself is not consumed
+                        u32 const until = get_u16(ip);
+                        u32 const body  = get_u16(ip + 2);
+                        while (true)
+                        {
+                            u32 const at = reader.get_cursor();
+                            if (exec(until, reader))
+                            {
+                                reader.set_cursor(at);
+                                break;
+                            }
+                            if (!exec(body, reader) || at == reader.get_cursor())
+                            {
+                                result = false;
+                                break;
+                            }
+                        }
+                        ip += 4;
+                        break;
+                    }
+                    case eENCLOSED:
+                        result = reader.peek() == get_u32(ip);
+                        if (result)
+                        {
+                            reader.skip();
+                            result = exec(get_u16(ip + 8), reader) && match_if(reader, reader.peek() == get_u32(ip + 4));
+                        }
+                        ip += 10;
+                        break;
+                    case eANY:
+                        result = reader.valid();
+                        if (result)
+                            reader.skip();
+                        break;
+                    case eIN:
+                    {
+                        uchar32 const   c    = reader.peek();
+                        u8 const*       text = ip + 1;
+                        u8 const* const end  = text + ip[0];
+                        result               = false;
+                        while (!result && text < end)
+                            result = utf8_read(text) == c;
+                        if (result)
+                            reader.skip();
+                        ip = end;
+                        break;
+                    }
+                    case eBETWEEN:
+                    {
+                        uchar32 const c = reader.peek();
+                        result          = match_if(reader, c >= get_u32(ip) && c <= get_u32(ip + 4));
+                        ip += 8;
+                        break;
+                    }
+                    case eALPHABET: result = match_if(reader, is_alphabet(reader.peek())); break;
+                    case eDIGIT: result = match_if(reader, is_digit(reader.peek())); break;
+                    case eHEX: result = match_if(reader, is_hex(reader.peek())); break;
+                    case eALNUM: result = match_if(reader, is_alphabet(reader.peek()) || is_digit(reader.peek())); break;
+                    case eEXACT:
+                    case eLIKE:
+                    {
+                        bool const      like = ip[-1] == eLIKE;
+                        u8 const*       text = ip + 1;
+                        u8 const* const end  = text + ip[0];
+                        while (result && text < end)
+                        {
+                            uchar32 const c = utf8_read(text);
+                            uchar32 const s = reader.read();
+                            result          = (c == s) || (like && nrunes::to_lower(c) == nrunes::to_lower(s));
+                        }
+                        ip = end;
+                        break;
+                    }
+                    case eWHITESPACE:
+                    {
+                        u32 const start = reader.get_cursor();
+                        while (reader.valid() && is_space(reader.peek()))
+                            reader.skip();
+                        result = (ip[0] & cZeroOrMore) != 0 || start != reader.get_cursor();
+                        ip += 1;
+                        break;
+                    }
+                    case eIS8:
+                        result = match_if(reader, reader.peek() == ip[0]);
+                        ip += 1;
+                        break;
+                    case eIS32:
+                        result = match_if(reader, reader.peek() == get_u32(ip));
+                        ip += 4;
+                        break;
+                    case eWORD:
+                        result = is_alphabet(reader.peek());
+                        while (is_alphabet(reader.peek()))
+                            reader.skip();
+                        break;
+                    case eEOT: result = !reader.valid(); break;
+                    case eENDOFLINE: result = end_of_line(reader); break;
+                    case eEOL: result = !reader.valid() || end_of_line(reader); break;
+                    case eU32:
+                        result = parse_unsigned(reader, get_u32(ip), get_u32(ip + 4));
+                        ip += 8;
+                        break;
+                    case eU64:
+                        result = parse_unsigned(reader, get_u64(ip), get_u64(ip + 8));
+                        ip += 16;
+                        break;
+                    case eI32:
+                        result = parse_integer(reader, (s32)get_u32(ip), (s32)get_u32(ip + 4));
+                        ip += 8;
+                        break;
+                    case eI64:
+                        result = parse_integer(reader, (s64)get_u64(ip), (s64)get_u64(ip + 8));
+                        ip += 16;
+                        break;
+                    case eF32:
+                        result = parse_float(reader, get_f32(ip), get_f32(ip + 4));
+                        ip += 8;
+                        break;
+                    case eF64:
+                        result = parse_float(reader, get_f64(ip), get_f64(ip + 8));
+                        ip += 16;
+                        break;
+                    default: ASSERT(false); return false;
+                }
+            }
+
+            reader.set_cursor(cursor);
+            return false;
+        }
 
         static void use_case_1()
         {
@@ -124,10 +1018,12 @@ namespace ncore
                 p.Sequence(p.Extract(&index, p.Integer32())
                                ->Is(':')
                                ->WhiteSpace(cZeroOrMore)
-                               ->Or(p.Sequence(p.Is('"')->Extract(&r1c, p.Until(p.Is('"'), p.Any()))->WhiteSpace(cZeroOrMore)->EOL()),
+                               ->Or(p.Sequence(p.Is('"')->Extract(&r1c, p.Until(p.Is('"'), p.Any()))->Is('"')->WhiteSpace(cZeroOrMore)->EOL()),
                                     p.Sequence(p.WhiteSpace(cZeroOrMore)
                                                    ->Until(p.Or(p.Is('|'), p.EOL()), p.Sequence(p.WhiteSpace(cZeroOrMore)->Extract(&lvars, p.Integer32())->WhiteSpace(cZeroOrMore)))
-                                                   ->Or(p.EOL(), p.Sequence(p.Until(p.EOL(), p.Sequence(p.WhiteSpace(cZeroOrMore)->Extract(&rvars, p.Integer32())->WhiteSpace(cZeroOrMore))))))));
+                                                   ->Or(p.EOL(), p.Sequence(p.Is('|')->Until(p.EOL(), p.Sequence(p.WhiteSpace(cZeroOrMore)->Extract(&rvars, p.Integer32())->WhiteSpace(cZeroOrMore))))))));
+
+            alloc->deallocate(data);
         }
     } // namespace parser3
 } // namespace ncore
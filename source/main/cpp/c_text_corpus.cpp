@@ -0,0 +1,255 @@
+#include "ccore/c_target.h"
+#include "cbase/c_runes.h"
+
+#include "ctext/c_text_corpus.h"
+
+namespace ncore
+{
+    namespace ncorpus
+    {
+        config_t::config_t()
+            : m_seed(0x5eed)
+            , m_encoding(ascii::TYPE)
+            , m_distribution(distribution_short)
+            , m_min_line(20)
+            , m_max_line(160)
+            , m_crlf(0)
+            , m_numbers(20)
+            , m_emails(5)
+            , m_ipv4(5)
+            , m_hosts(5)
+            , m_non_ascii(0)
+        {
+        }
+
+        static const char* sWords[] = {"connection", "from", "user", "request", "accepted", "refused", "retry", "later", "session", "timeout", "cache", "miss", "write", "read", "queue", "worker"};
+        static const char* sNames[] = {"john.doe", "jane", "admin", "x_y", "support", "no-reply", "m.smith", "ops"};
+        static const char* sHosts[] = {"example.org", "mail.example.com", "db-1.internal", "cdn.static-host.net", "localhost", "api.v2.service.io"};
+
+        // Words with 2, 3 and 4 byte UTF-8 sequences, the last one is a surrogate pair in UTF-16
+        static const uchar32 sCafe[]   = {'c', 'a', 'f', 0xe9, 0};
+        static const uchar32 sGrusse[] = {'g', 'r', 0xfc, 0xdf, 'e', 0};
+        static const uchar32 sDaten[]  = {0x434, 0x430, 0x43d, 0x43d, 0x44b, 0x435, 0};
+        static const uchar32 sNihon[]  = {0x65e5, 0x672c, 0x8a9e, 0};
+        static const uchar32 sSmile[]  = {'o', 'k', 0x1f600, 0};
+        static const uchar32* sNonAscii[] = {sCafe, sGrusse, sDaten, sNihon, sSmile};
+
+        static const u32 cMaxToken = 64;
+
+        static u32 append(uchar32* token, u32 len, const char* str)
+        {
+            while (*str != 0 && len < cMaxToken)
+                token[len++] = (uchar32)*str++;
+            return len;
+        }
+
+        static u32 append(uchar32* token, u32 len, u32 v)
+        {
+            char digits[10];
+            s32  n = 0;
+            do
+            {
+                digits[n++] = (char)('0' + (v % 10));
+                v /= 10;
+            } while (v != 0);
+            while (n > 0 && len < cMaxToken)
+                token[len++] = (uchar32)digits[--n];
+            return len;
+        }
+
+        generator_t::generator_t(config_t const& config) : m_config(config), m_state(config.m_seed != 0 ? config.m_seed : 0x9e3779b9), m_lines(0), m_bytes(0), m_line_size(0)
+        {
+            if (m_config.m_max_line > cMaxLine)
+                m_config.m_max_line = cMaxLine;
+            if (m_config.m_min_line > m_config.m_max_line)
+                m_config.m_min_line = m_config.m_max_line;
+        }
+
+        // xorshift32
+        u32 generator_t::next()
+        {
+            m_state ^= m_state << 13;
+            m_state ^= m_state >> 17;
+            m_state ^= m_state << 5;
+            return m_state;
+        }
+
+        void generator_t::put(uchar32 c)
+        {
+            u8* dst = m_line + m_line_size;
+            if (m_config.m_encoding == utf16::TYPE)
+            {
+                u16 units[2];
+                s32 n = 1;
+                if (c >= 0x10000)
+                {
+                    c -= 0x10000;
+                    units[0] = (u16)(0xd800 + (c >> 10));
+                    units[1] = (u16)(0xdc00 + (c & 0x3ff));
+                    n        = 2;
+                }
+                else
+                {
+                    units[0] = (u16)c;
+                }
+                u8 const* bytes = (u8 const*)units;
+                for (s32 i = 0; i < n * 2; ++i)
+                    dst[i] = bytes[i];
+                m_line_size += (u32)(n * 2);
+            }
+            else if (m_config.m_encoding == utf8::TYPE)
+            {
+                if (c < 0x80)
+                {
+                    dst[0] = (u8)c;
+                    m_line_size += 1;
+                }
+                else if (c < 0x800)
+                {
+                    dst[0] = (u8)(0xc0 | (c >> 6));
+                    dst[1] = (u8)(0x80 | (c & 0x3f));
+                    m_line_size += 2;
+                }
+                else if (c < 0x10000)
+                {
+                    dst[0] = (u8)(0xe0 | (c >> 12));
+                    dst[1] = (u8)(0x80 | ((c >> 6) & 0x3f));
+                    dst[2] = (u8)(0x80 | (c & 0x3f));
+                    m_line_size += 3;
+                }
+                else
+                {
+                    dst[0] = (u8)(0xf0 | (c >> 18));
+                    dst[1] = (u8)(0x80 | ((c >> 12) & 0x3f));
+                    dst[2] = (u8)(0x80 | ((c >> 6) & 0x3f));
+                    dst[3] = (u8)(0x80 | (c & 0x3f));
+                    m_line_size += 4;
+                }
+            }
+            else
+            {
+                dst[0] = (c < 0x80) ? (u8)c : (u8)'?';
+                m_line_size += 1;
+            }
+        }
+
+        // Writes the characters of a random token to 'token', returns the number of characters
+        u32 generator_t::token(uchar32* token)
+        {
+            u32 len  = 0;
+            u32 kind = below(100);
+            if (kind < m_config.m_numbers)
+                return append(token, len, below(1000000));
+            kind -= m_config.m_numbers;
+            if (kind < m_config.m_emails)
+            {
+                len = append(token, len, sNames[below(8)]);
+                len = append(token, len, "@");
+                return append(token, len, sHosts[below(6)]);
+            }
+            kind -= m_config.m_emails;
+            if (kind < m_config.m_ipv4)
+            {
+                for (s32 i = 0; i < 4; ++i)
+                {
+                    if (i > 0)
+                        len = append(token, len, ".");
+                    len = append(token, len, below(256));
+                }
+                return len;
+            }
+            kind -= m_config.m_ipv4;
+            if (kind < m_config.m_hosts)
+                return append(token, len, sHosts[below(6)]);
+
+            if (m_config.m_encoding != ascii::TYPE && below(100) < m_config.m_non_ascii)
+            {
+                uchar32 const* word = sNonAscii[below(5)];
+                while (*word != 0)
+                    token[len++] = *word++;
+                return len;
+            }
+            return append(token, len, sWords[below(16)]);
+        }
+
+        void generator_t::line()
+        {
+            u32 const span   = (u32)(m_config.m_max_line - m_config.m_min_line);
+            u32       length = m_config.m_min_line;
+            if (span > 0)
+            {
+                if (m_config.m_distribution == distribution_short)
+                {
+                    u64 const u = below(1024);
+                    length += (u32)(((u64)span * u * u * u) >> 30);
+                }
+                else
+                {
+                    length += below(span + 1);
+                }
+            }
+
+            m_line_size = 0;
+            u32 chars   = 0;
+            while (chars < length)
+            {
+                u32 room = length - chars;
+                if (chars > 0)
+                {
+                    if (room < 2)
+                        break;
+                    put(' ');
+                    chars += 1;
+                    room -= 1;
+                }
+
+                uchar32   text[cMaxToken];
+                u32 const len = token(text);
+                if (len > room)
+                    break;
+                for (u32 i = 0; i < len; ++i)
+                    put(text[i]);
+                chars += len;
+            }
+
+            // Pad the line to its length, the padding is a word of its own unless there is only room for 1 character
+            while (chars < length)
+            {
+                put((uchar32)('a' + (chars % 26)));
+                chars += 1;
+            }
+
+            if (below(100) < m_config.m_crlf)
+                put('\r');
+            put('\n');
+        }
+
+        u32 generator_t::write(u8* buffer, u32 size)
+        {
+            u32 written = 0;
+            while (true)
+            {
+                if (m_line_size == 0)
+                    line();
+                if (written + m_line_size > size)
+                    break;
+                for (u32 i = 0; i < m_line_size; ++i)
+                    buffer[written + i] = m_line[i];
+                written += m_line_size;
+                m_bytes += m_line_size;
+                m_lines += 1;
+                m_line_size = 0;
+            }
+            return written;
+        }
+
+        u32 generate(config_t const& config, u8* buffer, u32 size, u32& lines)
+        {
+            generator_t generator(config);
+            u32 const   written = generator.write(buffer, size);
+            lines               = (u32)generator.lines();
+            return written;
+        }
+
+    } // namespace ncorpus
+} // namespace ncore
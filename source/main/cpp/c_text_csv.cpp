@@ -0,0 +1,190 @@
+#include "ccore/c_target.h"
+#include "cbase/c_buffer.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_runes.h"
+
+#include "ctext/c_text_csv.h"
+#include "ctext/c_text_scan.h"
+
+namespace ncore
+{
+    namespace ncsv
+    {
+        u32 reader_t::required(config_t const& config)
+        {
+            u32 const fields = (u32)config.m_max_rows * (u32)config.m_max_columns;
+            return fields * (u32)sizeof(field_t) + (u32)config.m_max_rows * (u32)sizeof(s32) + (u32)sizeof(void*);
+        }
+
+        reader_t::reader_t(text_stream_t& stream, buffer_t memory, config_t const& config) : m_stream(&stream), m_config(config), m_fields(nullptr), m_widths(nullptr), m_next(0), m_valid(false), m_done(false), m_rows(0)
+        {
+            if (m_config.m_max_rows <= 0 || m_config.m_max_columns <= 0)
+                return;
+            u8* const begin = nscan::align_ptr(memory.m_begin);
+            if (begin > memory.m_end || (u32)(memory.m_end - memory.m_begin) < required(m_config))
+                return;
+            m_fields = (field_t*)begin;
+            m_widths = (s32*)(m_fields + m_config.m_max_rows * m_config.m_max_columns);
+            m_valid  = true;
+
+            crunes_t text;
+            m_stream->window(text);
+            m_next = text.m_str;
+        }
+
+        // The state of the scan of a row that is not complete yet
+        struct row_t
+        {
+            u32 m_start;       // cursor where the row starts
+            u32 m_field_begin; // cursor where the current field starts
+            s32 m_column;      // fields of the row so far
+        };
+
+        // The field from 'begin' up to the delimiter or line end at 'stop', without the '\r' of a "\r\n" line end
+        // and without the quotes of a quoted field
+        static void set_field(field_t& field, u8 const* base, u32 begin, u32 stop, bool eol, u8 quote)
+        {
+            if (eol && stop > begin && base[stop - 1] == '\r')
+                stop -= 1;
+            field.m_quoted = 0;
+            if (quote != 0 && (stop - begin) >= 2 && base[begin] == quote && base[stop - 1] == quote)
+            {
+                begin += 1;
+                stop -= 1;
+                field.m_quoted = 1;
+            }
+            field.m_begin = begin;
+            field.m_end   = stop;
+        }
+
+        bool reader_t::read(batch_t& batch)
+        {
+            batch.m_rows    = 0;
+            batch.m_columns = 0;
+            batch.m_stride  = m_config.m_max_rows;
+            batch.m_fields  = m_fields;
+            batch.m_widths  = m_widths;
+            if (!m_valid || m_done)
+                return false;
+
+            m_stream->consume(m_next);
+            crunes_t text;
+            m_stream->window(text);
+            if (text.m_type != ascii::TYPE && text.m_type != utf8::TYPE)
+            {
+                m_valid = false;
+                return false;
+            }
+
+            u8 const  quote       = m_config.m_quote;
+            u8 const  chars[3]    = {m_config.m_delimiter, (u8)'\n', quote};
+            s32 const num_chars   = (quote != 0) ? 3 : 2;
+            s32 const max_rows    = m_config.m_max_rows;
+            s32 const max_columns = m_config.m_max_columns;
+
+            row_t row;
+            while (true)
+            {
+                u8 const* base = (u8 const*)text.m_ascii;
+                u32 const end  = text.m_end;
+                row.m_start       = text.m_str;
+                row.m_field_begin = text.m_str;
+                row.m_column      = 0;
+                batch.m_rows      = 0;
+                batch.m_columns   = 0;
+
+                u64  inside = 0; // all ones when the previous block ended inside quotes
+                u32  pos    = text.m_str;
+                bool full   = false;
+                while (pos < end && !full)
+                {
+                    // The last block is copied and padded, bytes beyond the text do not count
+                    u8        tail[64];
+                    u64       valid;
+                    u8 const* block = nscan::block64(base + pos, base + end, tail, valid);
+
+                    u64 masks[3];
+                    nscan::match64(block, chars, num_chars, masks);
+                    u64 in_quotes = 0;
+                    if (quote != 0)
+                    {
+                        in_quotes = nscan::prefix_xor(masks[2] & valid) ^ inside;
+                        inside    = (u64)((s64)in_quotes >> 63);
+                    }
+                    u64 structural = (masks[0] | masks[1]) & ~in_quotes & valid;
+
+                    while (structural != 0)
+                    {
+                        u32 const at = pos + (u32)nscan::lowest_bit64(structural);
+                        structural &= structural - 1;
+
+                        bool const eol = base[at] == '\n';
+                        if (row.m_column < max_columns)
+                            set_field(m_fields[row.m_column * max_rows + batch.m_rows], base, row.m_field_begin, at, eol, quote);
+                        row.m_column += 1;
+                        row.m_field_begin = at + 1;
+
+                        if (eol)
+                        {
+                            s32 const width        = (row.m_column < max_columns) ? row.m_column : max_columns;
+                            m_widths[batch.m_rows] = width;
+                            batch.m_columns        = (width > batch.m_columns) ? width : batch.m_columns;
+                            batch.m_rows += 1;
+                            row.m_start  = at + 1;
+                            row.m_column = 0;
+                            if (batch.m_rows == max_rows)
+                            {
+                                full = true;
+                                break;
+                            }
+                        }
+                    }
+                    pos += 64;
+                }
+
+                if (full || batch.m_rows > 0)
+                    break;
+
+                // Not a single complete row in the window, extend it and scan again
+                if (!m_stream->more())
+                {
+                    // The last row of the text does not need a line end
+                    if (row.m_start < end)
+                    {
+                        if (row.m_column < max_columns)
+                            set_field(m_fields[row.m_column * max_rows], base, row.m_field_begin, end, true, quote);
+                        row.m_column += 1;
+                        m_widths[0]     = (row.m_column < max_columns) ? row.m_column : max_columns;
+                        batch.m_columns = m_widths[0];
+                        batch.m_rows    = 1;
+                        row.m_start     = end;
+                    }
+                    m_done = true;
+                    break;
+                }
+                m_stream->window(text);
+            }
+
+            batch.m_text = text;
+            m_next       = row.m_start;
+            m_rows += (u64)batch.m_rows;
+            return batch.m_rows > 0;
+        }
+
+        s32 reader_t::unquote(crunes_t const& field, char* out, s32 size) const
+        {
+            u8 const* str    = (u8 const*)field.m_ascii + field.m_str;
+            u8 const* end    = (u8 const*)field.m_ascii + field.m_end;
+            u8 const  quote  = m_config.m_quote;
+            s32       length = 0;
+            while (str < end && length < size)
+            {
+                if (*str == quote && (str + 1) < end && str[1] == quote)
+                    str += 1;
+                out[length++] = (char)*str++;
+            }
+            return length;
+        }
+
+    } // namespace ncsv
+} // namespace ncore
@@ -0,0 +1,469 @@
+#include "ccore/c_target.h"
+#include "cbase/c_buffer.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_runes.h"
+
+#include "ctext/c_parser2.h"
+#include "ctext/c_text_json.h"
+#include "ctext/c_text_scan.h"
+
+namespace ncore
+{
+    namespace njson
+    {
+        static const s32 cMaxDepth = 128; // nesting of objects and arrays
+
+        static inline bool is_space(u8 c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+        u32 document_t::required(s32 max_structurals)
+        {
+            if (max_structurals <= 0)
+                return 0;
+            return (u32)max_structurals * (u32)(sizeof(u32) * 2) + (u32)sizeof(void*);
+        }
+
+        document_t::document_t(buffer_t memory) : m_positions(nullptr), m_links(nullptr), m_capacity(0), m_count(0), m_valid(false)
+        {
+            m_line = ascii::make_crunes("");
+            u8* const begin = nscan::align_ptr(memory.m_begin);
+            if (begin < memory.m_end)
+            {
+                m_capacity  = (s32)((u32)(memory.m_end - begin) / (u32)(sizeof(u32) * 2));
+                m_positions = (u32*)begin;
+                m_links     = m_positions + m_capacity;
+            }
+        }
+
+        // Stage 1, the cursors of the structurals of the line: the operators outside strings, every unescaped
+        // quote and the first byte of every number or literal. Returns the number of structurals or -1.
+        static s32 index_structurals(u8 const* base, u32 begin, u32 end, u32* positions, s32 capacity)
+        {
+            static const u8 chars[12] = {(u8)'{', (u8)'}', (u8)'[', (u8)']', (u8)':', (u8)',', (u8)'"', (u8)'\\', (u8)' ', (u8)'\t', (u8)'\r', (u8)'\n'};
+
+            s32 count  = 0;
+            u64 inside = 0; // all ones when the previous block ended inside a string
+            u64 carry  = 0; // the first byte of this block is escaped
+            u64 scalar = 0; // the last byte of the previous block was part of a number or literal
+            for (u32 pos = begin; pos < end; pos += 64)
+            {
+                // The last block is copied and padded, bytes beyond the line do not count
+                u8        tail[64];
+                u64       valid;
+                u8 const* block = nscan::block64(base + pos, base + end, tail, valid);
+
+                u64 m[12];
+                nscan::match64(block, chars, 12, m);
+                u64 const ops       = m[0] | m[1] | m[2] | m[3] | m[4] | m[5];
+                u64 const spaces    = m[8] | m[9] | m[10] | m[11];
+                u64 const escaped   = nscan::escaped64(m[7] & valid, carry);
+                u64 const quotes    = m[6] & ~escaped & valid;
+                u64 const in_string = nscan::prefix_xor(quotes) ^ inside; // from an opening quote up to its closing quote
+                inside              = (u64)((s64)in_string >> 63);
+
+                u64 const outside = ~in_string & valid;
+                u64 const scalars = outside & ~(ops | spaces | quotes);
+                u64 const starts  = scalars & ~((scalars << 1) | scalar);
+                scalar            = scalars >> 63;
+
+                u64 structurals = (ops & outside) | quotes | starts;
+                while (structurals != 0)
+                {
+                    if (count == capacity)
+                        return -1;
+                    positions[count++] = pos + (u32)nscan::lowest_bit64(structurals);
+                    structurals &= structurals - 1;
+                }
+            }
+            return (inside == 0) ? count : -1;
+        }
+
+        bool document_t::parse(crunes_t const& line)
+        {
+            m_line  = line;
+            m_count = 0;
+            m_valid = false;
+            if (m_capacity == 0 || (line.m_type != ascii::TYPE && line.m_type != utf8::TYPE))
+                return false;
+
+            u8 const* base  = (u8 const*)line.m_ascii;
+            s32 const count = index_structurals(base, line.m_str, line.m_end, m_positions, m_capacity);
+            if (count <= 0)
+                return false;
+
+            // Stage 2, match the brackets and link every value to its end; the closing quotes are removed from the
+            // index, a string is linked to its closing quote instead
+            s32 opens[cMaxDepth];
+            s32 depth = 0;
+            s32 out   = 0;
+            for (s32 i = 0; i < count; ++i)
+            {
+                u32 const pos = m_positions[i];
+                u8 const  c   = base[pos];
+                m_positions[out] = pos;
+                m_links[out]     = 0;
+                switch (c)
+                {
+                    case '{':
+                    case '[':
+                        if (depth == cMaxDepth)
+                            return false;
+                        opens[depth++] = out;
+                        break;
+                    case '}':
+                    case ']':
+                    {
+                        if (depth == 0)
+                            return false;
+                        s32 const open = opens[--depth];
+                        if (base[m_positions[open]] != ((c == '}') ? '{' : '['))
+                            return false;
+                        m_links[open] = (u32)out;
+                        break;
+                    }
+                    case '"': m_links[out] = m_positions[++i]; break;
+                    case ':':
+                    case ',': break;
+                    default:
+                    {
+                        u32 stop = (i + 1 < count) ? m_positions[i + 1] : line.m_end;
+                        while (stop > pos && is_space(base[stop - 1]))
+                            stop -= 1;
+                        m_links[out] = stop;
+                        break;
+                    }
+                }
+                out += 1;
+            }
+            m_count = out;
+            m_valid = depth == 0 && after(0) == m_count;
+            return m_valid;
+        }
+
+        bool document_t::read(text_stream_t& stream)
+        {
+            crunes_t line;
+            while (stream.readLine(line))
+            {
+                u8 const* base = (u8 const*)line.m_ascii;
+                u32       pos  = line.m_str;
+                while (pos < line.m_end && is_space(base[pos]))
+                    pos += 1;
+                if (pos == line.m_end)
+                    continue;
+                parse(line);
+                return true;
+            }
+            m_count = 0;
+            m_valid = false;
+            return false;
+        }
+
+        static bool is_literal(u8 const* base, u32 begin, u32 end, const char* literal)
+        {
+            for (; begin < end && *literal != 0; ++begin, ++literal)
+            {
+                if (base[begin] != (u8)*literal)
+                    return false;
+            }
+            return begin == end && *literal == 0;
+        }
+
+        value_t document_t::at(s32 index) const
+        {
+            value_t value;
+            value.m_kind  = kind_none;
+            value.m_index = -1;
+            value.m_begin = m_line.m_str;
+            value.m_end   = m_line.m_str;
+            if (index < 0 || index >= m_count)
+                return value;
+
+            u8 const* base = (u8 const*)m_line.m_ascii;
+            u32 const pos  = m_positions[index];
+            value.m_index  = index;
+            value.m_begin  = pos;
+            value.m_end    = m_links[index];
+            switch (base[pos])
+            {
+                case '{':
+                case '[':
+                    value.m_kind = (base[pos] == '{') ? kind_object : kind_array;
+                    value.m_end  = m_positions[m_links[index]] + 1;
+                    break;
+                case '"':
+                    value.m_kind  = kind_string;
+                    value.m_begin = pos + 1;
+                    break;
+                case 't': value.m_kind = is_literal(base, pos, value.m_end, "true") ? kind_true : kind_none; break;
+                case 'f': value.m_kind = is_literal(base, pos, value.m_end, "false") ? kind_false : kind_none; break;
+                case 'n': value.m_kind = is_literal(base, pos, value.m_end, "null") ? kind_null : kind_none; break;
+                case '-':
+                case '0':
+                case '1':
+                case '2':
+                case '3':
+                case '4':
+                case '5':
+                case '6':
+                case '7':
+                case '8':
+                case '9': value.m_kind = kind_number; break;
+                default:
+                    value.m_kind  = kind_none;
+                    value.m_index = -1;
+                    value.m_end   = pos;
+                    break;
+            }
+            return value;
+        }
+
+        s32 document_t::after(s32 index) const
+        {
+            if (index >= m_count)
+                return m_count;
+            u8 const c = ((u8 const*)m_line.m_ascii)[m_positions[index]];
+            return (c == '{' || c == '[') ? (s32)m_links[index] + 1 : index + 1;
+        }
+
+        value_t document_t::root() const { return m_valid ? at(0) : at(-1); }
+
+        value_t document_t::member(value_t const& object, crunes_t const& key) const
+        {
+            if (object.m_kind != kind_object)
+                return at(-1);
+
+            u8 const* base   = (u8 const*)m_line.m_ascii;
+            u8 const* name   = (u8 const*)key.m_ascii + key.m_str;
+            u32 const length = key.m_end - key.m_str;
+            s32 const close  = (s32)m_links[object.m_index];
+            for (s32 i = object.m_index + 1; i < close;)
+            {
+                // "key" : value ,
+                if (base[m_positions[i]] != '"' || (i + 2) >= close || base[m_positions[i + 1]] != ':')
+                    return at(-1);
+                u32 const begin = m_positions[i] + 1;
+                if ((m_links[i] - begin) == length)
+                {
+                    u32 n = 0;
+                    while (n < length && base[begin + n] == name[n])
+                        n += 1;
+                    if (n == length)
+                        return at(i + 2);
+                }
+                i = after(i + 2);
+                if (i < close && base[m_positions[i]] == ',')
+                    i += 1;
+            }
+            return at(-1);
+        }
+
+        value_t document_t::element(value_t const& array, s32 index) const
+        {
+            if (array.m_kind != kind_array || index < 0)
+                return at(-1);
+
+            u8 const* base  = (u8 const*)m_line.m_ascii;
+            s32 const close = (s32)m_links[array.m_index];
+            for (s32 i = array.m_index + 1, n = 0; i < close; ++n)
+            {
+                if (n == index)
+                    return at(i);
+                i = after(i);
+                if (i < close && base[m_positions[i]] == ',')
+                    i += 1;
+            }
+            return at(-1);
+        }
+
+        s32 document_t::count(value_t const& value) const
+        {
+            if (value.m_kind != kind_object && value.m_kind != kind_array)
+                return 0;
+
+            // Every member or element but the last is followed by a comma at this level
+            u8 const* base  = (u8 const*)m_line.m_ascii;
+            s32 const close = (s32)m_links[value.m_index];
+            s32       n     = 0;
+            for (s32 i = value.m_index + 1; i < close; i = after(i))
+            {
+                if (base[m_positions[i]] == ',')
+                    n += 1;
+            }
+            return (close > value.m_index + 1) ? n + 1 : 0;
+        }
+
+        value_t document_t::find(value_t const& from, const char* path) const
+        {
+            crunes_t  key   = ascii::make_crunes(path);
+            u32 const end   = key.m_end;
+            value_t   value = from;
+            for (u32 pos = key.m_str; value.m_kind != kind_none && pos < end; ++pos)
+            {
+                u32  stop   = pos;
+                s32  index  = 0;
+                bool number = true;
+                for (; stop < end && path[stop] != '.'; ++stop)
+                {
+                    // An index beyond the structurals of the line is not an element, it stops growing before it can overflow
+                    number = number && path[stop] >= '0' && path[stop] <= '9';
+                    if (number)
+                        index = (index <= m_count / 10) ? index * 10 + (path[stop] - '0') : m_count;
+                }
+                if (number && stop > pos && value.m_kind == kind_array)
+                {
+                    value = element(value, index);
+                }
+                else
+                {
+                    key.m_str = pos;
+                    key.m_end = stop;
+                    value     = member(value, key);
+                }
+                pos = stop;
+            }
+            return value;
+        }
+
+        crunes_t document_t::text(value_t const& value) const
+        {
+            crunes_t text = m_line;
+            text.m_str    = value.m_begin;
+            text.m_end    = value.m_end;
+            return text;
+        }
+
+        bool document_t::as_s64(value_t const& value, s64& out) const
+        {
+            if (value.m_kind != kind_number)
+                return false;
+            nrunes::reader_t reader(text(value));
+            return parser2::read_integer64(reader, out) && !reader.valid();
+        }
+
+        bool document_t::as_f64(value_t const& value, f64& out) const
+        {
+            if (value.m_kind != kind_number)
+                return false;
+            nrunes::reader_t reader(text(value));
+            if (!parser2::read_float64(reader, out))
+                return false;
+
+            // The exponent of the number
+            uchar32 const e = reader.peek();
+            if (reader.valid() && (e == 'e' || e == 'E'))
+            {
+                reader.skip();
+                if (reader.peek() == '+')
+                    reader.skip();
+                s64 exponent = 0;
+                if (!parser2::read_integer64(reader, exponent))
+                    return false;
+                f64 scale = 1.0;
+                for (s64 i = (exponent < 0) ? -exponent : exponent; i > 0 && scale < 1e308; --i)
+                    scale *= 10.0;
+                out = (exponent < 0) ? out / scale : out * scale;
+            }
+            return !reader.valid();
+        }
+
+        static s32 hex_digit(u8 c)
+        {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            if (c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F')
+                return c - 'A' + 10;
+            return -1;
+        }
+
+        // The code unit of "\uXXXX" at 'str', -1 when it is not one
+        static s32 read_unit(u8 const* str, u8 const* end)
+        {
+            if ((end - str) < 6 || str[0] != '\\' || str[1] != 'u')
+                return -1;
+            s32 unit = 0;
+            for (s32 i = 2; i < 6; ++i)
+            {
+                s32 const digit = hex_digit(str[i]);
+                if (digit < 0)
+                    return -1;
+                unit = (unit << 4) | digit;
+            }
+            return unit;
+        }
+
+        s32 document_t::unescape(value_t const& value, char* out, s32 size) const
+        {
+            if (value.m_kind != kind_string)
+                return 0;
+
+            u8 const* str    = (u8 const*)m_line.m_ascii + value.m_begin;
+            u8 const* end    = (u8 const*)m_line.m_ascii + value.m_end;
+            s32       length = 0;
+            while (str < end && length < size)
+            {
+                if (*str != '\\' || (str + 1) == end)
+                {
+                    out[length++] = (char)*str++;
+                    continue;
+                }
+
+                u32 c = str[1];
+                str += 2;
+                switch (c)
+                {
+                    case 'b': c = '\b'; break;
+                    case 'f': c = '\f'; break;
+                    case 'n': c = '\n'; break;
+                    case 'r': c = '\r'; break;
+                    case 't': c = '\t'; break;
+                    case 'u':
+                    {
+                        s32 const unit = read_unit(str - 2, end);
+                        if (unit < 0)
+                            break;
+                        str += 4;
+                        c = (u32)unit;
+                        s32 const low = read_unit(str, end);
+                        if (c >= 0xd800 && c < 0xdc00 && low >= 0xdc00 && low < 0xe000)
+                        {
+                            c = 0x10000 + ((c - 0xd800) << 10) + ((u32)low - 0xdc00);
+                            str += 6;
+                        }
+                        break;
+                    }
+                    default: break;
+                }
+
+                // The code point as UTF-8
+                char bytes[4];
+                s32  n = 0;
+                if (c < 0x80)
+                    bytes[n++] = (char)c;
+                else if (c < 0x800)
+                {
+                    bytes[n++] = (char)(0xc0 | (c >> 6));
+                    bytes[n++] = (char)(0x80 | (c & 0x3f));
+                }
+                else if (c < 0x10000)
+                {
+                    bytes[n++] = (char)(0xe0 | (c >> 12));
+                    bytes[n++] = (char)(0x80 | ((c >> 6) & 0x3f));
+                    bytes[n++] = (char)(0x80 | (c & 0x3f));
+                }
+                else
+                {
+                    bytes[n++] = (char)(0xf0 | (c >> 18));
+                    bytes[n++] = (char)(0x80 | ((c >> 12) & 0x3f));
+                    bytes[n++] = (char)(0x80 | ((c >> 6) & 0x3f));
+                    bytes[n++] = (char)(0x80 | (c & 0x3f));
+                }
+                for (s32 i = 0; i < n && length < size; ++i)
+                    out[length++] = bytes[i];
+            }
+            return length;
+        }
+
+    } // namespace njson
+} // namespace ncore
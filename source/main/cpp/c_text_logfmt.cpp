@@ -0,0 +1,279 @@
+#include "ccore/c_target.h"
+#include "cbase/c_buffer.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_runes.h"
+
+#include "ctext/c_text_logfmt.h"
+#include "ctext/c_text_scan.h"
+
+namespace ncore
+{
+    namespace nlogfmt
+    {
+        static const u32 cNone     = 0xffffffff;
+        static const u32 cMinSlots = 16;
+        static const u32 cMaxSlots = 32768;
+        static const u32 cSeeds    = 1024; // seeds tried per table size
+
+        static u32 hash(u8 const* key, u32 length, u32 seed)
+        {
+            u32 h = seed ^ (length * 0x9e3779b1);
+            for (u32 i = 0; i < length; ++i)
+                h = (h ^ key[i]) * 0x01000193;
+            return h ^ (h >> 15);
+        }
+
+        static bool same(u8 const* a, u8 const* b, u32 length)
+        {
+            for (u32 i = 0; i < length; ++i)
+            {
+                if (a[i] != b[i])
+                    return false;
+            }
+            return true;
+        }
+
+        // The largest table build() will try, a table of about n*n slots makes a collision free seed likely
+        static u32 max_slots(s32 max_keys)
+        {
+            u32 slots = cMinSlots;
+            while (slots < cMaxSlots && slots < (u32)max_keys * (u32)max_keys)
+                slots <<= 1;
+            return slots;
+        }
+
+        u32 keys_t::required(s32 max_keys)
+        {
+            if (max_keys <= 0 || max_keys > (s32)(cMaxSlots / 2))
+                return 0;
+            return (u32)max_keys * (u32)sizeof(key_t) + max_slots(max_keys) * (u32)sizeof(s16) + (u32)sizeof(void*);
+        }
+
+        keys_t::keys_t(buffer_t memory) : m_memory(nullptr), m_size(0), m_keys(nullptr), m_slots(nullptr), m_mask(0), m_seed(0), m_count(0)
+        {
+            u8* const begin = nscan::align_ptr(memory.m_begin);
+            if (begin < memory.m_end)
+            {
+                m_memory = begin;
+                m_size   = (u32)(memory.m_end - begin);
+            }
+        }
+
+        bool keys_t::build(const char** keys, s32 count)
+        {
+            m_count = 0;
+            if (count <= 0 || required(count) == 0 || m_size + (u32)sizeof(void*) < required(count))
+                return false;
+
+            m_keys  = (key_t*)m_memory;
+            m_slots = (s16*)(m_keys + count);
+            for (s32 i = 0; i < count; ++i)
+            {
+                m_keys[i].m_str    = (u8 const*)keys[i];
+                m_keys[i].m_length = ascii::make_crunes(keys[i]).m_end;
+            }
+
+            // Start with a small table for the cache, grow it when no seed gives every key a slot of its own
+            u32 const largest = max_slots(count);
+            u32       slots   = cMinSlots;
+            while (slots < largest && slots < (u32)count * 2)
+                slots <<= 1;
+            for (; slots <= largest; slots <<= 1)
+            {
+                for (u32 seed = 1; seed <= cSeeds; ++seed)
+                {
+                    for (u32 s = 0; s < slots; ++s)
+                        m_slots[s] = -1;
+
+                    s32 i = 0;
+                    for (; i < count; ++i)
+                    {
+                        key_t const& key  = m_keys[i];
+                        u32 const    slot = hash(key.m_str, key.m_length, seed) & (slots - 1);
+                        if (m_slots[slot] >= 0)
+                        {
+                            // Equal keys collide under every seed
+                            key_t const& other = m_keys[m_slots[slot]];
+                            if (other.m_length == key.m_length && same(other.m_str, key.m_str, key.m_length))
+                                return false;
+                            break;
+                        }
+                        m_slots[slot] = (s16)i;
+                    }
+                    if (i == count)
+                    {
+                        m_mask  = slots - 1;
+                        m_seed  = seed;
+                        m_count = count;
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        s32 keys_t::find(u8 const* key, u32 length) const
+        {
+            if (m_count == 0)
+                return -1;
+            s32 const index = m_slots[hash(key, length, m_seed) & m_mask];
+            if (index < 0 || m_keys[index].m_length != length || !same(m_keys[index].m_str, key, length))
+                return -1;
+            return index;
+        }
+
+        // The pair of the token from 'begin' up to 'stop', 'equal' is the cursor of its first '=' or cNone
+        static void set_pair(pair_t& pair, u8 const* base, u32 begin, u32 equal, u32 stop)
+        {
+            pair.m_key_begin   = begin;
+            pair.m_key_end     = (equal != cNone) ? equal : stop;
+            pair.m_value_begin = (equal != cNone) ? equal + 1 : stop;
+            pair.m_value_end   = stop;
+            pair.m_quoted      = 0;
+            if ((pair.m_value_end - pair.m_value_begin) >= 2 && base[pair.m_value_begin] == '"' && base[pair.m_value_end - 1] == '"')
+            {
+                pair.m_value_begin += 1;
+                pair.m_value_end -= 1;
+                pair.m_quoted = 1;
+            }
+        }
+
+        // Cuts the line into tokens at the spaces outside quotes, 'visitor.pair(begin, equal, stop)' is called for
+        // every token and stops the scan when it returns false
+        template <typename visitor_t> static void scan(crunes_t const& line, visitor_t& visitor)
+        {
+            if (line.m_type != ascii::TYPE && line.m_type != utf8::TYPE)
+                return;
+
+            u8 const* base = (u8 const*)line.m_ascii;
+            u32       end  = line.m_end;
+            while (end > line.m_str && (base[end - 1] == '\n' || base[end - 1] == '\r'))
+                end -= 1;
+
+            static const u8 chars[4] = {(u8)'=', (u8)' ', (u8)'"', (u8)'\\'};
+
+            u32 token  = line.m_str; // cursor where the current token starts
+            u32 equal  = cNone;      // cursor of the first '=' of the current token
+            u64 inside = 0;          // all ones when the previous block ended inside quotes
+            u64 carry  = 0;          // the first byte of this block is escaped
+            for (u32 pos = line.m_str; pos < end; pos += 64)
+            {
+                // The last block is copied and padded, bytes beyond the line do not count
+                u8        tail[64];
+                u64       valid;
+                u8 const* block = nscan::block64(base + pos, base + end, tail, valid);
+
+                u64 masks[4];
+                nscan::match64(block, chars, 4, masks);
+                u64 const escaped   = nscan::escaped64(masks[3] & valid, carry);
+                u64 const in_quotes = nscan::prefix_xor(masks[2] & ~escaped & valid) ^ inside;
+                inside              = (u64)((s64)in_quotes >> 63);
+                u64 structural      = (masks[0] | masks[1]) & ~in_quotes & valid;
+
+                while (structural != 0)
+                {
+                    u32 const at = pos + (u32)nscan::lowest_bit64(structural);
+                    structural &= structural - 1;
+
+                    if (base[at] == '=')
+                    {
+                        if (equal == cNone)
+                            equal = at;
+                        continue;
+                    }
+                    if (at > token && !visitor.pair(base, token, equal, at))
+                        return;
+                    token = at + 1;
+                    equal = cNone;
+                }
+            }
+            if (end > token)
+                visitor.pair(base, token, equal, end);
+        }
+
+        struct tokenize_t
+        {
+            pair_t* m_pairs;
+            s32     m_max;
+            s32     m_count;
+
+            bool pair(u8 const* base, u32 begin, u32 equal, u32 stop)
+            {
+                set_pair(m_pairs[m_count++], base, begin, equal, stop);
+                return m_count < m_max;
+            }
+        };
+
+        s32 tokenize(crunes_t const& line, pair_t* pairs, s32 max_pairs)
+        {
+            if (max_pairs <= 0)
+                return 0;
+            tokenize_t visitor = {pairs, max_pairs, 0};
+            scan(line, visitor);
+            return visitor.m_count;
+        }
+
+        // Only the tokens with a wanted key become pairs, the first occurrence of a key wins
+        struct extract_t
+        {
+            keys_t const* m_keys;
+            pair_t*       m_values;
+            s32           m_found;
+
+            bool pair(u8 const* base, u32 begin, u32 equal, u32 stop)
+            {
+                u32 const key_end = (equal != cNone) ? equal : stop;
+                s32 const index   = m_keys->find(base + begin, key_end - begin);
+                if (index >= 0 && m_values[index].m_key_begin == m_values[index].m_key_end)
+                {
+                    set_pair(m_values[index], base, begin, equal, stop);
+                    m_found += 1;
+                }
+                return m_found < m_keys->count();
+            }
+        };
+
+        s32 extract(crunes_t const& line, keys_t const& keys, pair_t* values)
+        {
+            for (s32 i = 0; i < keys.count(); ++i)
+            {
+                pair_t& value       = values[i];
+                value.m_key_begin   = line.m_str;
+                value.m_key_end     = line.m_str;
+                value.m_value_begin = line.m_str;
+                value.m_value_end   = line.m_str;
+                value.m_quoted      = 0;
+            }
+            if (keys.count() == 0)
+                return 0;
+            extract_t visitor = {&keys, values, 0};
+            scan(line, visitor);
+            return visitor.m_found;
+        }
+
+        s32 unescape(crunes_t const& value, char* out, s32 size)
+        {
+            u8 const* str    = (u8 const*)value.m_ascii + value.m_str;
+            u8 const* end    = (u8 const*)value.m_ascii + value.m_end;
+            s32       length = 0;
+            while (str < end && length < size)
+            {
+                u8 c = *str++;
+                if (c == '\\' && str < end)
+                {
+                    c = *str++;
+                    switch (c)
+                    {
+                        case 'n': c = '\n'; break;
+                        case 't': c = '\t'; break;
+                        case 'r': c = '\r'; break;
+                        default: break;
+                    }
+                }
+                out[length++] = (char)c;
+            }
+            return length;
+        }
+
+    } // namespace nlogfmt
+} // namespace ncore
@@ -0,0 +1,423 @@
+#include "ccore/c_target.h"
+#include "cbase/c_buffer.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_runes.h"
+
+#include "ctext/c_text_pipeline.h"
+#include "ctext/c_text_scan.h"
+#include "ctext/private/c_text_queue.h"
+
+#include <atomic>
+#include <new>
+#include <thread>
+
+namespace ncore
+{
+    namespace npipeline
+    {
+        void backoff(s32& spins)
+        {
+            if (spins < 10)
+            {
+                for (s32 i = 0, n = 1 << spins; i < n; ++i)
+                    std::atomic_signal_fence(std::memory_order_seq_cst);
+                spins += 1;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        void parse_worker_t::parse(batch_t& batch)
+        {
+            for (s32 i = 0; i < batch.m_count; ++i)
+            {
+                nrunes::reader_t reader(batch.m_lines[i]);
+                batch.m_results[i] = parser2::parser_t::parse(m_program, reader) ? 1 : 0;
+            }
+        }
+
+        static const u64 cReading = ~(u64)0;
+
+        // Shared by the threads of a run
+        struct state_t
+        {
+            spsc_queue_t     m_free;    // sink -> reader, batches that can be filled
+            mpmc_queue_t     m_work;    // reader -> workers
+            mpmc_queue_t     m_done;    // workers -> sink
+            s64              m_lines;   // written by the reader before m_batches
+            std::atomic<u64> m_batches; // number of batches once the reader is done, cReading until then
+        };
+
+        static u32 align(u32 size) { return (size + (cCacheLine - 1)) & ~(cCacheLine - 1); }
+
+        static u32 batches_in_flight(s32 workers, config_t const& config)
+        {
+            u32 const wanted = (config.m_batches > 0) ? (u32)config.m_batches : (u32)workers * 4;
+            u32       count  = 2;
+            while (count < wanted)
+                count <<= 1;
+            return count;
+        }
+
+        static u32 batch_size(config_t const& config)
+        {
+            u32 const lines = (u32)config.m_batch_lines;
+            return align(sizeof(batch_t)) + align(lines * sizeof(crunes_t)) + align(lines * sizeof(s32)) + align(lines * sizeof(text_stream_t::segment_t*));
+        }
+
+        u32 pipeline_t::required(s32 workers, config_t const& config)
+        {
+            u32 const batches = batches_in_flight(workers, config);
+            u32       size    = cCacheLine; // aligning the start of the memory
+            size += align(sizeof(state_t));
+            size += align((u32)workers * sizeof(std::thread));
+            size += batches * batch_size(config);
+            size += align(spsc_queue_t::required(batches));
+            size += align(mpmc_queue_t::required(batches)) * 2;
+            size += align(batches * sizeof(batch_t*)); // the batches that wait for their turn at the sink
+            return size;
+        }
+
+        pipeline_t::pipeline_t(buffer_t memory, config_t const& config) : m_memory(memory), m_config(config)
+        {
+            if (m_config.m_batch_lines <= 0)
+                m_config.m_batch_lines = 1;
+        }
+
+        static void read_batches(state_t* state, text_stream_t* stream, s32 batch_lines)
+        {
+            u64 index = 0;
+            s64 lines = 0;
+            while (true)
+            {
+                void* item;
+                s32   spins = 0;
+                while (!state->m_free.pop(item))
+                    backoff(spins);
+
+                batch_t* batch = (batch_t*)item;
+                s32      count = 0;
+                while (count < batch_lines && stream->readLine(batch->m_lines[count], batch->m_segments[count]))
+                    count += 1;
+                if (count == 0)
+                    break;
+
+                // The batch belongs to the workers and the sink once it is pushed
+                batch->m_index = index;
+                batch->m_count = count;
+                while (!state->m_work.push(batch))
+                    backoff(spins);
+                index += 1;
+                lines += count;
+                if (count < batch_lines)
+                    break;
+            }
+            state->m_lines = lines;
+            state->m_batches.store(index, std::memory_order_release);
+        }
+
+        static void parse_batches(state_t* state, worker_t* worker)
+        {
+            s32 spins = 0;
+            while (true)
+            {
+                // Read before the queue: when the reader is done and the queue is empty, there is no more work
+                bool const finished = state->m_batches.load(std::memory_order_acquire) != cReading;
+
+                void* item;
+                if (state->m_work.pop(item))
+                {
+                    worker->parse(*(batch_t*)item);
+                    while (!state->m_done.push(item))
+                        backoff(spins);
+                    spins = 0;
+                }
+                else if (finished)
+                {
+                    break;
+                }
+                else
+                {
+                    backoff(spins);
+                }
+            }
+        }
+
+        s64 pipeline_t::run(text_stream_t& stream, worker_t** workers, s32 num_workers, sink_t& sink)
+        {
+            if (num_workers <= 0 || (u32)(m_memory.m_end - m_memory.m_begin) < required(num_workers, m_config))
+                return -1;
+
+            u32 const batches     = batches_in_flight(num_workers, m_config);
+            u32 const batch_lines = (u32)m_config.m_batch_lines;
+
+            u8* cursor = (u8*)(((ptr_t)m_memory.m_begin + (cCacheLine - 1)) & ~((ptr_t)cCacheLine - 1));
+
+            state_t* state = new (cursor) state_t();
+            cursor += align(sizeof(state_t));
+            std::thread* threads = (std::thread*)cursor;
+            cursor += align((u32)num_workers * sizeof(std::thread));
+
+            void* free_items = cursor;
+            cursor += align(spsc_queue_t::required(batches));
+            void* work_cells = cursor;
+            cursor += align(mpmc_queue_t::required(batches));
+            void* done_cells = cursor;
+            cursor += align(mpmc_queue_t::required(batches));
+            batch_t** slots = (batch_t**)cursor;
+            cursor += align(batches * sizeof(batch_t*));
+
+            state->m_free.initialize(free_items, batches);
+            state->m_work.initialize(work_cells, batches);
+            state->m_done.initialize(done_cells, batches);
+            state->m_lines = 0;
+            state->m_batches.store(cReading, std::memory_order_relaxed);
+
+            for (u32 i = 0; i < batches; ++i)
+            {
+                batch_t* batch = (batch_t*)cursor;
+                cursor += align(sizeof(batch_t));
+                batch->m_index = 0;
+                batch->m_count = 0;
+                batch->m_lines = (crunes_t*)cursor;
+                cursor += align(batch_lines * sizeof(crunes_t));
+                batch->m_results = (s32*)cursor;
+                cursor += align(batch_lines * sizeof(s32));
+                batch->m_segments = (text_stream_t::segment_t**)cursor;
+                cursor += align(batch_lines * sizeof(text_stream_t::segment_t*));
+                for (u32 j = 0; j < batch_lines; ++j)
+                    new (&batch->m_lines[j]) crunes_t();
+                slots[i] = nullptr;
+                state->m_free.push(batch);
+            }
+
+            for (s32 i = 0; i < num_workers; ++i)
+                new (&threads[i]) std::thread(parse_batches, state, workers[i]);
+            std::thread reader(read_batches, state, &stream, (s32)batch_lines);
+
+            // The sink, batches that arrive early wait in their slot, there are never more than 'batches' in flight
+            u64 const mask  = batches - 1;
+            u64       next  = 0;
+            s32       spins = 0;
+            while (next != state->m_batches.load(std::memory_order_acquire))
+            {
+                bool  progress = false;
+                void* item;
+                while (state->m_done.pop(item))
+                {
+                    batch_t* batch                = (batch_t*)item;
+                    slots[batch->m_index & mask] = batch;
+                    progress                      = true;
+                }
+
+                batch_t* batch;
+                while ((batch = slots[next & mask]) != nullptr && batch->m_index == next)
+                {
+                    slots[next & mask] = nullptr;
+                    sink.consume(*batch);
+                    for (s32 i = 0; i < batch->m_count; ++i)
+                        text_stream_t::release(batch->m_segments[i]);
+                    batch->m_count = 0;
+                    state->m_free.push(batch);
+                    next += 1;
+                    progress = true;
+                }
+
+                if (progress)
+                    spins = 0;
+                else
+                    backoff(spins);
+            }
+
+            reader.join();
+            for (s32 i = 0; i < num_workers; ++i)
+            {
+                threads[i].join();
+                threads[i].~thread();
+            }
+
+            s64 const lines = state->m_lines;
+            state->~state_t();
+            return lines;
+        }
+
+
+        void find_worker_t::parse(crunes_t const& chunk)
+        {
+            nrunes::reader_t reader(chunk);
+            nrunes::reader_t matches[32];
+            while (true)
+            {
+                s32 const n = parser2::parser_t::findAll(m_program, reader, matches, 32);
+                m_matches += n;
+                if (n < 32)
+                    break;
+            }
+        }
+
+        // A deque holds at most the halves of one split per level, 64 is more than a text of 4 GB needs
+        static const u32 cDequeCapacity = 64;
+
+        struct worker_state_t
+        {
+            deque_t m_deque;
+            s64     m_tasks;
+            s64     m_steals;
+        };
+
+        struct scheduler_state_t
+        {
+            crunes_t         m_text;
+            u32              m_task_size;
+            s32              m_workers;
+            chunk_worker_t** m_chunk_workers;
+            worker_state_t*  m_states;  // [m_workers]
+            std::atomic<s64> m_pending; // tasks that have been pushed and not parsed yet
+        };
+
+        static inline u64 make_task(u32 begin, u32 end) { return ((u64)begin << 32) | end; }
+
+        // Cursor of the start of the line after the one at 'cursor', the end of the text when there is none or when
+        // the text cannot be split
+        static u32 line_after(crunes_t const& text, u32 cursor)
+        {
+            if (text.m_type != ascii::TYPE && text.m_type != utf8::TYPE)
+                return text.m_end;
+            u8 const* base = (u8 const*)text.m_ascii;
+            u8 const* eol  = nscan::find_byte(base + cursor, base + text.m_end, '\n');
+            return (eol < base + text.m_end) ? (u32)(eol - base) + 1 : text.m_end;
+        }
+
+        static void run_tasks(scheduler_state_t* state, s32 index)
+        {
+            worker_state_t& self   = state->m_states[index];
+            chunk_worker_t* worker = state->m_chunk_workers[index];
+            u32             random = (u32)index * 2654435761u + 1;
+            s32             spins  = 0;
+            while (true)
+            {
+                u64 task;
+                if (!self.m_deque.pop(task))
+                {
+                    bool stolen = false;
+                    for (s32 attempt = 0; attempt < state->m_workers * 2 && !stolen; ++attempt)
+                    {
+                        random ^= random << 13;
+                        random ^= random >> 17;
+                        random ^= random << 5;
+                        s32 const victim = (s32)(random % (u32)state->m_workers);
+                        stolen           = victim != index && state->m_states[victim].m_deque.steal(task);
+                    }
+                    if (!stolen)
+                    {
+                        if (state->m_pending.load(std::memory_order_acquire) == 0)
+                            break;
+                        backoff(spins);
+                        continue;
+                    }
+                    self.m_steals += 1;
+                }
+                spins = 0;
+
+                // Keep the second halves for this worker or a thief, parse the first
+                u32 const begin = (u32)(task >> 32);
+                u32       end   = (u32)task;
+                while ((end - begin) > state->m_task_size)
+                {
+                    u32 const mid = line_after(state->m_text, begin + (end - begin) / 2);
+                    if (mid >= end)
+                        break;
+                    state->m_pending.fetch_add(1, std::memory_order_relaxed);
+                    if (!self.m_deque.push(make_task(mid, end)))
+                    {
+                        state->m_pending.fetch_sub(1, std::memory_order_relaxed);
+                        break;
+                    }
+                    end = mid;
+                }
+
+                crunes_t chunk = state->m_text;
+                chunk.m_str    = begin;
+                chunk.m_end    = end;
+                worker->parse(chunk);
+                self.m_tasks += 1;
+                state->m_pending.fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        scheduler_t::scheduler_t(buffer_t memory) : m_memory(memory), m_steals(0) {}
+
+        u32 scheduler_t::required(s32 workers)
+        {
+            u32 size = cCacheLine; // aligning the start of the memory
+            size += align(sizeof(scheduler_state_t));
+            size += align((u32)workers * sizeof(std::thread));
+            size += (u32)workers * (align(sizeof(worker_state_t)) + align(deque_t::required(cDequeCapacity)));
+            return size;
+        }
+
+        s64 scheduler_t::run(crunes_t const& text, chunk_worker_t** workers, s32 num_workers, u32 task_size)
+        {
+            m_steals = 0;
+            if (num_workers <= 0 || (u32)(m_memory.m_end - m_memory.m_begin) < required(num_workers))
+                return -1;
+
+            u8* cursor = (u8*)(((ptr_t)m_memory.m_begin + (cCacheLine - 1)) & ~((ptr_t)cCacheLine - 1));
+
+            scheduler_state_t* state = new (cursor) scheduler_state_t();
+            cursor += align(sizeof(scheduler_state_t));
+            std::thread* threads = (std::thread*)cursor;
+            cursor += align((u32)num_workers * sizeof(std::thread));
+
+            state->m_text          = text;
+            state->m_task_size     = (task_size > 0) ? task_size : 1;
+            state->m_workers       = num_workers;
+            state->m_chunk_workers = workers;
+            state->m_states        = (worker_state_t*)cursor;
+            state->m_pending.store(0, std::memory_order_relaxed);
+            cursor += (u32)num_workers * align(sizeof(worker_state_t));
+            for (s32 i = 0; i < num_workers; ++i)
+            {
+                worker_state_t* worker = new (&state->m_states[i]) worker_state_t();
+                worker->m_deque.initialize(cursor, cDequeCapacity);
+                worker->m_tasks  = 0;
+                worker->m_steals = 0;
+                cursor += align(deque_t::required(cDequeCapacity));
+            }
+
+            // Every worker starts with an equal part of the text, cut at line ends
+            u32 const size  = text.m_end - text.m_str;
+            u32       begin = text.m_str;
+            for (s32 i = 0; i < num_workers && begin < text.m_end; ++i)
+            {
+                u32 const end = (i == (num_workers - 1)) ? text.m_end : line_after(text, text.m_str + (u32)(((u64)size * (u64)(i + 1)) / (u64)num_workers));
+                if (end <= begin)
+                    continue;
+                state->m_pending.fetch_add(1, std::memory_order_relaxed);
+                state->m_states[i].m_deque.push(make_task(begin, end));
+                begin = end;
+            }
+
+            for (s32 i = 1; i < num_workers; ++i)
+                new (&threads[i]) std::thread(run_tasks, state, i);
+            run_tasks(state, 0);
+
+            s64 tasks = state->m_states[0].m_tasks;
+            m_steals  = state->m_states[0].m_steals;
+            for (s32 i = 1; i < num_workers; ++i)
+            {
+                threads[i].join();
+                threads[i].~thread();
+                tasks += state->m_states[i].m_tasks;
+                m_steals += state->m_states[i].m_steals;
+            }
+            for (s32 i = 0; i < num_workers; ++i)
+                state->m_states[i].~worker_state_t();
+            state->~scheduler_state_t();
+            return tasks;
+        }
+
+    } // namespace npipeline
+} // namespace ncore
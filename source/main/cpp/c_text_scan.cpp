@@ -0,0 +1,338 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+
+#include "ctext/c_text_scan.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define CTEXT_SCAN_SSE2
+#    include <emmintrin.h>
+#endif
+#if defined(__PCLMUL__)
+#    define CTEXT_SCAN_CLMUL
+#    include <wmmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#    include <intrin.h>
+#endif
+
+namespace ncore
+{
+    namespace nscan
+    {
+        static inline s32 lowest_bit(u32 mask)
+        {
+            s32 i = 0;
+            while ((mask & 1) == 0)
+            {
+                mask >>= 1;
+                i += 1;
+            }
+            return i;
+        }
+
+        void byteset_t::set(u8 from, u8 to)
+        {
+            for (u32 b = from; b <= to; ++b)
+                set((u8)b);
+        }
+
+        s32 byteset_t::count() const
+        {
+            s32 n = 0;
+            for (s32 i = 0; i < 4; ++i)
+            {
+                u64 w = m_bits[i];
+                while (w != 0)
+                {
+                    w &= w - 1;
+                    n += 1;
+                }
+            }
+            return n;
+        }
+
+        s32 byteset_t::first() const
+        {
+            for (s32 b = 0; b < 256; ++b)
+            {
+                if (has((u8)b))
+                    return b;
+            }
+            return -1;
+        }
+
+        // SWAR helpers, a byte in 'w' that is zero will have its high bit set in the result.
+        // Only the lowest flagged byte is exact, so callers re-scan the word byte by byte.
+        static const u64 cOnes  = 0x0101010101010101UL;
+        static const u64 cHighs = 0x8080808080808080UL;
+        static inline u64 has_zero(u64 w) { return (w - cOnes) & ~w & cHighs; }
+
+        u8 const* find_byte(u8 const* str, u8 const* end, u8 c)
+        {
+#if defined(CTEXT_SCAN_SSE2)
+            __m128i const pattern = _mm_set1_epi8((char)c);
+            while ((str + 16) <= end)
+            {
+                __m128i const block = _mm_loadu_si128((__m128i const*)str);
+                u32 const     mask  = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern));
+                if (mask != 0)
+                    return str + lowest_bit(mask);
+                str += 16;
+            }
+#else
+            while (str < end && ((ptr_t)str & 7) != 0)
+            {
+                if (*str == c)
+                    return str;
+                ++str;
+            }
+            u64 const pattern = cOnes * c;
+            while ((str + 8) <= end)
+            {
+                if (has_zero(*(u64 const*)str ^ pattern) != 0)
+                    break;
+                str += 8;
+            }
+#endif
+            while (str < end)
+            {
+                if (*str == c)
+                    return str;
+                ++str;
+            }
+            return end;
+        }
+
+        u8 const* find_byte2(u8 const* str, u8 const* end, u8 c1, u8 c2)
+        {
+#if defined(CTEXT_SCAN_SSE2)
+            __m128i const pattern1 = _mm_set1_epi8((char)c1);
+            __m128i const pattern2 = _mm_set1_epi8((char)c2);
+            while ((str + 16) <= end)
+            {
+                __m128i const block = _mm_loadu_si128((__m128i const*)str);
+                u32 const     mask  = (u32)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, pattern1), _mm_cmpeq_epi8(block, pattern2)));
+                if (mask != 0)
+                    return str + lowest_bit(mask);
+                str += 16;
+            }
+#else
+            while (str < end && ((ptr_t)str & 7) != 0)
+            {
+                if (*str == c1 || *str == c2)
+                    return str;
+                ++str;
+            }
+            u64 const pattern1 = cOnes * c1;
+            u64 const pattern2 = cOnes * c2;
+            while ((str + 8) <= end)
+            {
+                u64 const w = *(u64 const*)str;
+                if ((has_zero(w ^ pattern1) | has_zero(w ^ pattern2)) != 0)
+                    break;
+                str += 8;
+            }
+#endif
+            while (str < end)
+            {
+                if (*str == c1 || *str == c2)
+                    return str;
+                ++str;
+            }
+            return end;
+        }
+
+        u8 const* find_in_set(u8 const* str, u8 const* end, byteset_t const& set)
+        {
+            // Unrolled table lookup, the set is small enough to stay in L1
+            while ((str + 4) <= end)
+            {
+                if (set.has(str[0]))
+                    return str;
+                if (set.has(str[1]))
+                    return str + 1;
+                if (set.has(str[2]))
+                    return str + 2;
+                if (set.has(str[3]))
+                    return str + 3;
+                str += 4;
+            }
+            while (str < end)
+            {
+                if (set.has(*str))
+                    return str;
+                ++str;
+            }
+            return end;
+        }
+
+        void match64(u8 const* block, u8 const* chars, s32 count, u64* masks)
+        {
+#if defined(CTEXT_SCAN_SSE2)
+            __m128i const b0 = _mm_loadu_si128((__m128i const*)(block + 0));
+            __m128i const b1 = _mm_loadu_si128((__m128i const*)(block + 16));
+            __m128i const b2 = _mm_loadu_si128((__m128i const*)(block + 32));
+            __m128i const b3 = _mm_loadu_si128((__m128i const*)(block + 48));
+            for (s32 j = 0; j < count; ++j)
+            {
+                __m128i const pattern = _mm_set1_epi8((char)chars[j]);
+                u64 const     m0      = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(b0, pattern));
+                u64 const     m1      = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(b1, pattern));
+                u64 const     m2      = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(b2, pattern));
+                u64 const     m3      = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(b3, pattern));
+                masks[j]              = m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+            }
+#else
+            for (s32 j = 0; j < count; ++j)
+                masks[j] = 0;
+            for (s32 i = 0; i < 64; ++i)
+            {
+                u8 const b = block[i];
+                for (s32 j = 0; j < count; ++j)
+                    masks[j] |= (u64)(b == chars[j]) << i;
+            }
+#endif
+        }
+
+        u8 const* block64(u8 const* str, u8 const* end, u8* tail, u64& valid)
+        {
+            if ((end - str) >= 64)
+            {
+                valid = ~(u64)0;
+                return str;
+            }
+            u32 const n = (u32)(end - str);
+            for (u32 i = 0; i < 64; ++i)
+                tail[i] = (i < n) ? str[i] : 0;
+            valid = ((u64)1 << n) - 1;
+            return tail;
+        }
+
+        u64 prefix_xor(u64 mask)
+        {
+#if defined(CTEXT_SCAN_CLMUL)
+            __m128i const all = _mm_set1_epi8((char)0xff);
+            __m128i const m   = _mm_set_epi64x(0, (long long)mask);
+            return (u64)_mm_cvtsi128_si64(_mm_clmulepi64_si128(m, all, 0));
+#else
+            mask ^= mask << 1;
+            mask ^= mask << 2;
+            mask ^= mask << 4;
+            mask ^= mask << 8;
+            mask ^= mask << 16;
+            mask ^= mask << 32;
+            return mask;
+#endif
+        }
+
+        u64 escaped64(u64 backslashes, u64& carry)
+        {
+            // Runs of backslashes that start on an odd index escape the even bytes after them, and the other way
+            // around, adding the starts of the odd runs to the runs flips the parity of where each run ends
+            static const u64 cEvenBits = 0x5555555555555555UL;
+
+            backslashes &= ~carry;
+            u64 const follows    = (backslashes << 1) | carry;
+            u64 const odd_starts = backslashes & ~cEvenBits & ~follows;
+            u64 const sum        = odd_starts + backslashes;
+            carry                = (sum < odd_starts) ? 1 : 0;
+            u64 const invert     = sum << 1;
+            return (cEvenBits ^ invert) & follows;
+        }
+
+        bool validate_utf8(u8 const* str, u8 const* end, bool& ascii)
+        {
+            ascii = true;
+            while (str < end)
+            {
+                // Skip ahead to the next byte that is not ASCII
+#if defined(CTEXT_SCAN_SSE2)
+                while ((str + 16) <= end)
+                {
+                    u32 const mask = (u32)_mm_movemask_epi8(_mm_loadu_si128((__m128i const*)str));
+                    if (mask != 0)
+                    {
+                        str += lowest_bit(mask);
+                        break;
+                    }
+                    str += 16;
+                }
+#else
+                while (str < end && ((ptr_t)str & 7) != 0 && *str < 0x80)
+                    ++str;
+                while ((str + 8) <= end && ((ptr_t)str & 7) == 0 && (*(u64 const*)str & cHighs) == 0)
+                    str += 8;
+#endif
+                while (str < end && *str < 0x80)
+                    ++str;
+                if (str == end)
+                    break;
+
+                // The length of the sequence and the range of its second byte, the ranges exclude overlong
+                // encodings, surrogates and code points above U+10FFFF
+                ascii       = false;
+                u8 const c  = *str;
+                s32      n  = 0;
+                u8       lo = 0x80;
+                u8       hi = 0xbf;
+                if (c >= 0xc2 && c <= 0xdf)
+                    n = 2;
+                else if (c >= 0xe0 && c <= 0xef)
+                {
+                    n  = 3;
+                    lo = (c == 0xe0) ? 0xa0 : lo;
+                    hi = (c == 0xed) ? 0x9f : hi;
+                }
+                else if (c >= 0xf0 && c <= 0xf4)
+                {
+                    n  = 4;
+                    lo = (c == 0xf0) ? 0x90 : lo;
+                    hi = (c == 0xf4) ? 0x8f : hi;
+                }
+                else
+                    return false;
+
+                for (s32 i = 1; i < n; ++i)
+                {
+                    if ((str + i) == end)
+                        return true;
+                    u8 const b = str[i];
+                    if ((i == 1) ? (b < lo || b > hi) : ((b & 0xc0) != 0x80))
+                        return false;
+                }
+                str += n;
+            }
+            return true;
+        }
+
+        u32 utf8_incomplete(u8 const* str, u8 const* end)
+        {
+            // Step back over the continuation bytes (at most 3) to the byte that leads the last sequence
+            u8 const* lead = end;
+            while (lead > str && (end - lead) < 3 && (lead[-1] & 0xc0) == 0x80)
+                --lead;
+            if (lead == str || lead[-1] < 0xc0)
+                return 0;
+            --lead;
+            u8 const  c    = *lead;
+            u32 const n    = (c >= 0xf0) ? 4 : ((c >= 0xe0) ? 3 : 2);
+            u32 const have = (u32)(end - lead);
+            return (have < n) ? have : 0;
+        }
+
+#if !defined(__GNUC__) && !defined(__clang__)
+        s32 lowest_bit64(u64 mask)
+        {
+#    if defined(_MSC_VER) && defined(_M_X64)
+            unsigned long index;
+            _BitScanForward64(&index, mask);
+            return (s32)index;
+#    else
+            u32 const low = (u32)mask;
+            return (low != 0) ? lowest_bit(low) : 32 + lowest_bit((u32)(mask >> 32));
+#    endif
+        }
+#endif
+
+    } // namespace nscan
+} // namespace ncore
@@ -5,143 +5,391 @@
 #include "ccore/c_debug.h"
 #include "cbase/c_runes.h"
 
+#include "ctext/c_text_scan.h"
 #include "ctext/c_text_stream.h"
 
+#include <atomic>
+#include <new>
+
+#if defined(CTEXT_TEXT_STREAM_STATS)
+#    include <chrono>
+#endif
+
 namespace ncore
 {
-    text_stream_t::text_stream_t(istream_t* stream, encoding e) : m_stream(stream), m_stream_len(0), m_stream_pos(0), m_buffer_data(nullptr), m_buffer_data0(nullptr), m_buffer_size(0), m_buffer_text()
+#if defined(CTEXT_TEXT_STREAM_STATS)
+    static u64 now_ns() { return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+#endif
+
+    text_stream_t::text_stream_t(istream_t* stream, encoding e, alloc_t* allocator, u32 buffer_size) : m_stream(stream), m_allocator(allocator), m_stream_len(0), m_stream_pos(0), m_ascii_pos(0), m_buffer_data(nullptr), m_segment(nullptr), m_pool(nullptr), m_buffer_data0(nullptr), m_buffer_size(0), m_buffer_text(), m_encoding((u8)e), m_ascii(e == encoding_ascii), m_utf8(e == encoding_ascii || e == encoding_utf8)
     {
-        m_buffer_cap = 4096; // Should be somewhere like "average line length" * 10
+        if (m_allocator == nullptr)
+            m_allocator = context_t::system_alloc();
+        m_buffer_cap         = buffer_size; // Should be somewhere like "average line length" * 10
         m_buffer_text.m_type = (u8)e;
+        reset_stats();
     }
 
-    static u32 find_eol(crunes_t& text)
+    // The header of a buffer, the data follows it
+    struct text_stream_t::segment_t
     {
-        u32     cursor = 0;
-        uchar32 c      = nrunes::read(text, cursor);
-        while (c != cEOL && c != cEOF && c != cEOS)
+        std::atomic<s32>               m_refs;
+        alloc_t*                       m_allocator;
+        text_stream_t::segment_pool_t* m_pool; // where the last release puts the segment, null to free it
+        segment_t*                     m_next; // in the free list of the pool
+        u32                            m_size; // bytes of data
+    };
+
+    // The released segments of a stream. Any thread pushes (the last release of a segment), only the stream pops,
+    // so the list needs no protection against ABA. The list never holds more segments than were in use at the same
+    // time, which the reader bounds by the number of lines it keeps in flight. The pool is referenced by the stream
+    // and by the segments that are in use, the last of them frees the segments on the list and the pool.
+    struct text_stream_t::segment_pool_t
+    {
+        std::atomic<segment_t*> m_free;
+        std::atomic<s32>        m_refs;
+        alloc_t*                m_allocator;
+    };
+
+    static const u32 cSegmentHeader = (u32)((sizeof(text_stream_t::segment_t) + sizeof(void*) - 1) & ~(sizeof(void*) - 1));
+
+    static text_stream_t::segment_t* new_segment(alloc_t* allocator, u32 size)
+    {
+        void*                     mem     = allocator->allocate(cSegmentHeader + size, sizeof(void*));
+        text_stream_t::segment_t* segment = new (mem) text_stream_t::segment_t();
+        segment->m_refs.store(1, std::memory_order_relaxed);
+        segment->m_allocator = allocator;
+        segment->m_pool      = nullptr;
+        segment->m_next      = nullptr;
+        segment->m_size      = size;
+        return segment;
+    }
+
+    static void free_segment(text_stream_t::segment_t* segment)
+    {
+        alloc_t* allocator = segment->m_allocator;
+        segment->~segment_t();
+        allocator->deallocate(segment);
+    }
+
+    static inline u8* segment_data(text_stream_t::segment_t* segment) { return (u8*)segment + cSegmentHeader; }
+
+    static void release_pool(text_stream_t::segment_pool_t* pool)
+    {
+        if (pool->m_refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        text_stream_t::segment_t* segment = pool->m_free.load(std::memory_order_acquire);
+        while (segment != nullptr)
         {
-            c = nrunes::read(text, cursor);
+            text_stream_t::segment_t* next = segment->m_next;
+            free_segment(segment);
+            segment = next;
         }
-        return cursor;
+        alloc_t* allocator = pool->m_allocator;
+        pool->~segment_pool_t();
+        allocator->deallocate(pool);
     }
 
-    bool text_stream_t::grabLine(crunes_t& line)
+    // Take a released segment of at least 'size' bytes from the pool, null when there is none. Called by the
+    // stream only.
+    static text_stream_t::segment_t* take_segment(text_stream_t::segment_pool_t* pool, u32 size)
+    {
+        while (true)
+        {
+            text_stream_t::segment_t* segment = pool->m_free.load(std::memory_order_acquire);
+            while (segment != nullptr && !pool->m_free.compare_exchange_weak(segment, segment->m_next, std::memory_order_acquire, std::memory_order_acquire)) {}
+            if (segment == nullptr)
+                return nullptr;
+            if (segment->m_size < size)
+            {
+                // Released before the buffer had to grow
+                free_segment(segment);
+                continue;
+            }
+            segment->m_refs.store(1, std::memory_order_relaxed);
+            pool->m_refs.fetch_add(1, std::memory_order_relaxed);
+            return segment;
+        }
+    }
+
+    void text_stream_t::retain(segment_t* segment)
     {
-        line.m_ascii = m_buffer_text.m_ascii;
-        line.m_str   = m_buffer_text.m_str;
-        line.m_end   = m_buffer_text.m_end;
-        line.m_eos   = m_buffer_text.m_eos;
+        if (segment != nullptr)
+            segment->m_refs.fetch_add(1, std::memory_order_relaxed);
+    }
 
-        u32 const chars = find_eol(line);
-        if (chars > 0)
+    void text_stream_t::release(segment_t* segment)
+    {
+        if (segment == nullptr || segment->m_refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+
+        segment_pool_t* pool = segment->m_pool;
+        if (pool == nullptr)
         {
-            m_buffer_text.m_str += chars;
-            line.m_end = m_buffer_text.m_str;
-            return true;
+            free_segment(segment);
+            return;
         }
 
-        // Something going wrong
-        line.m_str = m_buffer_text.m_eos;
-        line.m_end = m_buffer_text.m_eos;
-        line.m_eos = m_buffer_text.m_eos;
-        return false;
+        // Back on the free list of the pool
+        segment->m_next = pool->m_free.load(std::memory_order_relaxed);
+        while (!pool->m_free.compare_exchange_weak(segment->m_next, segment, std::memory_order_release, std::memory_order_relaxed)) {}
+        release_pool(pool);
+    }
+
+    // Returns the number of characters of the first line including its end-of-line, 0 when the text does not
+    // hold a complete line (yet)
+    static u32 find_eol(crunes_t const& text)
+    {
+        // The end-of-line is a single byte that is never part of a multi-byte UTF-8 sequence
+        if (text.m_type == ascii::TYPE || text.m_type == utf8::TYPE)
+        {
+            u8 const* str = (u8 const*)text.m_ascii + text.m_str;
+            u8 const* end = (u8 const*)text.m_ascii + text.m_end;
+            u8 const* eol = nscan::find_byte2(str, end, (u8)cEOL, (u8)cEOF);
+            return (eol < end) ? (u32)(eol - str) + 1 : 0;
+        }
+
+        u32 const size   = text.m_end - text.m_str;
+        u32       cursor = 0;
+        while (cursor < size)
+        {
+            uchar32 const c = nrunes::read(text, cursor);
+            if (c == cEOL || c == cEOF)
+                return cursor;
+        }
+        return 0;
+    }
+
+    bool text_stream_t::grabLine(crunes_t& line)
+    {
+#if defined(CTEXT_TEXT_STREAM_STATS)
+        u64 const begin = now_ns();
+        u32 const chars = find_eol(m_buffer_text);
+        m_stats.m_split_ns += now_ns() - begin;
+#else
+        u32 const chars = find_eol(m_buffer_text);
+#endif
+        if (chars == 0)
+            return false;
+
+        line                = m_buffer_text;
+        line.m_end          = m_buffer_text.m_str + chars;
+        m_buffer_text.m_str = line.m_end;
+        return true;
     }
 
     bool text_stream_t::readLine(crunes_t& line)
     {
-        if (!grabLine(line))
+        while (!grabLine(line))
         {
-            if (m_buffer_data == nullptr && m_buffer_data0 == nullptr)
+            if (!more())
             {
-                if (m_stream_pos == 0)
-                {
-                    if (m_stream->canView())
-                    {
-                        s64 read              = m_stream->view(m_buffer_data0, m_buffer_cap);
-                        m_buffer_text.m_ascii = (ascii::pcrune)m_buffer_data0;
-                        m_buffer_text.m_str   = 0;
-                        m_buffer_text.m_eos   = m_buffer_cap;
-                        m_buffer_text.m_end   = (u32)read;
-                        m_stream_pos          = read;
-                        m_stream_len          = m_stream->getLength();
-                    }
-                    else
-                    {
-                        m_buffer_data = (u8*)context_t::system_alloc()->allocate(m_buffer_cap, sizeof(void*));
-                        m_buffer_size = 0;
-                        m_stream_pos  = 0;
-                        m_stream_len  = m_stream->getLength();
-                        m_buffer_size = (u32)m_stream->read(m_buffer_data, m_buffer_cap);
-                        m_stream_pos += m_buffer_size;
-                    }
-                }
+                // The last line of the stream does not have to end with an end-of-line
+                if (m_buffer_text.m_str == m_buffer_text.m_end)
+                    return false;
+                line                = m_buffer_text;
+                m_buffer_text.m_str = m_buffer_text.m_end;
+                break;
             }
-            else
+        }
+#if defined(CTEXT_TEXT_STREAM_STATS)
+        u32 const bytes = line.m_end - line.m_str;
+        m_stats.m_lines += 1;
+        if (bytes > m_stats.m_longest_line)
+            m_stats.m_longest_line = bytes;
+#endif
+        return true;
+    }
+
+    bool text_stream_t::readLine(crunes_t& line, segment_t*& segment)
+    {
+        segment = nullptr;
+        if (!readLine(line))
+            return false;
+        if (m_segment != nullptr && line.m_ascii == (ascii::pcrune)m_buffer_data)
+        {
+            segment = m_segment;
+            retain(segment);
+        }
+        return true;
+    }
+
+    // Extend the buffer with the next part of the stream, the text that has not been consumed is kept in front.
+    // A buffer that is full (a line or record longer than the buffer) is doubled in size.
+    bool text_stream_t::more()
+    {
+        u32 const  rest = m_buffer_text.m_end - m_buffer_text.m_str;
+        bool const grow = rest >= m_buffer_cap;
+        if (grow)
+            m_buffer_cap *= 2;
+
+        if (m_stream->canView())
+        {
+            // View the stream again from the first unconsumed character, nothing is copied
+            s64 const start = m_stream_pos - rest;
+            u8 const* data  = nullptr;
+#if defined(CTEXT_TEXT_STREAM_STATS)
+            u64 const begin = now_ns();
+            m_stream->setPos(start);
+            s64 const read = m_stream->view(data, m_buffer_cap);
+            m_stats.m_stream_ns += now_ns() - begin;
+            m_stats.m_views += 1;
+            m_stats.m_rewinds += (rest > 0) ? 1 : 0;
+#else
+            m_stream->setPos(start);
+            s64 const read = m_stream->view(data, m_buffer_cap);
+#endif
+            if (read <= (s64)rest)
             {
-                // Could not find EOL or EOF or there is no text left to scan
-                if (m_stream->canView())
-                {
-                    s64 const rest = m_buffer_text.m_end - m_buffer_text.m_str;
-                    m_stream_pos   = m_stream->getPos();
-                    m_stream_pos -= rest;
-                    m_stream->setPos(m_stream_pos);
-                    s64 read = m_stream->view(m_buffer_data0, m_buffer_cap);
-                    if (read == 0)
-                    {
-                        m_buffer_text = crunes_t();
-                        m_stream_pos  = m_stream_len;
-                        return false;
-                    }
-                    else
-                    {
-                        m_buffer_size         = 0;
-                        m_buffer_text.m_ascii = (ascii::pcrune)m_buffer_data0;
-                        m_buffer_text.m_str   = 0;
-                        m_buffer_text.m_end   = (u32)read;
-                        m_buffer_text.m_eos   = (u32)read;
-                    }
-                }
-                else
+                validate_end();
+                return false;
+            }
+#if defined(CTEXT_TEXT_STREAM_STATS)
+            m_stats.m_refills += 1;
+            m_stats.m_bytes_read += (u64)(read - rest);
+            m_stats.m_bytes_carried += rest;
+#endif
+
+            m_buffer_data0        = data;
+            m_buffer_text.m_ascii = (ascii::pcrune)data;
+            m_buffer_text.m_str   = 0;
+            m_buffer_text.m_end   = (u32)read;
+            m_buffer_text.m_eos   = (u32)read;
+            m_stream_pos          = start + read;
+            m_stream_len          = m_stream->getLength();
+            validate(rest);
+            return true;
+        }
+
+        // Move the 'rest' to the beginning of our buffer and join it with new data, another buffer is needed when
+        // it has to grow or when lines in it are still referenced
+        segment_t* segment  = m_segment;
+        bool const retained = segment != nullptr && segment->m_refs.load(std::memory_order_acquire) > 1;
+        if (segment == nullptr || grow || retained)
+        {
+            if (retained && m_pool == nullptr)
+            {
+                // Lines are retained, from now on segments are recycled; the pool is referenced by the stream and
+                // by the current segment
+                void* mem = m_allocator->allocate((u32)sizeof(segment_pool_t), sizeof(void*));
+                m_pool    = new (mem) segment_pool_t();
+                m_pool->m_free.store(nullptr, std::memory_order_relaxed);
+                m_pool->m_refs.store(2, std::memory_order_relaxed);
+                m_pool->m_allocator = m_allocator;
+                m_segment->m_pool   = m_pool;
+            }
+            segment = (m_pool != nullptr) ? take_segment(m_pool, m_buffer_cap) : nullptr;
+            if (segment == nullptr)
+            {
+                segment = new_segment(m_allocator, m_buffer_cap);
+                if (m_pool != nullptr)
                 {
-                    // Currently we are at the following position in our text buffer
-
-                    // Move the 'rest' to the beginning of our buffer and join it with new data
-                    ascii::pcrune src = m_buffer_text.m_ascii + m_buffer_text.m_str;
-                    ascii::pcrune end = m_buffer_text.m_ascii + m_buffer_text.m_end;
-                    u8*           dst = (u8*)m_buffer_data;
-                    while (src < end)
-                        *dst++ = *src++;
-
-                    m_buffer_size               = (u32)(dst - m_buffer_data);
-                    s64       read_request_size = m_buffer_cap - m_buffer_size;
-                    s64 const read_actual_size  = m_stream->read(dst, read_request_size);
-                    if (read_actual_size >= 0)
-                    {
-                        m_buffer_size += (u32)read_actual_size;
-                        m_stream_pos += read_actual_size;
-                    }
-                    else
-                    {
-                        // an error occured
-                        m_stream_pos = m_stream_len;
-                    }
-
-                    // Adjust our m_buffer_text
-                    m_buffer_text.m_ascii = (ascii::pcrune)m_buffer_data;
-                    m_buffer_text.m_eos   = m_buffer_size;
-                    m_buffer_text.m_str   = 0;
-                    m_buffer_text.m_end   = m_buffer_size;
+                    segment->m_pool = m_pool;
+                    m_pool->m_refs.fetch_add(1, std::memory_order_relaxed);
                 }
             }
+        }
+        u8* data = segment_data(segment);
 
-            if (!grabLine(line))
-                return false;
+        u8 const* src = (u8 const*)m_buffer_text.m_ascii + m_buffer_text.m_str;
+        u8 const* end = src + rest;
+        u8*       dst = data;
+        while (src < end)
+            *dst++ = *src++;
+
+        if (segment != m_segment)
+        {
+            release(m_segment);
+            m_segment     = segment;
+            m_buffer_data = data;
+            m_stream_len  = m_stream->getLength();
         }
 
+#if defined(CTEXT_TEXT_STREAM_STATS)
+        u64 const begin = now_ns();
+        s64 const read  = m_stream->read(dst, m_buffer_cap - rest);
+        m_stats.m_stream_ns += now_ns() - begin;
+        if (read > 0)
+        {
+            m_stats.m_refills += 1;
+            m_stats.m_bytes_read += (u64)read;
+            m_stats.m_bytes_carried += rest;
+        }
+#else
+        s64 const read = m_stream->read(dst, m_buffer_cap - rest);
+#endif
+        m_buffer_size         = rest + (u32)((read > 0) ? read : 0);
+        m_buffer_text.m_ascii = (ascii::pcrune)m_buffer_data;
+        m_buffer_text.m_str   = 0;
+        m_buffer_text.m_end   = m_buffer_size;
+        m_buffer_text.m_eos   = m_buffer_size;
+        if (read <= 0)
+        {
+            validate_end();
+            return false;
+        }
+        m_stream_pos += read;
+        validate(rest);
+        return true;
+    }
+
+    // Validate the bytes of a UTF-8 stream that are new in the window, the 'rest' in front of them was validated
+    // with the previous window except for a sequence that it cut off. A window that is pure ASCII is typed as ASCII.
+    void text_stream_t::validate(u32 rest)
+    {
+        if (m_encoding != encoding_utf8)
+            return;
+        u8 const* begin = (u8 const*)m_buffer_text.m_ascii + m_buffer_text.m_str;
+        u8 const* fresh = begin + rest;
+        u8 const* end   = (u8 const*)m_buffer_text.m_ascii + m_buffer_text.m_end;
+        u8 const* str   = fresh - nscan::utf8_incomplete(begin, fresh);
+        bool      pure  = false;
+        m_utf8          = nscan::validate_utf8(str, end, pure) && m_utf8;
+        if (!pure)
+        {
+            u8 const* last = end;
+            while (*--last < 0x80) {}
+            m_ascii_pos = m_stream_pos - (s64)(end - last) + 1;
+        }
+
+        // The carried bytes are ASCII when the last byte that is not ASCII was before the window
+        bool const ascii     = m_ascii_pos <= (m_stream_pos - (s64)(end - begin));
+        m_ascii              = ascii;
+        m_buffer_text.m_type = ascii ? (u8)encoding_ascii : (u8)encoding_utf8;
+#if defined(CTEXT_TEXT_STREAM_STATS)
+        m_stats.m_ascii_windows += ascii ? 1 : 0;
+#endif
+    }
+
+    // No next window completes a sequence that is cut off by the end of the stream
+    void text_stream_t::validate_end()
+    {
+        if (m_encoding != encoding_utf8)
+            return;
+        u8 const* str = (u8 const*)m_buffer_text.m_ascii + m_buffer_text.m_str;
+        u8 const* end = (u8 const*)m_buffer_text.m_ascii + m_buffer_text.m_end;
+        if (nscan::utf8_incomplete(str, end) != 0)
+            m_utf8 = false;
+    }
+
+    void text_stream_t::consume(u32 cursor)
+    {
+        ASSERT(cursor >= m_buffer_text.m_str && cursor <= m_buffer_text.m_end);
+        m_buffer_text.m_str = cursor;
+    }
+
+    bool text_stream_t::stats(stats_t& stats) const
+    {
+        stats = m_stats;
+#if defined(CTEXT_TEXT_STREAM_STATS)
         return true;
+#else
+        return false;
+#endif
     }
 
+    void text_stream_t::reset_stats() { m_stats = stats_t(); }
+
     bool text_stream_t::v_canSeek() const { return false; }
     bool text_stream_t::v_canRead() const { return m_stream->canRead(); }
     bool text_stream_t::v_canWrite() const { return m_stream->canWrite(); }
@@ -150,16 +398,18 @@ namespace ncore
 
     void text_stream_t::v_close()
     {
-        if (m_buffer_data != nullptr)
-        {
-            context_t::system_alloc()->deallocate(m_buffer_data);
-        }
+        release(m_segment);
+        m_segment = nullptr;
+        if (m_pool != nullptr)
+            release_pool(m_pool);
+        m_pool         = nullptr;
         m_buffer_cap   = 0;
         m_buffer_data  = nullptr;
         m_buffer_data0 = nullptr;
         m_buffer_size  = 0;
         m_stream_pos   = 0;
         m_stream_len   = 0;
+        m_ascii_pos    = 0;
         m_buffer_text  = crunes_t();
 
         m_stream->close();
@@ -6,6 +6,7 @@
 #endif
 
 #include "cbase/c_runes.h"
+#include "ctext/c_parser2.h"
 
 namespace ncore
 {
@@ -24,6 +25,15 @@ namespace ncore
              *
              */
             virtual bool Check(nrunes::reader_t&) = 0;
+
+            /*!
+             * @fn 	bool Lower(parser2::parser_t&, parser2::parser_t::program_t&)
+             * Emit the equivalent parser2 program of this rule (and its children)
+             * @return  Return @a false when the rule cannot be expressed as a parser2
+             * program (e.g. Extract and ReturnToCallback)
+             *
+             */
+            virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&) { return false; }
         };
 
         class tokenizer_1_t : public tokenizer_t
@@ -51,6 +61,7 @@ namespace ncore
             public:
                 inline Not(tokenizer_t& toka) : tokenizer_1_t(toka) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
 
             class Or : public tokenizer_2_t
@@ -58,6 +69,7 @@ namespace ncore
             public:
                 inline Or(tokenizer_t& toka, tokenizer_t& tokb) : tokenizer_2_t(toka, tokb) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
 
             class And : public tokenizer_2_t
@@ -65,6 +77,7 @@ namespace ncore
             public:
                 And(tokenizer_t& toka, tokenizer_t& tokb) : tokenizer_2_t(toka, tokb) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
 
             class Sequence : public tokenizer_2_t
@@ -72,6 +85,7 @@ namespace ncore
             public:
                 inline Sequence(tokenizer_t& toka, tokenizer_t& tokb) : tokenizer_2_t(toka, tokb) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
             class Sequence3 : public tokenizer_2_t
             {
@@ -80,6 +94,7 @@ namespace ncore
             public:
                 inline Sequence3(tokenizer_t& toka, tokenizer_t& tokb, tokenizer_t& tokc) : tokenizer_2_t(toka, tokb), m_tokenizer_c(tokc) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
 
             class Within : public tokenizer_1_t
@@ -91,38 +106,34 @@ namespace ncore
                 Within(u64 max, tokenizer_t& toka) : tokenizer_1_t(toka), m_min(0), m_max(max) {}
                 Within(tokenizer_t& toka) : tokenizer_1_t(toka), m_min(0), m_max(0xffffffffffffffffUL) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
 
-            class Times : public tokenizer_1_t
+            // Repetitions are a Within with fixed bounds, so that nothing has to be constructed while parsing
+            class Times : public Within
             {
-                s32 m_max;
-
             public:
-                inline Times(s32 max, tokenizer_t& toka) : tokenizer_1_t(toka), m_max(max) {}
-                virtual bool Check(nrunes::reader_t&);
+                inline Times(s32 max, tokenizer_t& toka) : Within(max, max, toka) {}
             };
 
-            class OneOrMore : public tokenizer_1_t
+            class OneOrMore : public Within
             {
             public:
-                inline OneOrMore(tokenizer_t& toka) : tokenizer_1_t(toka) {}
-                virtual bool Check(nrunes::reader_t&);
+                inline OneOrMore(tokenizer_t& toka) : Within(1, 0xffffffffffffffffUL, toka) {}
             };
 
-            class ZeroOrOne : public tokenizer_1_t
+            class ZeroOrOne : public Within
             {
             public:
-                inline ZeroOrOne(tokenizer_t& toka) : tokenizer_1_t(toka) {}
-                virtual bool Check(nrunes::reader_t&);
+                inline ZeroOrOne(tokenizer_t& toka) : Within(0, 1, toka) {}
             };
             typedef ZeroOrOne Optional;
             typedef ZeroOrOne _0Or1;
 
-            class While : public tokenizer_1_t
+            class While : public Within
             {
             public:
-                inline While(tokenizer_t& toka) : tokenizer_1_t(toka) {}
-                virtual bool Check(nrunes::reader_t&);
+                inline While(tokenizer_t& toka) : Within(0, 0xffffffffffffffffUL, toka) {}
             };
             typedef While ZeroOrMore;
 
@@ -131,6 +142,7 @@ namespace ncore
             public:
                 inline Until(tokenizer_t& toka) : tokenizer_1_t(toka) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
 
             class Extract : public tokenizer_1_t
@@ -140,6 +152,7 @@ namespace ncore
             public:
                 inline Extract(nrunes::reader_t& m1, tokenizer_t& toka) : tokenizer_1_t(toka), m_selection(m1) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
 
             typedef void (*CallBack)(nrunes::reader_t&, u32&);
@@ -150,6 +163,7 @@ namespace ncore
             public:
                 inline ReturnToCallback(CallBack cb, tokenizer_t& toka) : tokenizer_1_t(toka), m_cb(cb) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
 
             class Enclosed : public tokenizer_1_t
@@ -160,6 +174,7 @@ namespace ncore
             public:
                 inline Enclosed(nrunes::reader_t open, nrunes::reader_t close, tokenizer_t& toka) : tokenizer_1_t(toka), m_open(open), m_close(close) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
 
         } // namespace manipulators
@@ -171,6 +186,7 @@ namespace ncore
             public:
                 Any() {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
             extern Any sAny;
 
@@ -183,6 +199,7 @@ namespace ncore
                 In(const char* str, u32 len) : m_input(str, str + len) {}
                 In(nrunes::reader_t input) : m_input(input) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
 
             class Between : public tokenizer_t
@@ -194,6 +211,7 @@ namespace ncore
                 Between() : m_lower('a'), m_upper('z') {}
                 Between(uchar32 lower, uchar32 upper) : m_lower(lower), m_upper(upper) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
 
             class Alphabet : public tokenizer_t
@@ -204,6 +222,7 @@ namespace ncore
             public:
                 Alphabet() : m_lower_case('a', 'z'), m_upper_case('A', 'Z') {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
             extern Alphabet sAlphabet;
 
@@ -214,6 +233,7 @@ namespace ncore
             public:
                 Digit() : m_digit('0', '9') {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
             extern Digit sDigit;
 
@@ -226,6 +246,7 @@ namespace ncore
             public:
                 Hex() : m_lower_case('a', 'f'), m_upper_case('A', 'F') {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
             extern Hex sHex;
 
@@ -234,6 +255,7 @@ namespace ncore
             public:
                 AlphaNumeric() {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
             extern AlphaNumeric sAlphaNumeric;
 
@@ -245,7 +267,9 @@ namespace ncore
                 Exact() {}
                 Exact(const char* str, u32 len) : m_input(str, str + len) {}
                 Exact(nrunes::reader_t input) : m_input(input) {}
+                static bool  Match(nrunes::reader_t input, nrunes::reader_t& reader);
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
 
             class Like : public tokenizer_t
@@ -260,6 +284,7 @@ namespace ncore
                 Like(nrunes::reader_t input, u32 to) : m_input(input), m_to(to) {}
                 Like(nrunes::reader_t input, u32 from, u32 to) : m_input(input), m_from(from), m_to(to) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
 
             class WhiteSpace : public tokenizer_t
@@ -269,6 +294,7 @@ namespace ncore
             public:
                 WhiteSpace() : m_whitespace(" \t\n\r", 4) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
             extern WhiteSpace sWhitespace;
 
@@ -280,6 +306,7 @@ namespace ncore
                 Is() : m_char(' ') {}
                 Is(uchar32 c) : m_char(c) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
 
             class Decimal : public tokenizer_t
@@ -287,6 +314,7 @@ namespace ncore
             public:
                 Decimal() {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
             extern Decimal sDecimal;
 
@@ -295,6 +323,7 @@ namespace ncore
             public:
                 Word() {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
             extern Word sWord;
 
@@ -303,6 +332,7 @@ namespace ncore
             public:
                 EndOfText() {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
             extern EndOfText sEOT;
 
@@ -311,6 +341,7 @@ namespace ncore
             public:
                 EndOfLine() {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
             extern EndOfLine sEOL;
 
@@ -324,6 +355,7 @@ namespace ncore
                 Integer(s64 max) : m_min(0), m_max(max) {}
                 Integer(s64 min, s64 max) : m_min(min), m_max(max) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
 
             class Float : public tokenizer_t
@@ -336,6 +368,7 @@ namespace ncore
                 Float(f32 max) : m_min(0.0f), m_max(max) {}
                 Float(f32 min, f32 max) : m_min(min), m_max(max) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
 
             // namespace Date
@@ -357,20 +390,50 @@ namespace ncore
             public:
                 IPv4() : m_d3(1, 3, filters::sDigit), m_b8(255), m_sub(m_d3, m_b8), m_dot('.'), m_bad(m_sub, m_dot), m_domain(3, m_bad), m_ipv4(m_domain, m_sub) {}
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
             extern IPv4 sIPv4;
 
             class Host : public tokenizer_t
             {
+                IPv4                     m_ipv4;
+                manipulators::OneOrMore  m_oom_an;
+                filters::Is              m_dash;
+                filters::Is              m_dot;
+                manipulators::Sequence   m_dash_oom_an;
+                manipulators::Sequence   m_dot_oom_an;
+                manipulators::ZeroOrMore m_zom_dash_oom_an;
+                manipulators::Sequence   m_dot_oom_an_zom_dash_oom_an;
+                manipulators::ZeroOrMore m_host_tail;
+                manipulators::Sequence   m_host_head;
+                manipulators::Sequence   m_name;
+                manipulators::Or         m_host;
+
             public:
+                Host();
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
             extern Host sHost;
 
             class Email : public tokenizer_t
             {
+                filters::In              m_validchars;
+                manipulators::Or         m_valid;
+                manipulators::OneOrMore  m_oom_valid;
+                filters::Is              m_dot;
+                manipulators::Sequence   m_dot_valid;
+                manipulators::ZeroOrMore m_zom_dot_valid;
+                filters::Is              m_at;
+                Host                     m_domain;
+                manipulators::Sequence   m_local;
+                manipulators::Sequence   m_at_domain;
+                manipulators::Sequence   m_email;
+
             public:
+                Email();
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
             extern Email sEmail;
 
@@ -378,6 +441,7 @@ namespace ncore
             {
             public:
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
             extern ServerAddress sServerAddress;
 
@@ -385,9 +449,27 @@ namespace ncore
             {
             public:
                 virtual bool Check(nrunes::reader_t&);
+                virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
             };
             extern Uri sURI;
         } // namespace utils
+
+        // Lowers a rule (object graph) once into a parser2 program, checking then runs on the parser2 machine
+        // instead of through a virtual call per node and character. Rules that cannot be lowered keep running
+        // through their own Check.
+        class Compiled : public tokenizer_t
+        {
+            tokenizer_t&                 m_rule;
+            parser2::parser_t            m_parser;
+            parser2::parser_t::program_t m_program;
+            bool                         m_compiled;
+
+        public:
+            Compiled(tokenizer_t& rule, buffer_t buffer);
+            inline bool  IsCompiled() const { return m_compiled; }
+            virtual bool Check(nrunes::reader_t&);
+            virtual bool Lower(parser2::parser_t&, parser2::parser_t::program_t&);
+        };
     } // namespace combparser
 
 } // namespace ncore
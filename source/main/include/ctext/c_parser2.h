@@ -18,7 +18,7 @@ namespace ncore
         class parser_t
         {
         public:
-            typedef u16 pc_t;
+            typedef u32 pc_t;
 
             static const u8 cWHITESPACE = 1;
             static const u8 cALPHABET   = 2;
@@ -27,14 +27,31 @@ namespace ncore
             static const u8 cLOWERCASE  = 16;
             static const u8 cUPPERCASE  = 32;
 
+            // All the memory of the parser comes from 'buffer' (e.g. a block of a per-request arena), building and
+            // executing programs does not allocate. Backtracking state lives on the call stack, its depth is bounded
+            // by the nesting depth of the program.
             parser_t(buffer_t buffer);
 
+            // Bytes of 'buffer' needed to hold 'code_size' bytes of program code, see code_size().
+            static u32 required(u32 code_size);
+
+            u32  size() const; // bytes of the buffer in use
+            void reset();      // remove all programs, the buffer is reused
+
+            // False when the buffer was too small for the programs that have been built, the programs of this
+            // parser will not match anything. Building continues to measure the code, code_size() is the exact size
+            // of the code of all programs. To measure a grammar build it with a buffer of required(0) bytes, then
+            // build it again with a buffer of required(code_size()) bytes.
+            bool valid() const;
+            u32  code_size() const;
+
             struct program_t
             {
                 program_t();
                 program_t(machine_t* m);
                 program_t(machine_t* m, pc_t pc);
                 program_t(const program_t& p);
+                program_t& operator=(program_t const&) = default;
 
                 program_t Program(program_t p);
                 program_t Not(program_t p);
@@ -76,6 +93,9 @@ namespace ncore
             protected:
                 friend class machine_t;
                 friend class parser_t;
+                friend class ruleset_t;
+                friend class incremental_t;
+                friend class jit_t;
                 inline pc_t pc() const { return (pc_t)m_pc; }
 
             private:
@@ -85,6 +105,93 @@ namespace ncore
 
             static bool parse(program_t program, nrunes::reader_t& reader);
 
+            // Results of parse_partial
+            static const s32 cNOMATCH  = 0;
+            static const s32 cMATCH    = 1;
+            static const s32 cNEEDMORE = 2;
+
+            // Parse a text that is only the first part of the input, e.g. the window of a text_stream_t that ends
+            // in the middle of a record. Returns cNEEDMORE when the program examined the end of the text, meaning
+            // that the result can be different once more text is available. The cursor of 'reader' then stays at
+            // the start of the record, extend the text (the record start stays valid) and call again from there.
+            // When there is no more text use parse(), there the end of the text is the end of the input.
+            static s32 parse_partial(program_t program, nrunes::reader_t& reader);
+
+            // Search for the first position at or after the cursor of 'reader' where 'program' matches.
+            // Positions that cannot start a match (according to the FIRST set of the program) are skipped
+            // using a vectorized byte scan. On success 'match' selects the matched text and 'reader' is
+            // positioned right after the match.
+            static bool find(program_t program, nrunes::reader_t& reader, nrunes::reader_t& match);
+
+            // Find all non-overlapping matches, returns the number of matches written to 'matches'.
+            static s32 findAll(program_t program, nrunes::reader_t& reader, nrunes::reader_t* matches, s32 max_matches);
+
+            // Rewrite 'program' into an equivalent program that executes fewer instructions: nested Sequence and Or
+            // are flattened, an Or of single characters becomes one In, a prefix that the operands of an Or have in
+            // common is matched once and And(Within(Digit(), lo, hi), Unsigned32(min, max)) becomes a single
+            // instruction. The new code is added to the parser of 'program', the original program stays valid.
+            // Call after building and before compile(), returns 'program' when the buffer is too small.
+            static program_t optimize(program_t program);
+
+            // Number of instructions that are executed to run every part of 'program' once
+            static s32 instructions(program_t program);
+
+            // Generate C++ source for 'program' (e.g. from a tool at build time): a function
+            // 'const char* <name>(const char* cursor, const char* end)' that returns the end of the match or 0, with
+            // the same results as parse() on ASCII and UTF-8 text. Every instruction becomes a small inline function
+            // that the compiler can merge into one specialized function, the source does not depend on ctext.
+            // Supports the same instructions as jit_t. Returns the length of the source, also when 'size' is too
+            // small (the source is then cut off), or -1 when the program has other instructions.
+            static s32 generate(program_t program, const char* name, char* source, s32 size);
+
+            // Profiling counters of an instruction, see profile()
+            struct counter_t
+            {
+                u32 m_executions;  // times the instruction has been executed
+                u32 m_successes;   //
+                u32 m_failures;    //
+                u32 m_reserved;    //
+                u64 m_backtracked; // characters examined beyond the end of the match (or the start, on failure)
+                u64 m_time;        // nanoseconds spent in parse(), find(), ... of the program starting here
+            };
+
+            // Count the executions of every instruction in 'memory' (profile_required() bytes). Profiling is
+            // compiled out unless ctext is built with CTEXT_PARSER2_PROFILE, profile() then returns false and the
+            // production path is unaffected. Build all programs first, code added later is not counted.
+            bool profile(buffer_t memory);
+            u32  profile_required() const;
+
+            // The counters of the instruction at the start of 'program', nullptr when not profiling
+            static counter_t const* counters(program_t program);
+
+            // Write an annotated listing of 'program' to 'text', one instruction per line with its counters when
+            // profiling. Returns the length of the listing, also when 'size' is too small (the listing is then cut off).
+            static s32 listing(program_t program, char* text, s32 size);
+
+            // Write the instructions of 'program' in the order of the code, one per line with its pc, opcode name,
+            // operands and call targets. Returns the length of the text, also when 'size' is too small.
+            static s32 disassemble(program_t program, char* text, s32 size);
+
+            struct statistics_t
+            {
+                u32 m_size;         // bytes of code of the instructions of the program
+                s32 m_instructions; // number of different instructions
+                s32 m_max_depth;    // deepest nesting of calls, the program itself is depth 1
+                s32 m_backtracking; // estimated points where the cursor can move back: alternatives, repetitions, ...
+                s32 m_mix[256];     // number of instructions per opcode, see opcode()
+            };
+
+            // Size, instruction mix, nesting depth and backtracking points of 'program', false when it is invalid
+            static bool statistics(program_t program, statistics_t& stats);
+            static const char* opcode(s32 index); // name of an opcode of statistics_t::m_mix, nullptr when unused
+
+            // Analyse 'program' and compile its regular sub-programs (no captures, no lookahead and no backtracking
+            // needed) into DFAs that run as a table-driven loop over the bytes of the text, the other parts of the
+            // program keep running on the interpreter. DFA states are constructed lazily and cached in 'memory', which
+            // has to stay alive as long as the program is used. Call once per parser, returns the number of sub-programs
+            // that have been compiled.
+            static s32 compile(program_t program, buffer_t memory);
+
             program_t Program(program_t p);
             program_t Not(program_t p);
             program_t Or(program_t lhs, program_t rhs);
@@ -132,6 +239,169 @@ namespace ncore
             buffer_t   m_buffer;
         };
 
+        // The number kernels of Integer64 and Float64: read an optionally negative integer, or a decimal number
+        // with an optional fraction, at the cursor of 'reader'. False when nothing is a number, the reader is left
+        // after what was read in either case.
+        bool read_integer64(nrunes::reader_t& reader, s64& value);
+        bool read_float64(nrunes::reader_t& reader, f64& value);
+
+        // A program translated to native x86-64 code. Character classes become inline compares or table lookups,
+        // sequences become straight-line code and scopes keep their state in the stack frame. The code lives in
+        // executable pages that are mapped by compile() and released by reset() or the destructor, this is the only
+        // memory of ctext that does not come from the user.
+        // Programs with instructions that do not work on single ASCII bytes (Extract, Any, Until, Like, signed and
+        // float numbers) are not translated, neither is anything on other architectures; parse() then runs the
+        // interpreter. The native code does not track how far the text was examined, use parse_partial() of the
+        // parser for streaming.
+        class jit_t
+        {
+        public:
+            jit_t();
+            ~jit_t();
+
+            // Returns false when 'program' could not be translated, parse() still works
+            bool compile(parser_t::program_t program, u32 max_code_size = 0x10000);
+            void reset();
+
+            bool native() const { return m_code != nullptr; }
+            u32  size() const { return m_size; } // bytes of native code
+
+            // Same as parser_t::parse, UTF-8 and ASCII text runs the native code
+            bool parse(nrunes::reader_t& reader) const;
+
+        private:
+            jit_t(jit_t const&);
+            jit_t& operator=(jit_t const&);
+
+            parser_t::program_t m_program;
+            void*               m_code;
+            u32                 m_capacity;
+            u32                 m_size;
+        };
+
+        // A set of programs (rules) that are evaluated together in a single pass over a text.
+        // Rules are indexed by their literal prefix (Aho-Corasick automaton) or, when they do not start
+        // with a literal, by the set of characters they can start with. At every position of the text only
+        // the candidate rules are executed, so the cost scales with the size of the text and not with the
+        // number of rules times the size of the text.
+        //
+        // All the memory used by the rule-set (index and scan state) comes from 'buffer'.
+        class ruleset_t
+        {
+        public:
+            ruleset_t(buffer_t buffer, s32 max_rules = 256);
+
+            // Returns the index of the rule, or -1 when the set is full, has already been built or the parser of the
+            // program ran out of memory
+            s32 add(parser_t::program_t program);
+
+            // Build the index, call once after all rules have been added.
+            // Returns false when 'buffer' is too small.
+            bool build();
+
+            class report_t
+            {
+            public:
+                // Called for every match, the captures (Extract) of the rule hold the values of this match
+                virtual void match(s32 rule, nrunes::reader_t const& match) = 0;
+            };
+
+            // Evaluate all rules over the text of 'reader' (from its cursor) and report every match.
+            // The matches of a single rule do not overlap and are reported in text order.
+            // Returns the number of matches.
+            s32 scan(nrunes::reader_t const& reader, report_t* report);
+
+            // Most bytes of the buffer that have been in use, including the temporary memory of build(). A buffer
+            // of this size is enough for the same rules, when build() failed it is only a lower bound.
+            u32 size() const { return m_peak; }
+
+        private:
+            u8*  allocate(u32 size, u32 alignment);
+            bool attempt(s32 rule, nrunes::reader_t const& reader, u32 start, report_t* report);
+
+            buffer_t             m_buffer;
+            u8*                  m_alloc;      // bump allocator cursor in m_buffer
+            u32                  m_peak;       // high water mark of m_alloc
+            s32                  m_max_rules;  //
+            s32                  m_num_rules;  //
+            s32                  m_words;      // number of u64 words in a bitset of rules
+            bool                 m_built;      //
+            parser_t::program_t* m_rules;      // [m_max_rules]
+            u8*                  m_prefix_len; // [m_max_rules] length of the literal prefix in the automaton (0 = none)
+            s16*                 m_prefix_nxt; // [m_max_rules] next rule that has the same literal prefix
+            u32*                 m_next;       // [m_max_rules] scan state, cursor from where a rule can match again
+            u64*                 m_first;      // [256][m_words] rules without a literal prefix that can start with a byte
+            u64*                 m_always;     // [m_words] rules that can match the empty string
+            u8                   m_classes[256];
+            s32                  m_num_classes;
+            s32                  m_num_nodes;
+            u16*                 m_delta;     // [m_num_nodes][m_num_classes] automaton transitions
+            s16*                 m_node_rule; // [m_num_nodes] first rule whose literal prefix ends at this node
+            u16*                 m_node_dict; // [m_num_nodes] next node on the failure chain that has a rule, 0 = none
+        };
+
+        // Incremental parsing of a text that is a sequence of records (e.g. the lines of a config file) that all
+        // match 'program'. For every record the span it consumed and the furthest position it examined are kept,
+        // after an edit only the records that examined the edited text are parsed again. Parsing stops as soon as
+        // a record ends where a record that follows the edit starts, from there on the text is unchanged.
+        // Text that is not a record is kept as a 'bad' part that ends where a record can be parsed again.
+        //
+        // The records are kept in a gap buffer, the records after the gap hold their positions relative to the
+        // end of the text so that an edit does not have to update them. Edits close to each other (typing) only
+        // move the gap a little.
+        //
+        // All the memory comes from 'buffer', the number of records is limited by its size.
+        class incremental_t
+        {
+        public:
+            incremental_t(buffer_t buffer, parser_t::program_t program);
+
+            // Bytes of 'buffer' needed for a text of at most 'max_records' records (a part of the text that is not
+            // a record counts as one record)
+            static u32 required(s32 max_records);
+
+            // Parse the whole text (from the cursor of 'text')
+            bool parse(nrunes::reader_t const& text);
+
+            // The text has been edited, the part 'from' .. 'to' has been replaced by 'size' bytes. 'from' and 'to'
+            // are cursors of the text before the edit, 'text' is the text after the edit and has to start at the
+            // same cursor. Returns true when the whole text consists of records.
+            bool edit(nrunes::reader_t const& text, u32 from, u32 to, u32 size);
+
+            bool valid() const { return m_bad == 0 && !m_full; }
+            s32  count() const { return m_count; }
+            s32  reparsed() const { return m_reparsed; } // number of parse attempts of the last parse or edit
+
+            // Returns false when this part of the text is not a record
+            bool get(s32 index, u32& begin, u32& end) const;
+
+        private:
+            struct record_t
+            {
+                u32 m_begin;
+                u32 m_end;
+                u32 m_reach; // the furthest position that has been examined when parsing the record
+                u32 m_bad;   // not a record, the text up to the next record
+            };
+
+            record_t at(s32 index) const;
+            void     move_gap(s32 index);
+            void     drop();
+            bool     push(record_t const& record);
+            void     run(nrunes::reader_t const& text, u32 cursor);
+
+            parser_t::program_t m_program;
+            record_t*           m_records;  // [m_capacity]
+            s32                 m_capacity; //
+            s32                 m_count;    // number of records, before and after the gap
+            s32                 m_gap;      // number of records before the gap
+            s32                 m_bad;      // number of parts of the text that are not a record
+            bool                m_full;     // ran out of memory
+            u32                 m_begin;    // cursor where the text starts
+            u32                 m_end;      // cursor where the text ends
+            s32                 m_reparsed; //
+        };
+
     } // namespace parser2
 } // namespace ncore
 
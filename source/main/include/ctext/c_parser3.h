@@ -18,12 +18,10 @@ namespace ncore
             e.g.
 
             auto rule2 = p.Sequence(
-                p.Digest(p.cWHITESPACE)->
-                p.Until(p.Is('=')))->
-                p.Digest(p.cWHITESPACE)->
-                p.Extract(&var,
-                    p.Unsigned32()
-                )
+                p.WhiteSpace()->
+                Until(p.Is('='), p.Any())->
+                WhiteSpace()->
+                Extract(&var, p.Unsigned32())
             );
 
             runes_reader_t text("This is an integer = 512 in text to be parsed");
@@ -40,6 +38,10 @@ namespace ncore
         static const u32 cIGNORECASE = 0x08;
         static const u32 cZeroOrMore = 0x10;
 
+        // Code is written linearly into the buffer, the code_t block headers are allocated from the end of
+        // the buffer. A block is a sequence of instructions terminated by a 3 byte link slot, appending to a
+        // block that is not at the end of the code anymore turns its slot into a JMP to a new segment. When
+        // a block is locked its slot becomes a RET. Operands that are code blocks are 16-bit offsets (JSR).
         struct parser_t
         {
             // Call parser_t when starting a new code block.
@@ -52,14 +54,14 @@ namespace ncore
                 code_t* Or(code_t* lhs, code_t* rhs);
                 code_t* And(code_t* lhs, code_t* rhs);
                 code_t* Sequence(code_t* lhs);
-                code_t* Within(s32 _min = 0, s32 _max = 0x7fffffff);
-                code_t* Times(s32 _count);
+                code_t* Within(code_t* code, s32 _min = 0, s32 _max = 0x7fffffff);
+                code_t* Times(s32 _count, code_t* code);
                 code_t* OneOrMore(code_t* code);
                 code_t* ZeroOrMore(code_t* code);
                 code_t* ZeroOrOne(code_t* code);
                 code_t* While(code_t* code);
                 code_t* Until(code_t* until, code_t* code);
-                code_t* Enclosed(uchar32 _open, uchar32 _close);
+                code_t* Enclosed(uchar32 _open, uchar32 _close, code_t* code);
                 code_t* Any();
                 code_t* In(crunes_t const& _chars);
                 code_t* Between(uchar32 _from, uchar32 _until);
@@ -89,25 +91,37 @@ namespace ncore
                 code_t* Phone();
                 code_t* ServerAddress();
                 code_t* URI();
+
+                parser_t* m_parser;
+                u32       m_entry;  // offset of the first instruction
+                u32       m_tail;   // offset of the link slot of the last segment
+                bool      m_locked; // handed to another block, no more instructions can be added
             };
 
             parser_t(buffer_t buffer);
 
+            // Parse with the root, the last code block that has been created
             bool Parse(nrunes::reader_t&);
+            bool Parse(code_t* code, nrunes::reader_t&);
+
+            u32  Size() const { return m_top; }       // number of bytes of code
+            u32  Used() const;                        // number of bytes of the buffer in use (code and blocks)
+            bool IsValid() const { return !m_error; } // false when the buffer ran out of space
+            void Reset();                             // remove all code, the buffer is reused
 
             code_t* Extract(va_r_t* var, code_t* lhs);
             code_t* Not(code_t* lhs);
             code_t* Or(code_t* lhs, code_t* rhs);
             code_t* And(code_t* lhs, code_t* rhs);
             code_t* Sequence(code_t* lhs);
-            code_t* Within(s32 _min = 0, s32 _max = 0x7fffffff);
-            code_t* Times(s32 _count);
+            code_t* Within(code_t* code, s32 _min = 0, s32 _max = 0x7fffffff);
+            code_t* Times(s32 _count, code_t* code);
             code_t* OneOrMore(code_t* code);
             code_t* ZeroOrMore(code_t* code);
             code_t* ZeroOrOne(code_t* code);
             code_t* While(code_t* code);
             code_t* Until(code_t* until, code_t* code);
-            code_t* Enclosed(uchar32 _open, uchar32 _close);
+            code_t* Enclosed(uchar32 _open, uchar32 _close, code_t* code);
             code_t* Any();
             code_t* In(crunes_t const& _chars);
             code_t* Between(uchar32 _from, uchar32 _until);
@@ -139,6 +153,22 @@ namespace ncore
             code_t* URI();
 
             buffer_t m_buffer;
+            u32      m_top;    // end of the code
+            u32      m_bottom; // start of the code_t headers
+            code_t*  m_root;   // the last block that has been created
+            bool     m_error;  // ran out of space
+
+        private:
+            code_t* begin();
+            u8*     append(code_t* code, u32 size);
+            u16     lock(code_t* code);
+            u8*     emit(code_t* code, u8 opcode, u32 operands);
+            code_t* op(code_t* code, u8 opcode);
+            code_t* op(code_t* code, u8 opcode, code_t* a);
+            code_t* op(code_t* code, u8 opcode, code_t* a, code_t* b);
+            code_t* op(code_t* code, u8 opcode, crunes_t const& text);
+            bool    exec(u32 pc, nrunes::reader_t& reader);
+            bool    repeat(u32 pc, s32 _min, s32 _max, nrunes::reader_t& reader);
         };
 
     } // namespace parser3
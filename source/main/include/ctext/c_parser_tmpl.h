@@ -0,0 +1,501 @@
+#ifndef __CTEXT_PARSER_TMPL_H__
+#define __CTEXT_PARSER_TMPL_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cbase/c_runes.h"
+
+// Compile-time parser combinators.
+//
+// The same vocabulary as combparser and parser2, but a rule is a type and the whole grammar is known to the
+// compiler, there are no virtual calls and no bytecode, every node is inlined into the caller. Use this for
+// hot, fixed-format rules:
+//
+//     typedef tparser::Sequence<tparser::OneOrMore<tparser::Digit>, tparser::Is<'.'>, tparser::OneOrMore<tparser::Digit> > version_t;
+//     if (tparser::parse<version_t>(reader)) ...
+//
+// ASCII and UTF-8 text is parsed directly on the bytes, other encodings go through the nrunes::reader_t.
+
+namespace ncore
+{
+    namespace tparser
+    {
+        // ----------------------------------------------------------------------------------------------------
+        // Cursors, a rule is instantiated for every cursor type
+
+        struct ascii_cursor_t
+        {
+            typedef u8 const* pos_t;
+
+            inline ascii_cursor_t(u8 const* str, u8 const* end) : m_str(str), m_end(end) {}
+
+            inline bool    valid() const { return m_str < m_end; }
+            inline uchar32 peek() const { return m_str < m_end ? *m_str : 0; }
+            inline void    skip()
+            {
+                if (m_str < m_end)
+                    ++m_str;
+            }
+            inline pos_t pos() const { return m_str; }
+            inline void  set(pos_t p) { m_str = p; }
+
+            u8 const* m_str;
+            u8 const* m_end;
+        };
+
+        struct utf8_cursor_t
+        {
+            typedef u8 const* pos_t;
+
+            inline utf8_cursor_t(u8 const* str, u8 const* end) : m_str(str), m_end(end) {}
+
+            inline bool    valid() const { return m_str < m_end; }
+            inline uchar32 peek() const
+            {
+                if (m_str >= m_end)
+                    return 0;
+                u8 const c = m_str[0];
+                if (c < 0x80)
+                    return c;
+                return decode();
+            }
+            inline void skip()
+            {
+                if (m_str < m_end)
+                {
+                    u8 const c = m_str[0];
+                    s32      n = (c < 0x80) ? 1 : (c < 0xe0) ? 2 : (c < 0xf0) ? 3 : 4;
+                    m_str      = (m_str + n < m_end) ? m_str + n : m_end;
+                }
+            }
+            inline pos_t pos() const { return m_str; }
+            inline void  set(pos_t p) { m_str = p; }
+
+            uchar32 decode() const
+            {
+                u8 const c = m_str[0];
+                s32      n;
+                uchar32  r;
+                if (c < 0xe0)
+                {
+                    n = 2;
+                    r = c & 0x1f;
+                }
+                else if (c < 0xf0)
+                {
+                    n = 3;
+                    r = c & 0x0f;
+                }
+                else
+                {
+                    n = 4;
+                    r = c & 0x07;
+                }
+                for (s32 i = 1; i < n; ++i)
+                {
+                    if (m_str + i >= m_end)
+                        return '?';
+                    r = (r << 6) | (m_str[i] & 0x3f);
+                }
+                return r;
+            }
+
+            u8 const* m_str;
+            u8 const* m_end;
+        };
+
+        struct reader_cursor_t
+        {
+            typedef u32 pos_t;
+
+            inline reader_cursor_t(nrunes::reader_t& reader) : m_reader(reader) {}
+
+            inline bool    valid() const { return m_reader.valid(); }
+            inline uchar32 peek() const { return m_reader.peek(); }
+            inline void    skip() { m_reader.skip(); }
+            inline pos_t   pos() const { return m_reader.get_cursor(); }
+            inline void    set(pos_t p) { m_reader.set_cursor(p); }
+
+            nrunes::reader_t& m_reader;
+        };
+
+        namespace ndetail
+        {
+            inline uchar32 to_lower(uchar32 c)
+            {
+                if (c < 0x80)
+                    return (c >= 'A' && c <= 'Z') ? (c + ('a' - 'A')) : c;
+                return nrunes::to_lower(c);
+            }
+
+            template <uchar32... Cs> struct set_t;
+            template <> struct set_t<>
+            {
+                static inline bool has(uchar32) { return false; }
+            };
+            template <uchar32 C, uchar32... Cs> struct set_t<C, Cs...>
+            {
+                static inline bool has(uchar32 c) { return c == C || set_t<Cs...>::has(c); }
+            };
+
+            template <bool IgnoreCase, uchar32... Cs> struct text_t;
+            template <bool IgnoreCase> struct text_t<IgnoreCase>
+            {
+                template <typename C> static inline bool check(C&) { return true; }
+            };
+            template <bool IgnoreCase, uchar32 T, uchar32... Ts> struct text_t<IgnoreCase, T, Ts...>
+            {
+                template <typename C> static inline bool check(C& c)
+                {
+                    uchar32 const s = c.peek();
+                    if (!c.valid() || (s != T && (!IgnoreCase || to_lower(s) != to_lower(T))))
+                        return false;
+                    c.skip();
+                    return text_t<IgnoreCase, Ts...>::check(c);
+                }
+            };
+        } // namespace ndetail
+
+        // ----------------------------------------------------------------------------------------------------
+        // Manipulators
+
+        template <typename P> struct Not
+        {
+            template <typename C> static inline bool check(C& c)
+            {
+                typename C::pos_t const start  = c.pos();
+                bool const              result = P::check(c);
+                c.set(start);
+                return !result;
+            }
+        };
+
+        template <typename P, typename... Ps> struct Or
+        {
+            template <typename C> static inline bool check(C& c)
+            {
+                typename C::pos_t const start = c.pos();
+                if (P::check(c))
+                    return true;
+                c.set(start);
+                return Or<Ps...>::check(c);
+            }
+        };
+        template <typename P> struct Or<P>
+        {
+            template <typename C> static inline bool check(C& c) { return P::check(c); }
+        };
+
+        // Both operands have to match at the same position, the cursor ends up at the shortest match
+        template <typename A, typename B> struct And
+        {
+            template <typename C> static inline bool check(C& c)
+            {
+                typename C::pos_t const start = c.pos();
+                if (!A::check(c))
+                {
+                    c.set(start);
+                    return false;
+                }
+                typename C::pos_t const end_a = c.pos();
+                c.set(start);
+                if (!B::check(c))
+                {
+                    c.set(start);
+                    return false;
+                }
+                if (end_a < c.pos())
+                    c.set(end_a);
+                return true;
+            }
+        };
+
+        template <typename P, typename... Ps> struct Sequence
+        {
+            template <typename C> static inline bool check(C& c)
+            {
+                typename C::pos_t const start = c.pos();
+                if (P::check(c) && Sequence<Ps...>::check(c))
+                    return true;
+                c.set(start);
+                return false;
+            }
+        };
+        template <typename P> struct Sequence<P>
+        {
+            template <typename C> static inline bool check(C& c) { return P::check(c); }
+        };
+
+        template <typename P, s32 Min = 0, s32 Max = 0x7fffffff> struct Within
+        {
+            template <typename C> static inline bool check(C& c)
+            {
+                typename C::pos_t const start = c.pos();
+                s32                     i     = 0;
+                while (i < Max)
+                {
+                    typename C::pos_t const iteration = c.pos();
+                    if (!P::check(c))
+                    {
+                        c.set(iteration);
+                        break;
+                    }
+                    i += 1;
+                    if (iteration == c.pos())
+                        i = Max; // matched without consuming anything, repeating will not change that
+                }
+                if (i >= Min)
+                    return true;
+                c.set(start);
+                return false;
+            }
+        };
+
+        template <s32 N, typename P> struct Times : public Within<P, N, N> {};
+        template <typename P> struct OneOrMore : public Within<P, 1> {};
+        template <typename P> struct ZeroOrMore : public Within<P, 0> {};
+        template <typename P> struct ZeroOrOne : public Within<P, 0, 1> {};
+        template <typename P> struct While : public Within<P, 0> {};
+
+        // Advance until 'P' matches, the match of 'P' is included
+        template <typename P> struct Until
+        {
+            template <typename C> static inline bool check(C& c)
+            {
+                typename C::pos_t const start = c.pos();
+                while (c.valid())
+                {
+                    if (P::check(c))
+                        return true;
+                    c.skip();
+                }
+                c.set(start);
+                return false;
+            }
+        };
+
+        template <uchar32 Open, uchar32 Close, typename P> struct Enclosed
+        {
+            template <typename C> static inline bool check(C& c)
+            {
+                typename C::pos_t const start = c.pos();
+                if (c.peek() != Open || !c.valid())
+                    return false;
+                c.skip();
+                if (P::check(c) && c.valid() && c.peek() == Close)
+                {
+                    c.skip();
+                    return true;
+                }
+                c.set(start);
+                return false;
+            }
+        };
+
+        // ----------------------------------------------------------------------------------------------------
+        // Filters
+
+        struct Any
+        {
+            template <typename C> static inline bool check(C& c)
+            {
+                if (!c.valid())
+                    return false;
+                c.skip();
+                return true;
+            }
+        };
+
+        template <uchar32 Ch> struct Is
+        {
+            template <typename C> static inline bool check(C& c)
+            {
+                if (!c.valid() || c.peek() != Ch)
+                    return false;
+                c.skip();
+                return true;
+            }
+        };
+
+        template <uchar32 From, uchar32 Until> struct Between
+        {
+            template <typename C> static inline bool check(C& c)
+            {
+                uchar32 const s = c.peek();
+                if (!c.valid() || s < From || s > Until)
+                    return false;
+                c.skip();
+                return true;
+            }
+        };
+
+        template <uchar32... Cs> struct In
+        {
+            template <typename C> static inline bool check(C& c)
+            {
+                if (!c.valid() || !ndetail::set_t<Cs...>::has(c.peek()))
+                    return false;
+                c.skip();
+                return true;
+            }
+        };
+
+        struct Digit : public Between<'0', '9'> {};
+        struct Alphabet : public Or<Between<'a', 'z'>, Between<'A', 'Z'> > {};
+        struct Hex : public Or<Between<'0', '9'>, Between<'a', 'f'>, Between<'A', 'F'> > {};
+        struct AlphaNumeric : public Or<Between<'0', '9'>, Between<'a', 'z'>, Between<'A', 'Z'> > {};
+        struct WhiteSpace : public In<' ', '\t', '\r'> {};
+        struct Word : public OneOrMore<Alphabet> {};
+
+        // Case-sensitive text, e.g. Exact<'G', 'E', 'T'>
+        template <uchar32... Cs> struct Exact : public ndetail::text_t<false, Cs...> {};
+        // Case-insensitive text
+        template <uchar32... Cs> struct Like : public ndetail::text_t<true, Cs...> {};
+
+        struct EndOfText
+        {
+            template <typename C> static inline bool check(C& c) { return !c.valid(); }
+        };
+
+        struct EndOfLine
+        {
+            template <typename C> static inline bool check(C& c)
+            {
+                typename C::pos_t const start = c.pos();
+                uchar32 const           s     = c.peek();
+                if (s == '\n')
+                {
+                    c.skip();
+                    return true;
+                }
+                if (s == '\r')
+                {
+                    c.skip();
+                    if (c.peek() == '\n')
+                    {
+                        c.skip();
+                        return true;
+                    }
+                }
+                c.set(start);
+                return false;
+            }
+        };
+
+        template <u64 Min = 0, u64 Max = 0xffffffffffffffffUL> struct Unsigned
+        {
+            template <typename C> static inline bool check(C& c)
+            {
+                typename C::pos_t const start = c.pos();
+                u64                     value = 0;
+                uchar32                 s;
+                while (c.valid() && (s = c.peek()) >= '0' && s <= '9')
+                {
+                    value = (value * 10) + (s - '0');
+                    c.skip();
+                }
+                if (c.pos() != start && value >= Min && value <= Max)
+                    return true;
+                c.set(start);
+                return false;
+            }
+        };
+
+        template <s64 Min = 0, s64 Max = 0x7fffffffffffffffL> struct Integer
+        {
+            template <typename C> static inline bool check(C& c)
+            {
+                typename C::pos_t const start    = c.pos();
+                bool const              negative = c.valid() && c.peek() == '-';
+                if (negative)
+                    c.skip();
+                typename C::pos_t const digits = c.pos();
+                s64                     value  = 0;
+                uchar32                 s;
+                while (c.valid() && (s = c.peek()) >= '0' && s <= '9')
+                {
+                    value = (value * 10) + (s - '0');
+                    c.skip();
+                }
+                if (negative)
+                    value = -value;
+                if (c.pos() != digits && value >= Min && value <= Max)
+                    return true;
+                c.set(start);
+                return false;
+            }
+        };
+
+        struct Decimal : public Unsigned<> {};
+
+        // ----------------------------------------------------------------------------------------------------
+        // Utils, the same rules as parser2::parser_t::IPv4(), Host() and Email()
+
+        typedef And<Within<Digit, 1, 3>, Unsigned<0, 255> > Octet;
+        struct IPv4 : public Sequence<Times<3, Sequence<Octet, Is<'.'> > >, Octet> {};
+
+        typedef OneOrMore<AlphaNumeric> Label;
+        struct Host : public Or<IPv4, Sequence<Label, ZeroOrMore<Sequence<Is<'-'>, Label> >, ZeroOrMore<Sequence<Is<'.'>, Label, ZeroOrMore<Sequence<Is<'-'>, Label> > > > > > {};
+
+        typedef In<'!', '#', '$', '%', '&', '\'', '*', '+', '/', '=', '?', '^', '_', '`', '{', '|', '}', '~', '-'> EmailChars;
+        typedef OneOrMore<Or<AlphaNumeric, EmailChars> >                                               EmailAtom;
+        struct Email : public Sequence<EmailAtom, ZeroOrMore<Sequence<In<'.', '_'>, EmailAtom> >, Is<'@'>, Host> {};
+
+        // ----------------------------------------------------------------------------------------------------
+        // Entry points
+
+        // Match rule 'P' at the cursor of 'reader', on success the cursor is moved to the end of the match
+        template <typename P> inline bool parse(nrunes::reader_t& reader)
+        {
+            crunes_t const text = reader.get_current();
+            if (text.m_type == ascii::TYPE || text.m_type == utf8::TYPE)
+            {
+                u8 const* const str = (u8 const*)text.m_ascii + text.m_str;
+                u8 const* const end = (u8 const*)text.m_ascii + text.m_end;
+                u8 const*       pos;
+                if (text.m_type == ascii::TYPE)
+                {
+                    ascii_cursor_t c(str, end);
+                    if (!P::check(c))
+                        return false;
+                    pos = c.pos();
+                }
+                else
+                {
+                    utf8_cursor_t c(str, end);
+                    if (!P::check(c))
+                        return false;
+                    pos = c.pos();
+                }
+                reader.set_cursor(reader.get_cursor() + (u32)(pos - str));
+                return true;
+            }
+
+            reader_cursor_t c(reader);
+            return P::check(c);
+        }
+
+        // Search for the first position at or after the cursor of 'reader' where 'P' matches.
+        // On success 'match' selects the matched text and 'reader' is positioned right after the match.
+        template <typename P> inline bool find(nrunes::reader_t& reader, nrunes::reader_t& match)
+        {
+            while (true)
+            {
+                u32 const start = reader.get_cursor();
+                if (parse<P>(reader))
+                {
+                    match = reader.select(start, reader.get_cursor());
+                    return true;
+                }
+                if (!reader.valid())
+                    return false;
+                reader.skip();
+            }
+        }
+
+    } // namespace tparser
+} // namespace ncore
+
+#endif // __CTEXT_PARSER_TMPL_H__
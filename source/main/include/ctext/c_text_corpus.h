@@ -0,0 +1,77 @@
+#ifndef __CTEXT_TEXT_CORPUS_H__
+#define __CTEXT_TEXT_CORPUS_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cbase/c_runes.h"
+
+namespace ncore
+{
+    namespace ncorpus
+    {
+        // Line lengths are drawn between the minimum and maximum of the config
+        enum distribution
+        {
+            distribution_uniform = 0, // every length is as likely
+            distribution_short   = 1, // mostly short lines with a tail of long lines, like log files
+        };
+
+        struct config_t
+        {
+            config_t();
+
+            u32 m_seed;         // the same seed and config always produce the same text
+            s32 m_encoding;     // ascii::TYPE, utf8::TYPE or utf16::TYPE (native byte order, as text_stream_t::encoding)
+            u8  m_distribution; // distribution
+            u16 m_min_line;     // characters per line, without the line end
+            u16 m_max_line;     // at most cMaxLine
+            u8  m_crlf;         // percentage of lines that end with "\r\n" instead of "\n"
+            u8  m_numbers;      // percentage of the tokens that are numbers
+            u8  m_emails;       // percentage of the tokens that are email addresses
+            u8  m_ipv4;         // percentage of the tokens that are IPv4 addresses
+            u8  m_hosts;        // percentage of the tokens that are host names
+            u8  m_non_ascii;    // percentage of the words with non-ASCII characters (UTF-8 and UTF-16 only)
+        };
+
+        // Generates lines of space separated tokens: words, numbers, email and IPv4 addresses and host names. A line
+        // is cut to its drawn length with a padding word, so every line has exactly that number of characters. The
+        // text can be generated in parts of any size, the result is the same as when generated in one go.
+        class generator_t
+        {
+        public:
+            static const u32 cMaxLine = 1024;
+
+            generator_t(config_t const& config);
+
+            // Write complete lines to 'buffer', returns the number of bytes written. A line that does not fit is
+            // kept and written first by the next call, 0 means that 'buffer' is smaller than that line.
+            u32 write(u8* buffer, u32 size);
+
+            u64 lines() const { return m_lines; } // lines written
+            u64 bytes() const { return m_bytes; } // bytes written
+
+        private:
+            u32  next();
+            u32  below(u32 n) { return next() % n; }
+            void put(uchar32 c);
+            u32  token(uchar32* token);
+            void line();
+
+            config_t m_config;
+            u32      m_state;
+            u64      m_lines;
+            u64      m_bytes;
+            u32      m_line_size; // bytes of the pending line in 'm_line'
+            u8       m_line[(cMaxLine + 2) * 4];
+        };
+
+        // Convenience, generate 'size' bytes (or less, only complete lines) into 'buffer' and return the number of
+        // bytes. 'lines' receives the number of lines.
+        u32 generate(config_t const& config, u8* buffer, u32 size, u32& lines);
+
+    } // namespace ncorpus
+} // namespace ncore
+
+#endif // __CTEXT_TEXT_CORPUS_H__
@@ -0,0 +1,96 @@
+#ifndef __CTEXT_TEXT_CSV_H__
+#define __CTEXT_TEXT_CSV_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+
+#include "ctext/c_text_stream.h"
+
+namespace ncore
+{
+    namespace ncsv
+    {
+        struct config_t
+        {
+            config_t() : m_delimiter(','), m_quote('"'), m_max_rows(1024), m_max_columns(32) {}
+
+            u8  m_delimiter;   // ',' for CSV, '\t' for TSV
+            u8  m_quote;       // 0 when fields are never quoted
+            s32 m_max_rows;    // rows per batch
+            s32 m_max_columns; // fields of a row after this many are skipped
+        };
+
+        struct field_t
+        {
+            u32 m_begin;  // cursors of the text of the batch, without the quotes of a quoted field
+            u32 m_end;    //
+            u32 m_quoted; // 1 when the field was quoted, it can then contain doubled quotes (see reader_t::unquote)
+        };
+
+        // Rows of a CSV text stored per column, the field of 'row' in 'column' is m_fields[column * m_stride + row]
+        struct batch_t
+        {
+            crunes_t m_text;    // the text the fields are cursors of, valid until the next read
+            s32      m_rows;    //
+            s32      m_columns; // fields of the widest row
+            s32      m_stride;  // rows per column in m_fields
+            field_t* m_fields;  // [m_columns * m_stride]
+            s32*     m_widths;  // [m_rows], fields of every row
+
+            // The text of a field, empty when the row has fewer fields
+            crunes_t field(s32 row, s32 column) const
+            {
+                crunes_t text = m_text;
+                text.m_end    = text.m_str;
+                if (column < m_widths[row])
+                {
+                    field_t const& f = m_fields[column * m_stride + row];
+                    text.m_str       = f.m_begin;
+                    text.m_end       = f.m_end;
+                }
+                return text;
+            }
+        };
+
+        // Reads the rows of a CSV or TSV text from a text_stream_t in batches. Every block of 64 bytes is classified
+        // at once into bitmasks of delimiters, line ends and quotes (nscan::match64). The prefix XOR of the quote
+        // mask gives the bytes inside quotes, so delimiters and line ends inside quoted fields are masked out and
+        // the field boundaries are the remaining bits. A quoted field can span lines and refills of the stream. The
+        // fields are not copied, they are cursors into the window of the stream. "\r\n" line ends are accepted, the
+        // text has to be ASCII or UTF-8.
+        class reader_t
+        {
+        public:
+            // 'memory' holds the fields of a batch, required() bytes
+            reader_t(text_stream_t& stream, buffer_t memory, config_t const& config = config_t());
+
+            static u32 required(config_t const& config = config_t());
+
+            // Read the next rows, false at the end of the stream (or when 'memory' is too small or the text is not
+            // ASCII or UTF-8). The previous batch is invalid after this call.
+            bool read(batch_t& batch);
+
+            // Copy a quoted field to 'out' with every doubled quote replaced by a single quote, returns the length
+            s32 unquote(crunes_t const& field, char* out, s32 size) const;
+
+            u64 rows() const { return m_rows; } // rows read so far
+
+        private:
+            text_stream_t* m_stream;
+            config_t       m_config;
+            field_t*       m_fields;
+            s32*           m_widths;
+            u32            m_next; // cursor of the window where the next batch starts, consumed by the next read
+            bool           m_valid;
+            bool           m_done;
+            u64            m_rows;
+        };
+
+    } // namespace ncsv
+} // namespace ncore
+
+#endif // __CTEXT_TEXT_CSV_H__
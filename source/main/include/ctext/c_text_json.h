@@ -0,0 +1,103 @@
+#ifndef __CTEXT_TEXT_JSON_H__
+#define __CTEXT_TEXT_JSON_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+
+#include "ctext/c_text_stream.h"
+
+namespace ncore
+{
+    namespace njson
+    {
+        enum kind
+        {
+            kind_none   = 0, // no value, e.g. a path that is not in the document
+            kind_object = 1,
+            kind_array  = 2,
+            kind_string = 3,
+            kind_number = 4,
+            kind_true   = 5,
+            kind_false  = 6,
+            kind_null   = 7,
+        };
+
+        // A value of the document, the span is cursors of the line
+        struct value_t
+        {
+            s32 m_kind;  // see kind
+            s32 m_index; // structural index of the value
+            u32 m_begin; // a string without its quotes (and with its escapes), an object or array from its open up to
+            u32 m_end;   // and including its close
+        };
+
+        // One JSON value per line (JSON Lines), accessed on demand without building a tree. Parsing a line is done
+        // in two stages like simdjson. Stage 1 classifies every block of 64 bytes at once into bitmasks
+        // (nscan::match64), removes the escaped quotes (nscan::escaped64) and the bytes inside strings
+        // (nscan::prefix_xor) and writes the positions of the structural characters, the opening and closing
+        // quotes and the first byte of every number or literal to an index. Stage 2 walks the index once to match
+        // the brackets and to link every object, array, string and number to its end. Finding a member or element
+        // then only visits the index entries of the values it passes, a nested value is skipped in one step.
+        // Numbers are read with the number kernels of parser2. The line has to be ASCII or UTF-8, strings are
+        // compared and returned as they are in the text (see unescape).
+        class document_t
+        {
+        public:
+            // 'memory' holds the index, required() bytes, a line can have at most 'max_structurals' structurals
+            document_t(buffer_t memory);
+
+            static u32 required(s32 max_structurals);
+
+            // Index a line, false when the line is not a JSON value: brackets that do not match, a string that does
+            // not end, more than one value, or more structurals than fit the memory
+            bool parse(crunes_t const& line);
+
+            // Parse the next line of the stream that is not empty, false at the end of the stream. valid() tells
+            // whether the line parsed.
+            bool read(text_stream_t& stream);
+
+            bool    valid() const { return m_valid; }
+            s32     structurals() const { return m_count; }
+            value_t root() const;
+
+            // The member 'key' of an object or the element 'index' of an array, kind_none when it is not there
+            value_t member(value_t const& object, crunes_t const& key) const;
+            value_t element(value_t const& array, s32 index) const;
+
+            // Follow a path of members and elements separated by '.', e.g. "user.tags.0"; a number selects an
+            // element of an array, anything else a member of an object
+            value_t find(value_t const& from, const char* path) const;
+            value_t find(const char* path) const { return find(root(), path); }
+
+            // The number of members of an object or elements of an array
+            s32 count(value_t const& value) const;
+
+            crunes_t text(value_t const& value) const; // the span of 'value' in the line
+
+            // The value of a number, false when 'value' is not a number (or not an integer for as_s64)
+            bool as_s64(value_t const& value, s64& out) const;
+            bool as_f64(value_t const& value, f64& out) const;
+
+            // Copy a string to 'out' with the escapes replaced (\uXXXX as UTF-8), returns the length
+            s32 unescape(value_t const& value, char* out, s32 size) const;
+
+        private:
+            value_t at(s32 index) const;
+            s32     after(s32 index) const; // index of the structural after the value at 'index'
+
+            crunes_t m_line;
+            u32*     m_positions; // cursor of every structural
+            u32*     m_links;     // open: index of its close, string: cursor of its closing quote, scalar: cursor of its end
+            s32      m_capacity;
+            s32      m_count;
+            bool     m_valid;
+        };
+
+    } // namespace njson
+} // namespace ncore
+
+#endif // __CTEXT_TEXT_JSON_H__
@@ -0,0 +1,79 @@
+#ifndef __CTEXT_TEXT_LOGFMT_H__
+#define __CTEXT_TEXT_LOGFMT_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+
+namespace ncore
+{
+    namespace nlogfmt
+    {
+        // A key=value pair of a line, the spans are cursors of the line
+        struct pair_t
+        {
+            u32 m_key_begin;   //
+            u32 m_key_end;     // m_key_begin == m_key_end when the key is not on the line (see extract)
+            u32 m_value_begin; // without the quotes of a quoted value
+            u32 m_value_end;   //
+            u32 m_quoted;      // 1 when the value was quoted, it can then contain escapes (see unescape)
+        };
+
+        // The keys a caller wants from a line, looked up with a perfect hash. build() searches for a seed of the
+        // hash under which every key has a slot of its own, a lookup is then a hash of the key, one slot and one
+        // compare. The key strings are not copied, they have to outlive the keys_t.
+        class keys_t
+        {
+        public:
+            // 'memory' holds the slots and the keys, required() bytes
+            keys_t(buffer_t memory);
+
+            static u32 required(s32 max_keys);
+
+            // Build the hash of 'count' keys, false when the keys do not fit the memory or are not unique
+            bool build(const char** keys, s32 count);
+
+            // Index of the key in the array given to build(), -1 when it is not one of the keys
+            s32 find(u8 const* key, u32 length) const;
+
+            s32 count() const { return m_count; }
+
+        private:
+            struct key_t
+            {
+                u8 const* m_str;
+                u32       m_length;
+            };
+
+            u8*    m_memory;
+            u32    m_size;
+            key_t* m_keys;
+            s16*   m_slots;
+            u32    m_mask; // slots - 1, the number of slots is a power of two
+            u32    m_seed;
+            s32    m_count;
+        };
+
+        // Split a line of key=value pairs separated by spaces into 'pairs', returns the number of pairs written. A
+        // value can be quoted ("..."), a quoted value can contain spaces, '=' and escaped quotes (\"). A key without
+        // '=' has an empty value. Every block of 64 bytes of the line is classified at once into bitmasks of '=',
+        // spaces, quotes and backslashes (nscan::match64), the prefix XOR of the unescaped quotes masks out the
+        // bytes inside quoted values and the pairs are cut at the remaining bits. The line has to be ASCII or
+        // UTF-8, a line end at the end of the line is ignored.
+        s32 tokenize(crunes_t const& line, pair_t* pairs, s32 max_pairs);
+
+        // Like tokenize, but only the pairs of the wanted keys are written, to values[keys.find(key)]. 'values' has
+        // keys.count() entries, a key that is not on the line gets an empty key span. Returns the number of wanted
+        // keys that were found.
+        s32 extract(crunes_t const& line, keys_t const& keys, pair_t* values);
+
+        // Copy a quoted value to 'out' with the escapes (\" \\ \n \t \r) replaced, returns the length
+        s32 unescape(crunes_t const& value, char* out, s32 size);
+
+    } // namespace nlogfmt
+} // namespace ncore
+
+#endif // __CTEXT_TEXT_LOGFMT_H__
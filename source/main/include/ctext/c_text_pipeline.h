@@ -0,0 +1,142 @@
+#ifndef __CTEXT_TEXT_PIPELINE_H__
+#define __CTEXT_TEXT_PIPELINE_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+
+#include "ctext/c_parser2.h"
+#include "ctext/c_text_stream.h"
+
+namespace ncore
+{
+    namespace npipeline
+    {
+        // Lines of the stream on their way from the reader to a worker and from the worker to the sink
+        struct batch_t
+        {
+            u64                        m_index;    // position of the batch in the stream, the sink gets the batches in this order
+            s32                        m_count;    // number of lines
+            crunes_t*                  m_lines;    // [m_count]
+            s32*                       m_results;  // [m_count], written by the worker, e.g. whether the line matches
+            text_stream_t::segment_t** m_segments; // [m_count], keep the lines valid until the sink is done with the batch
+        };
+
+        // Parses the lines of a batch on a worker thread. Every worker thread has its own worker_t, so a worker can
+        // own state that cannot be shared, like a parser2::parser_t: a program must not run on two threads at the same
+        // time, give every worker its own parser (and buffer) with its own copy of the programs.
+        class worker_t
+        {
+        public:
+            virtual ~worker_t() {}
+            virtual void parse(batch_t& batch) = 0;
+        };
+
+        // Receives the parsed batches in the order of the stream, on the thread that runs the pipeline
+        class sink_t
+        {
+        public:
+            virtual ~sink_t() {}
+            virtual void consume(batch_t const& batch) = 0;
+        };
+
+        // A worker that runs a parser2 program on every line, the result of a line is 1 when it matches and 0 otherwise
+        class parse_worker_t : public worker_t
+        {
+        public:
+            parse_worker_t(parser2::parser_t::program_t program) : m_program(program) {}
+            virtual void parse(batch_t& batch);
+
+        private:
+            parser2::parser_t::program_t m_program;
+        };
+
+        struct config_t
+        {
+            config_t() : m_batch_lines(256), m_batches(0) {}
+
+            s32 m_batch_lines; // lines per batch
+            s32 m_batches;     // batches in flight, a power of two, 0 is 4 per worker
+        };
+
+        // Reads the lines of a text_stream_t on a reader thread and hands them in batches to worker threads, the
+        // parsed batches go to the sink in the order of the stream. The stages are connected by bounded lock-free
+        // queues, the reader waits when all batches are in flight, so a slow sink or slow workers hold back the
+        // reader instead of filling memory. The lines are not copied: lines of a stream that cannot be viewed are
+        // kept in the retained segments of the stream (see text_stream_t::readLine), lines of a view have to stay
+        // valid as long as the view.
+        class pipeline_t
+        {
+        public:
+            // 'memory' holds the batches, the queues and the std::thread objects, required() bytes for 'workers'
+            // workers. Starting the reader and worker threads allocates outside of it (their stacks and the state of
+            // std::thread), apart from that only the stream allocates, the segments of the lines in flight.
+            pipeline_t(buffer_t memory, config_t const& config = config_t());
+
+            static u32 required(s32 workers, config_t const& config = config_t());
+
+            // Run 'stream' through 'workers' (one thread each) into 'sink' until the end of the stream, returns the
+            // number of lines or -1 when 'memory' is too small for this number of workers.
+            s64 run(text_stream_t& stream, worker_t** workers, s32 num_workers, sink_t& sink);
+
+        private:
+            buffer_t m_memory;
+            config_t m_config;
+        };
+
+        // Parses parts of a text on a worker thread of a scheduler_t. Like worker_t every thread has its own
+        // chunk_worker_t, the parts arrive in any order.
+        class chunk_worker_t
+        {
+        public:
+            virtual ~chunk_worker_t() {}
+            virtual void parse(crunes_t const& chunk) = 0;
+        };
+
+        // A chunk worker that counts the matches of a parser2 program (see parser_t::findAll)
+        class find_worker_t : public chunk_worker_t
+        {
+        public:
+            find_worker_t(parser2::parser_t::program_t program) : m_program(program), m_matches(0) {}
+            virtual void parse(crunes_t const& chunk);
+
+            s64 matches() const { return m_matches; }
+
+        private:
+            parser2::parser_t::program_t m_program;
+            s64                          m_matches;
+        };
+
+        // Parses a text in memory on worker threads by work stealing. Every worker starts with an equal part of the
+        // text, it splits its current task in halves at line ends until the task is at most 'task_size' bytes, keeps
+        // the second halves in its own deque and parses the first. A worker without work steals the oldest (largest)
+        // task of another worker, so a region that is expensive to parse ends up shared by all workers instead of
+        // keeping one worker busy while the others are idle. Only ASCII and UTF-8 text is split, text in other
+        // encodings is parsed as one task.
+        class scheduler_t
+        {
+        public:
+            // 'memory' holds the deques and the std::thread objects, required() bytes for 'workers' workers. Starting
+            // the threads allocates outside of it (their stacks and the state of std::thread).
+            scheduler_t(buffer_t memory);
+
+            static u32 required(s32 workers);
+
+            // Parse 'text' with 'workers', the calling thread is the first worker and one thread is started for
+            // each of the others. Returns the number of tasks or -1 when 'memory' is too small.
+            s64 run(crunes_t const& text, chunk_worker_t** workers, s32 num_workers, u32 task_size = 65536);
+
+            s64 steals() const { return m_steals; } // tasks of the last run that were stolen
+
+        private:
+            buffer_t m_memory;
+            s64      m_steals;
+        };
+
+    } // namespace npipeline
+} // namespace ncore
+
+#endif // __CTEXT_TEXT_PIPELINE_H__
@@ -0,0 +1,89 @@
+#ifndef __CTEXT_TEXT_SCAN_H__
+#define __CTEXT_TEXT_SCAN_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+namespace ncore
+{
+    namespace nscan
+    {
+        // A set of bytes, one bit per byte value
+        struct byteset_t
+        {
+            inline byteset_t() { clear(); }
+
+            inline void clear() { m_bits[0] = m_bits[1] = m_bits[2] = m_bits[3] = 0; }
+            inline void fill() { m_bits[0] = m_bits[1] = m_bits[2] = m_bits[3] = 0xffffffffffffffffUL; }
+            inline void set(u8 b) { m_bits[b >> 6] |= ((u64)1 << (b & 63)); }
+            void        set(u8 from, u8 to);
+            inline bool has(u8 b) const { return (m_bits[b >> 6] & ((u64)1 << (b & 63))) != 0; }
+            inline void merge(byteset_t const& other)
+            {
+                for (s32 i = 0; i < 4; ++i)
+                    m_bits[i] |= other.m_bits[i];
+            }
+            inline void intersect(byteset_t const& other)
+            {
+                for (s32 i = 0; i < 4; ++i)
+                    m_bits[i] &= other.m_bits[i];
+            }
+            s32 count() const;
+            s32 first() const; // lowest byte in the set, -1 when empty
+
+            u64 m_bits[4];
+        };
+
+        // Returns a pointer to the first occurrence of 'c' in [str, end), or 'end' when not found.
+        // Uses SSE2 when available and falls back to 8 bytes per step (SWAR) otherwise.
+        u8 const* find_byte(u8 const* str, u8 const* end, u8 c);
+
+        // Same as find_byte but for either of two bytes (e.g. both cases of a letter)
+        u8 const* find_byte2(u8 const* str, u8 const* end, u8 c1, u8 c2);
+
+        // Returns a pointer to the first byte in [str, end) that is a member of 'set', or 'end'.
+        u8 const* find_in_set(u8 const* str, u8 const* end, byteset_t const& set);
+
+        // Classify 64 bytes at once: bit i of masks[j] is set when byte i of 'block' equals chars[j], for 'count'
+        // characters. 'block' has to hold 64 readable bytes. Uses SSE2 when available.
+        void match64(u8 const* block, u8 const* chars, s32 count, u64* masks);
+
+        // The block of 64 bytes at 'str' for match64. When fewer than 64 bytes are left before 'end' they are copied
+        // into 'tail' and padded with zeros, 'valid' is the mask of the bytes before 'end'.
+        u8 const* block64(u8 const* str, u8 const* end, u8* tail, u64& valid);
+
+        // Bit i of the result is the XOR of the bits 0 .. i of 'mask'. For a mask of quote characters this is the
+        // mask of the bytes inside quotes (the opening quote included, the closing quote not). Uses a carry-less
+        // multiply when available.
+        u64 prefix_xor(u64 mask);
+
+        // The bytes that are escaped by a backslash, from the mask of the backslashes of a block of 64 bytes. A run
+        // of backslashes escapes every second byte, 'carry' is 1 when the last byte of the previous block escapes
+        // the first byte of this block (start with 0) and is updated for the next block.
+        u64 escaped64(u64 backslashes, u64& carry);
+
+        // False when [str, end) is not UTF-8: a byte that cannot start a sequence, a missing continuation byte, an
+        // overlong encoding, a surrogate or a code point above U+10FFFF. A sequence that is cut off by 'end' is
+        // accepted, the rest of it can follow in the next block. 'ascii' is set when every byte is below 0x80. Runs
+        // of ASCII are skipped 16 bytes at a time with SSE2 (8 bytes at a time otherwise).
+        bool validate_utf8(u8 const* str, u8 const* end, bool& ascii);
+
+        // Number of bytes at the end of [str, end) that start a UTF-8 sequence which 'end' cuts off, 0 when the last
+        // sequence is complete. Only the last 4 bytes are looked at.
+        u32 utf8_incomplete(u8 const* str, u8 const* end);
+
+        // 'ptr' rounded up to the alignment of a pointer, used to carve structures from a buffer
+        inline u8* align_ptr(u8* ptr) { return (u8*)(((ptr_t)ptr + (sizeof(void*) - 1)) & ~((ptr_t)sizeof(void*) - 1)); }
+
+        // Index of the lowest set bit of 'mask', which is not 0
+#if defined(__GNUC__) || defined(__clang__)
+        inline s32 lowest_bit64(u64 mask) { return __builtin_ctzll(mask); }
+#else
+        s32 lowest_bit64(u64 mask);
+#endif
+
+    } // namespace nscan
+} // namespace ncore
+
+#endif // __CTEXT_TEXT_SCAN_H__
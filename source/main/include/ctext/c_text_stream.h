@@ -11,6 +11,7 @@
 namespace ncore
 {
     struct crunes_t;
+    class alloc_t;
 
     class text_stream_t : protected istream_t
     {
@@ -22,24 +23,88 @@ namespace ncore
             encoding_utf16 = utf16::TYPE,
             encoding_utf32 = utf32::TYPE
         };
-        text_stream_t(istream_t* stream, encoding e = encoding_utf8);
+        // The buffer is only allocated (from 'allocator', the system allocator when null) when the stream cannot
+        // be viewed, it is allocated once and only grows when a line or record is longer than 'buffer_size'.
+        text_stream_t(istream_t* stream, encoding e = encoding_utf8, alloc_t* allocator = nullptr, u32 buffer_size = 4096);
 
         bool readText(crunes_t& line, s64 length);
         bool readLine(crunes_t& line);
 
+        // Lines that stay valid after the next refill, e.g. to hand batches of lines to other threads without
+        // copying them. The buffer is a reference counted segment, this readLine adds a reference for the caller
+        // to the segment that holds 'line'. A segment that is still referenced is not reused by a refill, the refill
+        // takes a released segment from a free list or allocates one when the list is empty. The last release of a
+        // segment (from any thread) puts it back on the free list, the segments are freed when the stream has been
+        // closed and the last of them is released (the allocator then has to allow freeing from that thread). A
+        // reader that keeps a bounded number of lines in flight therefore stops allocating once it has as many
+        // segments as it keeps in flight. When the stream can be viewed the line points into the view and 'segment'
+        // is null, the line is then valid as long as the view of the underlying stream.
+        struct segment_t;
+        struct segment_pool_t;
+        bool        readLine(crunes_t& line, segment_t*& segment);
+        static void retain(segment_t* segment);
+        static void release(segment_t* segment);
+
+        // Direct access to the buffer, to parse records (that can span lines) without copying them out of the
+        // stream. 'window' gives the text that has not been consumed yet, 'more' extends it with the next part
+        // of the stream and returns false at the end of the stream. When the stream can be viewed the text is
+        // not copied, the window is re-based to start at the first unconsumed character though, cursors into a
+        // previous window are invalid after calling 'more'.
+        void window(crunes_t& text) const { text = m_buffer_text; }
+        bool more();
+        void consume(u32 cursor); // 'cursor' is a cursor of the window text, everything before it is consumed
+
         void close() { v_close(); }
 
+        u32 capacity() const { return m_buffer_cap; } // size of the buffer (or view) in bytes
+
+        // A UTF-8 stream validates the bytes that are new in the window every time it is extended, a sequence that is
+        // cut off by the end of the stream is invalid. When the window is pure ASCII it is handed out (window, lines
+        // and text) as ASCII: the bytes and cursors are the same, but readers (nrunes::reader_t and so parser2 and
+        // combparser) then index it byte by byte without decoding multi-byte sequences.
+        bool is_ascii() const { return m_ascii; } // the window is pure ASCII, always true for an ASCII stream
+        bool is_utf8() const { return m_utf8; }   // no invalid UTF-8 has been read, false for UTF-16 and UTF-32
+
+        // Counters of the work done by the stream. The counting is compiled out unless ctext is built with
+        // CTEXT_TEXT_STREAM_STATS, stats() then returns false and the stream pays nothing. The layout of the stream
+        // does not depend on the define.
+        struct stats_t
+        {
+            u64 m_bytes_read;    // bytes read or viewed from the underlying stream, not counting the carried bytes
+            u64 m_refills;       // calls of 'more' that extended the text
+            u64 m_views;         // views of the underlying stream (instead of reads)
+            u64 m_rewinds;       // setPos calls that moved the underlying stream back to re-view unconsumed text
+            u64 m_bytes_carried; // unconsumed bytes kept (copied or re-viewed) when extending the text
+            u64 m_ascii_windows; // windows of a UTF-8 stream that were pure ASCII
+            u64 m_lines;         // lines returned by readLine
+            u32 m_longest_line;  // in bytes, including the end-of-line
+            u64 m_stream_ns;     // time spent in the underlying stream
+            u64 m_split_ns;      // time spent searching for line ends
+        };
+        bool stats(stats_t& stats) const;
+        void reset_stats();
+
     protected:
-        istream_t* m_stream;
-        s64        m_stream_pos;
-        u64        m_stream_len;
-        u8*        m_buffer_data;
-        u8 const*  m_buffer_data0;
-        u32        m_buffer_cap;
-        u32        m_buffer_size;
-        crunes_t   m_buffer_text;
+        istream_t*      m_stream;
+        alloc_t*        m_allocator;
+        s64             m_stream_pos;
+        u64             m_stream_len;
+        s64             m_ascii_pos; // stream position after the last byte that is not ASCII
+        u8*             m_buffer_data;
+        segment_t*      m_segment; // holds m_buffer_data
+        segment_pool_t* m_pool;    // released segments, created when a line is retained over a refill
+        u8 const*       m_buffer_data0;
+        u32             m_buffer_cap;
+        u32             m_buffer_size;
+        crunes_t        m_buffer_text;
+        u8              m_encoding;
+        bool            m_ascii;
+        bool            m_utf8;
+        stats_t         m_stats;
 
         bool grabLine(crunes_t& line);
+        void validate(u32 rest);
+        void validate_end();
 
         virtual bool v_canSeek() const;
         virtual bool v_canRead() const;
@@ -0,0 +1,435 @@
+#ifndef __CTEXT_PARSER2_MACHINE_H__
+#define __CTEXT_PARSER2_MACHINE_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cbase/c_buffer.h"
+#include "cbase/c_va_list.h"
+#include "cbase/c_runes.h"
+
+#include "ctext/c_parser2.h"
+#include "ctext/c_text_scan.h"
+
+#if defined(CTEXT_PARSER2_PROFILE)
+#    include <chrono>
+#endif
+
+// Internal to ctext, the bytecode and the virtual machine that executes parser2 programs.
+
+namespace ncore
+{
+    namespace parser2
+    {
+        enum eOpcode
+        {
+            eNOP = 0,
+            // Manipulators (scope)
+            eNot,
+            eOr,
+            eAnd,
+            eSequence,
+            eWithin,
+            eTimes,
+            eOneOrMore,
+            eZeroOrMore,
+            eZeroOrOne,
+            eWhile,
+            eUntil,
+            eExtract,
+            eEnclosed,
+            // Filters
+            eAny = 0x80,
+            eDigest,
+            eIn,
+            eBetween,
+            eAlphabet,
+            eDigit,
+            eHex,
+            eAlphaNumeric,
+            eExact,
+            eLike,
+            eWhiteSpace,
+            eIs,
+            eDecimal,
+            eWord,
+            eEndOfText,
+            eEndOfLine,
+            eUnsigned32,
+            eUnsigned64,
+            eInteger32,
+            eInteger64,
+            eFloat32,
+            eFloat64,
+            eUnsignedDigits, // And(Within(Digit(), lo, hi), Unsigned64(min, max)), created by the optimizer
+            // Utils
+            eIPv4 = 0x40,
+            eHost,
+            eEmail,
+            ePhone,
+            eServerAddress,
+            eUri,
+            // A sub-program that runs as a DFA, the opcode is eRegular + index of the DFA in the machine,
+            // operands and calls of the original instruction are kept as-is.
+            eRegular = 0xC0,
+        };
+
+        // A regular sub-program compiled to a DFA. A state is a position of the (Glushkov) automaton, state 0 is
+        // the start state. Transitions are resolved the first time they are taken and cached in 'm_table'.
+        struct regular_t
+        {
+            static const s32 cMaxPositions = 64;
+            static const u8  cUnknown      = 0xff; // transition not resolved yet
+            static const u8  cDead         = 0xfe; // no transition, the match ends
+
+            u8                m_opcode;      // the original opcode of the instruction
+            u16               m_num_classes; // number of byte classes
+            u8                m_num_states;  // number of positions + 1
+            u8                m_accept[cMaxPositions + 1];
+            u8                m_classes[256];
+            u8                m_class_byte[256]; // a byte that is a member of the class
+            u64*              m_follow;          // [m_num_states] positions that can follow a state
+            nscan::byteset_t* m_sets;            // [m_num_states - 1] the bytes a position matches
+            u8*               m_table;           // [m_num_states][m_num_classes]
+        };
+
+        // Text written to a buffer of the user, the length is counted also when the buffer is too small
+        struct text_t
+        {
+            text_t(char* str, s32 size) : m_str(str), m_size(size), m_len(0) {}
+
+            void put(char c)
+            {
+                if (m_len < m_size)
+                    m_str[m_len] = c;
+                m_len += 1;
+            }
+            void put(const char* str)
+            {
+                while (*str != 0)
+                    put(*str++);
+            }
+            void put(u64 v, s32 width = 0)
+            {
+                char digits[20];
+                s32  n = 0;
+                do
+                {
+                    digits[n++] = (char)('0' + (v % 10));
+                    v /= 10;
+                } while (v != 0);
+                for (s32 i = n; i < width; ++i)
+                    put(' ');
+                while (n > 0)
+                    put(digits[--n]);
+            }
+            void put(s64 v)
+            {
+                if (v < 0)
+                {
+                    put('-');
+                    put((u64)0 - (u64)v);
+                }
+                else
+                {
+                    put((u64)v);
+                }
+            }
+            s32 end() // zero terminate when there is room, returns the length
+            {
+                if (m_len < m_size)
+                    m_str[m_len] = 0;
+                return m_len;
+            }
+
+            char* m_str;
+            s32   m_size;
+            s32   m_len;
+        };
+
+        class machine_t
+        {
+        public:
+            static const s32 cMaxRegular = 0x100 - eRegular;
+
+            machine_t() : m_code(), m_program(), m_regular(nullptr), m_num_regular(0), m_size(0), m_capacity(0), m_error(false), m_counters(nullptr), m_num_counters(0) {}
+
+            struct operands_t
+            {
+                static s32     read_s32(binary_reader_t& reader) { return reader.read_s32(); }
+                static s64     read_s64(binary_reader_t& reader) { return reader.read_s64(); }
+                static u8      read_u8(binary_reader_t& reader) { return reader.read_u8(); }
+                static u32     read_u32(binary_reader_t& reader) { return reader.read_u32(); }
+                static uchar32 read_uchar32(binary_reader_t& reader) { return (uchar32)reader.read_u32(); }
+                static u64     read_u64(binary_reader_t& reader) { return reader.read_u64(); }
+                static f32     read_f32(binary_reader_t& reader) { return reader.read_f32(); }
+                static f64     read_f64(binary_reader_t& reader) { return reader.read_f64(); }
+                static va_r_t* read_var(binary_reader_t& reader)
+                {
+                    va_r_t* var = (va_r_t*)reader.read_u64();
+                    return var;
+                }
+                static crunes_t read_crunes(binary_reader_t& reader)
+                {
+                    u8 const    str_type  = reader.read_u8();
+                    const char* str_begin = (const char*)reader.read_u64();
+                    const char* str_end   = (const char*)reader.read_u64();
+
+                    crunes_t str;
+                    str.m_type  = str_type;
+                    str.m_ascii = str_begin;
+                    str.m_str   = 0;
+                    str.m_eos   = (u32)(str_end - str_begin);
+                    str.m_end   = str.m_eos;
+                    return str;
+                }
+            };
+
+            nrunes::writer_t* get_writer(u32 channel) { return nullptr; }
+
+            binary_writer_t m_code;
+            binary_reader_t m_program;
+            regular_t**     m_regular; // [cMaxRegular]
+            s32             m_num_regular;
+            u32             m_size;     // size of the code, also when it did not fit in the buffer
+            u32             m_capacity; // size of the buffer for the code
+            bool            m_error;    // the buffer is too small for the code
+
+            parser_t::counter_t* m_counters;     // [m_num_counters] per pc, only used with CTEXT_PARSER2_PROFILE
+            u32                  m_num_counters; //
+
+            struct context_t
+            {
+                context_t(nrunes::reader_t const& _reader) : reader(_reader), hit_end(false), reach(_reader.get_cursor()) {}
+                u32              get_cursor() const { return reader.get_cursor(); }
+                void             set_cursor(u32 const& c) { reader.set_cursor(c); }
+                void             examine() // called wherever the text is examined
+                {
+                    u32 const cursor = reader.get_cursor();
+                    hit_end |= !reader.valid();
+                    reach = (cursor > reach) ? cursor : reach;
+                }
+                nrunes::reader_t reader;
+                bool             hit_end; // the end of the text has been examined, more text can change the result
+                u32              reach;   // the furthest position that has been examined
+            };
+            typedef parser_t::pc_t pc_t;
+
+            // All code is written here. When the buffer is full nothing is written anymore but 'm_size' keeps counting,
+            // it is the exact size of the code of all the programs that have been built.
+            template <typename T> void write(T v)
+            {
+                if (!m_error && (m_size + (u32)sizeof(T)) <= m_capacity)
+                    m_code.write(v);
+                else
+                    m_error = true;
+                m_size += (u32)sizeof(T);
+            }
+            void write(va_r_t* var) { write((u64)var); }
+
+            inline void                emit_instr(eOpcode o) { write((u8)o); }
+            template <typename T> void emit_instr(eOpcode o, T _a)
+            {
+                emit_instr(o);
+                write(_a);
+            }
+            template <typename T1, typename T2> void emit_instr(eOpcode o, T1 _a, T2 _b)
+            {
+                emit_instr(o);
+                write(_a);
+                write(_b);
+            }
+            void emit_instr(eOpcode o, crunes_t const& runes)
+            {
+                emit_instr(o);
+                write((u8)runes.m_type);
+                write((u64)(runes.m_ascii + runes.m_str));
+                write((u64)(runes.m_ascii + runes.m_end));
+            }
+            void emit_instr(eOpcode o, va_r_t var)
+            {
+                emit_instr(o);
+                write((u16)var.mType);
+                write((u64)var.mRef);
+            }
+            void emit_call(pc_t pc1) { write(pc1); }
+            void emit_calls(pc_t pc1)
+            {
+                write((u16)1);
+                emit_call(pc1);
+            }
+            void emit_calls(pc_t pc1, pc_t pc2)
+            {
+                write((u16)2);
+                emit_call(pc1);
+                emit_call(pc2);
+            }
+            void emit_calls(pc_t pc1, pc_t pc2, pc_t pc3)
+            {
+                write((u16)3);
+                emit_call(pc1);
+                emit_call(pc2);
+                emit_call(pc3);
+            }
+            void emit_calls(pc_t pc1, pc_t pc2, pc_t pc3, pc_t pc4)
+            {
+                write((u16)4);
+                emit_call(pc1);
+                emit_call(pc2);
+                emit_call(pc3);
+                emit_call(pc4);
+            }
+
+            inline pc_t pc() const { return (pc_t)m_size; }
+
+            inline pc_t read_pc() { return (pc_t)m_program.read_u32(); }
+
+            inline pc_t exec_jmp()
+            {
+                pc_t const pos = (pc_t)m_program.pos();
+                pc_t const pc  = read_pc();
+                m_program.seek(pc);
+                return pos;
+            }
+
+            inline void skip_jmp()
+            {
+                // skip a call entry
+                read_pc();
+            }
+
+            inline void skip_count()
+            {
+                // skip the number of call entries of a single operand manipulator
+                m_program.read_u16();
+            }
+
+            // Decoded form of a single instruction, used by the analysis passes (e.g. FIRST set)
+            struct instr_t
+            {
+                eOpcode  m_opcode;
+                u16      m_ncalls; // number of call entries
+                pc_t     m_calls;  // position of the first call entry
+                s64      m_a;      // integer operands
+                s64      m_b;
+                f64      m_fa; // float operands
+                f64      m_fb;
+                crunes_t m_text;      // eIn, eExact, eLike
+                u8       m_digits[2]; // eUnsignedDigits, the least and most number of digits
+                u32      m_size;      // bytes of code of the instruction, including its call entries
+            };
+
+            static inline bool is_scope(eOpcode o) { return o >= eNot && o <= eEnclosed; }
+
+            // The bytes of an instruction that matches a single ASCII character (not 0), for the code generators
+            static bool ascii_class(instr_t const& instr, nscan::byteset_t& set);
+
+            void decode(pc_t pc, instr_t& instr) const;
+            pc_t call(instr_t const& instr, s32 index) const;
+
+            // The set of bytes a program can start with, 'nullable' means that it can match without consuming anything
+            struct first_t
+            {
+                nscan::byteset_t m_set;
+                bool             m_nullable;
+            };
+            void first(pc_t pc, first_t& f) const;
+
+            // Scan forward from the cursor of 'reader' for the first position where 'prog' matches
+            bool search(parser_t::program_t const& prog, first_t const& first, nrunes::reader_t const& reader, u32& begin, u32& end);
+
+            // Find the regular sub-programs of 'pc' and compile them into DFAs, returns the number of compiled sub-programs
+            s32 compile(pc_t pc, buffer_t& memory);
+
+            bool fnOpcodeIs(eOpcode) const;
+            bool fnExec(context_t& ctxt);
+            bool fnRun(context_t& ctxt);
+#if defined(CTEXT_PARSER2_PROFILE)
+            bool fnProfile(context_t& ctxt);
+#endif
+            bool fnDispatch(context_t& ctxt, eOpcode o);
+            bool fnRegular(context_t& ctxt, regular_t* r);
+            bool fnNot(context_t& ctxt);
+            bool fnOr(context_t& ctxt);
+            bool fnAnd(context_t& ctxt);
+            bool fnSequence(context_t& ctxt);
+            bool fnWithin(context_t& ctxt, s32 _min, s32 _max);
+            bool fnTimes(context_t& ctxt, s32 _count);
+            bool fnOneOrMore(context_t& ctxt);
+            bool fnZeroOrMore(context_t& ctxt);
+            bool fnZeroOrOne(context_t& ctxt);
+            bool fnWhile(context_t& ctxt);
+            bool fnUntil(context_t& ctxt);
+            bool fnExtract(context_t& ctxt, va_r_t* var);
+            bool fnEnclosed(context_t& ctxt, uchar32 _open, uchar32 _close);
+
+            bool fnAny(context_t& ctxt);
+            bool fnDigest(context_t& ctxt, u8 flags);
+            bool fnIn(context_t& ctxt, nrunes::reader_t _chars);
+            bool fnBetween(context_t& ctxt, uchar32 _from, uchar32 _until);
+            bool fnAlphabet(context_t& ctxt);
+            bool fnDigit(context_t& ctxt);
+            bool fnHex(context_t& ctxt);
+            bool fnAlphaNumeric(context_t& ctxt);
+            bool fnExact(context_t& ctxt, nrunes::reader_t _text); // Case-Sensitive
+            bool fnLike(context_t& ctxt, nrunes::reader_t _text);  // Case-Insensitive
+            bool fnWhiteSpace(context_t& ctxt);
+            bool fnIs(context_t& ctxt, uchar32 _c);
+            bool fnWord(context_t& ctxt);
+            bool fnEndOfText(context_t& ctxt);
+            bool fnEndOfLine(context_t& ctxt);
+            bool fnUnsigned32(context_t& ctxt, u32 _min, u32 _max);
+            bool fnUnsigned64(context_t& ctxt, u64 _min, u64 _max);
+            bool fnInteger32(context_t& ctxt, s32 _min, s32 _max);
+            bool fnInteger64(context_t& ctxt, s64 _min, s64 _max);
+            bool fnFloat32(context_t& ctxt, f32 _min, f32 _max);
+            bool fnFloat64(context_t& ctxt, f64 _min, f64 _max);
+            bool fnDecimal(context_t& ctxt);
+            bool fnUnsignedDigits(context_t& ctxt, u64 _min, u64 _max, s32 _lo, s32 _hi);
+
+            parser_t::program_t initialize(buffer_t buffer)
+            {
+                m_code     = binary_writer_t(buffer.m_begin, buffer.m_end);
+                m_size     = 0;
+                m_capacity = (u32)buffer.size();
+                m_error    = false;
+                m_counters     = nullptr;
+                m_num_counters = 0;
+                return parser_t::program_t(this, 0);
+            }
+
+            bool execute(parser_t::program_t const& prog, nrunes::reader_t const& reader, u32& cursor, bool* hit_end = nullptr, u32* reach = nullptr)
+            {
+                if (m_error)
+                    return false;
+                context_t ctxt(reader);
+                ctxt.reader.set_cursor(cursor);
+                ctxt.reach = cursor;
+                buffer_t code = m_code.get_current_buffer();
+                m_program     = binary_reader_t(code.m_begin, code.m_end);
+                m_program.seek(prog.pc());
+#if defined(CTEXT_PARSER2_PROFILE)
+                std::chrono::steady_clock::time_point const begin = std::chrono::steady_clock::now();
+#endif
+                bool const result = fnRun(ctxt);
+#if defined(CTEXT_PARSER2_PROFILE)
+                if (prog.pc() < m_num_counters)
+                    m_counters[prog.pc()].m_time += (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+#endif
+                if (hit_end != nullptr)
+                    *hit_end = ctxt.hit_end;
+                if (reach != nullptr)
+                    *reach = ctxt.reach;
+                if (result)
+                    cursor = ctxt.get_cursor();
+                return result;
+            }
+
+            DCORE_CLASS_PLACEMENT_NEW_DELETE
+        };
+
+    } // namespace parser2
+} // namespace ncore
+
+#endif // __CTEXT_PARSER2_MACHINE_H__
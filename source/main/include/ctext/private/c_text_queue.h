@@ -0,0 +1,238 @@
+#ifndef __CTEXT_TEXT_QUEUE_H__
+#define __CTEXT_TEXT_QUEUE_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include <atomic>
+#include <new>
+
+// Internal to ctext, bounded lock-free queues that connect the threads of a pipeline and the deques of the
+// work-stealing scheduler.
+
+namespace ncore
+{
+    namespace npipeline
+    {
+        static const u32 cCacheLine = 64;
+
+        // Spin a little, then give up the time slice, used while waiting for a queue
+        void backoff(s32& spins);
+
+        // Single producer, single consumer. 'capacity' is a power of two, push() returns false when the queue is
+        // full and pop() when it is empty. Both sides keep a copy of the index of the other side and only read
+        // the shared index when their copy says full or empty.
+        class spsc_queue_t
+        {
+        public:
+            static u32 required(u32 capacity) { return capacity * (u32)sizeof(void*); }
+
+            void initialize(void* memory, u32 capacity)
+            {
+                m_items = (void**)memory;
+                m_mask  = capacity - 1;
+                m_head.store(0, std::memory_order_relaxed);
+                m_tail.store(0, std::memory_order_relaxed);
+                m_head_cache = 0;
+                m_tail_cache = 0;
+            }
+
+            bool push(void* item)
+            {
+                u32 const head = m_head.load(std::memory_order_relaxed);
+                if ((head - m_tail_cache) > m_mask)
+                {
+                    m_tail_cache = m_tail.load(std::memory_order_acquire);
+                    if ((head - m_tail_cache) > m_mask)
+                        return false;
+                }
+                m_items[head & m_mask] = item;
+                m_head.store(head + 1, std::memory_order_release);
+                return true;
+            }
+
+            bool pop(void*& item)
+            {
+                u32 const tail = m_tail.load(std::memory_order_relaxed);
+                if (tail == m_head_cache)
+                {
+                    m_head_cache = m_head.load(std::memory_order_acquire);
+                    if (tail == m_head_cache)
+                        return false;
+                }
+                item = m_items[tail & m_mask];
+                m_tail.store(tail + 1, std::memory_order_release);
+                return true;
+            }
+
+        private:
+            void** m_items;
+            u32    m_mask;
+            alignas(cCacheLine) std::atomic<u32> m_head; // written by the producer
+            u32 m_tail_cache;                            //
+            alignas(cCacheLine) std::atomic<u32> m_tail; // written by the consumer
+            u32 m_head_cache;                            //
+        };
+
+        // Multiple producers, multiple consumers (D. Vyukov's bounded queue). Every cell has a sequence number that
+        // tells whether it is free for the push or filled for the pop at a position, producers and consumers only
+        // contend on their own index. 'capacity' is a power of two.
+        class mpmc_queue_t
+        {
+        public:
+            static u32 required(u32 capacity) { return capacity * (u32)sizeof(cell_t); }
+
+            void initialize(void* memory, u32 capacity)
+            {
+                m_cells = (cell_t*)memory;
+                m_mask  = capacity - 1;
+                for (u32 i = 0; i < capacity; ++i)
+                {
+                    cell_t* cell = new (&m_cells[i]) cell_t();
+                    cell->m_sequence.store(i, std::memory_order_relaxed);
+                    cell->m_item = nullptr;
+                }
+                m_push.store(0, std::memory_order_relaxed);
+                m_pop.store(0, std::memory_order_relaxed);
+            }
+
+            bool push(void* item)
+            {
+                cell_t* cell;
+                u32     pos = m_push.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    cell           = &m_cells[pos & m_mask];
+                    u32 const seq  = cell->m_sequence.load(std::memory_order_acquire);
+                    s32 const diff = (s32)(seq - pos);
+                    if (diff == 0)
+                    {
+                        if (m_push.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                            break;
+                    }
+                    else if (diff < 0)
+                    {
+                        return false;
+                    }
+                    else
+                    {
+                        pos = m_push.load(std::memory_order_relaxed);
+                    }
+                }
+                cell->m_item = item;
+                cell->m_sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+
+            bool pop(void*& item)
+            {
+                cell_t* cell;
+                u32     pos = m_pop.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    cell           = &m_cells[pos & m_mask];
+                    u32 const seq  = cell->m_sequence.load(std::memory_order_acquire);
+                    s32 const diff = (s32)(seq - (pos + 1));
+                    if (diff == 0)
+                    {
+                        if (m_pop.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                            break;
+                    }
+                    else if (diff < 0)
+                    {
+                        return false;
+                    }
+                    else
+                    {
+                        pos = m_pop.load(std::memory_order_relaxed);
+                    }
+                }
+                item = cell->m_item;
+                cell->m_sequence.store(pos + m_mask + 1, std::memory_order_release);
+                return true;
+            }
+
+        private:
+            struct cell_t
+            {
+                std::atomic<u32> m_sequence;
+                void*            m_item;
+            };
+
+            cell_t* m_cells;
+            u32     m_mask;
+            alignas(cCacheLine) std::atomic<u32> m_push;
+            alignas(cCacheLine) std::atomic<u32> m_pop;
+        };
+
+        // Work-stealing deque of a worker (Chase and Lev, bounded). The owner pushes and pops at the bottom, the
+        // newest task first, other workers steal from the top, the oldest task. push() returns false when the deque
+        // is full, pop() and steal() return false when it is empty or when they lost the race for the last task.
+        class deque_t
+        {
+        public:
+            static u32 required(u32 capacity) { return capacity * (u32)sizeof(std::atomic<u64>); }
+
+            void initialize(void* memory, u32 capacity)
+            {
+                m_items = (std::atomic<u64>*)memory;
+                m_mask  = (s32)capacity - 1;
+                for (u32 i = 0; i < capacity; ++i)
+                    new (&m_items[i]) std::atomic<u64>(0);
+                m_top.store(0, std::memory_order_relaxed);
+                m_bottom.store(0, std::memory_order_relaxed);
+            }
+
+            bool push(u64 item)
+            {
+                s32 const b = m_bottom.load(std::memory_order_relaxed);
+                s32 const t = m_top.load(std::memory_order_acquire);
+                if ((b - t) > m_mask)
+                    return false;
+                m_items[b & m_mask].store(item, std::memory_order_relaxed);
+                m_bottom.store(b + 1, std::memory_order_release);
+                return true;
+            }
+
+            bool pop(u64& item)
+            {
+                s32 const b = m_bottom.load(std::memory_order_relaxed) - 1;
+                m_bottom.store(b, std::memory_order_seq_cst);
+                s32 t = m_top.load(std::memory_order_seq_cst);
+                if (t > b)
+                {
+                    m_bottom.store(b + 1, std::memory_order_relaxed);
+                    return false;
+                }
+                item = m_items[b & m_mask].load(std::memory_order_relaxed);
+                if (t < b)
+                    return true;
+
+                // The last task, a thief can take it at the same time
+                bool const won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+                return won;
+            }
+
+            bool steal(u64& item)
+            {
+                s32 t       = m_top.load(std::memory_order_seq_cst);
+                s32 const b = m_bottom.load(std::memory_order_seq_cst);
+                if (t >= b)
+                    return false;
+                item = m_items[t & m_mask].load(std::memory_order_relaxed);
+                return m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            }
+
+        private:
+            std::atomic<u64>* m_items;
+            s32               m_mask;
+            alignas(cCacheLine) std::atomic<s32> m_top;    // taken by thieves
+            alignas(cCacheLine) std::atomic<s32> m_bottom; // written by the owner
+        };
+
+    } // namespace npipeline
+} // namespace ncore
+
+#endif // __CTEXT_TEXT_QUEUE_H__
@@ -0,0 +1,63 @@
+#ifndef __CTEXT_TEST_STREAM_H__
+#define __CTEXT_TEST_STREAM_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "ccore/c_stream.h"
+
+// Internal to the ctext unittests, shared by the test suites.
+
+namespace ncore
+{
+    // A stream over text in memory, it can be viewed unless 'view' is false and then text_stream_t has to copy the
+    // text into its own buffer
+    class memory_stream_t : public istream_t
+    {
+        u8 const* m_buffer;
+        u64       m_size;
+        u64       m_cursor;
+        bool      m_view;
+
+    public:
+        memory_stream_t(u8 const* data, u64 size, bool view = true) : m_buffer(data), m_size(size), m_cursor(0), m_view(view) {}
+
+    protected:
+        virtual bool v_canSeek() const { return true; }
+        virtual bool v_canRead() const { return true; }
+        virtual bool v_canWrite() const { return false; }
+        virtual bool v_canView() const { return m_view; }
+        virtual void v_flush() {}
+        virtual void v_close() {}
+        virtual u64  v_getLength() const { return m_size; }
+        virtual void v_setLength(u64) {}
+        virtual s64  v_setPos(s64 pos)
+        {
+            m_cursor = ((u64)pos < m_size) ? (u64)pos : m_size;
+            return (s64)m_cursor;
+        }
+        virtual s64 v_getPos() const { return (s64)m_cursor; }
+        virtual s64 v_view(u8 const*& buffer, s64 count)
+        {
+            if ((u64)count > (m_size - m_cursor))
+                count = (s64)(m_size - m_cursor);
+            buffer = (count > 0) ? m_buffer + m_cursor : nullptr;
+            m_cursor += (u64)count;
+            return count;
+        }
+        virtual s64 v_read(u8* buffer, s64 count)
+        {
+            if ((u64)count > (m_size - m_cursor))
+                count = (s64)(m_size - m_cursor);
+            for (s64 i = 0; i < count; ++i)
+                buffer[i] = m_buffer[m_cursor + i];
+            m_cursor += (u64)count;
+            return count;
+        }
+        virtual s64 v_write(const u8*, s64) { return -1; }
+    };
+
+} // namespace ncore
+
+#endif // __CTEXT_TEST_STREAM_H__
@@ -1,4 +1,5 @@
 #include "cbase/c_allocator.h"
+#include "cbase/c_buffer.h"
 #include "cbase/c_runes.h"
 #include "ctext/c_parser.h"
 #include "cunittest/cunittest.h"
@@ -29,6 +30,48 @@ UNITTEST_SUITE_BEGIN(test_parser)
 			combparser::utils::Email email;
             CHECK_TRUE(email.Check(reader));
 		}
+
+		UNITTEST_TEST(test_compiled)
+		{
+			u8 data[4096];
+			combparser::utils::Email email;
+			combparser::Compiled compiled(email, buffer_t(data, data + sizeof(data)));
+			CHECK_TRUE(compiled.IsCompiled());
+
+			const char* texts[] = {"john.doe@gmail.com", "jane@10.0.0.1", "@nobody.org", "a.b.c@host-name.com.", "x@"};
+			for (s32 i = 0; i < 5; ++i)
+			{
+				nrunes::reader_t reader1(texts[i]);
+				nrunes::reader_t reader2(texts[i]);
+				CHECK_EQUAL(email.Check(reader1), compiled.Check(reader2));
+				CHECK_EQUAL(reader1.get_cursor(), reader2.get_cursor());
+			}
+		}
+
+		UNITTEST_TEST(test_compiled_fallback)
+		{
+			u8 data[1024];
+			nrunes::reader_t selection;
+			combparser::manipulators::Extract extract(selection, combparser::filters::sWord);
+			combparser::Compiled compiled(extract, buffer_t(data, data + sizeof(data)));
+			CHECK_FALSE(compiled.IsCompiled());
+
+			nrunes::reader_t reader("hello world");
+			CHECK_TRUE(compiled.Check(reader));
+			CHECK_TRUE(nrunes::starts_with(selection.get_current(), ascii::make_crunes("hello")));
+		}
+
+		UNITTEST_TEST(test_compiled_buffer_too_small)
+		{
+			// The program does not fit, the rule is not compiled and runs through its own Check
+			u8 data[256];
+			combparser::utils::Email email;
+			combparser::Compiled compiled(email, buffer_t(data, data + sizeof(data)));
+			CHECK_FALSE(compiled.IsCompiled());
+
+			nrunes::reader_t reader("john.doe@gmail.com");
+			CHECK_TRUE(compiled.Check(reader));
+		}
 	}
 }
 UNITTEST_SUITE_END
@@ -15,6 +15,67 @@ namespace ncore
     }
 } // namespace ncore
 
+// Text of 'lines' lines "key<n> = <n>\n"
+static u32 write_config(char* text, s32 lines)
+{
+    char* cursor = text;
+    for (s32 i = 0; i < lines; ++i)
+    {
+        char digits[10];
+        s32  n = 0;
+        u32  v = (u32)i;
+        do
+        {
+            digits[n++] = (char)('0' + (v % 10));
+            v /= 10;
+        } while (v != 0);
+
+        const char* key = "key";
+        while (*key != 0)
+            *cursor++ = *key++;
+        for (s32 d = n - 1; d >= 0; --d)
+            *cursor++ = digits[d];
+        *cursor++ = ' ';
+        *cursor++ = '=';
+        *cursor++ = ' ';
+        for (s32 d = n - 1; d >= 0; --d)
+            *cursor++ = digits[d];
+        *cursor++ = '\n';
+    }
+    return (u32)(cursor - text);
+}
+
+// Replace 'from' .. 'to' of 'text' (of 'size' characters) by 'insert', returns the new size
+static u32 edit_text(char* text, u32 size, u32 from, u32 to, const char* insert)
+{
+    u32 n = 0;
+    while (insert[n] != 0)
+        n++;
+    if (n > to - from)
+    {
+        for (u32 i = size; i > to; --i)
+            text[i - 1 + n - (to - from)] = text[i - 1];
+    }
+    else if (n < to - from)
+    {
+        for (u32 i = to; i < size; ++i)
+            text[i - (to - from) + n] = text[i];
+    }
+    for (u32 i = 0; i < n; ++i)
+        text[from + i] = insert[i];
+    return size - (to - from) + n;
+}
+
+// A grammar of more than 64 KB of code, the program at the end calls programs at both ends of the code
+static parser2::parser_t::program_t large_grammar(parser2::parser_t& parser)
+{
+    parser2::parser_t::program_t email = parser.Email();
+    while (parser.code_size() < 0x10000)
+        parser.Any();
+    parser2::parser_t::program_t ipv4 = parser.IPv4();
+    return parser.Sequence(email, parser.Is(' '), ipv4);
+}
+
 UNITTEST_SUITE_BEGIN(test_parser2)
 {
     UNITTEST_FIXTURE(main)
@@ -29,6 +90,546 @@ UNITTEST_SUITE_BEGIN(test_parser2)
             parser2::parser_t parser(buffer);
 
         }
+
+        UNITTEST_TEST(test_parse_email_and_ipv4)
+        {
+            u8                data[4096];
+            parser2::parser_t parser(buffer_t(data, data + sizeof(data)));
+
+            parser2::parser_t::program_t email = parser.Email();
+            parser2::parser_t::program_t ipv4  = parser.IPv4();
+
+            nrunes::reader_t reader1("john.doe@hotmail.com");
+            CHECK_TRUE(parser2::parser_t::parse(email, reader1));
+            CHECK_FALSE(reader1.valid());
+
+            nrunes::reader_t reader2("10.0.8.9");
+            CHECK_TRUE(parser2::parser_t::parse(ipv4, reader2));
+
+            nrunes::reader_t reader3("10.0.800.9");
+            CHECK_FALSE(parser2::parser_t::parse(ipv4, reader3));
+        }
+
+        UNITTEST_TEST(test_required_memory)
+        {
+            u8                data[4096];
+            parser2::parser_t parser(buffer_t(data, data + sizeof(data)));
+            u32 const         empty = parser.size();
+            parser.Email();
+            u32 const code = parser.size() - empty;
+            CHECK_TRUE(code > 0);
+
+            // A buffer of the required size holds the same program
+            u32 const         required = parser2::parser_t::required(code);
+            parser2::parser_t exact(buffer_t(data, data + required));
+            parser2::parser_t::program_t email = exact.Email();
+            CHECK_TRUE(exact.size() <= required);
+            nrunes::reader_t reader("john.doe@hotmail.com");
+            CHECK_TRUE(parser2::parser_t::parse(email, reader));
+
+            // Reset reuses the buffer
+            exact.reset();
+            CHECK_EQUAL(empty, exact.size());
+        }
+
+        UNITTEST_TEST(test_large_code_and_measure)
+        {
+            static u8 data[80 * 1024];
+
+            // Measure with a buffer that only holds the machine
+            parser2::parser_t            measure(buffer_t(data, data + parser2::parser_t::required(0)));
+            parser2::parser_t::program_t none = large_grammar(measure);
+            CHECK_FALSE(measure.valid());
+            u32 const code = measure.code_size();
+            CHECK_TRUE(code > 0x10000);
+            nrunes::reader_t reader1("john@example.org 10.0.0.1");
+            CHECK_FALSE(parser2::parser_t::parse(none, reader1));
+
+            // Too small, the code does not fit
+            parser2::parser_t            small(buffer_t(data, data + parser2::parser_t::required(code / 2)));
+            parser2::parser_t::program_t half = large_grammar(small);
+            CHECK_FALSE(small.valid());
+            CHECK_EQUAL(code, small.code_size());
+            nrunes::reader_t reader2("john@example.org 10.0.0.1");
+            CHECK_FALSE(parser2::parser_t::parse(half, reader2));
+            CHECK_EQUAL(0, reader2.get_cursor());
+
+            // Exact size, calls beyond 64 KB
+            parser2::parser_t            parser(buffer_t(data, data + parser2::parser_t::required(code)));
+            parser2::parser_t::program_t both = large_grammar(parser);
+            CHECK_TRUE(parser.valid());
+            CHECK_EQUAL(code, parser.code_size());
+            nrunes::reader_t reader3("john@example.org 10.0.0.1");
+            CHECK_TRUE(parser2::parser_t::parse(both, reader3));
+            CHECK_FALSE(reader3.valid());
+        }
+
+        UNITTEST_TEST(test_optimize)
+        {
+            u8                data[8192];
+            parser2::parser_t parser(buffer_t(data, data + sizeof(data)));
+
+            parser2::parser_t::program_t programs[3];
+            programs[0] = parser.Email();
+            programs[1] = parser.IPv4();
+            programs[2] = parser.Host();
+
+            const char* inputs[] = {"john.doe@hotmail.com", "a_b@c", "@nobody", "x_y@10.0.0.1", "10.0.8.9", "255.255.255.255", "256.1.1.1", "1.2.3", "0255.1.1.1", "1234", "my-host.example.org", "-host", "", "a.b.c.d"};
+            for (s32 p = 0; p < 3; ++p)
+            {
+                parser2::parser_t::program_t const optimized = parser2::parser_t::optimize(programs[p]);
+                CHECK_TRUE(parser.valid());
+                CHECK_TRUE(parser2::parser_t::instructions(optimized) < parser2::parser_t::instructions(programs[p]));
+
+                for (s32 i = 0; i < (s32)(sizeof(inputs) / sizeof(inputs[0])); ++i)
+                {
+                    nrunes::reader_t r1(inputs[i]);
+                    nrunes::reader_t r2(inputs[i]);
+                    CHECK_EQUAL(parser2::parser_t::parse(programs[p], r1), parser2::parser_t::parse(optimized, r2));
+                    CHECK_EQUAL(r1.get_cursor(), r2.get_cursor());
+                }
+            }
+
+            // Or(Sequence(x, a), Sequence(x, b)) -> Sequence(x, In("ab"))
+            parser2::parser_t::program_t xab       = parser.Or(parser.Sequence(parser.Is('x'), parser.Is('a')), parser.Sequence(parser.Is('x'), parser.Is('b')));
+            parser2::parser_t::program_t optimized = parser2::parser_t::optimize(xab);
+            CHECK_EQUAL(7, parser2::parser_t::instructions(xab));
+            CHECK_EQUAL(3, parser2::parser_t::instructions(optimized));
+            nrunes::reader_t r1("xb");
+            CHECK_TRUE(parser2::parser_t::parse(optimized, r1));
+            CHECK_FALSE(r1.valid());
+            nrunes::reader_t r2("xc");
+            CHECK_FALSE(parser2::parser_t::parse(optimized, r2));
+
+            // An optimized program can be compiled
+            u8 memory[8192];
+            CHECK_TRUE(parser2::parser_t::compile(optimized, buffer_t(memory, memory + sizeof(memory))) > 0);
+            nrunes::reader_t r3("xa");
+            CHECK_TRUE(parser2::parser_t::parse(optimized, r3));
+            CHECK_FALSE(r3.valid());
+        }
+
+        UNITTEST_TEST(test_jit)
+        {
+            u8                data[8192];
+            parser2::parser_t parser(buffer_t(data, data + sizeof(data)));
+
+            parser2::parser_t::program_t programs[8];
+            programs[0] = parser.Email();
+            programs[1] = parser.IPv4();
+            programs[2] = parser.Host();
+            programs[3] = parser2::parser_t::optimize(programs[0]);
+            programs[4] = parser2::parser_t::optimize(programs[1]);
+            programs[5] = parser2::parser_t::optimize(programs[2]);
+            programs[6] = parser.Sequence(parser.Word(), parser.Or(parser.EndOfLine(), parser.EndOfText()));
+            programs[7] = parser.Sequence(parser.Not(parser.Is('#')), parser.Within(parser.Hex(), 2, 4), parser.Exact(ascii::make_crunes("=>")), parser.Unsigned64(10, 99999));
+
+            const char* inputs[] = {"john.doe@hotmail.com", "a_b@c", "@nobody", "x_y@10.0.0.1", "10.0.8.9", "255.255.255.255", "256.1.1.1", "1.2.3", "0255.1.1.1", "my-host.example.org", "-host", "", "word\r\n", "word\n", "wo rd", "ab12=>123", "#ab=>12", "abcde=>12", "ff=>7", "ff=", "caf\xc3\xa9"};
+            for (s32 p = 0; p < 8; ++p)
+            {
+                parser2::jit_t jit;
+                jit.compile(programs[p]);
+                CHECK_TRUE(jit.native() == (jit.size() > 0));
+
+                for (s32 i = 0; i < (s32)(sizeof(inputs) / sizeof(inputs[0])); ++i)
+                {
+                    nrunes::reader_t r1(inputs[i]);
+                    nrunes::reader_t r2(inputs[i]);
+                    CHECK_EQUAL(parser2::parser_t::parse(programs[p], r1), jit.parse(r2));
+                    CHECK_EQUAL(r1.get_cursor(), r2.get_cursor());
+                }
+            }
+
+            // Extract is not translated, the interpreter runs it
+            crunes_t                     word;
+            va_r_t                       var(&word);
+            parser2::parser_t::program_t extract = parser.Extract(&var, parser.Word());
+            parser2::jit_t               jit;
+            CHECK_FALSE(jit.compile(extract));
+            CHECK_FALSE(jit.native());
+            nrunes::reader_t reader("hello world");
+            CHECK_TRUE(jit.parse(reader));
+            CHECK_EQUAL(5, reader.get_cursor());
+        }
+
+        UNITTEST_TEST(test_generate)
+        {
+            u8                data[4096];
+            parser2::parser_t parser(buffer_t(data, data + sizeof(data)));
+
+            parser2::parser_t::program_t ipv4 = parser2::parser_t::optimize(parser.IPv4());
+
+            // Measure, then generate
+            s32 const length = parser2::parser_t::generate(ipv4, "parse_ipv4", nullptr, 0);
+            CHECK_TRUE(length > 0);
+            char source[8192];
+            CHECK_TRUE(length < (s32)sizeof(source));
+            CHECK_EQUAL(length, parser2::parser_t::generate(ipv4, "parse_ipv4", source, sizeof(source)));
+            CHECK_EQUAL(0, source[length]);
+
+            const char* signature = "const char* parse_ipv4(const char* cursor, const char* end)";
+            bool        found     = false;
+            for (s32 i = 0; i < length && !found; ++i)
+            {
+                s32 j = 0;
+                while (signature[j] != 0 && source[i + j] == signature[j])
+                    j += 1;
+                found = signature[j] == 0;
+            }
+            CHECK_TRUE(found);
+
+            // Extract has no generated form
+            crunes_t word;
+            va_r_t   var(&word);
+            CHECK_EQUAL(-1, parser2::parser_t::generate(parser.Extract(&var, parser.Word()), "parse_word", source, sizeof(source)));
+        }
+
+        UNITTEST_TEST(test_profile_and_listing)
+        {
+            u8                data[4096];
+            parser2::parser_t parser(buffer_t(data, data + sizeof(data)));
+
+            parser2::parser_t::program_t ipv4 = parser.IPv4();
+
+            u8         counters[65536];
+            bool const profiling = parser.profile(buffer_t(counters, counters + sizeof(counters)));
+            CHECK_TRUE(parser.profile_required() <= sizeof(counters));
+
+            nrunes::reader_t r1("10.0.8.9");
+            CHECK_TRUE(parser2::parser_t::parse(ipv4, r1));
+            nrunes::reader_t r2("10.0.800.9");
+            CHECK_FALSE(parser2::parser_t::parse(ipv4, r2));
+
+            parser2::parser_t::counter_t const* counter = parser2::parser_t::counters(ipv4);
+            if (profiling)
+            {
+                CHECK_NOT_NULL(counter);
+                CHECK_EQUAL(2, counter->m_executions);
+                CHECK_EQUAL(1, counter->m_successes);
+                CHECK_EQUAL(1, counter->m_failures);
+            }
+            else
+            {
+                CHECK_NULL(counter);
+            }
+
+            // Measure, then list
+            s32 const length = parser2::parser_t::listing(ipv4, nullptr, 0);
+            CHECK_TRUE(length > 0);
+            char text[8192];
+            CHECK_TRUE(length < (s32)sizeof(text));
+            CHECK_EQUAL(length, parser2::parser_t::listing(ipv4, text, sizeof(text)));
+            CHECK_EQUAL(0, text[length]);
+
+            s32 lines = 0;
+            for (s32 i = 0; i < length; ++i)
+                lines += (text[i] == '\n') ? 1 : 0;
+            CHECK_TRUE(lines > 8);
+
+            // A program that is called twice is listed once
+            parser2::parser_t::program_t digit = parser.Digit();
+            parser2::parser_t::program_t pair  = parser.Sequence(digit, digit);
+            s32 const                    n     = parser2::parser_t::listing(pair, text, sizeof(text));
+            s32                          refs  = 0;
+            for (s32 i = 0; i + 1 < n; ++i)
+                refs += (text[i] == '-' && text[i + 1] == '>') ? 1 : 0;
+            CHECK_EQUAL(1, refs);
+        }
+
+        UNITTEST_TEST(test_disassemble_and_statistics)
+        {
+            u8                data[4096];
+            parser2::parser_t parser(buffer_t(data, data + sizeof(data)));
+
+            parser2::parser_t::program_t a       = parser.Is('a');
+            parser2::parser_t::program_t b       = parser.Is('b');
+            parser2::parser_t::program_t ab      = parser.Or(a, b);
+            parser2::parser_t::program_t digits  = parser.Within(parser.Digit(), 1, 3);
+            parser2::parser_t::program_t program = parser.Sequence(ab, digits);
+
+            parser2::parser_t::statistics_t stats;
+            CHECK_TRUE(parser2::parser_t::statistics(program, stats));
+            CHECK_EQUAL(6, stats.m_instructions);
+            CHECK_EQUAL(3, stats.m_max_depth);
+            CHECK_EQUAL(2, stats.m_backtracking);
+            s32 is = 0;
+            for (s32 i = 0; i < 256; ++i)
+            {
+                const char* name = parser2::parser_t::opcode(i);
+                if (name != nullptr && name[0] == 'I' && name[1] == 'S' && name[2] == 0)
+                    is = stats.m_mix[i];
+            }
+            CHECK_EQUAL(2, is);
+            CHECK_TRUE(stats.m_size > 0 && stats.m_size <= parser.code_size());
+
+            // One line per instruction, in the order of the code
+            s32 const length = parser2::parser_t::disassemble(program, nullptr, 0);
+            char      text[1024];
+            CHECK_TRUE(length > 0 && length < (s32)sizeof(text));
+            CHECK_EQUAL(length, parser2::parser_t::disassemble(program, text, sizeof(text)));
+            s32 lines = 0;
+            for (s32 i = 0; i < length; ++i)
+                lines += (text[i] == '\n') ? 1 : 0;
+            CHECK_EQUAL(6, lines);
+            const char* first = "000000  IS 'a'\n";
+            for (s32 i = 0; first[i] != 0; ++i)
+                CHECK_EQUAL(first[i], text[i]);
+        }
+
+        UNITTEST_TEST(test_find)
+        {
+            u8                data[4096];
+            parser2::parser_t parser(buffer_t(data, data + sizeof(data)));
+
+            parser2::parser_t::program_t ipv4 = parser.IPv4();
+
+            nrunes::reader_t reader("connection from 192.168.1.20 refused, retry via 10.0.0.1 later");
+            nrunes::reader_t match;
+            CHECK_TRUE(parser2::parser_t::find(ipv4, reader, match));
+            CHECK_TRUE(nrunes::starts_with(match.get_current(), ascii::make_crunes("192.168.1.20")));
+
+            nrunes::reader_t matches[4];
+            CHECK_EQUAL(1, parser2::parser_t::findAll(ipv4, reader, matches, 4));
+            CHECK_TRUE(nrunes::starts_with(matches[0].get_current(), ascii::make_crunes("10.0.0.1")));
+
+            nrunes::reader_t none("no addresses in this line");
+            CHECK_FALSE(parser2::parser_t::find(ipv4, none, match));
+        }
+
+        UNITTEST_TEST(test_find_all_emails)
+        {
+            u8                data[4096];
+            parser2::parser_t parser(buffer_t(data, data + sizeof(data)));
+
+            parser2::parser_t::program_t email = parser.Email();
+
+            nrunes::reader_t reader("mail john.doe@hotmail.com or jane@example.org, not @nobody");
+            nrunes::reader_t matches[4];
+            CHECK_EQUAL(2, parser2::parser_t::findAll(email, reader, matches, 4));
+            CHECK_TRUE(nrunes::starts_with(matches[0].get_current(), ascii::make_crunes("john.doe@hotmail.com")));
+            CHECK_TRUE(nrunes::starts_with(matches[1].get_current(), ascii::make_crunes("jane@example.org")));
+        }
+
+        class collect_t : public parser2::ruleset_t::report_t
+        {
+        public:
+            collect_t() : m_count(0) {}
+            virtual void match(s32 rule, nrunes::reader_t const& match)
+            {
+                if (m_count < 8)
+                {
+                    m_rules[m_count]   = rule;
+                    m_matches[m_count] = match;
+                }
+                m_count += 1;
+            }
+            s32              m_count;
+            s32              m_rules[8];
+            nrunes::reader_t m_matches[8];
+        };
+
+        UNITTEST_TEST(test_ruleset)
+        {
+            u8                data[4096];
+            parser2::parser_t parser(buffer_t(data, data + sizeof(data)));
+
+            parser2::parser_t::program_t error = parser.Exact(ascii::make_crunes("ERROR"));
+            parser2::parser_t::program_t warn  = parser.Exact(ascii::make_crunes("WARN"));
+            parser2::parser_t::program_t user  = parser.Sequence(parser.Exact(ascii::make_crunes("user=")), parser.OneOrMore(parser.AlphaNumeric()));
+            parser2::parser_t::program_t ipv4  = parser.IPv4();
+            parser2::parser_t::program_t email = parser.Email();
+
+            u8                 rules_data[8192];
+            parser2::ruleset_t rules(buffer_t(rules_data, rules_data + sizeof(rules_data)), 8);
+            CHECK_EQUAL(0, rules.add(error));
+            CHECK_EQUAL(1, rules.add(warn));
+            CHECK_EQUAL(2, rules.add(user));
+            CHECK_EQUAL(3, rules.add(ipv4));
+            CHECK_EQUAL(4, rules.add(email));
+            CHECK_TRUE(rules.build());
+
+            nrunes::reader_t reader("WARN user=jane from 10.0.0.1, ERROR mail jane@example.org");
+            collect_t        collect;
+            CHECK_EQUAL(5, rules.scan(reader, &collect));
+            CHECK_EQUAL(5, collect.m_count);
+
+            CHECK_EQUAL(1, collect.m_rules[0]);
+            CHECK_EQUAL(2, collect.m_rules[1]);
+            CHECK_TRUE(nrunes::starts_with(collect.m_matches[1].get_current(), ascii::make_crunes("user=jane")));
+            CHECK_EQUAL(3, collect.m_rules[2]);
+            CHECK_TRUE(nrunes::starts_with(collect.m_matches[2].get_current(), ascii::make_crunes("10.0.0.1")));
+            CHECK_EQUAL(0, collect.m_rules[3]);
+            CHECK_EQUAL(4, collect.m_rules[4]);
+            CHECK_TRUE(nrunes::starts_with(collect.m_matches[4].get_current(), ascii::make_crunes("jane@example.org")));
+
+            // The same text scanned again produces the same matches
+            collect_t again;
+            CHECK_EQUAL(5, rules.scan(reader, &again));
+        }
+
+        UNITTEST_TEST(test_compile_regular)
+        {
+            u8                data[4096];
+            parser2::parser_t parser(buffer_t(data, data + sizeof(data)));
+
+            parser2::parser_t::program_t number = parser.Sequence(parser.OneOrMore(parser.Digit()), parser.ZeroOrOne(parser.Sequence(parser.Is('.'), parser.OneOrMore(parser.Digit()))));
+
+            u8 dfa[4096];
+            CHECK_EQUAL(1, parser2::parser_t::compile(number, buffer_t(dfa, dfa + sizeof(dfa))));
+
+            nrunes::reader_t reader1("12.5x");
+            CHECK_TRUE(parser2::parser_t::parse(number, reader1));
+            CHECK_EQUAL('x', reader1.peek());
+
+            // The optional fraction fails half-way, the match ends before the '.'
+            nrunes::reader_t reader2("12.x");
+            CHECK_TRUE(parser2::parser_t::parse(number, reader2));
+            CHECK_EQUAL('.', reader2.peek());
+
+            nrunes::reader_t reader3(".5");
+            CHECK_FALSE(parser2::parser_t::parse(number, reader3));
+
+            // The host part of an email is regular, the rest keeps running on the interpreter
+            u8                           data2[4096];
+            parser2::parser_t            mail_parser(buffer_t(data2, data2 + sizeof(data2)));
+            parser2::parser_t::program_t email = mail_parser.Email();
+            u8                           dfa2[8192];
+            CHECK_TRUE(parser2::parser_t::compile(email, buffer_t(dfa2, dfa2 + sizeof(dfa2))) > 0);
+
+            nrunes::reader_t reader4("john.doe@mail-1.example.org");
+            CHECK_TRUE(parser2::parser_t::parse(email, reader4));
+            CHECK_FALSE(reader4.valid());
+        }
+
+        UNITTEST_TEST(test_compile_regular_matches_interpreter)
+        {
+            u8                data1[4096];
+            u8                data2[4096];
+            parser2::parser_t interpreted(buffer_t(data1, data1 + sizeof(data1)));
+            parser2::parser_t compiled(buffer_t(data2, data2 + sizeof(data2)));
+
+            parser2::parser_t*           parsers[2] = {&interpreted, &compiled};
+            parser2::parser_t::program_t programs[2][4];
+            for (s32 i = 0; i < 2; ++i)
+            {
+                parser2::parser_t& p = *parsers[i];
+                programs[i][0]       = p.Sequence(p.Within(p.Digit(), 1, 3), p.Times(2, p.Sequence(p.Is('.'), p.Within(p.Digit(), 1, 3))));
+                programs[i][1]       = p.Or(p.Sequence(p.Is('a'), p.OneOrMore(p.Is('b'))), p.Sequence(p.Is('b'), p.ZeroOrMore(p.Or(p.Is('a'), p.Digit()))));
+                programs[i][2]       = p.Sequence(p.Like(ascii::make_crunes("ab")), p.ZeroOrMore(p.Sequence(p.Is('-'), p.OneOrMore(p.Hex()))));
+                programs[i][3]       = p.Sequence(p.Word(), p.ZeroOrOne(p.Sequence(p.Is('.'), p.Within(p.Alphabet(), 2, 4))), p.Is('1'));
+            }
+
+            u8       dfa[8192];
+            buffer_t memory(dfa, dfa + sizeof(dfa));
+            for (s32 j = 0; j < 4; ++j)
+                CHECK_EQUAL(1, parser2::parser_t::compile(programs[1][j], memory(j * 2048, (j + 1) * 2048)));
+
+            // Random strings over a small alphabet, both must agree on success and on the end of the match
+            char const alphabet[] = "0123456789.abAB-1";
+            u32        seed       = 12345;
+            char       text[16];
+            for (s32 n = 0; n < 4000; ++n)
+            {
+                s32 const len = n % 12;
+                for (s32 i = 0; i < len; ++i)
+                {
+                    seed    = seed * 1103515245 + 12345;
+                    text[i] = alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+                }
+                text[len] = 0;
+
+                for (s32 j = 0; j < 4; ++j)
+                {
+                    nrunes::reader_t r1(text);
+                    nrunes::reader_t r2(text);
+                    bool const       m1 = parser2::parser_t::parse(programs[0][j], r1);
+                    bool const       m2 = parser2::parser_t::parse(programs[1][j], r2);
+                    CHECK_EQUAL(m1, m2);
+                    CHECK_EQUAL(r1.get_cursor(), r2.get_cursor());
+                }
+            }
+        }
+
+        UNITTEST_TEST(test_incremental)
+        {
+            u8                data[2048];
+            parser2::parser_t p(buffer_t(data, data + sizeof(data)));
+
+            // clang-format off
+            parser2::parser_t::program_t line = p.Sequence(
+                p.OneOrMore(p.AlphaNumeric()),
+                p.Digest(),
+                p.Is('='),
+                p.Sequence(p.Digest(), p.Unsigned32(), p.EndOfLine())
+            );
+            // clang-format on
+
+            s32 const    lines = 50000;
+            static char  text[50000 * 24];
+            static u8    memory[(50000 + 16) * 16];
+            u32          size = write_config(text, lines);
+
+            parser2::incremental_t config(buffer_t(memory, memory + sizeof(memory)), line);
+            CHECK_TRUE(config.parse(nrunes::reader_t(text, size)));
+            CHECK_EQUAL(lines, config.count());
+            CHECK_EQUAL(lines, config.reparsed());
+
+            u32 begin, end;
+            CHECK_TRUE(config.get(25000, begin, end));
+
+            // Change a digit of the value, only that line is parsed again
+            u32 const value = end - 2;
+            size            = edit_text(text, size, value, value + 1, "7");
+            CHECK_TRUE(config.edit(nrunes::reader_t(text, size), value, value + 1, 1));
+            CHECK_EQUAL(1, config.reparsed());
+            CHECK_EQUAL(lines, config.count());
+
+            // Break a line and fix it again
+            u32 const assign = begin + 9;
+            CHECK_EQUAL('=', text[assign]);
+            size = edit_text(text, size, assign, assign + 1, "?");
+            CHECK_FALSE(config.edit(nrunes::reader_t(text, size), assign, assign + 1, 1));
+            CHECK_TRUE(config.reparsed() <= 20); // every position of the broken line is tried
+            CHECK_FALSE(config.get(25000, begin, end));
+            CHECK_TRUE(config.get(25001, begin, end));
+            size = edit_text(text, size, assign, assign + 1, "=");
+            CHECK_TRUE(config.edit(nrunes::reader_t(text, size), assign, assign + 1, 1));
+            CHECK_EQUAL(1, config.reparsed());
+
+            // Insert a line in front of line 100 and remove it again
+            CHECK_TRUE(config.get(100, begin, end));
+            size = edit_text(text, size, begin, begin, "inserted = 1\n");
+            CHECK_TRUE(config.edit(nrunes::reader_t(text, size), begin, begin, 13));
+            CHECK_EQUAL(lines + 1, config.count());
+            CHECK_TRUE(config.reparsed() <= 2);
+
+            u32 b2, e2;
+            CHECK_TRUE(config.get(101, b2, e2));
+            CHECK_EQUAL(begin + 13, b2);
+
+            size = edit_text(text, size, begin, begin + 13, "");
+            CHECK_TRUE(config.edit(nrunes::reader_t(text, size), begin, begin + 13, 0));
+            CHECK_EQUAL(lines, config.count());
+
+            // Join two lines, the joined line is not a record
+            CHECK_TRUE(config.get(200, begin, end));
+            size = edit_text(text, size, end - 1, end, " ");
+            CHECK_FALSE(config.edit(nrunes::reader_t(text, size), end - 1, end, 1));
+            CHECK_TRUE(config.reparsed() <= 20);
+
+            // The incremental result has to be the same as parsing the edited text from scratch
+            static u8              memory2[(50000 + 16) * 16];
+            parser2::incremental_t scratch(buffer_t(memory2, memory2 + sizeof(memory2)), line);
+            CHECK_FALSE(scratch.parse(nrunes::reader_t(text, size)));
+            CHECK_EQUAL(scratch.count(), config.count());
+            for (s32 i = 0; i < config.count(); i += 97)
+            {
+                u32 b1, e1;
+                CHECK_EQUAL(scratch.get(i, b1, e1), config.get(i, b2, e2));
+                CHECK_EQUAL(b1, b2);
+                CHECK_EQUAL(e1, e2);
+            }
+        }
     }
 }
 UNITTEST_SUITE_END
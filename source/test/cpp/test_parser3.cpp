@@ -0,0 +1,217 @@
+#include "cbase/c_allocator.h"
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+#include "cbase/c_va_list.h"
+#include "ctext/c_parser2.h"
+#include "ctext/c_parser3.h"
+#include "cunittest/cunittest.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(test_parser3)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_FIXTURE_SETUP() {}
+        UNITTEST_FIXTURE_TEARDOWN() {}
+
+        UNITTEST_TEST(test_parse_email_and_ipv4)
+        {
+            u8                data[4096];
+            parser3::parser_t parser(buffer_t(data, data + sizeof(data)));
+
+            parser3::parser_t::code_t* email = parser.Email();
+            parser3::parser_t::code_t* ipv4  = parser.IPv4();
+            CHECK_TRUE(parser.IsValid());
+
+            nrunes::reader_t reader1("john.doe@hotmail.com");
+            CHECK_TRUE(parser.Parse(email, reader1));
+            CHECK_FALSE(reader1.valid());
+
+            nrunes::reader_t reader2("10.0.8.9");
+            CHECK_TRUE(parser.Parse(ipv4, reader2));
+            CHECK_FALSE(reader2.valid());
+
+            nrunes::reader_t reader3("10.0.800.9");
+            CHECK_FALSE(parser.Parse(ipv4, reader3));
+            CHECK_EQUAL(0, reader3.get_cursor());
+        }
+
+        UNITTEST_TEST(test_parse_root_and_extract)
+        {
+            u8                data[1024];
+            parser3::parser_t p(buffer_t(data, data + sizeof(data)));
+
+            s32    value = 0;
+            va_r_t var(&value);
+            p.Sequence(p.WhiteSpace()->Until(p.Is('='), p.Any())->Is('=')->WhiteSpace()->Extract(&var, p.Unsigned32()));
+
+            nrunes::reader_t text("This is an integer = 512 in text to be parsed");
+            CHECK_TRUE(p.Parse(text));
+            CHECK_EQUAL(512, value);
+        }
+
+        UNITTEST_TEST(test_parse_use_case)
+        {
+            u8                data[1024];
+            parser3::parser_t p(buffer_t(data, data + sizeof(data)));
+
+            s32      idx   = 0;
+            s32      lint  = 0;
+            s32      rint  = 0;
+            crunes_t str;
+            va_r_t   index(&idx);
+            va_r_t   lvar(&lint);
+            va_r_t   rvar(&rint);
+            va_r_t   svar(&str);
+
+            // clang-format off
+            p.Sequence(p.Extract(&index, p.Integer32())
+                ->Is(':')
+                ->WhiteSpace()
+                ->Or(p.Sequence(p.Is('"')->Extract(&svar, p.Until(p.Is('"'), p.Any()))->Is('"')->WhiteSpace()->EOL()),
+                     p.Sequence(p.Until(p.Or(p.Is('|'), p.EOL()), p.Sequence(p.WhiteSpace()->Extract(&lvar, p.Integer32())->WhiteSpace()))
+                        ->Or(p.EOL(), p.Sequence(p.Is('|')->Until(p.EOL(), p.Sequence(p.WhiteSpace()->Extract(&rvar, p.Integer32())->WhiteSpace())))))));
+            // clang-format on
+            CHECK_TRUE(p.IsValid());
+
+            nrunes::reader_t line1("12: \"hello\"\n");
+            CHECK_TRUE(p.Parse(line1));
+            CHECK_EQUAL(12, idx);
+            CHECK_TRUE(nrunes::starts_with(str, ascii::make_crunes("hello")));
+
+            nrunes::reader_t line2("3: 1 2 7 | 4 5");
+            CHECK_TRUE(p.Parse(line2));
+            CHECK_EQUAL(3, idx);
+            CHECK_EQUAL(7, lint);
+            CHECK_EQUAL(5, rint);
+
+            nrunes::reader_t line3("3: 1 x");
+            CHECK_FALSE(p.Parse(line3));
+        }
+
+        UNITTEST_TEST(test_blocks_are_compact)
+        {
+            // Appending to a block that is not at the end of the code continues in a new segment
+            u8                data[256];
+            parser3::parser_t p(buffer_t(data, data + sizeof(data)));
+
+            parser3::parser_t::code_t* a = p.Is('a');
+            parser3::parser_t::code_t* b = p.Is('b');
+            a->Is('c');
+            b->Is('d');
+            parser3::parser_t::code_t* ab = p.Or(a, b);
+            CHECK_TRUE(p.IsValid());
+
+            nrunes::reader_t reader1("bd");
+            CHECK_TRUE(p.Parse(ab, reader1));
+            CHECK_FALSE(reader1.valid());
+            nrunes::reader_t reader2("ab");
+            CHECK_FALSE(p.Parse(ab, reader2));
+
+            // A locked block can not be extended anymore
+            u32 const size = p.Size();
+            p.Sequence(ab);
+            CHECK_TRUE(p.Size() > size);
+        }
+
+        UNITTEST_TEST(test_used_and_reset)
+        {
+            u8                data[1024];
+            parser3::parser_t p(buffer_t(data, data + sizeof(data)));
+            CHECK_EQUAL(0, p.Used());
+
+            p.IPv4();
+            u32 const used = p.Used();
+            CHECK_TRUE(used > p.Size());
+
+            p.Reset();
+            CHECK_EQUAL(0, p.Used());
+            parser3::parser_t::code_t* ipv4 = p.IPv4();
+            CHECK_EQUAL(used, p.Used());
+
+            nrunes::reader_t reader("10.0.8.9");
+            CHECK_TRUE(p.Parse(ipv4, reader));
+        }
+
+        UNITTEST_TEST(test_out_of_memory)
+        {
+            u8                data[96];
+            parser3::parser_t p(buffer_t(data, data + sizeof(data)));
+
+            parser3::parser_t::code_t* email = p.Email();
+            CHECK_FALSE(p.IsValid());
+
+            nrunes::reader_t reader("john@example.org");
+            CHECK_FALSE(p.Parse(email, reader));
+        }
+
+        UNITTEST_TEST(test_same_results_as_parser2)
+        {
+            u8                data2[8192];
+            parser2::parser_t parser2(buffer_t(data2, data2 + sizeof(data2)));
+            u8                data3[4096];
+            parser3::parser_t parser3(buffer_t(data3, data3 + sizeof(data3)));
+
+            parser2::parser_t::program_t email2 = parser2.Email();
+            parser2::parser_t::program_t ipv42  = parser2.IPv4();
+            parser2::parser_t::program_t host2  = parser2.Host();
+            parser3::parser_t::code_t*   email3 = parser3.Email();
+            parser3::parser_t::code_t*   ipv43  = parser3.IPv4();
+            parser3::parser_t::code_t*   host3  = parser3.Host();
+            CHECK_TRUE(parser3.IsValid());
+
+            const char* inputs[] = {"john.doe@hotmail.com", "a@b", "@nobody", "x_y@10.0.0.1", "10.0.8.9", "255.255.255.255", "256.1.1.1", "1.2.3", "my-host.example.org", "-host", "", "a.b.c.d"};
+            for (s32 i = 0; i < (s32)(sizeof(inputs) / sizeof(inputs[0])); ++i)
+            {
+                nrunes::reader_t r2(inputs[i]);
+                nrunes::reader_t r3(inputs[i]);
+                CHECK_EQUAL(parser2::parser_t::parse(email2, r2), parser3.Parse(email3, r3));
+                CHECK_EQUAL(r2.get_cursor(), r3.get_cursor());
+
+                r2.reset();
+                r3.reset();
+                CHECK_EQUAL(parser2::parser_t::parse(ipv42, r2), parser3.Parse(ipv43, r3));
+                CHECK_EQUAL(r2.get_cursor(), r3.get_cursor());
+
+                r2.reset();
+                r3.reset();
+                CHECK_EQUAL(parser2::parser_t::parse(host2, r2), parser3.Parse(host3, r3));
+                CHECK_EQUAL(r2.get_cursor(), r3.get_cursor());
+            }
+        }
+
+        UNITTEST_TEST(test_date_time_and_addresses)
+        {
+            u8                data[4096];
+            parser3::parser_t p(buffer_t(data, data + sizeof(data)));
+
+            parser3::parser_t::code_t* date   = p.Date();
+            parser3::parser_t::code_t* time   = p.Time();
+            parser3::parser_t::code_t* server = p.ServerAddress();
+            parser3::parser_t::code_t* uri    = p.URI();
+            parser3::parser_t::code_t* phone  = p.Phone();
+            CHECK_TRUE(p.IsValid());
+
+            nrunes::reader_t r1("2024-02-29");
+            CHECK_TRUE(p.Parse(date, r1));
+            nrunes::reader_t r2("2024-13-01");
+            CHECK_FALSE(p.Parse(date, r2));
+            nrunes::reader_t r3("23:59:60");
+            CHECK_TRUE(p.Parse(time, r3));
+            CHECK_FALSE(r3.valid());
+            nrunes::reader_t r4("24:00");
+            CHECK_FALSE(p.Parse(time, r4));
+            nrunes::reader_t r5("localhost:8080");
+            CHECK_TRUE(p.Parse(server, r5));
+            CHECK_FALSE(r5.valid());
+            nrunes::reader_t r6("https://example.org:443/index.html?q=1");
+            CHECK_TRUE(p.Parse(uri, r6));
+            CHECK_FALSE(r6.valid());
+            nrunes::reader_t r7("+31 20-555 1234");
+            CHECK_TRUE(p.Parse(phone, r7));
+            CHECK_FALSE(r7.valid());
+        }
+    }
+}
+UNITTEST_SUITE_END
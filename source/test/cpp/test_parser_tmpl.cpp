@@ -0,0 +1,65 @@
+#include "cbase/c_allocator.h"
+#include "cbase/c_runes.h"
+#include "ctext/c_parser_tmpl.h"
+#include "cunittest/cunittest.h"
+
+using namespace ncore;
+
+UNITTEST_SUITE_BEGIN(test_parser_tmpl)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_FIXTURE_SETUP() {}
+        UNITTEST_FIXTURE_TEARDOWN() {}
+
+        UNITTEST_TEST(test_parse_ip)
+        {
+            nrunes::reader_t reader1("10.0.8.9");
+            CHECK_TRUE(tparser::parse<tparser::IPv4>(reader1));
+            CHECK_FALSE(reader1.valid());
+
+            nrunes::reader_t reader2("10.0.800.9");
+            CHECK_FALSE(tparser::parse<tparser::IPv4>(reader2));
+            CHECK_EQUAL(0, reader2.get_cursor());
+        }
+
+        UNITTEST_TEST(test_parse_email)
+        {
+            nrunes::reader_t reader("john.doe@mail-1.example.org");
+            CHECK_TRUE(tparser::parse<tparser::Email>(reader));
+            CHECK_FALSE(reader.valid());
+        }
+
+        UNITTEST_TEST(test_parse_version)
+        {
+            using namespace tparser;
+            typedef Sequence<Like<'v'>, OneOrMore<Digit>, Times<2, Sequence<Is<'.'>, Unsigned<0, 999> > >, ZeroOrOne<Sequence<Is<'-'>, Word> > > version_t;
+
+            nrunes::reader_t reader1("V1.20.3-beta;");
+            CHECK_TRUE(parse<version_t>(reader1));
+            CHECK_EQUAL(';', reader1.peek());
+
+            nrunes::reader_t reader2("v1.2");
+            CHECK_FALSE(parse<version_t>(reader2));
+
+            nrunes::reader_t reader3("v1.2.3-;");
+            CHECK_TRUE(parse<version_t>(reader3));
+            CHECK_EQUAL('-', reader3.peek());
+        }
+
+        UNITTEST_TEST(test_find)
+        {
+            using namespace tparser;
+            typedef Sequence<Exact<'i', 'd', '='>, Integer<-1000, 1000> > id_t;
+
+            nrunes::reader_t reader("name=x id=-42 id=5000 id=7");
+            nrunes::reader_t match;
+            CHECK_TRUE(find<id_t>(reader, match));
+            CHECK_TRUE(nrunes::starts_with(match.get_current(), ascii::make_crunes("id=-42")));
+            CHECK_TRUE(find<id_t>(reader, match));
+            CHECK_TRUE(nrunes::starts_with(match.get_current(), ascii::make_crunes("id=7")));
+            CHECK_FALSE(find<id_t>(reader, match));
+        }
+    }
+}
+UNITTEST_SUITE_END
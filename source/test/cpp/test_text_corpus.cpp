@@ -0,0 +1,149 @@
+#include "cbase/c_runes.h"
+#include "ctext/c_text_corpus.h"
+#include "cunittest/cunittest.h"
+
+using namespace ncore;
+
+static u8 sText1[32768];
+static u8 sText2[32768];
+
+UNITTEST_SUITE_BEGIN(test_text_corpus)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_FIXTURE_SETUP() {}
+        UNITTEST_FIXTURE_TEARDOWN() {}
+
+        UNITTEST_TEST(same_text_in_parts)
+        {
+            ncorpus::config_t config;
+            config.m_crlf = 50;
+
+            u32       lines = 0;
+            u32 const size  = ncorpus::generate(config, sText1, sizeof(sText1), lines);
+            CHECK_TRUE(size > sizeof(sText1) - 256);
+            CHECK_TRUE(lines > 0);
+            CHECK_EQUAL('\n', sText1[size - 1]);
+
+            // Generated in parts of 1000 bytes, stopped at the same number of lines
+            ncorpus::generator_t generator(config);
+            u32                  written = 0;
+            while (generator.lines() < lines)
+                written += generator.write(sText2 + written, 1000 < (sizeof(sText2) - written) ? 1000 : (u32)(sizeof(sText2) - written));
+            CHECK_EQUAL(size, written);
+            for (u32 i = 0; i < size; ++i)
+                CHECK_EQUAL(sText1[i], sText2[i]);
+
+            // Another seed, another text
+            config.m_seed = 1234;
+            ncorpus::generate(config, sText2, sizeof(sText2), lines);
+            u32 same = 0;
+            for (u32 i = 0; i < 64; ++i)
+                same += (sText1[i] == sText2[i]) ? 1 : 0;
+            CHECK_TRUE(same < 64);
+        }
+
+        UNITTEST_TEST(line_lengths_and_line_ends)
+        {
+            ncorpus::config_t config;
+            config.m_distribution = ncorpus::distribution_uniform;
+            config.m_min_line     = 10;
+            config.m_max_line     = 50;
+            config.m_crlf         = 30;
+
+            u32       lines = 0;
+            u32 const size  = ncorpus::generate(config, sText1, sizeof(sText1), lines);
+
+            u32 count = 0;
+            u32 crlf  = 0;
+            u32 begin = 0;
+            for (u32 i = 0; i < size; ++i)
+            {
+                if (sText1[i] != '\n')
+                    continue;
+                u32 end = i;
+                if (end > begin && sText1[end - 1] == '\r')
+                {
+                    end -= 1;
+                    crlf += 1;
+                }
+                CHECK_TRUE((end - begin) >= 10 && (end - begin) <= 50);
+                begin = i + 1;
+                count += 1;
+            }
+            CHECK_EQUAL(lines, count);
+            CHECK_TRUE(crlf > lines / 5 && crlf < (lines * 2) / 5);
+        }
+
+        UNITTEST_TEST(numeric_density)
+        {
+            ncorpus::config_t config;
+
+            u32 digits[2];
+            u8  densities[2] = {0, 100};
+            for (s32 d = 0; d < 2; ++d)
+            {
+                config.m_numbers = densities[d];
+                config.m_emails  = 0;
+                config.m_ipv4    = 0;
+                config.m_hosts   = 0;
+                u32       lines  = 0;
+                u32 const size   = ncorpus::generate(config, sText1, sizeof(sText1), lines);
+                digits[d]        = 0;
+                for (u32 i = 0; i < size; ++i)
+                    digits[d] += (sText1[i] >= '0' && sText1[i] <= '9') ? 1 : 0;
+            }
+            CHECK_EQUAL(0, digits[0]);
+            CHECK_TRUE(digits[1] > sizeof(sText1) / 2);
+        }
+
+        UNITTEST_TEST(encodings)
+        {
+            ncorpus::config_t config;
+            config.m_non_ascii = 50;
+
+            // ASCII never has non-ASCII characters
+            u32 lines = 0;
+            u32 size  = ncorpus::generate(config, sText1, sizeof(sText1), lines);
+            u32 high  = 0;
+            for (u32 i = 0; i < size; ++i)
+                high += (sText1[i] >= 0x80) ? 1 : 0;
+            CHECK_EQUAL(0, high);
+
+            // UTF-8, a well formed sequence for every character
+            config.m_encoding = utf8::TYPE;
+            size              = ncorpus::generate(config, sText1, sizeof(sText1), lines);
+            for (u32 i = 0; i < size;)
+            {
+                u8 const  b = sText1[i];
+                u32 const n = (b < 0x80) ? 1 : (b >= 0xf0) ? 4 : (b >= 0xe0) ? 3 : 2;
+                CHECK_TRUE(b < 0x80 || b >= 0xc2);
+                for (u32 j = 1; j < n; ++j)
+                    CHECK_EQUAL(0x80, sText1[i + j] & 0xc0);
+                high += (n > 1) ? 1 : 0;
+                i += n;
+            }
+            CHECK_TRUE(high > 0);
+
+            // UTF-16, the line ends are units and surrogates come in pairs
+            config.m_encoding = utf16::TYPE;
+            size              = ncorpus::generate(config, sText1, sizeof(sText1), lines);
+            CHECK_EQUAL(0, size & 1);
+            u16 const* units = (u16 const*)sText1;
+            u32        ends  = 0;
+            u32        pairs = 0;
+            for (u32 i = 0; i < size / 2; ++i)
+            {
+                ends += (units[i] == '\n') ? 1 : 0;
+                if (units[i] >= 0xd800 && units[i] < 0xdc00)
+                {
+                    CHECK_TRUE(units[i + 1] >= 0xdc00 && units[i + 1] < 0xe000);
+                    pairs += 1;
+                }
+            }
+            CHECK_EQUAL(lines, ends);
+            CHECK_TRUE(pairs > 0);
+        }
+    }
+}
+UNITTEST_SUITE_END
@@ -0,0 +1,253 @@
+#include "cbase/c_buffer.h"
+#include "ccore/c_stream.h"
+#include "cbase/c_runes.h"
+#include "ctext/c_text_csv.h"
+#include "ctext/c_text_scan.h"
+#include "ctext/c_text_stream.h"
+#include "cunittest/cunittest.h"
+
+#include "c_test_stream.h"
+
+using namespace ncore;
+
+namespace ncore
+{
+    static bool field_is(crunes_t const& field, const char* text)
+    {
+        u32 const length = field.m_end - field.m_str;
+        for (u32 i = 0; i < length; ++i)
+        {
+            if (text[i] != field.m_ascii[field.m_str + i])
+                return false;
+        }
+        return text[length] == 0;
+    }
+
+    static bool equal(const char* a, const char* b)
+    {
+        while (*a != 0 && *a == *b)
+        {
+            ++a;
+            ++b;
+        }
+        return *a == *b;
+    }
+
+    // The value of field 'column'' of row 'row' of the generated text, every fourth field is quoted and has a
+    // delimiter, a line end and quotes in it
+    static bool expected_field(s32 row, s32 column, char* text)
+    {
+        char*      cursor = text;
+        bool const quoted = ((row + column) % 4) == 0;
+        if (quoted)
+        {
+            const char* value = "a,b\n\"c\"";
+            while (*value != 0)
+                *cursor++ = *value++;
+        }
+        *cursor++ = 'f';
+        s32  value = row * 100 + column;
+        char digits[10];
+        s32  n = 0;
+        do
+        {
+            digits[n++] = (char)('0' + (value % 10));
+            value /= 10;
+        } while (value != 0);
+        while (n > 0)
+            *cursor++ = digits[--n];
+        *cursor = 0;
+        return quoted;
+    }
+
+    static s32 expected_width(s32 row) { return (row % 5) + 1; }
+
+    // Rows of 1 to 5 fields, every other row ends with "\r\n" when 'crlf'
+    static u32 write_rows(u8* text, s32 rows, bool crlf)
+    {
+        u32 size = 0;
+        for (s32 r = 0; r < rows; ++r)
+        {
+            for (s32 c = 0; c < expected_width(r); ++c)
+            {
+                if (c > 0)
+                    text[size++] = ',';
+                char       field[64];
+                bool const quoted = expected_field(r, c, field);
+                if (quoted)
+                    text[size++] = '"';
+                for (char const* f = field; *f != 0; ++f)
+                {
+                    if (*f == '"')
+                        text[size++] = '"';
+                    text[size++] = (u8)*f;
+                }
+                if (quoted)
+                    text[size++] = '"';
+            }
+            if (crlf && (r & 1) != 0)
+                text[size++] = '\r';
+            text[size++] = '\n';
+        }
+        return size;
+    }
+} // namespace ncore
+
+static u8 sText[65536];
+static u8 sMemory[65536];
+
+UNITTEST_SUITE_BEGIN(test_text_csv)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_FIXTURE_SETUP() {}
+        UNITTEST_FIXTURE_TEARDOWN() {}
+
+        UNITTEST_TEST(masks_and_prefix_xor)
+        {
+            u8 block[64];
+            for (s32 i = 0; i < 64; ++i)
+                block[i] = (u8)'x';
+            block[0]  = ',';
+            block[5]  = '"';
+            block[9]  = ',';
+            block[12] = '"';
+            block[63] = '\n';
+
+            u8 const chars[3] = {',', '\n', '"'};
+            u64      masks[3];
+            nscan::match64(block, chars, 3, masks);
+            CHECK_EQUAL(((u64)1 << 0) | ((u64)1 << 9), masks[0]);
+            CHECK_EQUAL((u64)1 << 63, masks[1]);
+            CHECK_EQUAL(((u64)1 << 5) | ((u64)1 << 12), masks[2]);
+
+            // Inside the quotes: from the opening quote up to the closing quote
+            u64 const inside = nscan::prefix_xor(masks[2]);
+            CHECK_EQUAL(((u64)1 << 12) - ((u64)1 << 5), inside);
+            CHECK_EQUAL(9, nscan::lowest_bit64(masks[0] & inside));
+            CHECK_EQUAL(63, nscan::lowest_bit64(masks[1]));
+        }
+
+        UNITTEST_TEST(fields)
+        {
+            const char* text = "name,city,note\r\nbob,\"Paris, France\",\"said \"\"hi\"\"\"\n,,\nlast";
+            u32 const   size = ascii::make_crunes(text).m_end;
+
+            ncsv::config_t config;
+            config.m_max_rows = 64;
+
+            memory_stream_t stream((u8 const*)text, size, true);
+            text_stream_t   input(&stream, text_stream_t::encoding_utf8);
+            ncsv::reader_t  reader(input, buffer_t(sMemory, sMemory + sizeof(sMemory)), config);
+            ncsv::batch_t   batch;
+            CHECK_TRUE(reader.read(batch));
+
+            CHECK_EQUAL(3, batch.m_rows);
+            CHECK_EQUAL(3, batch.m_columns);
+            CHECK_TRUE(field_is(batch.field(0, 0), "name"));
+            CHECK_TRUE(field_is(batch.field(0, 2), "note"));
+            CHECK_TRUE(field_is(batch.field(1, 1), "Paris, France"));
+            CHECK_EQUAL(1, batch.m_fields[1 * batch.m_stride + 1].m_quoted);
+            CHECK_EQUAL(0, batch.m_fields[0 * batch.m_stride + 1].m_quoted);
+
+            char      note[32];
+            s32 const length = reader.unquote(batch.field(1, 2), note, sizeof(note));
+            note[length]     = 0;
+            CHECK_TRUE(equal(note, "said \"hi\""));
+
+            CHECK_EQUAL(3, batch.m_widths[2]);
+            CHECK_TRUE(field_is(batch.field(2, 0), ""));
+            CHECK_TRUE(field_is(batch.field(2, 2), ""));
+
+            // The last row does not end with a line end
+            CHECK_TRUE(reader.read(batch));
+            CHECK_EQUAL(1, batch.m_rows);
+            CHECK_TRUE(field_is(batch.field(0, 0), "last"));
+            CHECK_TRUE(field_is(batch.field(0, 1), ""));
+            CHECK_FALSE(reader.read(batch));
+            CHECK_EQUAL(4, reader.rows());
+        }
+
+        UNITTEST_TEST(quoted_fields_across_lines_and_refills)
+        {
+            s32 const rows = 600;
+            u32 const size = write_rows(sText, rows, true);
+            CHECK_TRUE(size < sizeof(sText));
+
+            ncsv::config_t config;
+            config.m_max_rows    = 7;
+            config.m_max_columns = 8;
+            CHECK_TRUE(ncsv::reader_t::required(config) <= sizeof(sMemory));
+
+            for (s32 view = 0; view < 2; ++view)
+            {
+                memory_stream_t stream(sText, size, view == 1);
+                text_stream_t   input(&stream, text_stream_t::encoding_ascii, nullptr, 100);
+                ncsv::reader_t  reader(input, buffer_t(sMemory, sMemory + sizeof(sMemory)), config);
+                ncsv::batch_t   batch;
+
+                s32 row    = 0;
+                s32 errors = 0;
+                while (reader.read(batch))
+                {
+                    CHECK_TRUE(batch.m_rows <= 7);
+                    for (s32 r = 0; r < batch.m_rows; ++r, ++row)
+                    {
+                        errors += (batch.m_widths[r] == expected_width(row)) ? 0 : 1;
+                        for (s32 c = 0; c < batch.m_widths[r]; ++c)
+                        {
+                            char       expected[64];
+                            bool const quoted = expected_field(row, c, expected);
+                            crunes_t   field  = batch.field(r, c);
+                            errors += ((s32)batch.m_fields[c * batch.m_stride + r].m_quoted == (quoted ? 1 : 0)) ? 0 : 1;
+
+                            char      value[64];
+                            s32 const length = reader.unquote(field, value, sizeof(value) - 1);
+                            value[length]    = 0;
+                            errors += equal(value, expected) ? 0 : 1;
+                        }
+                    }
+                }
+                CHECK_EQUAL(0, errors);
+                CHECK_EQUAL(rows, row);
+                CHECK_EQUAL((u64)rows, reader.rows());
+                input.close();
+            }
+        }
+
+        UNITTEST_TEST(tsv_without_quotes)
+        {
+            const char* text = "a\t\"b\tc\n1\t2\t3\t4\t5\n";
+            u32 const   size = ascii::make_crunes(text).m_end;
+
+            ncsv::config_t config;
+            config.m_delimiter   = '\t';
+            config.m_quote       = 0;
+            config.m_max_columns = 3;
+
+            memory_stream_t stream((u8 const*)text, size, true);
+            text_stream_t   input(&stream, text_stream_t::encoding_ascii);
+            ncsv::reader_t  reader(input, buffer_t(sMemory, sMemory + sizeof(sMemory)), config);
+            ncsv::batch_t   batch;
+            CHECK_TRUE(reader.read(batch));
+            CHECK_EQUAL(2, batch.m_rows);
+            CHECK_TRUE(field_is(batch.field(0, 1), "\"b"));
+            CHECK_TRUE(field_is(batch.field(0, 2), "c"));
+
+            // Fields after the maximum number of columns are skipped
+            CHECK_EQUAL(3, batch.m_widths[1]);
+            CHECK_TRUE(field_is(batch.field(1, 2), "3"));
+            CHECK_FALSE(reader.read(batch));
+        }
+
+        UNITTEST_TEST(memory_too_small)
+        {
+            memory_stream_t stream((u8 const*)"a,b\n", 4, true);
+            text_stream_t   input(&stream, text_stream_t::encoding_ascii);
+            ncsv::reader_t  reader(input, buffer_t(sMemory, sMemory + 64));
+            ncsv::batch_t   batch;
+            CHECK_FALSE(reader.read(batch));
+        }
+    }
+}
+UNITTEST_SUITE_END
@@ -0,0 +1,172 @@
+#include "cbase/c_buffer.h"
+#include "ccore/c_stream.h"
+#include "cbase/c_runes.h"
+#include "ctext/c_text_json.h"
+#include "ctext/c_text_stream.h"
+#include "cunittest/cunittest.h"
+
+#include "c_test_stream.h"
+
+using namespace ncore;
+
+namespace ncore
+{
+    static bool text_is(crunes_t const& text, const char* expected)
+    {
+        for (u32 i = text.m_str; i < text.m_end; ++i, ++expected)
+        {
+            if (*expected != text.m_ascii[i])
+                return false;
+        }
+        return *expected == 0;
+    }
+} // namespace ncore
+
+static u8 sMemory[16384];
+
+UNITTEST_SUITE_BEGIN(test_text_json)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_FIXTURE_SETUP() {}
+        UNITTEST_FIXTURE_TEARDOWN() {}
+
+        UNITTEST_TEST(values_by_path)
+        {
+            crunes_t const line = ascii::make_crunes("{\"id\": 42, \"user\": {\"name\": \"eve \\\"e\\\"\", \"tags\": [\"a\", \"b\", {\"k\": null}]}, \"ok\": true, \"score\": -1.5e2, \"empty\": {}, \"list\": []}\n");
+
+            njson::document_t document(buffer_t(sMemory, sMemory + sizeof(sMemory)));
+            CHECK_TRUE(document.parse(line));
+            CHECK_EQUAL((s32)njson::kind_object, document.root().m_kind);
+            CHECK_EQUAL(6, document.count(document.root()));
+
+            s64 id = 0;
+            CHECK_TRUE(document.as_s64(document.find("id"), id));
+            CHECK_EQUAL(42, (s32)id);
+
+            njson::value_t const name = document.find("user.name");
+            CHECK_EQUAL((s32)njson::kind_string, name.m_kind);
+            CHECK_TRUE(text_is(document.text(name), "eve \\\"e\\\""));
+            char      unescaped[32];
+            s32 const length  = document.unescape(name, unescaped, sizeof(unescaped) - 1);
+            unescaped[length] = 0;
+            CHECK_TRUE(text_is(ascii::make_crunes(unescaped), "eve \"e\""));
+
+            njson::value_t const tags = document.find("user.tags");
+            CHECK_EQUAL((s32)njson::kind_array, tags.m_kind);
+            CHECK_EQUAL(3, document.count(tags));
+            CHECK_TRUE(text_is(document.text(document.element(tags, 1)), "b"));
+            CHECK_EQUAL((s32)njson::kind_null, document.find("user.tags.2.k").m_kind);
+            CHECK_EQUAL((s32)njson::kind_null, document.find(tags, "2.k").m_kind);
+            CHECK_TRUE(text_is(document.text(document.find("user.tags.0001")), "b"));
+            CHECK_EQUAL((s32)njson::kind_true, document.find("ok").m_kind);
+
+            f64 score = 0.0;
+            CHECK_TRUE(document.as_f64(document.find("score"), score));
+            CHECK_TRUE(score > -150.001 && score < -149.999);
+            s64 integer = 0;
+            CHECK_FALSE(document.as_s64(document.find("score"), integer));
+
+            CHECK_EQUAL(0, document.count(document.find("empty")));
+            CHECK_EQUAL(0, document.count(document.find("list")));
+            CHECK_TRUE(text_is(document.text(document.find("empty")), "{}"));
+
+            // Paths that are not in the document
+            CHECK_EQUAL((s32)njson::kind_none, document.find("user.tags.3").m_kind);
+            CHECK_EQUAL((s32)njson::kind_none, document.find("user.nam").m_kind);
+            CHECK_EQUAL((s32)njson::kind_none, document.find("id.x").m_kind);
+            CHECK_EQUAL((s32)njson::kind_none, document.find("missing.id").m_kind);
+
+            // Indices with more digits than fit, 2^32 + 1 must not wrap around to element 1
+            CHECK_EQUAL((s32)njson::kind_none, document.find("user.tags.4294967297").m_kind);
+            CHECK_EQUAL((s32)njson::kind_none, document.find("user.tags.99999999999999999999").m_kind);
+        }
+
+        UNITTEST_TEST(strings_and_escapes_across_blocks)
+        {
+            // A long string with escaped quotes, backslashes and structural characters in it, a backslash run that
+            // crosses a block of 64 bytes and a unicode escape
+            char text[512];
+            s32  n = 0;
+            for (const char* s = "[{\"long\":\""; *s != 0; ++s)
+                text[n++] = *s;
+            for (; n < 61; ++n)
+                text[n] = ((n % 5) == 0) ? ',' : (((n % 7) == 0) ? '}' : 'x');
+            for (const char* s = "\\\\\\\"]:\\u00e9\\ud83d\\ude00\",\"n\":12345678901}, 7, false]"; *s != 0; ++s)
+                text[n++] = *s;
+            text[n] = 0;
+
+            njson::document_t document(buffer_t(sMemory, sMemory + sizeof(sMemory)));
+            CHECK_TRUE(document.parse(ascii::make_crunes(text)));
+            CHECK_EQUAL(3, document.count(document.root()));
+
+            s64 number = 0;
+            CHECK_TRUE(document.as_s64(document.find("0.n"), number));
+            CHECK_TRUE(number == 12345678901LL);
+            CHECK_TRUE(document.as_s64(document.find("1"), number));
+            CHECK_EQUAL(7, (s32)number);
+            CHECK_EQUAL((s32)njson::kind_false, document.find("2").m_kind);
+
+            char      value[128];
+            s32 const length = document.unescape(document.find("0.long"), value, sizeof(value));
+            CHECK_EQUAL(51 + 2 + 2 + 2 + 4, length);
+            CHECK_EQUAL('\\', value[51]);
+            CHECK_EQUAL('"', value[52]);
+            CHECK_EQUAL(']', value[53]);
+            CHECK_EQUAL((u8)0xc3, (u8)value[55]);
+            CHECK_EQUAL((u8)0xa9, (u8)value[56]);
+            CHECK_EQUAL((u8)0xf0, (u8)value[57]);
+            CHECK_EQUAL((u8)0x80, (u8)value[60]);
+        }
+
+        UNITTEST_TEST(not_json)
+        {
+            njson::document_t document(buffer_t(sMemory, sMemory + sizeof(sMemory)));
+            CHECK_FALSE(document.parse(ascii::make_crunes("{\"a\":1")));
+            CHECK_FALSE(document.parse(ascii::make_crunes("{\"a\":\"b}")));
+            CHECK_FALSE(document.parse(ascii::make_crunes("[1,2]]")));
+            CHECK_FALSE(document.parse(ascii::make_crunes("[1,2}")));
+            CHECK_FALSE(document.parse(ascii::make_crunes("{\"a\":1} {\"b\":2}")));
+            CHECK_FALSE(document.parse(ascii::make_crunes("   ")));
+            CHECK_EQUAL((s32)njson::kind_none, document.root().m_kind);
+            CHECK_EQUAL((s32)njson::kind_none, document.find("a").m_kind);
+
+            // A scalar is a document too
+            CHECK_TRUE(document.parse(ascii::make_crunes(" -12 \r\n")));
+            s64 value = 0;
+            CHECK_TRUE(document.as_s64(document.root(), value));
+            CHECK_EQUAL(-12, (s32)value);
+
+            // More structurals than fit the memory
+            njson::document_t small(buffer_t(sMemory, sMemory + njson::document_t::required(4)));
+            CHECK_TRUE(small.parse(ascii::make_crunes("[1,2]")));
+            CHECK_FALSE(small.parse(ascii::make_crunes("[1,2,3]")));
+        }
+
+        UNITTEST_TEST(lines_of_a_stream)
+        {
+            const char*     text = "{\"n\":1}\n\n  \r\n{\"n\":2, \"s\":\"x\"}\r\n{\"n\":\n{\"n\":4}";
+            memory_stream_t stream((u8 const*)text, ascii::make_crunes(text).m_end);
+            text_stream_t   input(&stream, text_stream_t::encoding_utf8);
+
+            njson::document_t document(buffer_t(sMemory, sMemory + sizeof(sMemory)));
+            s64               sum   = 0;
+            s32               lines = 0;
+            s32               bad   = 0;
+            while (document.read(input))
+            {
+                lines += 1;
+                s64 n = 0;
+                if (document.valid() && document.as_s64(document.find("n"), n))
+                    sum += n;
+                else
+                    bad += 1;
+            }
+            CHECK_EQUAL(4, lines);
+            CHECK_EQUAL(1, bad);
+            CHECK_EQUAL(7, (s32)sum);
+            input.close();
+        }
+    }
+}
+UNITTEST_SUITE_END
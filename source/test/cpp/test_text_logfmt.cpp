@@ -0,0 +1,164 @@
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+#include "ctext/c_text_logfmt.h"
+#include "ctext/c_text_scan.h"
+#include "cunittest/cunittest.h"
+
+using namespace ncore;
+
+namespace ncore
+{
+    static bool span_is(crunes_t const& line, u32 begin, u32 end, const char* text)
+    {
+        for (u32 i = begin; i < end; ++i, ++text)
+        {
+            if (*text != line.m_ascii[i])
+                return false;
+        }
+        return *text == 0;
+    }
+
+    static bool key_is(crunes_t const& line, nlogfmt::pair_t const& pair, const char* text) { return span_is(line, pair.m_key_begin, pair.m_key_end, text); }
+    static bool value_is(crunes_t const& line, nlogfmt::pair_t const& pair, const char* text) { return span_is(line, pair.m_value_begin, pair.m_value_end, text); }
+
+    static bool equal(const char* a, const char* b)
+    {
+        while (*a != 0 && *a == *b)
+        {
+            ++a;
+            ++b;
+        }
+        return *a == *b;
+    }
+} // namespace ncore
+
+static u8 sMemory[16384];
+
+UNITTEST_SUITE_BEGIN(test_text_logfmt)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_FIXTURE_SETUP() {}
+        UNITTEST_FIXTURE_TEARDOWN() {}
+
+        UNITTEST_TEST(escaped_bytes)
+        {
+            // a\"b\\"c : the quote after one backslash is escaped, the quote after two is not
+            u64 carry   = 0;
+            u64 escaped = nscan::escaped64(((u64)1 << 1) | ((u64)1 << 4) | ((u64)1 << 5), carry);
+            CHECK_EQUAL(((u64)1 << 2) | ((u64)1 << 5), escaped);
+            CHECK_EQUAL((u64)0, carry);
+
+            // A backslash in the last byte escapes the first byte of the next block
+            escaped = nscan::escaped64((u64)1 << 63, carry);
+            CHECK_EQUAL((u64)0, escaped);
+            CHECK_EQUAL((u64)1, carry);
+            escaped = nscan::escaped64((u64)1, carry);
+            CHECK_EQUAL((u64)1, escaped);
+            CHECK_EQUAL((u64)0, carry);
+        }
+
+        UNITTEST_TEST(pairs)
+        {
+            crunes_t const  line = ascii::make_crunes("ts=17 level=info  msg=\"said \\\"a=b c\\\"\" debug path=/x=y empty=\r\n");
+            nlogfmt::pair_t pairs[8];
+            s32 const       count = nlogfmt::tokenize(line, pairs, 8);
+            CHECK_EQUAL(6, count);
+            CHECK_TRUE(key_is(line, pairs[0], "ts"));
+            CHECK_TRUE(value_is(line, pairs[0], "17"));
+            CHECK_TRUE(value_is(line, pairs[1], "info"));
+            CHECK_TRUE(key_is(line, pairs[2], "msg"));
+            CHECK_TRUE(value_is(line, pairs[2], "said \\\"a=b c\\\""));
+            CHECK_EQUAL(1, pairs[2].m_quoted);
+            CHECK_EQUAL(0, pairs[1].m_quoted);
+            CHECK_TRUE(key_is(line, pairs[3], "debug"));
+            CHECK_TRUE(value_is(line, pairs[3], ""));
+            CHECK_TRUE(value_is(line, pairs[4], "/x=y"));
+            CHECK_TRUE(key_is(line, pairs[5], "empty"));
+            CHECK_TRUE(value_is(line, pairs[5], ""));
+
+            char      msg[32];
+            crunes_t  value = line;
+            value.m_str     = pairs[2].m_value_begin;
+            value.m_end     = pairs[2].m_value_end;
+            s32 const n     = nlogfmt::unescape(value, msg, sizeof(msg) - 1);
+            msg[n]          = 0;
+            CHECK_TRUE(equal(msg, "said \"a=b c\""));
+
+            // Not more than 'max_pairs'
+            CHECK_EQUAL(2, nlogfmt::tokenize(line, pairs, 2));
+            CHECK_EQUAL(0, nlogfmt::tokenize(ascii::make_crunes("  \n"), pairs, 8));
+        }
+
+        UNITTEST_TEST(quotes_and_escapes_across_blocks)
+        {
+            // The quoted value starts in the first block of 64 bytes and ends in the third, a run of three
+            // backslashes over the first and second block escapes the quote after it
+            char text[256];
+            s32  n = 0;
+            for (const char* s = "a=1 q=\""; *s != 0; ++s)
+                text[n++] = *s;
+            for (; n < 62; ++n)
+                text[n] = (n & 7) == 0 ? ' ' : 'x';
+            text[n++] = '\\';
+            text[n++] = '\\';
+            text[n++] = '\\';
+            text[n++] = '"';
+            text[n++] = '=';
+            for (; n < 140; ++n)
+                text[n] = (n & 3) == 0 ? ' ' : 'y';
+            text[n++] = '"';
+            for (const char* s = " last=2"; *s != 0; ++s)
+                text[n++] = *s;
+            text[n] = 0;
+
+            crunes_t const  line = ascii::make_crunes(text);
+            nlogfmt::pair_t pairs[8];
+            CHECK_EQUAL(3, nlogfmt::tokenize(line, pairs, 8));
+            CHECK_TRUE(key_is(line, pairs[1], "q"));
+            CHECK_EQUAL(1, pairs[1].m_quoted);
+            CHECK_EQUAL(7u, pairs[1].m_value_begin);
+            CHECK_EQUAL(140u, pairs[1].m_value_end);
+            CHECK_TRUE(key_is(line, pairs[2], "last"));
+            CHECK_TRUE(value_is(line, pairs[2], "2"));
+        }
+
+        UNITTEST_TEST(perfect_hash)
+        {
+            const char* names[] = {"ts", "level", "msg", "user", "latency_ms", "status", "path", "method", "host", "id", "trace", "span"};
+            s32 const   count   = sizeof(names) / sizeof(names[0]);
+            CHECK_TRUE(nlogfmt::keys_t::required(count) <= sizeof(sMemory));
+
+            nlogfmt::keys_t keys(buffer_t(sMemory, sMemory + sizeof(sMemory)));
+            CHECK_TRUE(keys.build(names, count));
+            CHECK_EQUAL(count, keys.count());
+            for (s32 i = 0; i < count; ++i)
+                CHECK_EQUAL(i, keys.find((u8 const*)names[i], ascii::make_crunes(names[i]).m_end));
+            CHECK_EQUAL(-1, keys.find((u8 const*)"lev", 3));
+            CHECK_EQUAL(-1, keys.find((u8 const*)"levels", 6));
+            CHECK_EQUAL(-1, keys.find((u8 const*)"", 0));
+
+            // Keys that are not unique never get a slot of their own, nor do keys that do not fit the memory
+            const char* twice[] = {"a", "b", "a"};
+            CHECK_FALSE(keys.build(twice, 3));
+            CHECK_EQUAL(-1, keys.find((u8 const*)"a", 1));
+            nlogfmt::keys_t small(buffer_t(sMemory, sMemory + 16));
+            CHECK_FALSE(small.build(names, count));
+        }
+
+        UNITTEST_TEST(extract_wanted_keys)
+        {
+            const char*     names[] = {"user", "status", "missing"};
+            nlogfmt::keys_t keys(buffer_t(sMemory, sMemory + sizeof(sMemory)));
+            CHECK_TRUE(keys.build(names, 3));
+
+            crunes_t const  line = ascii::make_crunes("ts=1 status=200 msg=\"user=eve\" user=bob status=500\n");
+            nlogfmt::pair_t values[3];
+            CHECK_EQUAL(2, nlogfmt::extract(line, keys, values));
+            CHECK_TRUE(value_is(line, values[0], "bob"));
+            CHECK_TRUE(value_is(line, values[1], "200"));
+            CHECK_EQUAL(values[2].m_key_begin, values[2].m_key_end);
+        }
+    }
+}
+UNITTEST_SUITE_END
@@ -0,0 +1,271 @@
+#include "cbase/c_allocator.h"
+#include "cbase/c_buffer.h"
+#include "ccore/c_stream.h"
+#include "cbase/c_runes.h"
+#include "ctext/c_parser2.h"
+#include "ctext/c_text_corpus.h"
+#include "ctext/c_text_pipeline.h"
+#include "ctext/c_text_stream.h"
+#include "cunittest/cunittest.h"
+
+#include <atomic>
+
+#include "c_test_stream.h"
+
+using namespace ncore;
+
+namespace ncore
+{
+    // Counts the allocations and frees of the segments, they happen on the reader thread and the sink thread
+    class pipeline_alloc_t : public alloc_t
+    {
+    public:
+        pipeline_alloc_t() : m_allocs(0), m_frees(0) {}
+        std::atomic<s32> m_allocs;
+        std::atomic<s32> m_frees;
+
+    protected:
+        virtual void* v_allocate(u32 size, u32 alignment)
+        {
+            m_allocs += 1;
+            return context_t::system_alloc()->allocate(size, alignment);
+        }
+        virtual void v_deallocate(void* ptr)
+        {
+            m_frees += 1;
+            context_t::system_alloc()->deallocate(ptr);
+        }
+    };
+
+    // The result of a line is its length
+    class length_worker_t : public npipeline::worker_t
+    {
+    public:
+        virtual void parse(npipeline::batch_t& batch)
+        {
+            for (s32 i = 0; i < batch.m_count; ++i)
+                batch.m_results[i] = (s32)(batch.m_lines[i].m_end - batch.m_lines[i].m_str);
+        }
+    };
+
+    // Checks that the lines arrive in the order of the text and that they are still intact
+    class check_sink_t : public npipeline::sink_t
+    {
+    public:
+        check_sink_t(u8 const* text) : m_text(text), m_offset(0), m_batches(0), m_lines(0), m_matches(0), m_errors(0) {}
+
+        virtual void consume(npipeline::batch_t const& batch)
+        {
+            m_errors += (batch.m_index == m_batches) ? 0 : 1;
+            for (s32 i = 0; i < batch.m_count; ++i)
+            {
+                crunes_t const& line   = batch.m_lines[i];
+                u32 const       length = line.m_end - line.m_str;
+                for (u32 j = 0; j < length; ++j)
+                    m_errors += ((char)m_text[m_offset + j] == line.m_ascii[line.m_str + j]) ? 0 : 1;
+                m_offset += length;
+                m_matches += batch.m_results[i];
+            }
+            m_batches += 1;
+            m_lines += batch.m_count;
+        }
+
+        u8 const* m_text;
+        u32       m_offset;
+        u64       m_batches;
+        s64       m_lines;
+        s64       m_matches;
+        s32       m_errors;
+    };
+
+    // Checks that every chunk is a run of complete lines, the sizes add up to the size of the text
+    class chunk_check_t : public npipeline::chunk_worker_t
+    {
+    public:
+        chunk_check_t() : m_bytes(0), m_chunks(0), m_largest(0), m_errors(0) {}
+
+        virtual void parse(crunes_t const& chunk)
+        {
+            u32 const size = chunk.m_end - chunk.m_str;
+            m_errors += (size > 0 && chunk.m_ascii[chunk.m_end - 1] == '\n') ? 0 : 1;
+            m_errors += (chunk.m_str == 0 || chunk.m_ascii[chunk.m_str - 1] == '\n') ? 0 : 1;
+            m_bytes += size;
+            m_chunks += 1;
+            m_largest = (size > m_largest) ? size : m_largest;
+        }
+
+        u64 m_bytes;
+        s64 m_chunks;
+        u32 m_largest;
+        s32 m_errors;
+    };
+} // namespace ncore
+
+static u8 sText[65536];
+static u8 sMemory[262144];
+
+UNITTEST_SUITE_BEGIN(test_text_pipeline)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_FIXTURE_SETUP() {}
+        UNITTEST_FIXTURE_TEARDOWN() {}
+
+        UNITTEST_TEST(ordered_lines)
+        {
+            ncorpus::config_t corpus;
+            u32               lines = 0;
+            u32 const         size  = ncorpus::generate(corpus, sText, sizeof(sText), lines);
+
+            // Small batches and few of them, the reader has to wait for the sink
+            npipeline::config_t config;
+            config.m_batch_lines = 16;
+            config.m_batches     = 4;
+            CHECK_TRUE(npipeline::pipeline_t::required(3, config) <= sizeof(sMemory));
+
+            length_worker_t      workers[3];
+            npipeline::worker_t* stages[3] = {&workers[0], &workers[1], &workers[2]};
+
+            for (s32 view = 0; view < 2; ++view)
+            {
+                pipeline_alloc_t alloc;
+                {
+                    memory_stream_t stream(sText, size, view == 1);
+                    text_stream_t   text(&stream, text_stream_t::encoding_ascii, &alloc, 512);
+
+                    npipeline::pipeline_t pipeline(buffer_t(sMemory, sMemory + sizeof(sMemory)), config);
+                    check_sink_t          sink(sText);
+                    CHECK_EQUAL((s64)lines, pipeline.run(text, stages, 3, sink));
+                    text.close();
+
+                    CHECK_EQUAL(0, sink.m_errors);
+                    CHECK_EQUAL((s64)lines, sink.m_lines);
+                    CHECK_EQUAL(size, sink.m_offset);
+                    CHECK_EQUAL((s64)size, sink.m_matches); // the sum of the line lengths
+                }
+                CHECK_EQUAL(alloc.m_allocs.load(), alloc.m_frees.load());
+                if (view == 1)
+                    CHECK_EQUAL(0, alloc.m_allocs.load());
+            }
+        }
+
+        UNITTEST_TEST(parser_per_worker)
+        {
+            // Every third line is a number
+            u32 size    = 0;
+            s64 numbers = 0;
+            for (s32 i = 0; i < 3000; ++i)
+            {
+                const char* line = (i % 3 == 0) ? "4711\n" : "none\n";
+                while (*line != 0)
+                    sText[size++] = (u8)*line++;
+                numbers += (i % 3 == 0) ? 1 : 0;
+            }
+
+            static u8         data[2][4096];
+            parser2::parser_t first(buffer_t(data[0], data[0] + sizeof(data[0])));
+            parser2::parser_t second(buffer_t(data[1], data[1] + sizeof(data[1])));
+
+            npipeline::parse_worker_t workers[2] = {npipeline::parse_worker_t(first.Unsigned32()), npipeline::parse_worker_t(second.Unsigned32())};
+            npipeline::worker_t*      stages[2]  = {&workers[0], &workers[1]};
+
+            memory_stream_t       stream(sText, size, false);
+            text_stream_t         text(&stream, text_stream_t::encoding_ascii, nullptr, 1024);
+            npipeline::pipeline_t pipeline(buffer_t(sMemory, sMemory + sizeof(sMemory)));
+            check_sink_t          sink(sText);
+            CHECK_EQUAL(3000, pipeline.run(text, stages, 2, sink));
+            text.close();
+
+            CHECK_EQUAL(0, sink.m_errors);
+            CHECK_EQUAL(numbers, sink.m_matches);
+        }
+
+        UNITTEST_TEST(memory_too_small)
+        {
+            length_worker_t      worker;
+            npipeline::worker_t* stages[1] = {&worker};
+
+            u32 const             required = npipeline::pipeline_t::required(1);
+            npipeline::pipeline_t pipeline(buffer_t(sMemory, sMemory + required - 128));
+
+            memory_stream_t stream(sText, 0, true);
+            text_stream_t   text(&stream, text_stream_t::encoding_ascii);
+            check_sink_t    sink(sText);
+            CHECK_EQUAL(-1, pipeline.run(text, stages, 1, sink));
+            CHECK_EQUAL(0, sink.m_batches);
+
+            npipeline::scheduler_t     scheduler(buffer_t(sMemory, sMemory + npipeline::scheduler_t::required(4) - 128));
+            chunk_check_t              checks[4];
+            npipeline::chunk_worker_t* workers[4] = {&checks[0], &checks[1], &checks[2], &checks[3]};
+            CHECK_EQUAL(-1, scheduler.run(ascii::make_crunes("a\n"), workers, 4));
+        }
+
+        UNITTEST_TEST(scheduler_splits_into_lines)
+        {
+            ncorpus::config_t corpus;
+            u32               lines = 0;
+            u32 const         size  = ncorpus::generate(corpus, sText, sizeof(sText), lines);
+            crunes_t const    text  = make_crunes((ascii::pcrune)sText, 0, size, size);
+
+            CHECK_TRUE(npipeline::scheduler_t::required(4) <= sizeof(sMemory));
+            npipeline::scheduler_t scheduler(buffer_t(sMemory, sMemory + sizeof(sMemory)));
+
+            for (s32 num_workers = 1; num_workers <= 4; ++num_workers)
+            {
+                chunk_check_t              checks[4];
+                npipeline::chunk_worker_t* workers[4] = {&checks[0], &checks[1], &checks[2], &checks[3]};
+
+                s64 const tasks = scheduler.run(text, workers, num_workers, 1024);
+                CHECK_TRUE(tasks >= (s64)(size / 1024));
+
+                u64 bytes  = 0;
+                s64 chunks = 0;
+                for (s32 i = 0; i < num_workers; ++i)
+                {
+                    CHECK_EQUAL(0, checks[i].m_errors);
+                    CHECK_TRUE(checks[i].m_largest <= 1024);
+                    bytes += checks[i].m_bytes;
+                    chunks += checks[i].m_chunks;
+                }
+                CHECK_EQUAL((u64)size, bytes);
+                CHECK_EQUAL(tasks, chunks);
+                if (num_workers == 1)
+                    CHECK_EQUAL(0, scheduler.steals());
+            }
+        }
+
+        UNITTEST_TEST(scheduler_finds_the_same_matches)
+        {
+            ncorpus::config_t corpus;
+            corpus.m_emails = 30;
+            u32       lines = 0;
+            u32 const size  = ncorpus::generate(corpus, sText, sizeof(sText), lines);
+
+            // One thread over the whole text
+            static u8         data[5][4096];
+            parser2::parser_t single(buffer_t(data[4], data[4] + sizeof(data[4])));
+            s64               expected = 0;
+            {
+                npipeline::find_worker_t find(single.Email());
+                find.parse(make_crunes((ascii::pcrune)sText, 0, size, size));
+                expected = find.matches();
+            }
+            CHECK_TRUE(expected > 0);
+
+            parser2::parser_t first(buffer_t(data[0], data[0] + sizeof(data[0])));
+            parser2::parser_t second(buffer_t(data[1], data[1] + sizeof(data[1])));
+            parser2::parser_t third(buffer_t(data[2], data[2] + sizeof(data[2])));
+            parser2::parser_t fourth(buffer_t(data[3], data[3] + sizeof(data[3])));
+            npipeline::find_worker_t   finds[4]   = {npipeline::find_worker_t(first.Email()), npipeline::find_worker_t(second.Email()), npipeline::find_worker_t(third.Email()), npipeline::find_worker_t(fourth.Email())};
+            npipeline::chunk_worker_t* workers[4] = {&finds[0], &finds[1], &finds[2], &finds[3]};
+
+            npipeline::scheduler_t scheduler(buffer_t(sMemory, sMemory + sizeof(sMemory)));
+            CHECK_TRUE(scheduler.run(make_crunes((ascii::pcrune)sText, 0, size, size), workers, 4, 2048) > 4);
+            s64 found = 0;
+            for (s32 i = 0; i < 4; ++i)
+                found += finds[i].matches();
+            CHECK_EQUAL(expected, found);
+        }
+    }
+}
+UNITTEST_SUITE_END
@@ -2,6 +2,9 @@
 #include "ccore/c_stream.h"
 #include "cbase/c_runes.h"
 #include "ctext/c_text_stream.h"
+#include "ctext/c_parser2.h"
+#include "ctext/c_text_corpus.h"
+#include "ctext/c_text_scan.h"
 #include "cunittest/cunittest.h"
 
 extern unsigned char   read_text_txt[];
@@ -56,7 +59,7 @@ namespace ncore
             s64 i = 0;
             while (i < count && m_cursor < m_size)
             {
-                buffer[i] = m_buffer[m_cursor++];
+                buffer[i++] = m_buffer[m_cursor++];
             }
             return i;
         }
@@ -82,6 +85,116 @@ namespace ncore
 
         virtual s64 v_write(const u8* buffer, s64 count) { return -1; }
     };
+
+    // A stream that can only be read, text_stream_t has to copy the data into its own buffer
+    class mem_read_stream : public mem_stream
+    {
+    public:
+        mem_read_stream(u8 const* data, uint_t length) : mem_stream(data, length) {}
+
+    protected:
+        virtual bool v_canView() const { return false; }
+    };
+
+    static char* write_u32(char* cursor, u32 value)
+    {
+        char digits[10];
+        s32  n = 0;
+        do
+        {
+            digits[n++] = (char)('0' + (value % 10));
+            value /= 10;
+        } while (value != 0);
+        while (n > 0)
+            *cursor++ = digits[--n];
+        return cursor;
+    }
+
+    // Counts the allocations, forwards to the system allocator
+    class counting_alloc_t : public alloc_t
+    {
+    public:
+        counting_alloc_t() : m_allocs(0), m_frees(0) {}
+        s32 m_allocs;
+        s32 m_frees;
+
+    protected:
+        virtual void* v_allocate(u32 size, u32 alignment)
+        {
+            m_allocs += 1;
+            return context_t::system_alloc()->allocate(size, alignment);
+        }
+        virtual void v_deallocate(void* ptr)
+        {
+            m_frees += 1;
+            context_t::system_alloc()->deallocate(ptr);
+        }
+    };
+
+    // Multi-line records "record <n>:\n  value = <n*7>\n"
+    static u32 write_records(char* text, s32 count)
+    {
+        char* cursor = text;
+        for (s32 i = 0; i < count; ++i)
+        {
+            const char* record = "record ";
+            while (*record != 0)
+                *cursor++ = *record++;
+            cursor = write_u32(cursor, (u32)i);
+            const char* value = ":\n  value = ";
+            while (*value != 0)
+                *cursor++ = *value++;
+            cursor = write_u32(cursor, (u32)(i * 7));
+            *cursor++ = '\n';
+        }
+        return (u32)(cursor - text);
+    }
+
+    static s32 parse_records(text_stream_t& text)
+    {
+        u8                data[2048];
+        parser2::parser_t p(buffer_t(data, data + sizeof(data)));
+
+        s32    index = -1;
+        s32    value = -1;
+        va_r_t index_var(&index);
+        va_r_t value_var(&value);
+
+        // clang-format off
+        parser2::parser_t::program_t record = p.Sequence(
+            p.Exact(ascii::make_crunes("record ")),
+            p.Extract(&index_var, p.Unsigned32()),
+            p.Exact(ascii::make_crunes(":\n  value = ")),
+            p.Sequence(p.Extract(&value_var, p.Unsigned32()), p.EndOfLine())
+        );
+        // clang-format on
+
+        s32  count = 0;
+        bool last  = false;
+        while (true)
+        {
+            crunes_t window;
+            text.window(window);
+            nrunes::reader_t reader(window);
+
+            s32 result;
+            if (last)
+                result = parser2::parser_t::parse(record, reader) ? parser2::parser_t::cMATCH : parser2::parser_t::cNOMATCH;
+            else
+                result = parser2::parser_t::parse_partial(record, reader);
+
+            if (result == parser2::parser_t::cNEEDMORE)
+            {
+                last = !text.more();
+                continue;
+            }
+            if (result == parser2::parser_t::cNOMATCH || index != count || value != count * 7)
+                break;
+            text.consume(reader.get_cursor());
+            count += 1;
+        }
+        return count;
+    }
 } // namespace ncore
 
 using namespace ncore;
@@ -108,6 +221,350 @@ UNITTEST_SUITE_BEGIN(test_text_stream)
             text.close();
             memtext.close();
         }
+
+        UNITTEST_TEST(read_lines_across_buffer_boundaries)
+        {
+            mem_read_stream memtext(read_text_txt, read_text_txt_len);
+            text_stream_t   text(&memtext, text_stream_t::encoding_ascii);
+
+            crunes_t thisstr = ascii::make_crunes("this ");
+            crunes_t line;
+            u32      length = 0;
+            while (text.readLine(line))
+            {
+                CHECK_TRUE(nrunes::starts_with(line, thisstr));
+                length += line.m_end - line.m_str;
+            }
+            CHECK_EQUAL(read_text_txt_len, length);
+
+            text.close();
+        }
+
+        UNITTEST_TEST(read_generated_corpus)
+        {
+            // Lines of many lengths with a mix of line ends, through the buffer of a stream that cannot be viewed
+            static u8         corpus[65536];
+            ncorpus::config_t config;
+            config.m_max_line = 1000;
+            config.m_crlf     = 50;
+            u32       lines   = 0;
+            u32 const size    = ncorpus::generate(config, corpus, sizeof(corpus), lines);
+
+            mem_read_stream memtext(corpus, size);
+            text_stream_t   text(&memtext, text_stream_t::encoding_ascii, nullptr, 256);
+
+            crunes_t line;
+            u32      count  = 0;
+            u32      length = 0;
+            while (text.readLine(line))
+            {
+                count += 1;
+                length += line.m_end - line.m_str;
+            }
+            CHECK_EQUAL(lines, count);
+            CHECK_EQUAL(size, length);
+
+            text.close();
+        }
+
+        UNITTEST_TEST(stats)
+        {
+            static u8         corpus[16384];
+            ncorpus::config_t config;
+            config.m_max_line = 400;
+            u32       lines   = 0;
+            u32 const size    = ncorpus::generate(config, corpus, sizeof(corpus), lines);
+
+            for (s32 view = 0; view < 2; ++view)
+            {
+                mem_stream      viewable(corpus, size);
+                mem_read_stream readable(corpus, size);
+                text_stream_t   text(view ? (istream_t*)&viewable : (istream_t*)&readable, text_stream_t::encoding_ascii, nullptr, 1024);
+
+                crunes_t line;
+                u32      longest = 0;
+                while (text.readLine(line))
+                    longest = (line.m_end - line.m_str) > longest ? (line.m_end - line.m_str) : longest;
+
+                text_stream_t::stats_t stats;
+                if (text.stats(stats))
+                {
+                    CHECK_EQUAL(lines, stats.m_lines);
+                    CHECK_EQUAL(longest, stats.m_longest_line);
+                    CHECK_EQUAL(size, stats.m_bytes_read);
+                    CHECK_TRUE(stats.m_refills >= size / 1024);
+                    CHECK_TRUE(stats.m_bytes_carried > 0);
+                    CHECK_EQUAL(view ? stats.m_refills + 1 : 0, stats.m_views);
+                    CHECK_TRUE(view ? stats.m_rewinds > 0 : stats.m_rewinds == 0);
+                }
+                else
+                {
+                    CHECK_EQUAL(0, stats.m_lines);
+                }
+                text.close();
+            }
+        }
+
+        UNITTEST_TEST(retained_lines)
+        {
+            static u8         corpus[8192];
+            ncorpus::config_t config;
+            u32               lines = 0;
+            u32 const         size  = ncorpus::generate(config, corpus, sizeof(corpus), lines);
+
+            static crunes_t                  batch[1024];
+            static text_stream_t::segment_t* segments[1024];
+            CHECK_TRUE(lines <= 1024);
+
+            // Every line stays valid after refills until its segment is released
+            counting_alloc_t alloc;
+            {
+                mem_read_stream memtext(corpus, size);
+                text_stream_t   text(&memtext, text_stream_t::encoding_ascii, &alloc, 512);
+                u32             count = 0;
+                while (count < 1024 && text.readLine(batch[count], segments[count]))
+                {
+                    CHECK_NOT_NULL(segments[count]);
+                    count += 1;
+                }
+                CHECK_EQUAL(lines, count);
+                text.close();
+
+                u32 offset = 0;
+                for (u32 i = 0; i < count; ++i)
+                {
+                    u32 const length = batch[i].m_end - batch[i].m_str;
+                    for (u32 j = 0; j < length; ++j)
+                        CHECK_EQUAL((char)corpus[offset + j], batch[i].m_ascii[batch[i].m_str + j]);
+                    offset += length;
+                    text_stream_t::release(segments[i]);
+                }
+                CHECK_EQUAL(size, offset);
+            }
+            CHECK_TRUE(alloc.m_allocs > 1);
+            CHECK_EQUAL(alloc.m_allocs, alloc.m_frees);
+
+            // Lines of a view are not in a segment
+            mem_stream    viewable(corpus, size);
+            text_stream_t text(&viewable, text_stream_t::encoding_ascii, nullptr, 512);
+            CHECK_TRUE(text.readLine(batch[0], segments[0]));
+            CHECK_NULL(segments[0]);
+            text.close();
+        }
+
+        UNITTEST_TEST(lines_in_flight)
+        {
+            static u8         corpus[8192];
+            ncorpus::config_t config;
+            u32               lines = 0;
+            u32 const         size  = ncorpus::generate(config, corpus, sizeof(corpus), lines);
+
+            // A reader that keeps the last 8 lines, the released segments are reused by the refills
+            counting_alloc_t alloc;
+            {
+                mem_read_stream           memtext(corpus, size);
+                text_stream_t             text(&memtext, text_stream_t::encoding_ascii, &alloc, 256);
+                crunes_t                  line;
+                text_stream_t::segment_t* ring[8] = {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
+                u32                       count   = 0;
+                u32                       bytes   = 0;
+                while (text.readLine(line, ring[count & 7]))
+                {
+                    bytes += line.m_end - line.m_str;
+                    count += 1;
+                    text_stream_t::release(ring[count & 7]);
+                    ring[count & 7] = nullptr;
+                }
+                CHECK_EQUAL(lines, count);
+                CHECK_EQUAL(size, bytes);
+                CHECK_TRUE(size / 256 > 16);
+
+                // The first refills allocate, after that the segments are recycled
+                CHECK_TRUE(alloc.m_allocs <= 8);
+
+                // Lines can still be released after the stream has been closed
+                text.close();
+                for (s32 i = 0; i < 8; ++i)
+                    text_stream_t::release(ring[i]);
+            }
+            CHECK_EQUAL(alloc.m_allocs, alloc.m_frees);
+        }
+
+        UNITTEST_TEST(allocations)
+        {
+            // A stream that can be viewed does not need a buffer
+            counting_alloc_t alloc;
+            {
+                mem_stream    memtext(read_text_txt, read_text_txt_len);
+                text_stream_t text(&memtext, text_stream_t::encoding_ascii, &alloc, 1024);
+                crunes_t      line;
+                while (text.readLine(line)) {}
+                text.close();
+            }
+            CHECK_EQUAL(0, alloc.m_allocs);
+
+            // Otherwise the buffer is allocated once, lines are shorter than the buffer
+            {
+                mem_read_stream memtext(read_text_txt, read_text_txt_len);
+                text_stream_t   text(&memtext, text_stream_t::encoding_ascii, &alloc, 1024);
+                CHECK_EQUAL(1024, text.capacity());
+                crunes_t line;
+                while (text.readLine(line)) {}
+                text.close();
+            }
+            CHECK_EQUAL(1, alloc.m_allocs);
+        }
+
+        UNITTEST_TEST(utf8_validation)
+        {
+            u8 const* plain = (u8 const*)"plain ascii text that is longer than 16 bytes";
+            bool      ascii = false;
+            CHECK_TRUE(nscan::validate_utf8(plain, plain + 45, ascii));
+            CHECK_TRUE(ascii);
+
+            u8 const valid[] = {'a', 0xc3, 0xa9, 'b', 0xe2, 0x82, 0xac, 0xf0, 0x9f, 0x98, 0x80, 'c'};
+            CHECK_TRUE(nscan::validate_utf8(valid, valid + sizeof(valid), ascii));
+            CHECK_FALSE(ascii);
+
+            // A sequence cut off at the end is accepted, the rest can follow in the next block
+            CHECK_TRUE(nscan::validate_utf8(valid, valid + 6, ascii));
+
+            u8 const overlong[]  = {'a', 0xc0, 0x80};
+            u8 const surrogate[] = {0xed, 0xa0, 0x80};
+            u8 const too_high[]  = {0xf4, 0x90, 0x80, 0x80};
+            u8 const missing[]   = {0xe2, 0x82, 'x'};
+            u8 const lone[]      = {'a', 0x80, 'b'};
+            CHECK_FALSE(nscan::validate_utf8(overlong, overlong + sizeof(overlong), ascii));
+            CHECK_FALSE(nscan::validate_utf8(surrogate, surrogate + sizeof(surrogate), ascii));
+            CHECK_FALSE(nscan::validate_utf8(too_high, too_high + sizeof(too_high), ascii));
+            CHECK_FALSE(nscan::validate_utf8(missing, missing + sizeof(missing), ascii));
+            CHECK_FALSE(nscan::validate_utf8(lone, lone + sizeof(lone), ascii));
+
+            CHECK_EQUAL(0, nscan::utf8_incomplete(valid, valid + sizeof(valid)));
+            CHECK_EQUAL(0, nscan::utf8_incomplete(valid, valid + 7));
+            CHECK_EQUAL(2, nscan::utf8_incomplete(valid, valid + 6));
+            CHECK_EQUAL(3, nscan::utf8_incomplete(valid, valid + 10));
+            CHECK_EQUAL(1, nscan::utf8_incomplete(valid + 4, valid + 5));
+            CHECK_EQUAL(0, nscan::utf8_incomplete(valid + 5, valid + 6));
+        }
+
+        UNITTEST_TEST(utf8_cut_off_by_the_end_of_the_stream)
+        {
+            // The euro sign is cut off by the end of the stream, in a window of its own and in a larger one
+            u8 const cut[] = {'a', 'b', '\n', 'c', 0xe2, 0x82};
+            for (s32 view = 0; view < 2; ++view)
+            {
+                for (u32 size = 4; size <= 64; size += 60)
+                {
+                    mem_stream      viewable(cut, sizeof(cut));
+                    mem_read_stream readable(cut, sizeof(cut));
+                    text_stream_t   stream(view ? (istream_t*)&viewable : (istream_t*)&readable, text_stream_t::encoding_utf8, nullptr, size);
+                    crunes_t        line;
+                    u32             length = 0;
+                    while (stream.readLine(line))
+                        length += line.m_end - line.m_str;
+                    CHECK_EQUAL((u32)sizeof(cut), length);
+                    CHECK_FALSE(stream.is_utf8());
+                    stream.close();
+                }
+            }
+
+            // The same text completed is valid
+            u8 const complete[] = {'a', 'b', '\n', 'c', 0xe2, 0x82, 0xac};
+            mem_stream    viewable(complete, sizeof(complete));
+            text_stream_t stream(&viewable, text_stream_t::encoding_utf8, nullptr, 4);
+            crunes_t      line;
+            while (stream.readLine(line)) {}
+            CHECK_TRUE(stream.is_utf8());
+            stream.close();
+        }
+
+        UNITTEST_TEST(ascii_windows_of_a_utf8_stream)
+        {
+            // ASCII lines followed by lines with multi-byte sequences that are cut by the buffer of the stream
+            static u8 text[4096];
+            u32       size = 0;
+            for (s32 l = 0; l < 40; ++l)
+            {
+                for (s32 i = 0; i < 20; ++i)
+                    text[size++] = (u8)('a' + (i % 26));
+                text[size++] = '\n';
+            }
+            u32 const ascii_size = size;
+            for (s32 l = 0; l < 40; ++l)
+            {
+                for (s32 i = 0; i < 7; ++i)
+                {
+                    text[size++] = 0xe2; // the euro sign
+                    text[size++] = 0x82;
+                    text[size++] = 0xac;
+                }
+                text[size++] = '\n';
+            }
+
+            for (s32 view = 0; view < 2; ++view)
+            {
+                mem_stream      viewable(text, size);
+                mem_read_stream readable(text, size);
+                text_stream_t   stream(view ? (istream_t*)&viewable : (istream_t*)&readable, text_stream_t::encoding_utf8, nullptr, 64);
+
+                crunes_t line;
+                u32      length = 0;
+                s32      errors = 0;
+                while (stream.readLine(line))
+                {
+                    // Lines in the ASCII part can share a window with the first multi-byte lines
+                    bool const in_ascii = (length + (line.m_end - line.m_str)) <= ascii_size;
+                    if (!in_ascii)
+                        errors += (line.m_type == utf8::TYPE && !stream.is_ascii()) ? 0 : 1;
+                    else if (length < ascii_size / 2)
+                        errors += (line.m_type == ascii::TYPE && stream.is_ascii()) ? 0 : 1;
+                    length += line.m_end - line.m_str;
+                }
+                CHECK_EQUAL(0, errors);
+                CHECK_EQUAL(size, length);
+                CHECK_TRUE(stream.is_utf8());
+                stream.close();
+            }
+
+            // Invalid UTF-8 is remembered, an ASCII stream is not validated
+            text[ascii_size + 1] = 0x41;
+            mem_stream    invalid(text, size);
+            text_stream_t stream(&invalid, text_stream_t::encoding_utf8);
+            crunes_t      line;
+            while (stream.readLine(line)) {}
+            CHECK_FALSE(stream.is_utf8());
+            stream.close();
+
+            mem_stream    plain(text, size);
+            text_stream_t ascii_stream(&plain, text_stream_t::encoding_ascii);
+            CHECK_TRUE(ascii_stream.is_ascii());
+            CHECK_TRUE(ascii_stream.readLine(line));
+            CHECK_EQUAL((s32)ascii::TYPE, (s32)line.m_type);
+            ascii_stream.close();
+        }
+
+        UNITTEST_TEST(parse_records_from_view_stream)
+        {
+            static char records[64 * 1024];
+            u32 const   size = write_records(records, 2000);
+
+            mem_stream    memtext((u8 const*)records, size);
+            text_stream_t text(&memtext, text_stream_t::encoding_ascii);
+            CHECK_EQUAL(2000, parse_records(text));
+            text.close();
+        }
+
+        UNITTEST_TEST(parse_records_from_read_stream)
+        {
+            static char records[64 * 1024];
+            u32 const   size = write_records(records, 2000);
+
+            mem_read_stream memtext((u8 const*)records, size);
+            text_stream_t   text(&memtext, text_stream_t::encoding_ascii);
+            CHECK_EQUAL(2000, parse_records(text));
+            text.close();
+        }
     }
 }
 UNITTEST_SUITE_END